@@ -38,15 +38,18 @@ void DataPoint::setData(const std::vector<char>& newData) {
 */
 
 std::vector<char> DataPoint::serialize(GlobalParameters* config) const {
-    std::vector<char> data = Storable::serializeLongLong(id); // Start with the ID
-
-    Storable::appendData(data, this->data); // Append the point data
-
-    Storable::appendData(data, point.serialize(config)); // Append the point data at the end
-
+    std::vector<char> data(getSerializedSize(config));
+    serializeInto(config, std::as_writable_bytes(std::span(data)));
     return data;
 }
 
+// ID, then the data, then the point at the end
+size_t DataPoint::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+    size_t offset = Storable::writeLongLong(out, 0, id);
+    offset = Storable::writeChars(out, offset, data);
+    return offset + point.serializeInto(config, out.subspan(offset));
+}
+
 DataPoint DataPoint::deserialize(GlobalParameters* config, const std::vector<char>& data) {
     if (data.size() < getSerializedSize(config)) {
         throw std::invalid_argument("Data size is too small for DataPoint deserialization.");
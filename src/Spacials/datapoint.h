@@ -31,6 +31,7 @@ public:
 
     // Serialize the DataPoint to a string representation
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
 
     // Deserialize the DataPoint from a string representation
     static DataPoint deserialize(GlobalParameters* config, const std::vector<char>& data);
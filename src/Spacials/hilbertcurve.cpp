@@ -0,0 +1,67 @@
+#include "hilbertcurve.h"
+#include <algorithm>
+#include <cmath>
+
+HilbertCurve::HilbertCurve(const Region& bounds) {
+    dimensions = bounds.getStart().size();
+    if (dimensions == 0) {
+        throw std::invalid_argument("A Hilbert curve needs a bounding box with at least one dimension.");
+    }
+    bitsPerDimension = std::clamp(HILBERT_KEY_BITS / dimensions, 1, HILBERT_MAX_BITS_PER_DIMENSION);
+    low = bounds.getStart();
+    scale.resize(dimensions);
+    double cells = std::ldexp(1.0, bitsPerDimension);
+    for (int d = 0; d < dimensions; ++d) {
+        double extent = bounds.getEnd()[d] - low[d];
+        scale[d] = extent > 0.0 ? cells / extent : 0.0;
+    }
+}
+
+uint64_t HilbertCurve::key(const double* coords) const {
+    // Grid cell of the point in each dimension
+    uint64_t maxCell = (uint64_t(1) << bitsPerDimension) - 1;
+    std::vector<uint64_t> x(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        double cell = (coords[d] - low[d]) * scale[d];
+        x[d] = cell <= 0.0 ? 0 : std::min(maxCell, static_cast<uint64_t>(cell));
+    }
+
+    // Skilling's AxestoTranspose: afterwards bit b of x[d] is bit b * dimensions + (dimensions - 1 - d) of the index
+    uint64_t top = uint64_t(1) << (bitsPerDimension - 1);
+    for (uint64_t q = top; q > 1; q >>= 1) {
+        uint64_t p = q - 1;
+        for (int d = 0; d < dimensions; ++d) {
+            if (x[d] & q) {
+                x[0] ^= p; // Invert
+            }
+            else {
+                uint64_t t = (x[0] ^ x[d]) & p; // Exchange
+                x[0] ^= t;
+                x[d] ^= t;
+            }
+        }
+    }
+    for (int d = 1; d < dimensions; ++d) {
+        x[d] ^= x[d - 1]; // Gray encode
+    }
+    uint64_t t = 0;
+    for (uint64_t q = top; q > 1; q >>= 1) {
+        if (x[dimensions - 1] & q) {
+            t ^= q - 1;
+        }
+    }
+    for (int d = 0; d < dimensions; ++d) {
+        x[d] ^= t;
+    }
+
+    // Interleave the bits from the most significant, up to HILBERT_KEY_BITS of them
+    uint64_t result = 0;
+    int bits = 0;
+    for (int b = bitsPerDimension - 1; b >= 0 && bits < HILBERT_KEY_BITS; --b) {
+        for (int d = 0; d < dimensions && bits < HILBERT_KEY_BITS; ++d) {
+            result = (result << 1) | ((x[d] >> b) & 1);
+            bits++;
+        }
+    }
+    return result << (HILBERT_KEY_BITS - bits); // Left-aligned, so keys of any dimensions compare alike
+}
@@ -0,0 +1,36 @@
+#ifndef HILBERTCURVE_H
+#define HILBERTCURVE_H
+
+#include <cstdint>
+#include <vector>
+#include "point.h"
+#include "region.h"
+
+#define HILBERT_KEY_BITS 64 // Bits of a Hilbert key
+#define HILBERT_MAX_BITS_PER_DIMENSION 32 // Finest grid, reached in 1 and 2 dimensions
+
+class HilbertCurve {
+    // Position of points along a Hilbert curve through a bounding box, for any number of dimensions.
+    // The box is cut into a grid of 2^bitsPerDimension cells per dimension, and the key of a point is the index
+    // of its cell along the curve, computed with Skilling's transform (Programming the Hilbert curve, 2004).
+    // Cells next to each other along the curve are next to each other in space, so ordering points by key
+    // keeps points that are close in space close in the order.
+    // bitsPerDimension is HILBERT_KEY_BITS / dimensions (at least 1), so the index fits in a key. With more than
+    // HILBERT_KEY_BITS dimensions, the key keeps the leading bits of the index: the order of a coarser curve.
+    // Points outside the box are clamped to its border cells.
+private:
+    int dimensions;
+    int bitsPerDimension;
+    std::vector<double> low; // Start of the box
+    std::vector<double> scale; // Cells per unit in each dimension, 0 where the box is flat
+public:
+    explicit HilbertCurve(const Region& bounds);
+
+    uint64_t key(const double* coords) const; // coords holds one value per dimension
+    uint64_t key(const Point& point) const { return key(point.getCoordinates().data()); }
+
+    int getDimensions() const { return dimensions; }
+    int getBitsPerDimension() const { return bitsPerDimension; }
+};
+
+#endif // HILBERTCURVE_H
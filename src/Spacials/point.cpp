@@ -17,6 +17,15 @@ std::string Point::toString(GlobalParameters* config) const {
     return result;
 }
 
+double Point::squaredDistance(const Point& other) const {
+    double result = 0.0;
+    for (size_t i = 0; i < coords.size(); ++i) {
+        double difference = coords[i] - other.coords[i];
+        result += difference * difference;
+    }
+    return result;
+}
+
 bool operator==(const Point& lhs, const Point& rhs) {
     return lhs.getCoordinates() == rhs.getCoordinates();
 }
@@ -29,6 +38,17 @@ std::vector<char> Point::serialize(GlobalParameters* config) const {
     return Storable::serializeDoubles(coords);
 }
 
+// An empty point (an unused slot) is written as zeros
+size_t Point::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+    if (coords.empty()) {
+        return Storable::writeZeros(out, 0, getSerializedSize(config));
+    }
+    if (coords.size() != config->dimensions) {
+        throw std::invalid_argument("Point has " + std::to_string(coords.size()) + " dimensions, expected " + std::to_string(config->dimensions) + ".");
+    }
+    return Storable::writeDoubles(out, 0, coords);
+}
+
 // Deserialize the point from a string representation
 Point Point::deserialize(GlobalParameters* config, const std::vector<char>& data) {
     if (data.size() < config->dimensions * sizeof(double)) {
@@ -24,11 +24,14 @@ public:
     // Get the start and end coordinates of the point (both are the same)
     const std::vector<double>& getStart() const override { return coords; }
     const std::vector<double>& getEnd() const override { return coords; }
+    // Squared Euclidean distance to another point of the same dimensions
+    double squaredDistance(const Point& other) const;
     // For printing the point, NOT for serialization
     std::string toString(GlobalParameters* config) const;
 
     // Storage stuff:
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
     static Point deserialize(GlobalParameters* config, const std::vector<char>& data);
     static int getSerializedSize(GlobalParameters* config);
 };
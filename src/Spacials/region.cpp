@@ -1,14 +1,16 @@
 #include "region.h"
 #include <cstring> // For memcpy
+#include <algorithm>
 
 Region::Region(const std::vector<double>& startCoords, const std::vector<double>& endCoords) {
     if (startCoords.size() != endCoords.size()) {
         throw std::invalid_argument("Start and end coordinates must have the same dimension.");
     }
     for(size_t i = 0; i < startCoords.size(); ++i) {
-        if (startCoords[i] >= endCoords[i]) {
-            // Ensure that no point or invalid region is accidentally passed as a region
-            throw std::invalid_argument("Start coordinates must be less than end coordinates in each dimension.");
+        if (startCoords[i] > endCoords[i]) {
+            // Ensure that no invalid region is accidentally passed as a region
+            // Degenerate (zero-width) regions are allowed, as they are the MBRs of points and point sets
+            throw std::invalid_argument("Start coordinates must be less than or equal to end coordinates in each dimension.");
         }
         start.push_back(startCoords[i]);
         end.push_back(endCoords[i]);
@@ -45,16 +47,81 @@ double Region::overlap(const Region& other) const {
         if (start[i] >= other.end[i] || other.start[i] >= end[i]) {
             return 0.0; // No overlap in this dimension
         }
-        overlapArea *= std::min(end[i] - other.start[i], other.end[i] - start[i]); // one will be <= 0
+        overlapArea *= std::min(end[i], other.end[i]) - std::max(start[i], other.start[i]);
     }
     return overlapArea;
 }
 
+// Smallest region enclosing both this region and the other object
+Region Region::enlarged(const AbstractBoundedClass& other) const {
+    const std::vector<double>& otherStart = other.getStart();
+    const std::vector<double>& otherEnd = other.getEnd();
+    if (start.empty()) {
+        return Region(otherStart, otherEnd); // An empty region grows into the other object
+    }
+
+    std::vector<double> newStart(start.size());
+    std::vector<double> newEnd(end.size());
+    for (size_t i = 0; i < start.size(); ++i) {
+        newStart[i] = std::min(start[i], otherStart[i]);
+        newEnd[i] = std::max(end[i], otherEnd[i]);
+    }
+    return Region(newStart, newEnd);
+}
+
+// Area increase needed to include the other object, as used in ChooseSubtree
+double Region::enlargement(const AbstractBoundedClass& other) const {
+    return enlarged(other).area() - area();
+}
+
+std::vector<double> Region::center() const {
+    std::vector<double> result(start.size());
+    for (size_t i = 0; i < start.size(); ++i) {
+        result[i] = (start[i] + end[i]) / 2.0;
+    }
+    return result;
+}
+
+double Region::minDist(const Point& point) const {
+    const std::vector<double>& coords = point.getCoordinates();
+    double result = 0.0;
+    for (size_t i = 0; i < start.size(); ++i) {
+        double difference = 0.0;
+        if (coords[i] < start[i]) {
+            difference = start[i] - coords[i];
+        }
+        else if (coords[i] > end[i]) {
+            difference = coords[i] - end[i];
+        }
+        result += difference * difference;
+    }
+    return result;
+}
+
+double Region::minMaxDist(const Point& point) const {
+    const std::vector<double>& coords = point.getCoordinates();
+    // Distance to the farthest corner, then in each dimension swap in the nearer face instead
+    double farthest = 0.0;
+    for (size_t i = 0; i < start.size(); ++i) {
+        double middle = (start[i] + end[i]) / 2.0;
+        double far = coords[i] >= middle ? coords[i] - start[i] : end[i] - coords[i];
+        farthest += far * far;
+    }
+    double result = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < start.size(); ++i) {
+        double middle = (start[i] + end[i]) / 2.0;
+        double near = coords[i] <= middle ? coords[i] - start[i] : end[i] - coords[i];
+        double far = coords[i] >= middle ? coords[i] - start[i] : end[i] - coords[i];
+        result = std::min(result, farthest - far * far + near * near);
+    }
+    return result;
+}
+
 // Can be used to check both if a path should be taken (overlaps Region) 
 // and if a point is inside the region (overlaps Point)
 bool Region::overlaps(const AbstractBoundedClass& other) const  {
-    std::vector<double> otherStart = other.getStart();
-    std::vector<double> otherEnd = other.getEnd();
+    const std::vector<double>& otherStart = other.getStart();
+    const std::vector<double>& otherEnd = other.getEnd();
 
     // Check for overlap in each dimension
     for(size_t i = 0; i < start.size(); ++i) {
@@ -108,13 +175,26 @@ bool operator==(const Region& lhs, const Region& rhs) {
 
 // Serialize the object to a string representation
 std::vector<char> Region::serialize(GlobalParameters* config) const {
+    std::vector<char> data(getSerializedSize(config));
+    serializeInto(config, std::as_writable_bytes(std::span(data)));
+    return data;
+}
+
+size_t Region::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
     if (start.size() != end.size()) {
         throw std::invalid_argument("Mismatched start/end dimensions during serialization");
     }
 
-    std::vector<char> data = Storable::serializeDoubles(start);
-    Storable::appendData(data, Storable::serializeDoubles(end));
-    return data;
+    if (start.empty()) {
+        // An empty region (e.g. the box of an empty node) is stored as zeros
+        return Storable::writeZeros(out, 0, getSerializedSize(config));
+    }
+    if (start.size() != config->dimensions) {
+        throw std::invalid_argument("Region has " + std::to_string(start.size()) + " dimensions, expected " + std::to_string(config->dimensions) + ".");
+    }
+
+    size_t offset = Storable::writeDoubles(out, 0, start);
+    return Storable::writeDoubles(out, offset, end);
 }
 
 // Deserialize the object from a string representation
@@ -6,6 +6,7 @@
 #include "abstractBoundedClass.h"
 #include <limits>
 #include "storable.h"
+#include "point.h"
 
 class Region: public AbstractBoundedClass, public Storable {
     // This class represents a multi-dimensional rectangular region defined by its start and end coordinates.
@@ -28,6 +29,16 @@ public:
     double combinedArea(const Region& other) const;
     double combinedMargin(const Region& other) const;
     double overlap(const Region& other) const;
+    // Get the smallest region enclosing this and the other object, and the area it adds (used in ChooseSubtree)
+    Region enlarged(const AbstractBoundedClass& other) const;
+    double enlargement(const AbstractBoundedClass& other) const;
+    // Get the center of the region, used to order entries in R*-tree reinsertion
+    std::vector<double> center() const;
+    // Squared distances to a point, as used in nearest neighbor search (Roussopoulos et al., 1995)
+    // MINDIST: lower bound of the distance to any object in the region
+    // MINMAXDIST: upper bound of the distance to the nearest object, if every face of the region touches an object
+    double minDist(const Point& point) const;
+    double minMaxDist(const Point& point) const;
     // Can be used to check both if a path should be taken (overlaps Region) 
     // and if a point is inside the region (overlaps Point)
     bool overlaps(const AbstractBoundedClass& other) const;
@@ -37,6 +48,7 @@ public:
 
     // Storage stuff:
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
     static int getSerializedSize(GlobalParameters* config);
     static Region deserialize(GlobalParameters* config, const std::vector<char>& data);
     
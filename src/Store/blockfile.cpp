@@ -0,0 +1,253 @@
+#include "blockfile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "storable.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+static std::runtime_error ioError(const std::string& what, const std::string& filename) {
+    return std::runtime_error(what + " '" + filename + "': " + std::strerror(errno));
+}
+
+BlockFile::BlockFile(const std::string& filename, GlobalParameters* config, int pageSize) {
+    this->filename = filename;
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw ioError("Cannot open block file", filename);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw ioError("Cannot stat block file", filename);
+    }
+
+    if (info.st_size > 0) {
+        // Existing file: the metadata block is the source of truth for the parameters
+        try {
+            readMetadata();
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        *config = parameters;
+        return;
+    }
+
+    // New file
+    this->pageSize = pageSize > 0 ? roundToPage(pageSize) : pageSizeFor(config);
+    this->parameters = *config;
+    this->numBlocks = 1;
+    writeMetadata();
+}
+
+BlockFile::~BlockFile() {
+    if (fd >= 0) {
+        try {
+            writeMetadata();
+        }
+        catch (const std::exception&) {
+            // Nothing sensible to do in a destructor, the previous metadata block stays valid
+        }
+        ::close(fd);
+    }
+}
+
+/*
+===================================================
+================== Metadata block =================
+===================================================
+*/
+
+// Layout: magic, version, pageSize, maxChildren, dimensions, numBlocks, rootID, height, count, childBoxBits, leafFormat
+// Version 1 files end at count and hold doubles in their interior pages, version 2 files end at childBoxBits
+// and hold plain leaves
+void BlockFile::writeMetadata() {
+    std::vector<char> data = Storable::serializeInts({BLOCKFILE_MAGIC, BLOCKFILE_VERSION, pageSize,
+        parameters.maxChildren, parameters.dimensions, numBlocks, rootID, height});
+    Storable::appendData(data, Storable::serializeLongLong(count));
+    Storable::appendData(data, Storable::serializeInts({parameters.childBoxBits, parameters.leafFormat}));
+    writeBlock(0, data);
+}
+
+void BlockFile::readMetadata() {
+    // The page size is not known yet, so read the fixed-size part of the header first
+    // Older versions have less of it, but a page is always larger than the newest one
+    std::vector<char> data(10 * sizeof(int) + sizeof(long long));
+    if (::pread(fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+        throw std::runtime_error("Block file '" + filename + "' has a truncated metadata block.");
+    }
+
+    std::vector<int> fields = Storable::deserializeInts(data, 0, 8);
+    if (fields[0] != BLOCKFILE_MAGIC) {
+        throw std::runtime_error("File '" + filename + "' is not a block file.");
+    }
+    if (fields[1] < 1 || fields[1] > BLOCKFILE_VERSION) {
+        throw std::runtime_error("Block file '" + filename + "' has unsupported version " + std::to_string(fields[1]) + ".");
+    }
+    pageSize = fields[2];
+    parameters.maxChildren = fields[3];
+    parameters.dimensions = fields[4];
+    numBlocks = fields[5];
+    rootID = fields[6];
+    height = fields[7];
+    count = Storable::deserializeLongLong(data, 8 * sizeof(int));
+    parameters.childBoxBits = fields[1] < 2 ? 0 : Storable::deserializeInt(data, 8 * sizeof(int) + sizeof(long long));
+    parameters.leafFormat = fields[1] < 3 ? 0 : Storable::deserializeInt(data, 9 * sizeof(int) + sizeof(long long));
+    reads++;
+}
+
+/*
+===================================================
+==================== Block I/O ====================
+===================================================
+*/
+
+void BlockFile::readBlock(int blockID, char* buffer) {
+    if (blockID < 0 || blockID >= numBlocks) {
+        throw std::out_of_range("Block " + std::to_string(blockID) + " does not exist in '" + filename + "'.");
+    }
+    off_t offset = static_cast<off_t>(blockID) * pageSize;
+    ssize_t done = 0;
+    while (done < pageSize) {
+        ssize_t result = ::pread(fd, buffer + done, pageSize - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result == 0) {
+            // Past the end of the file: a reserved block not written yet
+            std::memset(buffer + done, 0, pageSize - done);
+            break;
+        }
+        if (result < 0) {
+            throw ioError("Cannot read block " + std::to_string(blockID) + " of", filename);
+        }
+        done += result;
+    }
+    reads++;
+}
+
+void BlockFile::writeBlock(int blockID, const char* buffer) {
+    if (blockID < 0 || blockID >= numBlocks) {
+        throw std::out_of_range("Block " + std::to_string(blockID) + " does not exist in '" + filename + "'.");
+    }
+    off_t offset = static_cast<off_t>(blockID) * pageSize;
+    ssize_t done = 0;
+    while (done < pageSize) {
+        ssize_t result = ::pwrite(fd, buffer + done, pageSize - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw ioError("Cannot write block " + std::to_string(blockID) + " of", filename);
+        }
+        done += result;
+    }
+    writes++;
+}
+
+std::vector<char> BlockFile::readBlock(int blockID) {
+    std::vector<char> data(pageSize);
+    readBlock(blockID, data.data());
+    return data;
+}
+
+void BlockFile::writeBlock(int blockID, const std::vector<char>& data) {
+    if (data.size() > pageSize) {
+        throw std::invalid_argument("Data of " + std::to_string(data.size()) + " bytes does not fit in a page of " + std::to_string(pageSize) + " bytes.");
+    }
+    if (data.size() == pageSize) {
+        writeBlock(blockID, data.data());
+        return;
+    }
+    std::vector<char> page(data);
+    page.resize(pageSize, 0);
+    writeBlock(blockID, page.data());
+}
+
+int BlockFile::allocateBlock() {
+    int blockID = numBlocks++;
+    writeBlock(blockID, std::vector<char>(pageSize, 0));
+    return blockID;
+}
+
+int BlockFile::reserveBlock() {
+    return numBlocks++;
+}
+
+int BlockFile::appendBlocks(const char* buffer, int count) {
+    if (count < 0) {
+        throw std::invalid_argument("Cannot append a negative number of blocks.");
+    }
+    int firstID = numBlocks;
+    off_t offset = static_cast<off_t>(firstID) * pageSize;
+    size_t total = static_cast<size_t>(count) * pageSize;
+    size_t done = 0;
+    while (done < total) {
+        ssize_t result = ::pwrite(fd, buffer + done, total - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw ioError("Cannot append blocks to", filename);
+        }
+        done += result;
+    }
+    numBlocks += count;
+    writes += count;
+    return firstID;
+}
+
+void BlockFile::truncate(int keepBlocks) {
+    if (keepBlocks < 1) {
+        throw std::invalid_argument("The metadata block cannot be truncated.");
+    }
+    if (::ftruncate(fd, static_cast<off_t>(keepBlocks) * pageSize) != 0) {
+        throw ioError("Cannot truncate block file", filename);
+    }
+    numBlocks = keepBlocks;
+    rootID = -1;
+    height = 0;
+    count = 0;
+    writeMetadata();
+}
+
+void BlockFile::sync() {
+    if (::fsync(fd) != 0) {
+        throw ioError("Cannot sync block file", filename);
+    }
+}
+
+/*
+===================================================
+==================== Page sizes ===================
+===================================================
+*/
+
+int BlockFile::roundToPage(int bytes) {
+    return std::max(1, (bytes + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT) * BLOCK_ALIGNMENT;
+}
+
+int BlockFile::pageSizeFor(GlobalParameters* config) {
+    return roundToPage(std::max(TreeLeafNode::getSerializedSize(config), TreeInteriorNode::getSerializedSize(config)));
+}
+
+int BlockFile::maxChildrenFor(GlobalParameters* config, int pageSize) {
+    GlobalParameters shape = *config;
+    shape.maxChildren = 2;
+    if (std::max(TreeLeafNode::getSerializedSize(&shape), TreeInteriorNode::getSerializedSize(&shape)) > pageSize) {
+        throw std::invalid_argument("Pages of " + std::to_string(pageSize) + " bytes cannot hold nodes of 2 entries.");
+    }
+    while (true) {
+        shape.maxChildren++;
+        if (std::max(TreeLeafNode::getSerializedSize(&shape), TreeInteriorNode::getSerializedSize(&shape)) > pageSize) {
+            return shape.maxChildren - 1;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef BLOCKFILE_H
+#define BLOCKFILE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "globalparameters.h"
+
+#define BLOCK_ALIGNMENT 4096 // Pages are multiples of the OS page size
+#define BLOCKFILE_MAGIC 0x52535452 // "RSTR"
+#define BLOCKFILE_VERSION 3 // 2 added childBoxBits, 3 added leafFormat
+
+class BlockFile {
+    // A file of fixed-size pages addressed by block ID, read and written with pread/pwrite.
+    // Block 0 is the metadata block: it persists the GlobalParameters, the page size
+    // and a small header (root, height, record count) for the structure stored in the file.
+    // Every other block is one page, so reading a node or a data block costs exactly one page read.
+private:
+    int fd = -1;
+    std::string filename;
+    int pageSize;
+    int numBlocks; // Including the metadata block
+    GlobalParameters parameters; // As stored in the metadata block
+
+    // Header of the structure stored in the file
+    int rootID = -1;
+    int height = 0;
+    long long count = 0;
+
+    // I/O counters, in pages (atomic, as the pool writes pages back from several threads)
+    std::atomic<long long> reads = 0;
+    std::atomic<long long> writes = 0;
+
+    void readMetadata();
+
+    // Prevent copying and assignment
+    BlockFile(const BlockFile&) = delete;
+    BlockFile& operator=(const BlockFile&) = delete;
+public:
+    // Opens the file if it exists and is not empty, loading config from its metadata block.
+    // Otherwise creates it with the given config and page size (0 to use pageSizeFor(config)).
+    BlockFile(const std::string& filename, GlobalParameters* config, int pageSize = 0);
+    ~BlockFile();
+
+    // Page addressed I/O. Buffers must hold exactly getPageSize() bytes.
+    void readBlock(int blockID, char* buffer);
+    void writeBlock(int blockID, const char* buffer);
+    std::vector<char> readBlock(int blockID);
+    void writeBlock(int blockID, const std::vector<char>& data); // Pads data up to the page size
+
+    int allocateBlock(); // Appends a zeroed block and returns its ID
+    // Appends a block without writing it and returns its ID, for pages first written whole through the pool.
+    // It reads as zeros until written.
+    int reserveBlock();
+    int appendBlocks(const char* buffer, int count); // Appends count pages with one write, returns the ID of the first
+    void truncate(int keepBlocks = 1); // Drops (or zero-fills up to) every block from keepBlocks on and resets the header
+    void writeMetadata();
+    void sync(); // fsync
+
+    // Getters & setters
+    int getPageSize() const { return pageSize; }
+    int getNumBlocks() const { return numBlocks; }
+    const std::string& getFilename() const { return filename; }
+    int getRootID() const { return rootID; }
+    void setRootID(int newRootID) { rootID = newRootID; }
+    int getHeight() const { return height; }
+    void setHeight(int newHeight) { height = newHeight; }
+    long long getCount() const { return count; }
+    void setCount(long long newCount) { count = newCount; }
+    long long getReads() const { return reads; }
+    long long getWrites() const { return writes; }
+
+    // Size of a page able to hold any tree node, rounded up to BLOCK_ALIGNMENT
+    static int pageSizeFor(GlobalParameters* config);
+    // Largest maxChildren whose nodes, with config's dimensions, childBoxBits and leafFormat, fit in pages of pageSize bytes
+    static int maxChildrenFor(GlobalParameters* config, int pageSize);
+    static int roundToPage(int bytes);
+};
+
+#endif // BLOCKFILE_H
@@ -1,8 +1,466 @@
 #include "buffer.h"
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include "storable.h"
+#include "hilbertcurve.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
 
+Buffer::Buffer(GlobalParameters* config, const std::string& treeFilename, const std::string& dataFilename, long long treeBufferSize, long long dataBufferSize) {
+    this->config = config;
+    // Open the tree file first, so that an existing index decides the parameters
+    treeFile = std::make_unique<BlockFile>(treeFilename, config);
+    dataFile = std::make_unique<BlockFile>(dataFilename, config, std::max<int>(DATA_BLOCK_SIZE, sizeof(int) + DataPoint::getSerializedSize(config)));
+    if (dataFile->getPageSize() < sizeof(int) + DataPoint::getSerializedSize(config)) {
+        throw std::invalid_argument("Data file '" + dataFilename + "' was created with different parameters.");
+    }
+    recordsPerBlock = (dataFile->getPageSize() - sizeof(int)) / DataPoint::getSerializedSize(config);
+
+    treePool = std::make_unique<BufferPool>(treeFile.get(), treeBufferSize);
+    dataPool = std::make_unique<BufferPool>(dataFile.get(), dataBufferSize);
+}
+
+Buffer::~Buffer() {
+    // The block files persist their metadata when closed
+}
+
+void Buffer::flush() {
+    treePool->flushAll();
+    dataPool->flushAll();
+    treeFile->writeMetadata();
+    dataFile->writeMetadata();
+    treeFile->sync();
+    dataFile->sync();
+}
+
+/*
+===================================================
+=================== Tree blocks ===================
+===================================================
+*/
+
+// Read a node, costing at most one page read (none if the page is cached)
+// The level (second field of every node) tells leaves from interior nodes
+std::shared_ptr<TreeNode> Buffer::readNode(int nodeID, NodeArena* arena, bool* hit) {
+    char* frame = treePool->pin(nodeID, true, hit);
+    std::vector<char> page(frame, frame + treeFile->getPageSize());
+    treePool->unpin(nodeID, false);
+
+    int level = Storable::deserializeInt(page, sizeof(int));
+    if (arena != nullptr) {
+        if (level == 0) {
+            return TreeLeafNode::deserialize(config, page, *arena);
+        }
+        return TreeInteriorNode::deserialize(config, page, *arena);
+    }
+    if (level == 0) {
+        return std::make_shared<TreeLeafNode>(TreeLeafNode::deserialize(config, page));
+    }
+    return std::make_shared<TreeInteriorNode>(TreeInteriorNode::deserialize(config, page));
+}
+
+// Write a node into its cached page, which reaches the file when evicted or flushed
+void Buffer::writeNode(const TreeNode& node) {
+    char* frame = treePool->pin(node.getID(), false); // The whole page is overwritten
+    std::span<std::byte> page(reinterpret_cast<std::byte*>(frame), treeFile->getPageSize());
+    try {
+        size_t written = node.serializeInto(config, page);
+        std::fill(page.begin() + written, page.end(), std::byte{0});
+    }
+    catch (...) {
+        treePool->unpin(node.getID(), false);
+        throw;
+    }
+    treePool->unpin(node.getID(), true);
+}
+
+PinnedPage Buffer::pinNode(int nodeID) {
+    if (nodeID < 1) {
+        throw std::out_of_range("Block " + std::to_string(nodeID) + " is not a tree node.");
+    }
+    return PinnedPage(treePool.get(), nodeID);
+}
+
+int Buffer::allocateNode() {
+    return treeFile->allocateBlock();
+}
+
+/*
+===================================================
+=================== Data blocks ===================
+===================================================
+*/
+
+// Append a DataPoint to the last data block, starting a new block when it is full
+std::pair<int, int> Buffer::addDataPoint(const DataPoint& dataPoint) {
+    int blockID = dataFile->getNumBlocks() - 1;
+    char* page = nullptr;
+    int count = recordsPerBlock; // Forces a new block if there is only the metadata block
+    if (blockID > 0) {
+        page = dataPool->pin(blockID);
+        count = Storable::deserializeInt(std::vector<char>(page, page + sizeof(int)));
+        if (count >= recordsPerBlock) {
+            dataPool->unpin(blockID, false);
+        }
+    }
+    if (count >= recordsPerBlock) {
+        blockID = dataFile->reserveBlock(); // Written once, when the pool writes the page back
+        page = dataPool->pin(blockID, false);
+        std::fill(page, page + dataFile->getPageSize(), 0);
+        count = 0;
+    }
+
+    std::span<std::byte> block(reinterpret_cast<std::byte*>(page), dataFile->getPageSize());
+    int recordSize = DataPoint::getSerializedSize(config);
+    try {
+        dataPoint.serializeInto(config, block.subspan(sizeof(int) + count * recordSize, recordSize));
+    }
+    catch (...) {
+        dataPool->unpin(blockID, true); // A new block was already zeroed
+        throw;
+    }
+    Storable::writeInt(block, 0, count + 1);
+    dataPool->unpin(blockID, true);
+    dataFile->setCount(dataFile->getCount() + 1);
+
+    return {blockID, count};
+}
+
+DataPoint Buffer::readDataPoint(int blockID, int recordID) {
+    if (blockID < 1) {
+        throw std::out_of_range("Block " + std::to_string(blockID) + " is not a data block.");
+    }
+    int recordSize = DataPoint::getSerializedSize(config);
+    char* page = dataPool->pin(blockID);
+    int count = Storable::deserializeInt(std::vector<char>(page, page + sizeof(int)));
+    if (recordID < 0 || recordID >= count) {
+        dataPool->unpin(blockID, false);
+        throw std::out_of_range("Record " + std::to_string(recordID) + " does not exist in data block " + std::to_string(blockID) + ".");
+    }
+    std::vector<char> record(page + sizeof(int) + recordID * recordSize, page + sizeof(int) + (recordID + 1) * recordSize);
+    dataPool->unpin(blockID, false);
+    return DataPoint::deserialize(config, record);
+}
+
+std::vector<DataPoint> Buffer::readDataBlock(int blockID) {
+    if (blockID < 1) {
+        throw std::out_of_range("Block " + std::to_string(blockID) + " is not a data block.");
+    }
+    char* frame = dataPool->pin(blockID);
+    std::vector<char> page(frame, frame + dataFile->getPageSize());
+    dataPool->unpin(blockID, false);
+
+    int count = Storable::deserializeInt(page, 0);
+    int recordSize = DataPoint::getSerializedSize(config);
+    std::vector<DataPoint> dataPoints;
+    for (int i = 0; i < count; ++i) {
+        std::vector<char> record(page.begin() + sizeof(int) + i * recordSize, page.begin() + sizeof(int) + (i + 1) * recordSize);
+        dataPoints.push_back(DataPoint::deserialize(config, record));
+    }
+    return dataPoints;
+}
+
+/*
+===================================================
+================ Data clustering ==================
+===================================================
+*/
+
+void Buffer::scanDataFile(const std::function<void(int blockID, int recordID, const char* record)>& visit) {
+    dataPool->flushAll();
+    int recordSize = DataPoint::getSerializedSize(config);
+    std::vector<char> page(dataFile->getPageSize());
+    for (int blockID = 1; blockID < dataFile->getNumBlocks(); ++blockID) {
+        dataFile->readBlock(blockID, page.data());
+        int count = Storable::deserializeInt(page, 0);
+        for (int i = 0; i < count; ++i) {
+            visit(blockID, i, page.data() + sizeof(int) + i * recordSize);
+        }
+    }
+}
+
+// Two scans of the file: the first finds the box the curve spans, the second sorts the records by key
+long long Buffer::clusterDataFile(WorkStealingPool& pool, long long memoryBudget, const std::string& tempDirectory, const DataMoveCallback& onMove) {
+    if (memoryBudget <= 0) {
+        throw std::invalid_argument("Memory budget must be positive.");
+    }
+    int dimensions = config->dimensions;
+    size_t pointOffset = sizeof(long long) + MAX_DATA_SIZE; // The point ends a serialized DataPoint
+    int recordSize = DataPoint::getSerializedSize(config);
+
+    std::vector<double> low(dimensions, std::numeric_limits<double>::infinity());
+    std::vector<double> high(dimensions, -std::numeric_limits<double>::infinity());
+    std::vector<double> coords(dimensions);
+    long long count = 0;
+    scanDataFile([&](int, int, const char* record) {
+        std::memcpy(coords.data(), record + pointOffset, dimensions * sizeof(double));
+        for (int d = 0; d < dimensions; ++d) {
+            low[d] = std::min(low[d], coords[d]);
+            high[d] = std::max(high[d], coords[d]);
+        }
+        count++;
+    });
+    if (count == 0) {
+        return 0;
+    }
+
+    // <key high, key low, blockID, recordID, DataPoint>, the 64-bit key split so that both halves are exact doubles
+    HilbertCurve curve(Region(low, high));
+    ExternalSorter records(EXTERNAL_SORT_KEYS + 2 + packedDataPointWidth(config), memoryBudget, pool, tempDirectory);
+    std::vector<double> entry(records.getWidth(), 0.0);
+    scanDataFile([&](int blockID, int recordID, const char* record) {
+        std::memcpy(coords.data(), record + pointOffset, dimensions * sizeof(double));
+        uint64_t key = curve.key(coords.data());
+        entry[0] = static_cast<double>(key >> 32);
+        entry[1] = static_cast<double>(key & 0xFFFFFFFFu);
+        entry[2] = blockID;
+        entry[3] = recordID;
+        std::memcpy(entry.data() + 4, record, recordSize);
+        records.add(entry.data());
+    });
+    if (!onMove) {
+        return rewriteDataFile(records);
+    }
+    return rewriteDataFile(records, [&](const double* record, int blockID, int recordID) {
+        onMove(static_cast<int>(record[2]), static_cast<int>(record[3]), blockID, recordID);
+    });
+}
+
+int Buffer::packedDataPointWidth(GlobalParameters* config) {
+    return (DataPoint::getSerializedSize(config) + sizeof(double) - 1) / sizeof(double);
+}
+
+// Copies the serialized DataPoint as it is, the doubles only carry its bytes through the sort
+void Buffer::packDataPoint(int blockID, int recordID, double* out) {
+    if (blockID < 1) {
+        throw std::out_of_range("Block " + std::to_string(blockID) + " is not a data block.");
+    }
+    int recordSize = DataPoint::getSerializedSize(config);
+    char* page = dataPool->pin(blockID);
+    int count = Storable::deserializeInt(std::vector<char>(page, page + sizeof(int)));
+    if (recordID < 0 || recordID >= count) {
+        dataPool->unpin(blockID, false);
+        throw std::out_of_range("Record " + std::to_string(recordID) + " does not exist in data block " + std::to_string(blockID) + ".");
+    }
+    std::memcpy(out, page + sizeof(int) + recordID * recordSize, recordSize);
+    dataPool->unpin(blockID, false);
+}
+
+// The sorter holds every record by now, so the file is emptied and refilled from the front,
+// DATA_REWRITE_PAGES full pages per write, bypassing the pool
+long long Buffer::rewriteDataFile(ExternalSorter& records, const DataRewriteCallback& onWrite) {
+    records.finish();
+    int recordSize = DataPoint::getSerializedSize(config);
+    int payload = records.getWidth() - packedDataPointWidth(config);
+    int pageSize = dataFile->getPageSize();
+    dataPool->discardAll();
+    dataFile->truncate();
+
+    std::vector<char> pages(static_cast<size_t>(DATA_REWRITE_PAGES) * pageSize, 0);
+    int pagesFilled = 0;
+    int count = 0; // Records in the page being filled
+    long long written = 0;
+    auto appendPages = [&]() {
+        dataFile->appendBlocks(pages.data(), pagesFilled);
+        std::fill(pages.begin(), pages.end(), 0);
+        pagesFilled = 0;
+    };
+    while (const double* record = records.next()) {
+        char* page = pages.data() + static_cast<size_t>(pagesFilled) * pageSize;
+        if (onWrite) {
+            onWrite(record, dataFile->getNumBlocks() + pagesFilled, count);
+        }
+        std::memcpy(page + sizeof(int) + count * recordSize, record + payload, recordSize);
+        count++;
+        Storable::writeInt(std::span(reinterpret_cast<std::byte*>(page), sizeof(int)), 0, count);
+        written++;
+        if (count == recordsPerBlock) {
+            count = 0;
+            pagesFilled++;
+            if (pagesFilled == DATA_REWRITE_PAGES) {
+                appendPages();
+            }
+        }
+    }
+    if (count > 0) {
+        pagesFilled++;
+    }
+    appendPages();
+    dataFile->setCount(written);
+    dataFile->writeMetadata();
+    return written;
+}
+
+/*
+===================================================
+=================== OSM loading ===================
+===================================================
+*/
+
+// Parse the attributes of a tag starting right after its name, up to the closing '>'
+// Returns a pointer past the tag, or nullptr if the tag is cut off by the end of the chunk
+static const char* parseNodeAttributes(const char* pos, const char* end, long long& id, double& lat, double& lon, int& found) {
+    found = 0;
+    while (true) {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) {
+            pos++;
+        }
+        if (pos >= end) {
+            return nullptr;
+        }
+        if (*pos == '>') {
+            return pos + 1;
+        }
+        if (*pos == '/') {
+            if (pos + 1 >= end) {
+                return nullptr;
+            }
+            return pos + 2; // "/>"
+        }
+
+        // name="value" (or single quotes)
+        const char* nameStart = pos;
+        const char* equals = static_cast<const char*>(std::memchr(pos, '=', end - pos));
+        if (equals == nullptr || equals + 1 >= end) {
+            return nullptr;
+        }
+        char quote = equals[1];
+        const char* valueStart = equals + 2;
+        const char* valueEnd = static_cast<const char*>(std::memchr(valueStart, quote, end - valueStart));
+        if (valueEnd == nullptr) {
+            return nullptr;
+        }
+
+        std::string_view name(nameStart, equals - nameStart);
+        if (name == "id") {
+            found |= std::from_chars(valueStart, valueEnd, id).ec == std::errc() ? 1 : 0;
+        }
+        else if (name == "lat") {
+            found |= std::from_chars(valueStart, valueEnd, lat).ec == std::errc() ? 2 : 0;
+        }
+        else if (name == "lon") {
+            found |= std::from_chars(valueStart, valueEnd, lon).ec == std::errc() ? 4 : 0;
+        }
+        pos = valueEnd + 1;
+    }
+}
 
 // Create new data from the OSM file provided
 // WARNING: Will delete anything that existed previously
-void Buffer::parseOSMFile(const std::string& filename) {
-    
-}
\ No newline at end of file
+long long Buffer::parseOSMFile(const std::string& filename, const OSMRecordCallback& onRecord, size_t chunkSize) {
+    if (config->dimensions != 2) {
+        throw std::invalid_argument("OSM nodes are 2-dimensional, but the buffer has " + std::to_string(config->dimensions) + " dimensions.");
+    }
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open OSM file '" + filename + "': " + std::strerror(errno));
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    dataPool->discardAll();
+    dataFile->truncate();
+
+    // Records are packed straight into pinned data pages
+    int recordSize = DataPoint::getSerializedSize(config);
+    int blockID = -1;
+    char* page = nullptr;
+    int count = 0;
+    auto finishBlock = [&]() {
+        Storable::writeInt(std::span(reinterpret_cast<std::byte*>(page), sizeof(int)), 0, count);
+        dataPool->unpin(blockID, true);
+    };
+
+    long long loaded = 0;
+    std::vector<char> chunk(chunkSize);
+    size_t carried = 0; // Bytes of an incomplete tag moved to the front of the chunk
+    bool endOfFile = false;
+    try {
+        while (!endOfFile) {
+            if (carried == chunk.size()) {
+                chunk.resize(chunk.size() * 2); // A single tag longer than the chunk
+            }
+            ssize_t bytesRead = ::read(fd, chunk.data() + carried, chunk.size() - carried);
+            if (bytesRead < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Cannot read OSM file '" + filename + "': " + std::strerror(errno));
+            }
+            endOfFile = bytesRead == 0;
+            const char* pos = chunk.data();
+            const char* end = chunk.data() + carried + bytesRead;
+            const char* incomplete = nullptr;
+
+            while (pos < end) {
+                const char* tag = static_cast<const char*>(std::memchr(pos, '<', end - pos));
+                if (tag == nullptr) {
+                    break;
+                }
+                // "<node" followed by whitespace; "<nd" and "<nodes" do not match
+                if (end - tag < 6) {
+                    incomplete = tag;
+                    break;
+                }
+                if (std::memcmp(tag + 1, "node", 4) != 0 || (tag[5] != ' ' && tag[5] != '\t' && tag[5] != '\n' && tag[5] != '\r')) {
+                    pos = tag + 1;
+                    continue;
+                }
+
+                long long id = 0;
+                double lat = 0.0, lon = 0.0;
+                int found;
+                const char* after = parseNodeAttributes(tag + 5, end, id, lat, lon, found);
+                if (after == nullptr) {
+                    incomplete = tag;
+                    break;
+                }
+                pos = after;
+                if (found != 7) {
+                    continue; // Nodes without coordinates (e.g. deleted ones in history files)
+                }
+
+                if (page == nullptr || count == recordsPerBlock) {
+                    if (page != nullptr) {
+                        finishBlock();
+                    }
+                    blockID = dataFile->reserveBlock();
+                    page = dataPool->pin(blockID, false);
+                    std::fill(page, page + dataFile->getPageSize(), 0);
+                    count = 0;
+                }
+                DataPoint dataPoint(std::vector<double>{lat, lon}, std::vector<char>(), id);
+                dataPoint.serializeInto(config, std::span(reinterpret_cast<std::byte*>(page) + sizeof(int) + count * recordSize, recordSize));
+                if (onRecord) {
+                    onRecord(dataPoint, blockID, count);
+                }
+                count++;
+                loaded++;
+            }
+
+            // Keep the incomplete tag for the next read, everything else is done
+            carried = 0;
+            if (incomplete != nullptr && !endOfFile) {
+                carried = end - incomplete;
+                std::memmove(chunk.data(), incomplete, carried);
+            }
+        }
+    }
+    catch (...) {
+        if (page != nullptr) {
+            finishBlock();
+        }
+        ::close(fd);
+        throw;
+    }
+
+    if (page != nullptr) {
+        finishBlock();
+    }
+    ::close(fd);
+    dataFile->setCount(loaded);
+    return loaded;
+}
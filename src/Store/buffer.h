@@ -2,21 +2,98 @@
 #define BUFFER_H
 
 #include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include "globalparameters.h"
+#include "blockfile.h"
+#include "bufferpool.h"
+#include "datapoint.h"
+#include "treenode.h"
+#include "nodearena.h"
+#include "externalsorter.h"
+
+#define DATA_BLOCK_SIZE 4096 // Size of a data block, rounded up if a single DataPoint does not fit
+#define DEFAULT_TREE_BUFFER_SIZE (64LL << 20) // Default t-buff-size in bytes
+#define DEFAULT_DATA_BUFFER_SIZE (64LL << 20) // Default d-buff-size in bytes
+#define OSM_CHUNK_SIZE (1 << 20) // Bytes read at a time from an OSM file
+#define DATA_REWRITE_PAGES 64 // Data pages appended with one write by rewriteDataFile
+
+// Called for every node loaded from an OSM file, with the IDs it was stored under
+typedef std::function<void(const DataPoint& dataPoint, int blockID, int recordID)> OSMRecordCallback;
+// Called for every record clusterDataFile moves, with its IDs before and after
+typedef std::function<void(int oldBlockID, int oldRecordID, int blockID, int recordID)> DataMoveCallback;
+// Called for every record rewriteDataFile writes: the sorted record and the IDs it was stored under
+typedef std::function<void(const double* record, int blockID, int recordID)> DataRewriteCallback;
 
 class Buffer {
+    // Gives access to the two block files of the project:
+    // the tree file, where each node is one block (node ID == block ID),
+    // and the data file, where each block packs DataPoints addressed by (blockID, recordID).
+    // Data block layout: number of records, then the serialized DataPoints.
+    // Each file is cached by its own buffer pool with its own memory budget (t-buff-size and d-buff-size),
+    // so that hot tree nodes are not pushed out by data blocks.
 private:
-    int size; // Size of the buffer in number of elements
-    void* data; // Pointer to the buffer data, can be any type
+    GlobalParameters* config;
+    std::unique_ptr<BlockFile> treeFile;
+    std::unique_ptr<BlockFile> dataFile;
+    // Declared after the files, so that they are destroyed (and flushed) first
+    std::unique_ptr<BufferPool> treePool;
+    std::unique_ptr<BufferPool> dataPool;
+    int recordsPerBlock; // DataPoints per data block
+
+    // Calls visit for every record of the data file, read straight from the file in block order
+    void scanDataFile(const std::function<void(int blockID, int recordID, const char* record)>& visit);
 
     // Prevent copying and assignment
     Buffer(const Buffer&) = delete;
     Buffer& operator=(const Buffer&) = delete;
 public:
-    Buffer(int size); // is size in memory or in number of elements?????
+    // Opens (or creates) both files. If the tree file exists, config is loaded from it.
+    // Buffer sizes are memory budgets in bytes for the tree and data pools.
+    Buffer(GlobalParameters* config, const std::string& treeFilename, const std::string& dataFilename,
+        long long treeBufferSize = DEFAULT_TREE_BUFFER_SIZE, long long dataBufferSize = DEFAULT_DATA_BUFFER_SIZE);
     ~Buffer();
 
-    void parseOSMFile(const std::string& filename);
+    // Tree node blocks
+    // Placed in the arena if given. Tells hit, if given, whether the node's page was in the tree pool.
+    std::shared_ptr<TreeNode> readNode(int nodeID, NodeArena* arena = nullptr, bool* hit = nullptr);
+    void writeNode(const TreeNode& node);
+    int allocateNode();
+    // Pin a node's page to read it in place with a LeafNodeView or InteriorNodeView
+    PinnedPage pinNode(int nodeID);
+
+    // Data blocks
+    std::pair<int, int> addDataPoint(const DataPoint& dataPoint); // <blockID, recordID>
+    DataPoint readDataPoint(int blockID, int recordID);
+    std::vector<DataPoint> readDataBlock(int blockID);
+    int getRecordsPerBlock() const { return recordsPerBlock; }
+
+    // Rewrites the data file with its DataPoints in the order of the Hilbert keys of their points (see HilbertCurve),
+    // so that points close in space share data blocks and a range query reads fewer of them.
+    // Every (blockID, recordID) changes, so this runs before a tree is built over the file; onMove is told the moves.
+    // Sorted externally in memoryBudget bytes on the pool's threads. Returns the number of records.
+    long long clusterDataFile(WorkStealingPool& pool, long long memoryBudget, const std::string& tempDirectory = "", const DataMoveCallback& onMove = nullptr);
+    // Building blocks of clusterDataFile for other orders: records of the sorter end with packedDataPointWidth doubles
+    // filled by packDataPoint, and rewriteDataFile replaces the contents of the data file with them in sorted order
+    static int packedDataPointWidth(GlobalParameters* config);
+    void packDataPoint(int blockID, int recordID, double* out);
+    long long rewriteDataFile(ExternalSorter& records, const DataRewriteCallback& onWrite = nullptr); // Calls records.finish()
+
+    // Write back dirty pages, persist the metadata blocks and fsync both files
+    void flush();
+
+    BlockFile* getTreeFile() { return treeFile.get(); }
+    BlockFile* getDataFile() { return dataFile.get(); }
+    BufferPool* getTreePool() { return treePool.get(); }
+    BufferPool* getDataPool() { return dataPool.get(); }
+
+    // Load the <node id lat lon> elements of an OSM XML file into the data file as DataPoints
+    // with coordinates (lat, lon) and the OSM ID. The file is streamed in chunks, so memory use
+    // depends on the chunk size and the data buffer size, not on the file size.
+    // Returns the number of nodes loaded.
+    long long parseOSMFile(const std::string& filename, const OSMRecordCallback& onRecord = nullptr, size_t chunkSize = OSM_CHUNK_SIZE);
 };
 
 
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
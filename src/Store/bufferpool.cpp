@@ -0,0 +1,238 @@
+#include "bufferpool.h"
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+BufferPool::BufferPool(BlockFile* file, long long budget) {
+    this->file = file;
+    this->pageSize = file->getPageSize();
+    if (budget < pageSize) {
+        throw std::invalid_argument("Buffer pool budget of " + std::to_string(budget) + " bytes cannot hold a page of " + std::to_string(pageSize) + " bytes.");
+    }
+    this->numFrames = budget / pageSize;
+
+    memory = static_cast<char*>(std::aligned_alloc(BLOCK_ALIGNMENT, static_cast<size_t>(numFrames) * pageSize));
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    frames.resize(numFrames);
+    // Hand out low frames first
+    for (int i = numFrames - 1; i >= 0; --i) {
+        freeFrames.push_back(i);
+    }
+}
+
+BufferPool::~BufferPool() {
+    try {
+        flushAll();
+    }
+    catch (const std::exception&) {
+        // Nothing sensible to do in a destructor
+    }
+    std::free(memory);
+}
+
+/*
+===================================================
+================== Pin and unpin ==================
+===================================================
+*/
+
+char* BufferPool::pin(int blockID, bool load, bool* hit) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        auto it = pageTable.find(blockID);
+        if (it != pageTable.end()) {
+            Frame& frame = frames[it->second];
+            if (frame.loading) {
+                // Another thread is reading the page; look again once it is done (or has failed)
+                loaded.wait(lock, [&] { return !pageTable.contains(blockID) || !frames[pageTable[blockID]].loading; });
+                continue;
+            }
+            frame.pinCount++;
+            frame.referenced = true;
+            stats.hits++;
+            if (hit != nullptr) {
+                *hit = true;
+            }
+            return frameData(it->second);
+        }
+
+        int victim = findVictim();
+        Frame& frame = frames[victim];
+        if (frame.dirty) {
+            int victimID = frame.blockID;
+            writeBack(victim, lock);
+            // Other threads ran while the page was written: they may have loaded blockID, or taken or changed the victim
+            if (pageTable.contains(blockID) || frame.blockID != victimID || frame.pinCount > 0 || frame.dirty) {
+                continue;
+            }
+        }
+
+        stats.misses++;
+        if (hit != nullptr) {
+            *hit = false;
+        }
+        if (frame.blockID != -1) {
+            pageTable.erase(frame.blockID);
+            stats.evictions++;
+        }
+
+        frame.blockID = blockID;
+        frame.pinCount = 1;
+        frame.dirty = false;
+        frame.referenced = true;
+        pageTable[blockID] = victim;
+        if (load) {
+            // Read without the mutex, so that pins of other pages go on meanwhile
+            frame.loading = true;
+            lock.unlock();
+            try {
+                file->readBlock(blockID, frameData(victim));
+            }
+            catch (...) {
+                lock.lock();
+                pageTable.erase(blockID);
+                frame = Frame();
+                freeFrames.push_back(victim);
+                loaded.notify_all();
+                throw;
+            }
+            lock.lock();
+            frame.loading = false;
+            loaded.notify_all();
+        }
+        return frameData(victim);
+    }
+}
+
+void BufferPool::unpin(int blockID, bool dirty) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = pageTable.find(blockID);
+    if (it == pageTable.end() || frames[it->second].pinCount == 0) {
+        throw std::logic_error("Block " + std::to_string(blockID) + " is not pinned.");
+    }
+    Frame& frame = frames[it->second];
+    frame.pinCount--;
+    frame.dirty = frame.dirty || dirty;
+}
+
+// CLOCK: sweep the frames, giving referenced frames a second chance
+int BufferPool::findVictim() {
+    if (!freeFrames.empty()) {
+        int frame = freeFrames.back();
+        freeFrames.pop_back();
+        return frame;
+    }
+
+    // Two full sweeps clear every reference bit, so no victim after that means all frames are pinned
+    for (int step = 0; step < 2 * numFrames; ++step) {
+        int candidate = clockHand;
+        clockHand = (clockHand + 1) % numFrames;
+
+        Frame& frame = frames[candidate];
+        if (frame.pinCount > 0) {
+            continue;
+        }
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        return candidate;
+    }
+    throw std::runtime_error("All " + std::to_string(numFrames) + " buffer pool frames are pinned.");
+}
+
+/*
+===================================================
+==================== Write back ===================
+===================================================
+*/
+
+void BufferPool::writeBack(int frame, std::unique_lock<std::mutex>& lock) {
+    int blockID = frames[frame].blockID;
+    // One write-back of a block at a time, so that they reach the file in order
+    writtenBack.wait(lock, [&] { return !writingBack.contains(blockID); });
+    if (frames[frame].blockID != blockID || !frames[frame].dirty) {
+        return; // Written back by another thread meanwhile
+    }
+
+    // Write a copy without the mutex, keeping the frame pinned so that it is not reused meanwhile
+    std::vector<char> image(frameData(frame), frameData(frame) + pageSize);
+    WriteBackHook hook = writeBackHook;
+    frames[frame].dirty = false;
+    frames[frame].pinCount++;
+    writingBack.insert(blockID);
+    lock.unlock();
+    try {
+        if (hook) {
+            hook(blockID);
+        }
+        file->writeBlock(blockID, image.data());
+    }
+    catch (...) {
+        lock.lock();
+        frames[frame].dirty = true;
+        frames[frame].pinCount--;
+        writingBack.erase(blockID);
+        writtenBack.notify_all();
+        throw;
+    }
+    lock.lock();
+    frames[frame].pinCount--;
+    writingBack.erase(blockID);
+    stats.writebacks++;
+    writtenBack.notify_all();
+}
+
+void BufferPool::flush(int blockID) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = pageTable.find(blockID);
+    if (it != pageTable.end()) {
+        writeBack(it->second, lock);
+    }
+}
+
+void BufferPool::flushAll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int i = 0; i < numFrames; ++i) {
+        if (frames[i].blockID != -1) {
+            writeBack(i, lock);
+        }
+    }
+    writtenBack.wait(lock, [&] { return writingBack.empty(); });
+}
+
+void BufferPool::discardAll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    writtenBack.wait(lock, [&] { return writingBack.empty(); });
+    for (int i = 0; i < numFrames; ++i) {
+        if (frames[i].pinCount > 0) {
+            throw std::logic_error("Block " + std::to_string(frames[i].blockID) + " is still pinned.");
+        }
+    }
+    pageTable.clear();
+    freeFrames.clear();
+    for (int i = numFrames - 1; i >= 0; --i) {
+        frames[i] = Frame();
+        freeFrames.push_back(i);
+    }
+    clockHand = 0;
+}
+
+void BufferPool::setWriteBackHook(WriteBackHook hook) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeBackHook = std::move(hook);
+}
+
+BufferPoolStats BufferPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void BufferPool::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats = BufferPoolStats();
+}
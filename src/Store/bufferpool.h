@@ -0,0 +1,110 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <functional>
+#include <span>
+#include <cstddef>
+#include "blockfile.h"
+
+// Counters of a buffer pool, used to size the pools
+struct BufferPoolStats {
+    long long hits = 0; // Pins served from memory
+    long long misses = 0; // Pins that read the page from the file
+    long long evictions = 0; // Frames reused for another page
+    long long writebacks = 0; // Dirty pages written to the file
+};
+
+// Called with a block's ID right before its dirty page is written back to the file.
+// The pool's mutex is not held, so the hook may block on I/O; the page stays pinned meanwhile.
+typedef std::function<void(int blockID)> WriteBackHook;
+
+class BufferPool {
+    // A fixed number of page frames caching the blocks of one BlockFile.
+    // Pinned frames are never evicted; unpinned ones are replaced with the CLOCK algorithm.
+    // Dirty pages are written back when evicted or flushed.
+    // All methods are thread safe; a pinned frame stays valid until unpinned.
+    // Write-backs release the mutex for their I/O, writing a copy of the page taken under the mutex.
+    // Misses read the page without the mutex too, while other pins of the same block wait for it.
+private:
+    struct Frame {
+        int blockID = -1; // -1 for free frames
+        int pinCount = 0;
+        bool dirty = false;
+        bool referenced = false; // CLOCK reference bit
+        bool loading = false; // Being read from the file, by the thread that pinned it first
+    };
+
+    BlockFile* file;
+    int pageSize;
+    int numFrames;
+    char* memory; // numFrames pages, page aligned
+    std::vector<Frame> frames;
+    std::vector<int> freeFrames;
+    std::unordered_map<int, int> pageTable; // blockID -> frame
+    int clockHand = 0;
+    BufferPoolStats stats;
+    WriteBackHook writeBackHook;
+    std::unordered_set<int> writingBack; // Blocks whose write-back is in progress
+    mutable std::mutex mutex;
+    std::condition_variable writtenBack;
+    std::condition_variable loaded; // A frame finished loading
+
+    char* frameData(int frame) const { return memory + static_cast<size_t>(frame) * pageSize; }
+    int findVictim(); // Called with the mutex held
+    void writeBack(int frame, std::unique_lock<std::mutex>& lock); // Called with the mutex held, which it releases meanwhile
+
+    // Prevent copying and assignment
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+public:
+    // The budget is in bytes and must hold at least one page
+    BufferPool(BlockFile* file, long long budget);
+    ~BufferPool(); // Writes back dirty pages
+
+    // Pin a block and return its page. If load is false a miss does not read the file,
+    // which is meant for callers that overwrite the whole page.
+    // Throws an error if every frame is pinned. Tells hit, if given, whether the page was already in memory.
+    char* pin(int blockID, bool load = true, bool* hit = nullptr);
+    void unpin(int blockID, bool dirty);
+
+    void flush(int blockID);
+    void flushAll();
+    void discardAll(); // Drops every cached page without writing it back, for when the file is truncated
+    void setWriteBackHook(WriteBackHook hook); // nullptr to remove it
+
+    int getNumFrames() const { return numFrames; }
+    int getPageSize() const { return pageSize; }
+    BufferPoolStats getStats() const;
+    void resetStats();
+};
+
+class PinnedPage {
+    // Keeps a block pinned (read-only) for as long as it lives, so that its page can be read in place
+private:
+    BufferPool* pool;
+    int blockID;
+    bool hit = false; // Declared before page, which sets it
+    const char* page;
+
+public:
+    PinnedPage(BufferPool* pool, int blockID) : pool(pool), blockID(blockID), page(pool->pin(blockID, true, &hit)) {}
+    PinnedPage(PinnedPage&& other) noexcept : pool(other.pool), blockID(other.blockID), hit(other.hit), page(other.page) { other.pool = nullptr; }
+    ~PinnedPage() {
+        if (pool != nullptr) {
+            pool->unpin(blockID, false);
+        }
+    }
+    PinnedPage(const PinnedPage&) = delete;
+    PinnedPage& operator=(const PinnedPage&) = delete;
+    PinnedPage& operator=(PinnedPage&&) = delete;
+
+    bool wasHit() const { return hit; } // Whether the page was in memory when pinned
+    std::span<const std::byte> bytes() const { return {reinterpret_cast<const std::byte*>(page), static_cast<size_t>(pool->getPageSize())}; }
+};
+
+#endif // BUFFERPOOL_H
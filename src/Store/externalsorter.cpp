@@ -0,0 +1,316 @@
+#include "externalsorter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+===================================================
+=================== Record files ==================
+===================================================
+*/
+
+RecordFile::RecordFile(const std::string& directory, int width, size_t bufferBytes) {
+    if (width < 1) {
+        throw std::invalid_argument("Records must hold at least one value.");
+    }
+    this->width = width;
+    std::filesystem::path path = directory.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(directory);
+    std::string name = (path / "rstartree_sort_XXXXXX").string();
+    fd = ::mkstemp(name.data());
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create a temporary file in '" + path.string() + "': " + std::strerror(errno));
+    }
+    ::unlink(name.c_str());
+    buffer.resize(std::max<size_t>(1, bufferBytes / (width * sizeof(double))) * width);
+}
+
+RecordFile::~RecordFile() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void RecordFile::append(const double* record) {
+    if (reading) {
+        throw std::logic_error("Cannot append to a record file that is being read.");
+    }
+    std::copy(record, record + width, buffer.begin() + buffered * width);
+    buffered++;
+    count++;
+    if (buffered * width == buffer.size()) {
+        writeBuffer();
+    }
+}
+
+void RecordFile::writeBuffer() {
+    const char* bytes = reinterpret_cast<const char*>(buffer.data());
+    size_t total = buffered * width * sizeof(double);
+    size_t done = 0;
+    while (done < total) {
+        ssize_t result = ::write(fd, bytes + done, total - done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw std::runtime_error(std::string("Cannot write a temporary file: ") + std::strerror(errno));
+        }
+        done += result;
+    }
+    buffered = 0;
+}
+
+void RecordFile::rewind(size_t bufferBytes) {
+    if (!reading) {
+        writeBuffer();
+        reading = true;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    buffer.assign(std::max<size_t>(1, bufferBytes / (width * sizeof(double))) * width, 0.0);
+    buffer.shrink_to_fit();
+    readRecords = 0;
+    position = 0;
+    buffered = 0;
+}
+
+const double* RecordFile::next() {
+    if (position == buffered) {
+        if (!reading || readRecords == count) {
+            return nullptr;
+        }
+        buffered = std::min<long long>(buffer.size() / width, count - readRecords);
+        position = 0;
+        char* bytes = reinterpret_cast<char*>(buffer.data());
+        size_t total = buffered * width * sizeof(double);
+        off_t offset = static_cast<off_t>(readRecords) * width * sizeof(double);
+        size_t done = 0;
+        while (done < total) {
+            ssize_t result = ::pread(fd, bytes + done, total - done, offset + done);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                throw std::runtime_error(std::string("Cannot read a temporary file: ") + std::strerror(errno));
+            }
+            done += result;
+        }
+        readRecords += buffered;
+    }
+    return buffer.data() + position++ * width;
+}
+
+/*
+===================================================
+===================== Merging =====================
+===================================================
+*/
+
+bool ExternalSorter::less(const double* a, const double* b) {
+    for (int k = 0; k < EXTERNAL_SORT_KEYS; ++k) {
+        if (a[k] != b[k]) {
+            return a[k] < b[k];
+        }
+    }
+    return false;
+}
+
+bool ExternalSorter::Merger::advance(Source& source) {
+    if (source.file != nullptr) {
+        source.record = source.file->next();
+    }
+    else if (source.position < source.keys->size()) {
+        source.record = source.data + (*source.keys)[source.position++].index * width;
+    }
+    else {
+        source.record = nullptr;
+    }
+    return source.record != nullptr;
+}
+
+void ExternalSorter::Merger::start(std::vector<Source> inputs) {
+    sources = std::move(inputs);
+    heap.clear();
+    current = -1;
+    for (int i = 0; i < sources.size(); ++i) {
+        if (advance(sources[i])) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](int a, int b) { return less(sources[b].record, sources[a].record); });
+}
+
+const double* ExternalSorter::Merger::next() {
+    auto greater = [this](int a, int b) { return less(sources[b].record, sources[a].record); };
+    // The record returned last stays valid until now, so its source only moves on here
+    if (current >= 0 && advance(sources[current])) {
+        heap.push_back(current);
+        std::push_heap(heap.begin(), heap.end(), greater);
+    }
+    current = -1;
+    if (heap.empty()) {
+        return nullptr;
+    }
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    current = heap.back();
+    heap.pop_back();
+    return sources[current].record;
+}
+
+/*
+===================================================
+===================== Sorting =====================
+===================================================
+*/
+
+ExternalSorter::ExternalSorter(int width, long long memoryBudget, WorkStealingPool& pool, const std::string& tempDirectory)
+    : width(width), memoryBudget(memoryBudget), pool(pool), directory(tempDirectory), merger(width) {
+    if (width < EXTERNAL_SORT_KEYS) {
+        throw std::invalid_argument("Records must hold at least " + std::to_string(EXTERNAL_SORT_KEYS) + " values.");
+    }
+    if (memoryBudget <= 0) {
+        throw std::invalid_argument("Memory budget must be positive.");
+    }
+    // Each chunk takes a quarter of the budget, with the keys it is sorted by
+    chunkRecords = std::max<size_t>(1, memoryBudget / 4 / (width * sizeof(double) + sizeof(Key)));
+}
+
+ExternalSorter::~ExternalSorter() {
+    if (sortingChunk) {
+        try {
+            pool.wait();
+        }
+        catch (...) {
+            // Only reached when unwinding from another error
+        }
+    }
+}
+
+void ExternalSorter::add(const double* record) {
+    if (finished) {
+        throw std::logic_error("Cannot add records to a finished sort.");
+    }
+    if (filling.empty()) {
+        filling.reserve(chunkRecords * width);
+    }
+    filling.insert(filling.end(), record, record + width);
+    count++;
+    if (filling.size() == chunkRecords * width) {
+        spillChunk();
+    }
+}
+
+std::vector<ExternalSorter::Key> ExternalSorter::sortPart(const std::vector<double>& chunk, size_t begin, size_t end) const {
+    std::vector<Key> keys;
+    keys.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        Key key;
+        std::copy(chunk.begin() + i * width, chunk.begin() + i * width + EXTERNAL_SORT_KEYS, key.keys);
+        key.index = i;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return less(a.keys, b.keys); });
+    return keys;
+}
+
+// Hand the filled chunk to the pool, once the previous one is written, and start filling the other
+void ExternalSorter::spillChunk() {
+    if (sortingChunk) {
+        sortingChunk = false;
+        pool.wait();
+    }
+    std::swap(filling, sorting);
+    filling.clear();
+
+    size_t records = sorting.size() / width;
+    size_t numParts = std::min<size_t>(pool.getNumThreads(), records);
+    for (size_t p = 0; p < numParts; ++p) {
+        size_t begin = records * p / numParts;
+        size_t end = records * (p + 1) / numParts;
+        pool.submit([this, begin, end]() {
+            std::vector<Key> keys = sortPart(sorting, begin, end);
+            auto run = std::make_unique<RecordFile>(directory, width, EXTERNAL_SORT_MIN_BUFFER);
+            for (const Key& key : keys) {
+                run->append(sorting.data() + key.index * width);
+            }
+            run->rewind(0); // Flushes the last records and drops the write buffer
+            std::lock_guard<std::mutex> lock(runsMutex);
+            runs.push_back(std::move(run));
+        });
+    }
+    sortingChunk = true;
+}
+
+std::unique_ptr<RecordFile> ExternalSorter::mergeRuns(size_t begin, size_t end, size_t bufferBytes) {
+    std::vector<Source> inputs;
+    for (size_t i = begin; i < end; ++i) {
+        runs[i]->rewind(bufferBytes);
+        inputs.push_back({runs[i].get()});
+    }
+    Merger merge(width);
+    merge.start(std::move(inputs));
+    auto merged = std::make_unique<RecordFile>(directory, width, bufferBytes);
+    while (const double* record = merge.next()) {
+        merged->append(record);
+    }
+    merged->rewind(0);
+    return merged;
+}
+
+void ExternalSorter::finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+
+    if (!sortingChunk) {
+        // Everything fits in one chunk: sort its parts in parallel and merge them in memory
+        size_t records = filling.size() / width;
+        size_t numParts = std::min<size_t>(pool.getNumThreads(), std::max<size_t>(records, 1));
+        parts.resize(numParts);
+        for (size_t p = 0; p < numParts; ++p) {
+            pool.submit([this, p, records, numParts]() {
+                parts[p] = sortPart(filling, records * p / numParts, records * (p + 1) / numParts);
+            });
+        }
+        pool.wait();
+        std::vector<Source> inputs;
+        for (const std::vector<Key>& keys : parts) {
+            inputs.push_back({nullptr, filling.data(), &keys});
+        }
+        merger.start(std::move(inputs));
+        return;
+    }
+
+    if (!filling.empty()) {
+        spillChunk();
+    }
+    sortingChunk = false;
+    pool.wait();
+    std::vector<double>().swap(filling);
+    std::vector<double>().swap(sorting);
+
+    // Merges read through a buffer per run, within half the budget
+    size_t mergeBudget = memoryBudget / 2;
+    size_t fanIn = std::max<size_t>(2, mergeBudget / EXTERNAL_SORT_MIN_BUFFER);
+    while (runs.size() > fanIn) {
+        std::unique_ptr<RecordFile> merged = mergeRuns(0, fanIn, mergeBudget / (fanIn + 1));
+        runs.erase(runs.begin(), runs.begin() + fanIn);
+        runs.push_back(std::move(merged));
+    }
+    std::vector<Source> inputs;
+    for (std::unique_ptr<RecordFile>& run : runs) {
+        run->rewind(mergeBudget / runs.size());
+        inputs.push_back({run.get()});
+    }
+    merger.start(std::move(inputs));
+}
+
+const double* ExternalSorter::next() {
+    if (!finished) {
+        throw std::logic_error("The sort must be finished before reading it.");
+    }
+    return merger.next();
+}
@@ -0,0 +1,116 @@
+#ifndef EXTERNALSORTER_H
+#define EXTERNALSORTER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "workstealingpool.h"
+
+#define EXTERNAL_SORT_MIN_BUFFER (64 << 10) // Smallest read buffer of a run in a merge, bounds the merge fan-in
+#define EXTERNAL_SORT_KEYS 2 // Records are ordered by this many leading values
+
+class RecordFile {
+    // Temporary file of fixed-width records of doubles, written sequentially once and then read back sequentially.
+    // The file is unlinked right after it is created, so it disappears with the object, or the process.
+private:
+    int fd = -1;
+    int width; // Doubles per record
+    long long count = 0;
+    std::vector<double> buffer; // Records waiting to be written, or read ahead
+    size_t position = 0; // Next record to read from buffer
+    size_t buffered = 0; // Records in buffer
+    long long readRecords = 0; // Records read from the file so far
+    bool reading = false;
+
+    void writeBuffer();
+
+    // Prevent copying and assignment
+    RecordFile(const RecordFile&) = delete;
+    RecordFile& operator=(const RecordFile&) = delete;
+public:
+    // A new empty file in directory (the system temp directory if empty), buffering bufferBytes at a time
+    RecordFile(const std::string& directory, int width, size_t bufferBytes);
+    ~RecordFile();
+
+    void append(const double* record);
+    // Switches to reading from the first record, with a read buffer of bufferBytes
+    void rewind(size_t bufferBytes);
+    const double* next(); // The next record (valid until the next call), nullptr after the last one
+
+    long long size() const { return count; }
+};
+
+class ExternalSorter {
+    // Sorts fixed-width records of doubles by their first EXTERNAL_SORT_KEYS values, in a bounded amount of memory.
+    // add() fills a chunk of records; a full chunk is cut in one part per pool thread, the parts are sorted
+    // in parallel and each written as a sorted run, while the next chunk fills on the calling thread.
+    // finish() merges runs, fan-in at a time, until what is left can be merged with a buffer per run,
+    // then next() streams that last merge. A sort that never filled a chunk stays in memory.
+    // The chunks (two of them, one filling while the other is sorted) and the merge buffers each take at most half the budget.
+private:
+    struct Key {
+        double keys[EXTERNAL_SORT_KEYS];
+        size_t index;
+    };
+    // One sorted input of a merge: a run file, or a sorted part of the chunk in memory
+    struct Source {
+        RecordFile* file = nullptr;
+        const double* data = nullptr; // Records of the chunk, in the order of keys
+        const std::vector<Key>* keys = nullptr;
+        size_t position = 0;
+        const double* record = nullptr; // Current record, nullptr once the source is exhausted
+    };
+    // K-way merge of sorted sources through a heap of their current records
+    class Merger {
+    private:
+        int width;
+        std::vector<Source> sources;
+        std::vector<int> heap; // Indexes into sources, smallest record on top
+        int current = -1; // Source of the record returned last, advanced on the next call
+        bool advance(Source& source);
+    public:
+        explicit Merger(int width) : width(width) {}
+        void start(std::vector<Source> inputs);
+        const double* next();
+    };
+
+    int width;
+    long long memoryBudget;
+    WorkStealingPool& pool;
+    std::string directory;
+    size_t chunkRecords;
+
+    std::vector<double> filling; // Chunk add() writes to
+    std::vector<double> sorting; // Chunk being sorted into runs by the pool
+    bool sortingChunk = false; // Whether pool tasks may still read sorting
+    std::vector<std::vector<Key>> parts; // Sorted order of the parts of a chunk left in memory
+    std::vector<std::unique_ptr<RecordFile>> runs;
+    std::mutex runsMutex;
+    long long count = 0;
+    bool finished = false;
+    Merger merger;
+
+    static bool less(const double* a, const double* b);
+    std::vector<Key> sortPart(const std::vector<double>& chunk, size_t begin, size_t end) const;
+    void spillChunk();
+    std::unique_ptr<RecordFile> mergeRuns(size_t begin, size_t end, size_t bufferBytes);
+
+    // Prevent copying and assignment
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+public:
+    // Records of width doubles (at least EXTERNAL_SORT_KEYS), runs written to tempDirectory (the system temp directory if empty)
+    ExternalSorter(int width, long long memoryBudget, WorkStealingPool& pool, const std::string& tempDirectory = "");
+    ~ExternalSorter(); // Waits for the pool, whose tasks may still be sorting a chunk
+
+    void add(const double* record);
+    void finish(); // No add() after finish()
+    const double* next(); // Records in ascending order (valid until the next call), nullptr after the last one
+
+    long long size() const { return count; }
+    int getWidth() const { return width; }
+    int getNumRuns() const { return runs.size(); }
+};
+
+#endif // EXTERNALSORTER_H
@@ -1,6 +1,7 @@
 #include "storable.h"
 #include <stdexcept>
 #include <cstring>
+#include <string>
 
 // ==================== INT ====================
 
@@ -39,7 +40,8 @@ long long Storable::deserializeLongLong(const std::vector<char>& data, size_t of
     }
     long long value = 0;
     for (size_t i = 0; i < sizeof(long long); ++i) {
-        value |= (static_cast<unsigned char>(data[offset + i]) << (i * 8));
+        // Widen before shifting, bytes above the fourth would be lost in an int shift
+        value |= (static_cast<long long>(static_cast<unsigned char>(data[offset + i])) << (i * 8));
     }
     return value;
 }
@@ -119,4 +121,53 @@ void Storable::appendData(std::vector<char>& data, const std::vector<char>& addi
         throw std::invalid_argument("Additional data cannot be empty.");
     }
     data.insert(data.end(), additionalData.begin(), additionalData.end());
+}
+
+// ==================== WRITE INTO SPANS ====================
+
+void Storable::checkSpace(std::span<std::byte> out, size_t offset, size_t count) {
+    if (out.size() < offset + count) {
+        throw std::invalid_argument("Output of " + std::to_string(out.size()) + " bytes is too small to write " + std::to_string(count) + " bytes at offset " + std::to_string(offset) + ".");
+    }
+}
+
+// Same byte order as serializeInt
+size_t Storable::writeInt(std::span<std::byte> out, size_t offset, int value) {
+    checkSpace(out, offset, sizeof(int));
+    for (size_t i = 0; i < sizeof(int); ++i) {
+        out[offset + i] = static_cast<std::byte>((value >> (i * 8)) & 0xFF);
+    }
+    return offset + sizeof(int);
+}
+
+size_t Storable::writeLongLong(std::span<std::byte> out, size_t offset, long long value) {
+    checkSpace(out, offset, sizeof(long long));
+    for (size_t i = 0; i < sizeof(long long); ++i) {
+        out[offset + i] = static_cast<std::byte>((value >> (i * 8)) & 0xFF);
+    }
+    return offset + sizeof(long long);
+}
+
+size_t Storable::writeInts(std::span<std::byte> out, size_t offset, std::span<const int> values) {
+    checkSpace(out, offset, values.size_bytes());
+    std::memcpy(out.data() + offset, values.data(), values.size_bytes());
+    return offset + values.size_bytes();
+}
+
+size_t Storable::writeDoubles(std::span<std::byte> out, size_t offset, std::span<const double> values) {
+    checkSpace(out, offset, values.size_bytes());
+    std::memcpy(out.data() + offset, values.data(), values.size_bytes());
+    return offset + values.size_bytes();
+}
+
+size_t Storable::writeChars(std::span<std::byte> out, size_t offset, std::span<const char> values) {
+    checkSpace(out, offset, values.size_bytes());
+    std::memcpy(out.data() + offset, values.data(), values.size_bytes());
+    return offset + values.size_bytes();
+}
+
+size_t Storable::writeZeros(std::span<std::byte> out, size_t offset, size_t count) {
+    checkSpace(out, offset, count);
+    std::memset(out.data() + offset, 0, count);
+    return offset + count;
 }
\ No newline at end of file
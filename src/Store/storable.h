@@ -2,6 +2,8 @@
 #define STORABLE_H
 
 #include <vector>
+#include <span>
+#include <cstddef>
 #include "globalparameters.h"
 #include <stdexcept>
 
@@ -17,6 +19,11 @@ public:
     virtual std::vector<char> serialize(GlobalParameters* config) const { 
         throw std::runtime_error("Serialize not implemented for this type.");
     }
+    // Write the same bytes as serialize directly into out (e.g. a buffer pool frame), without allocating.
+    // Returns the number of bytes written; throws if out is too small.
+    virtual size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+        throw std::runtime_error("SerializeInto not implemented for this type.");
+    }
     static Storable deserialize(GlobalParameters* config, const std::vector<char>& data) { 
         throw std::runtime_error("Deserialize not implemented for this type.");
     }
@@ -43,6 +50,17 @@ public:
     static std::vector<double> deserializeDoubles(const std::vector<char>& data, size_t offset = 0, size_t count = 0);
     
     static void appendData(std::vector<char>& data, const std::vector<char>& additionalData);
+
+    // Writers for serializeInto: put the value at offset in out and return the offset after it
+    static size_t writeInt(std::span<std::byte> out, size_t offset, int value);
+    static size_t writeLongLong(std::span<std::byte> out, size_t offset, long long value);
+    static size_t writeInts(std::span<std::byte> out, size_t offset, std::span<const int> values);
+    static size_t writeDoubles(std::span<std::byte> out, size_t offset, std::span<const double> values);
+    static size_t writeChars(std::span<std::byte> out, size_t offset, std::span<const char> values);
+    static size_t writeZeros(std::span<std::byte> out, size_t offset, size_t count);
+
+private:
+    static void checkSpace(std::span<std::byte> out, size_t offset, size_t count);
 };
 
 
@@ -0,0 +1,290 @@
+#include "writeaheadlog.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "storable.h"
+
+static std::runtime_error ioError(const std::string& what, const std::string& filename) {
+    return std::runtime_error(what + " '" + filename + "': " + std::strerror(errno));
+}
+
+// CRC-32 (IEEE), to find the torn tail a crash leaves at the end of the log
+static uint32_t crc32(const char* data, size_t length, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> values;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            values[i] = value;
+        }
+        return values;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void writeAll(int fd, const char* data, size_t length, off_t offset, const std::string& filename) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t result = ::pwrite(fd, data + done, length - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw ioError("Cannot write log", filename);
+        }
+        done += result;
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& filename, BlockFile* file, BufferPool* pool) {
+    this->filename = filename;
+    this->file = file;
+    this->pool = pool;
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw ioError("Cannot open log", filename);
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw ioError("Cannot stat log", filename);
+    }
+    if (info.st_size < WAL_HEADER_SIZE) {
+        // A new log starts from the file as it is
+        checkpointState = {file->getNumBlocks(), file->getRootID(), file->getHeight(), file->getCount()};
+        writeHeader();
+    }
+    else {
+        std::vector<char> header(WAL_HEADER_SIZE);
+        if (::pread(fd, header.data(), WAL_HEADER_SIZE, 0) != WAL_HEADER_SIZE) {
+            ::close(fd);
+            throw ioError("Cannot read log header of", filename);
+        }
+        std::vector<int> fields = Storable::deserializeInts(header, 0, 5);
+        if (fields[0] != WAL_MAGIC || fields[1] != file->getPageSize()) {
+            ::close(fd);
+            throw std::runtime_error("File '" + filename + "' is not a log of '" + file->getFilename() + "'.");
+        }
+        checkpointState = {fields[2], fields[3], fields[4], Storable::deserializeLongLong(header, 5 * sizeof(int))};
+        appendedLSN = durableLSN = info.st_size;
+    }
+    imaged.assign(checkpointState.numBlocks, false);
+    pool->setWriteBackHook([this](int blockID) { beforeWriteBack(blockID); });
+}
+
+// Make everything appended durable and write the pool back while page images are still logged,
+// so that the tree file and the log agree whatever is destroyed first afterwards
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        commit(appendedLSN);
+        pool->flushAll();
+    }
+    catch (const std::exception&) {
+        // Nothing sensible to do in a destructor; recovery goes back to what the log holds
+    }
+    pool->setWriteBackHook(nullptr);
+    ::close(fd);
+}
+
+void WriteAheadLog::writeHeader() {
+    std::vector<char> header(WAL_HEADER_SIZE, 0);
+    std::span<std::byte> out(reinterpret_cast<std::byte*>(header.data()), header.size());
+    size_t offset = Storable::writeInt(out, 0, WAL_MAGIC);
+    offset = Storable::writeInt(out, offset, file->getPageSize());
+    offset = Storable::writeInt(out, offset, checkpointState.numBlocks);
+    offset = Storable::writeInt(out, offset, checkpointState.rootID);
+    offset = Storable::writeInt(out, offset, checkpointState.height);
+    Storable::writeLongLong(out, offset, checkpointState.count);
+    if (::ftruncate(fd, WAL_HEADER_SIZE) != 0) {
+        throw ioError("Cannot truncate log", filename);
+    }
+    writeAll(fd, header.data(), header.size(), 0, filename);
+    if (::fdatasync(fd) != 0) {
+        throw ioError("Cannot sync log", filename);
+    }
+}
+
+/*
+===================================================
+================== Group commit ===================
+===================================================
+*/
+
+long long WriteAheadLog::append(WALRecordType type, const std::vector<char>& payload) {
+    std::vector<char> record(WAL_RECORD_HEADER_SIZE);
+    std::span<std::byte> out(reinterpret_cast<std::byte*>(record.data()), record.size());
+    Storable::writeInt(out, 0, static_cast<int>(type));
+    Storable::writeInt(out, sizeof(int), payload.size());
+    uint32_t crc = crc32(payload.data(), payload.size(), crc32(record.data(), 2 * sizeof(int)));
+    std::memcpy(record.data() + 2 * sizeof(int), &crc, sizeof(crc));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.insert(pending.end(), record.begin(), record.end());
+    pending.insert(pending.end(), payload.begin(), payload.end());
+    appendedLSN += record.size() + payload.size();
+    stats.records++;
+    return appendedLSN;
+}
+
+void WriteAheadLog::commit(long long lsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.commits++;
+    while (durableLSN < lsn) {
+        if (syncing) {
+            synced.wait(lock);
+            continue;
+        }
+        // Lead this group: write out whatever is pending, including the records of the committers waiting behind
+        syncing = true;
+        std::vector<char> batch;
+        batch.swap(pending);
+        off_t offset = durableLSN - baseLSN;
+        long long target = appendedLSN;
+        lock.unlock();
+        try {
+            writeAll(fd, batch.data(), batch.size(), offset, filename);
+            if (::fdatasync(fd) != 0) {
+                throw ioError("Cannot sync log", filename);
+            }
+        }
+        catch (...) {
+            lock.lock();
+            pending.insert(pending.begin(), batch.begin(), batch.end());
+            syncing = false;
+            synced.notify_all();
+            throw;
+        }
+        lock.lock();
+        durableLSN = target;
+        syncing = false;
+        stats.syncs++;
+        synced.notify_all();
+    }
+}
+
+// Called by the pool before it overwrites a page of the file
+void WriteAheadLog::beforeWriteBack(int blockID) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (blockID <= 0 || blockID >= imaged.size() || imaged[blockID]) {
+            return; // Metadata, new since the checkpoint, or logged already
+        }
+        imaged[blockID] = true;
+    }
+    std::vector<char> payload = Storable::serializeInt(blockID);
+    Storable::appendData(payload, file->readBlock(blockID));
+    long long lsn = append(WALRecordType::PageImage, payload);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.pageImages++;
+    }
+    commit(lsn);
+}
+
+/*
+===================================================
+============ Checkpoints and recovery =============
+===================================================
+*/
+
+void WriteAheadLog::checkpoint(const WALCheckpoint& state) {
+    std::unique_lock<std::mutex> lock(mutex);
+    synced.wait(lock, [this]() { return !syncing; });
+    // The file holds every change appended so far, so the records still pending are not needed either
+    pending.clear();
+    baseLSN = appendedLSN - WAL_HEADER_SIZE;
+    durableLSN = appendedLSN;
+    checkpointState = state;
+    imaged.assign(state.numBlocks, false);
+    writeHeader();
+    stats.checkpoints++;
+    synced.notify_all();
+}
+
+bool WriteAheadLog::restore() {
+    std::lock_guard<std::mutex> lock(mutex);
+    long long size = appendedLSN - baseLSN;
+    std::vector<char> data(size - WAL_HEADER_SIZE);
+    if (!data.empty() && ::pread(fd, data.data(), data.size(), WAL_HEADER_SIZE) != data.size()) {
+        throw ioError("Cannot read log", filename);
+    }
+
+    // Records up to the first torn or corrupt one, which a crash during a group's write may leave
+    std::vector<std::pair<int, std::vector<char>>> images;
+    recovered.clear();
+    size_t offset = 0;
+    while (offset + WAL_RECORD_HEADER_SIZE <= data.size()) {
+        int type = Storable::deserializeInt(data, offset);
+        int length = Storable::deserializeInt(data, offset + sizeof(int));
+        uint32_t crc;
+        std::memcpy(&crc, data.data() + offset + 2 * sizeof(int), sizeof(crc));
+        if (length < 0 || offset + WAL_RECORD_HEADER_SIZE + length > data.size()) {
+            break;
+        }
+        const char* payload = data.data() + offset + WAL_RECORD_HEADER_SIZE;
+        if (crc32(payload, length, crc32(data.data() + offset, 2 * sizeof(int))) != crc) {
+            break;
+        }
+        std::vector<char> body(payload, payload + length);
+        if (type == static_cast<int>(WALRecordType::PageImage)) {
+            images.emplace_back(Storable::deserializeInt(body, 0), std::vector<char>(body.begin() + sizeof(int), body.end()));
+        }
+        else {
+            recovered.emplace_back(static_cast<WALRecordType>(type), std::move(body));
+        }
+        offset += WAL_RECORD_HEADER_SIZE + length;
+    }
+    if (offset < data.size()) {
+        // Drop the torn tail, so that records appended from now on are not hidden behind it
+        if (::ftruncate(fd, WAL_HEADER_SIZE + offset) != 0) {
+            throw ioError("Cannot truncate log", filename);
+        }
+        appendedLSN = durableLSN = baseLSN + WAL_HEADER_SIZE + offset;
+    }
+
+    bool changed = !images.empty() || !recovered.empty() || file->getNumBlocks() != checkpointState.numBlocks
+        || file->getRootID() != checkpointState.rootID || file->getHeight() != checkpointState.height || file->getCount() != checkpointState.count;
+    if (!changed) {
+        return false;
+    }
+    // Back to the checkpoint: pages added since are dropped, overwritten ones get their images back
+    pool->discardAll();
+    file->truncate(checkpointState.numBlocks);
+    for (const auto& [blockID, page] : images) {
+        if (blockID > 0 && blockID < checkpointState.numBlocks) {
+            file->writeBlock(blockID, page);
+        }
+    }
+    file->setRootID(checkpointState.rootID);
+    file->setHeight(checkpointState.height);
+    file->setCount(checkpointState.count);
+    file->writeMetadata();
+    file->sync();
+    return true;
+}
+
+std::vector<std::pair<WALRecordType, std::vector<char>>> WriteAheadLog::takeRecovered() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(recovered);
+}
+
+long long WriteAheadLog::getSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appendedLSN - baseLSN;
+}
+
+WALStats WriteAheadLog::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
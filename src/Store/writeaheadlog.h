@@ -0,0 +1,101 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "blockfile.h"
+#include "bufferpool.h"
+
+#define WAL_MAGIC 0x57414C31 // "WAL1"
+#define WAL_HEADER_SIZE 64 // Magic, page size and the checkpoint the log starts from
+#define WAL_RECORD_HEADER_SIZE 12 // Type, payload length and CRC-32 of each record
+#define WAL_CHECKPOINT_SIZE (64LL << 20) // Log size in bytes at which the tree checkpoints after a write
+
+enum class WALRecordType {
+    Insert = 1, // Logical: blockID, recordID and the point's coordinates
+    Delete = 2, // Logical: the point's coordinates
+    PageImage = 3, // Physical: a block ID and the block's page as of the checkpoint
+};
+
+// State of the tree file at a checkpoint
+struct WALCheckpoint {
+    int numBlocks = 1;
+    int rootID = -1;
+    int height = 0;
+    long long count = 0;
+};
+
+struct WALStats {
+    long long records = 0; // Appended since the log was opened
+    long long commits = 0; // Calls to commit
+    long long syncs = 0; // fdatasyncs of the log, each covering every record appended before it started
+    long long pageImages = 0;
+    long long checkpoints = 0;
+};
+
+class WriteAheadLog {
+    // Log of the changes made to a tree file since its last checkpoint, so that they survive a crash.
+    // Inserts and deletes are logged logically, while the tree still holds its latch, and are durable once commit returns.
+    // Pages of the tree file may reach the file at any time (evicted from the pool), so the first time a page of the
+    // checkpoint is about to be overwritten, its image as of the checkpoint is logged and made durable first.
+    // Recovery writes those images back, which returns the file to the checkpoint whatever reached it since,
+    // and the tree then redoes the logical records.
+    // Group commit: the first committer writes every record appended so far with one write and one fdatasync,
+    // while later committers wait for it and are covered by it, or by the next one.
+    // LSNs are byte positions in the log, counted from when it was opened and not reset by checkpoints.
+private:
+    int fd = -1;
+    std::string filename;
+    BlockFile* file; // The tree file the log protects
+    BufferPool* pool; // The pool writing the tree file's pages back, whose write-backs log page images
+
+    WALCheckpoint checkpointState;
+    std::vector<bool> imaged; // Blocks of the checkpoint whose image is in the log
+    std::vector<std::pair<WALRecordType, std::vector<char>>> recovered; // Logical records read by restore, until replay
+
+    mutable std::mutex mutex;
+    std::condition_variable synced;
+    std::vector<char> pending; // Records appended and not written yet
+    long long baseLSN = 0; // LSN of the start of the log file
+    long long appendedLSN = WAL_HEADER_SIZE; // End of the last appended record
+    long long durableLSN = WAL_HEADER_SIZE;
+    bool syncing = false; // Whether a committer is writing and syncing the log
+    WALStats stats;
+
+    void writeHeader(); // Called with the mutex held
+    void beforeWriteBack(int blockID);
+
+    // Prevent copying and assignment
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+public:
+    // Opens the log of file (creating it with file's current state as the checkpoint) and hooks into pool's write-backs
+    WriteAheadLog(const std::string& filename, BlockFile* file, BufferPool* pool);
+    ~WriteAheadLog();
+
+    // Returns the LSN commit needs to make the record durable
+    long long append(WALRecordType type, const std::vector<char>& payload);
+    // Blocks until every record up to lsn is in the log file and synced
+    void commit(long long lsn);
+
+    // Logs the checkpoint image of blockID, if not logged yet (for callers writing the file directly)
+    void preservePage(int blockID) { beforeWriteBack(blockID); }
+
+    // Recovery, at startup before the file is used: writes the logged page images back,
+    // truncates the file to the checkpoint and restores its metadata. Returns whether the file changed.
+    bool restore();
+    // The logical records found by restore, in log order, for the tree to redo
+    std::vector<std::pair<WALRecordType, std::vector<char>>> takeRecovered();
+
+    // Starts an empty log from state. The file must already hold state, flushed and synced.
+    void checkpoint(const WALCheckpoint& state);
+
+    const WALCheckpoint& getCheckpoint() const { return checkpointState; }
+    long long getSize() const; // Bytes in the log, including records not written yet
+    WALStats getStats() const;
+    const std::string& getFilename() const { return filename; }
+};
+
+#endif // WRITEAHEADLOG_H
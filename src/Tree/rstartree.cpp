@@ -0,0 +1,2428 @@
+#include "rstartree.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <queue>
+#include <functional>
+#include <set>
+#include "storable.h"
+
+RStarTree::RStarTree(GlobalParameters* config, Buffer* buffer, WriteAheadLog* wal) {
+    if (config->maxChildren < 2) {
+        throw std::invalid_argument("maxChildren must be at least 2 for an R*-tree.");
+    }
+    if (config->dimensions < 1) {
+        throw std::invalid_argument("dimensions must be at least 1.");
+    }
+    if (!QuantizedMBR::isValidBits(config->childBoxBits)) {
+        throw std::invalid_argument("childBoxBits must be 0, 8 or 16.");
+    }
+    if (config->leafFormat != LEAF_FORMAT_PLAIN && config->leafFormat != LEAF_FORMAT_DELTA) {
+        throw std::invalid_argument("leafFormat must be LEAF_FORMAT_PLAIN or LEAF_FORMAT_DELTA.");
+    }
+    if (wal != nullptr && buffer == nullptr) {
+        throw std::invalid_argument("A write-ahead log needs a tree stored in a buffer.");
+    }
+    this->config = config;
+    this->buffer = buffer;
+    this->wal = wal;
+    this->minChildren = std::max(1, static_cast<int>(RSTAR_MIN_FILL * config->maxChildren));
+    this->minLeafChildren = minChildren;
+    if (config->leafFormat == LEAF_FORMAT_DELTA) {
+        // A compressed leaf may fill its page with as few as maxChildren / 2 + 1 points
+        this->minLeafChildren = std::max(1, static_cast<int>(RSTAR_MIN_FILL * (config->maxChildren / 2 + 1)));
+        this->leafPageSize = buffer != nullptr ? buffer->getTreeFile()->getPageSize() : BlockFile::pageSizeFor(config);
+    }
+    if (wal != nullptr) {
+        // Back to the last checkpoint before reading anything from the file
+        wal->restore();
+    }
+
+    if (buffer != nullptr && buffer->getTreeFile()->getRootID() > 0) {
+        // Reopen the tree stored in the file
+        BlockFile* treeFile = buffer->getTreeFile();
+        this->rootID = treeFile->getRootID();
+        this->height = treeFile->getHeight();
+        this->size = treeFile->getCount();
+        this->looseBoxes = size > 0; // An earlier run may have deleted points
+        addLatches(treeFile->getNumBlocks() - 1);
+    }
+    else {
+        // Start with a single empty leaf as the root
+        this->rootID = newNodeID();
+        this->height = 1;
+        makeNode(rootID, 0, -1, std::vector<Entry>());
+        saveMetadata();
+    }
+
+    if (wal != nullptr) {
+        replayLog();
+    }
+}
+
+RStarTree::~RStarTree() {
+    try {
+        stopBackgroundCompaction();
+        if (buffer == nullptr) {
+            return;
+        }
+        if (wal != nullptr) {
+            checkpoint();
+        }
+        else if (bufferedPoints > 0) {
+            flushInsertBuffers(); // Buffers only live in memory
+        }
+    }
+    catch (const std::exception&) {
+        // Nothing sensible to do in a destructor; the log still covers every committed insert
+    }
+}
+
+/*
+===================================================
+================== Node storage ===================
+===================================================
+*/
+
+std::shared_ptr<TreeNode> RStarTree::getNode(int nodeID, QueryStats* stats) const {
+    if (buffer != nullptr) {
+        if (stats == nullptr) {
+            return buffer->readNode(nodeID, arena.get());
+        }
+        bool hit;
+        std::shared_ptr<TreeNode> node = buffer->readNode(nodeID, arena.get(), &hit);
+        stats->addPage(hit);
+        stats->bytesDeserialized += buffer->getTreeFile()->getPageSize();
+        return node;
+    }
+    auto it = nodes.find(nodeID);
+    if (it == nodes.end()) {
+        throw std::out_of_range("Node " + std::to_string(nodeID) + " does not exist in the tree.");
+    }
+    return it->second;
+}
+
+void RStarTree::saveNode(const std::shared_ptr<TreeNode>& node) {
+    if (buffer != nullptr) {
+        buffer->writeNode(*node);
+        return;
+    }
+    // Nodes changed in place are already stored, and looking them up leaves the map alone for concurrent readers
+    auto it = nodes.find(node->getID());
+    if (it == nodes.end() || it->second != node) {
+        nodes[node->getID()] = node;
+    }
+}
+
+int RStarTree::newNodeID() {
+    if (!freeNodeIDs.empty()) {
+        int id = freeNodeIDs.back();
+        freeNodeIDs.pop_back();
+        return id;
+    }
+    int id = buffer != nullptr ? buffer->allocateNode() : nextNodeID++;
+    addLatches(id);
+    return id;
+}
+
+void RStarTree::saveMetadata() {
+    if (buffer == nullptr) {
+        return;
+    }
+    BlockFile* treeFile = buffer->getTreeFile();
+    treeFile->setRootID(rootID);
+    treeFile->setHeight(height);
+    treeFile->setCount(size);
+}
+
+/*
+===================================================
+================ Write-ahead logging ==============
+===================================================
+*/
+
+long long RStarTree::logInsert(const Point& point, int blockID, int recordID) {
+    if (wal == nullptr || replaying) {
+        return 0;
+    }
+    std::vector<char> payload = Storable::serializeInt(blockID);
+    Storable::appendData(payload, Storable::serializeInt(recordID));
+    Storable::appendData(payload, Storable::serializeDoubles(point.getCoordinates()));
+    return wal->append(WALRecordType::Insert, payload);
+}
+
+long long RStarTree::logDelete(const Point& point) {
+    if (wal == nullptr || replaying) {
+        return 0;
+    }
+    return wal->append(WALRecordType::Delete, Storable::serializeDoubles(point.getCoordinates()));
+}
+
+void RStarTree::commitLog(long long lsn) {
+    if (lsn == 0) {
+        return;
+    }
+    wal->commit(lsn);
+    if (wal->getSize() >= WAL_CHECKPOINT_SIZE) {
+        std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+        if (wal->getSize() >= WAL_CHECKPOINT_SIZE) { // Unless another insert checkpointed first
+            checkpointLocked();
+        }
+    }
+}
+
+// Inserts redone here were committed before the crash, so they find the tree as they left it at the checkpoint
+void RStarTree::replayLog() {
+    std::vector<std::pair<WALRecordType, std::vector<char>>> records = wal->takeRecovered();
+    replaying = true;
+    try {
+        for (const auto& [type, payload] : records) {
+            if (type == WALRecordType::Insert) {
+                int blockID = Storable::deserializeInt(payload, 0);
+                int recordID = Storable::deserializeInt(payload, sizeof(int));
+                std::vector<double> coords = Storable::deserializeDoubles(payload, 2 * sizeof(int), config->dimensions);
+                insert(Point(coords), blockID, recordID);
+            }
+            else if (type == WALRecordType::Delete) {
+                remove(Point(Storable::deserializeDoubles(payload, 0, config->dimensions)));
+            }
+        }
+    }
+    catch (...) {
+        replaying = false;
+        throw;
+    }
+    replaying = false;
+    checkpoint();
+}
+
+void RStarTree::checkpoint() {
+    if (buffer == nullptr) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    checkpointLocked();
+}
+
+// The pool logs the checkpoint images of the pages it overwrites, so a crash during the flush still recovers
+void RStarTree::checkpointLocked() {
+    BlockFile* treeFile = buffer->getTreeFile();
+    flushInsertBuffersLocked(); // The log is about to forget the buffered points
+    buffer->getTreePool()->flushAll();
+    saveMetadata();
+    treeFile->writeMetadata();
+    treeFile->sync();
+    if (wal != nullptr) {
+        wal->checkpoint({treeFile->getNumBlocks(), rootID, height, size});
+    }
+}
+
+/*
+===================================================
+===================== Latches =====================
+===================================================
+*/
+
+// Shared tree latch, queued behind any thread waiting for it exclusively
+// (readers would otherwise keep an overflowing insert waiting as long as they overlap)
+std::shared_lock<std::shared_mutex> RStarTree::lockTreeShared() const {
+    if (exclusiveWaiting.load() > 0) {
+        std::lock_guard<std::mutex> gate(treeLatchGate);
+    }
+    return std::shared_lock<std::shared_mutex>(treeLatch);
+}
+
+std::unique_lock<std::shared_mutex> RStarTree::lockTreeExclusive() const {
+    exclusiveWaiting++;
+    std::lock_guard<std::mutex> gate(treeLatchGate);
+    std::unique_lock<std::shared_mutex> lock(treeLatch);
+    exclusiveWaiting--;
+    return lock;
+}
+
+RStarTree::NodeLatch& RStarTree::latchFor(int nodeID) const {
+    if (nodeID < 0 || nodeID >= latches.size()) {
+        throw std::out_of_range("Node " + std::to_string(nodeID) + " has no latch.");
+    }
+    return *latches[nodeID];
+}
+
+void RStarTree::addLatches(int lastNodeID) {
+    while (latches.size() <= lastNodeID) {
+        latches.push_back(std::make_unique<NodeLatch>());
+    }
+}
+
+// Build a node holding exactly the given entries and store it under the given ID
+// Replaces any node previously stored under that ID
+std::shared_ptr<TreeNode> RStarTree::makeNode(int id, int level, int parentID, const std::vector<Entry>& entries) {
+    Region box;
+    for (const Entry& entry : entries) {
+        box = box.enlarged(entry.box);
+    }
+
+    std::shared_ptr<TreeNode> node;
+    if (level == 0) {
+        std::vector<Point> points;
+        std::vector<int> blockIDs;
+        std::vector<int> recordIDs;
+        for (const Entry& entry : entries) {
+            points.emplace_back(entry.box.getStart());
+            blockIDs.push_back(entry.id);
+            recordIDs.push_back(entry.recordID);
+        }
+        auto leaf = arena->make<TreeLeafNode>(config, id, level, parentID, box);
+        leaf->addPoints(config, points, blockIDs, recordIDs);
+        node = leaf;
+    }
+    else {
+        std::vector<int> childrenIDs;
+        std::vector<Region> childrenBoundingBoxes;
+        for (const Entry& entry : entries) {
+            childrenIDs.push_back(entry.id);
+            childrenBoundingBoxes.push_back(entry.box);
+        }
+        auto interior = arena->make<TreeInteriorNode>(config, id, level, parentID, box);
+        interior->addChildren(config, childrenIDs, childrenBoundingBoxes);
+        node = interior;
+    }
+    saveNode(node);
+    return node;
+}
+
+std::vector<RStarTree::Entry> RStarTree::getEntries(const std::shared_ptr<TreeNode>& node) const {
+    std::vector<Entry> entries;
+    if (node->isLeaf()) {
+        auto leaf = std::static_pointer_cast<TreeLeafNode>(node);
+        for (int i = 0; i < leaf->getNumChildren(); ++i) {
+            if (leaf->isDeleted(i)) {
+                continue; // Tombstones are dropped whenever a leaf is rebuilt from its entries
+            }
+            std::vector<double> coords = leaf->getPoint(i).getCoordinates();
+            entries.push_back({Region(coords, coords), leaf->getBlockIDs()[i], leaf->getRecordIDs()[i]});
+        }
+    }
+    else {
+        auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+        for (int i = 0; i < interior->getNumChildren(); ++i) {
+            entries.push_back({interior->getChildBoundingBox(i), interior->getChildID(i), -1});
+        }
+    }
+    return entries;
+}
+
+bool RStarTree::fits(std::span<const Entry> entries, int level) const {
+    if (entries.size() > config->maxChildren) {
+        return false;
+    }
+    if (level > 0 || leafPageSize == 0) {
+        return true;
+    }
+    DeltaLeaf::Footprint footprint(config->dimensions);
+    for (const Entry& entry : entries) {
+        footprint.add(entry.box.getStart().data(), 1, entry.id, entry.recordID);
+    }
+    return leafFits(footprint);
+}
+
+bool RStarTree::hasRoom(const std::shared_ptr<TreeNode>& node, const Entry& entry) const {
+    if (node->getNumChildren() >= config->maxChildren) {
+        return false;
+    }
+    if (!node->isLeaf() || leafPageSize == 0) {
+        return true;
+    }
+    DeltaLeaf::Footprint footprint = std::static_pointer_cast<TreeLeafNode>(node)->getFootprint();
+    footprint.add(entry.box.getStart().data(), 1, entry.id, entry.recordID);
+    return leafFits(footprint);
+}
+
+void RStarTree::setChildrenParent(const std::vector<Entry>& entries, int level, int parentID) {
+    if (level == 0) {
+        return; // Leaf entries are points, not nodes
+    }
+    for (const Entry& entry : entries) {
+        std::shared_ptr<TreeNode> child = getNode(entry.id);
+        child->setParentID(parentID);
+        saveNode(child);
+    }
+}
+
+/*
+===================================================
+==================== Insertion ====================
+===================================================
+*/
+
+// Insert a point with the IDs of its record in the data file
+// Throws an error if the point is already in the tree, as points identify their datapoints
+void RStarTree::insert(const Point& point, int blockID, int recordID) {
+    if (point.getCoordinates().size() != config->dimensions) {
+        throw std::invalid_argument("Point dimensions do not match the tree's dimensions.");
+    }
+    if (blockID < 0 || recordID < 0) {
+        throw std::invalid_argument("Block ID and Record ID must be non-negative.");
+    }
+    if (findPoint(point).first != -1) {
+        throw std::invalid_argument("Point already exists in the tree: " + point.toString(config) + ".");
+    }
+    const std::vector<double>& coords = point.getCoordinates();
+    Entry entry = {Region(coords, coords), blockID, recordID};
+
+    long long lsn = 0;
+    bool inserted = false;
+    bool bufferFull = false;
+    {
+        std::shared_lock<std::shared_mutex> shared = lockTreeShared();
+        if (insertBufferCapacity > 0 && height > 1) {
+            bufferFull = bufferEntry(entry);
+            inserted = true;
+        }
+        else {
+            inserted = insertInPlace(entry);
+        }
+        if (inserted) {
+            lsn = logInsert(point, blockID, recordID);
+        }
+    }
+
+    if (bufferFull) {
+        std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+        if (insertBufferCapacity > 0 && latchFor(rootID).buffered.size() >= insertBufferCapacity) { // Unless another insert emptied it first
+            emptyBuffer(rootID, false);
+            saveMetadata();
+        }
+    }
+    if (!inserted) {
+        // The leaf is full, so the tree may change anywhere
+        std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+        // OverflowTreatment may reinsert only once per level for each inserted point
+        reinsertedLevels.assign(height, false);
+        insertEntry(entry, 0);
+        size++;
+        saveMetadata();
+        lsn = logInsert(point, blockID, recordID);
+    }
+    // Synced with no latch held, so that the inserts waiting for the same sync can run meanwhile
+    commitLog(lsn);
+}
+
+// Insert a point into the leaf ChooseSubtree picks, if it has room, alongside other inserts and queries
+// Boxes on the path are grown from the root down before the point is added,
+// so that a query finding the point implies that every later query finds it too
+// Descends with latch coupling: a node's latch is only released once its child's is held
+bool RStarTree::insertInPlace(const Entry& entry) {
+    std::vector<std::pair<int, int>> path; // <nodeID, index of the chosen child>
+    int nodeID = rootID;
+    std::shared_lock<std::shared_mutex> parentLock;
+    for (int level = height - 1; level > 0; --level) {
+        std::shared_lock<std::shared_mutex> lock(latchFor(nodeID).latch);
+        auto interior = std::static_pointer_cast<TreeInteriorNode>(getNode(nodeID));
+        int index = chooseChild(*interior, entry.box);
+        path.emplace_back(nodeID, index);
+        nodeID = interior->getChildID(index);
+        parentLock = std::move(lock);
+    }
+
+    // Reserve a slot in the leaf, so that it cannot fill up while the path grows
+    // The room left in a compressed leaf depends on the points it gets, so it takes one reservation at a time
+    NodeLatch& leafLatch = latchFor(nodeID);
+    {
+        std::unique_lock<std::shared_mutex> lock(leafLatch.latch);
+        parentLock = std::shared_lock<std::shared_mutex>();
+        std::shared_ptr<TreeNode> leaf = getNode(nodeID);
+        bool full = leafPageSize > 0 ? leafLatch.reserved > 0 || !hasRoom(leaf, entry)
+                                     : leaf->getNumChildren() + leafLatch.reserved >= config->maxChildren;
+        if (full) {
+            return false;
+        }
+        leafLatch.reserved++;
+    }
+
+    for (auto [parentID, index] : path) {
+        std::unique_lock<std::shared_mutex> lock(latchFor(parentID).latch);
+        auto parent = std::static_pointer_cast<TreeInteriorNode>(getNode(parentID));
+        if (!parent->getPackedBoxes().boxContains(index, entry.box)) {
+            parent->setChildBoundingBox(index, parent->getChildBoundingBox(index).enlarged(entry.box));
+            saveNode(parent);
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(leafLatch.latch);
+        leafLatch.reserved--;
+        auto leaf = std::static_pointer_cast<TreeLeafNode>(getNode(nodeID));
+        leaf->addPoint(config, Point(entry.box.getStart()), entry.id, entry.recordID);
+        saveNode(leaf);
+    }
+    size++;
+    std::lock_guard<std::mutex> metadataLock(metadataMutex);
+    saveMetadata();
+    return true;
+}
+
+// Insert an entry into a node of the given level (0 for points)
+void RStarTree::insertEntry(const Entry& entry, int level) {
+    std::shared_ptr<TreeNode> node = getNode(chooseSubtree(entry.box, level));
+
+    if (!hasRoom(node, entry)) {
+        overflowTreatment(node, entry);
+        return;
+    }
+
+    if (node->isLeaf()) {
+        std::static_pointer_cast<TreeLeafNode>(node)->addPoint(config, Point(entry.box.getStart()), entry.id, entry.recordID);
+    }
+    else {
+        std::static_pointer_cast<TreeInteriorNode>(node)->addChild(config, entry.id, entry.box);
+        setChildrenParent({entry}, level, node->getID());
+    }
+    saveNode(node);
+    adjustPath(node);
+}
+
+// Descend from the root to the node of the given level that should receive the box
+int RStarTree::chooseSubtree(const Region& box, int level) {
+    std::shared_ptr<TreeNode> node = getNode(rootID);
+    while (node->getLevel() > level) {
+        auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+        node = getNode(interior->getChildID(chooseChild(*interior, box)));
+    }
+    return node->getID();
+}
+
+// Children that are leaves: minimum overlap enlargement, then area enlargement, then area
+// Other children: minimum area enlargement, then area
+// The costs of all children are computed at once by the kernels of the node's packed boxes
+int RStarTree::chooseChild(const TreeInteriorNode& node, const Region& box) const {
+    const double* start = box.getStart().data();
+    const double* end = box.getEnd().data();
+    const PackedMBRs& children = node.getPackedBoxes();
+    int n = node.getNumChildren();
+    std::vector<double> enlargements(n);
+    std::vector<double> areas(n);
+    children.enlargementCosts(n, start, end, areas.data(), enlargements.data());
+
+    // Order by area enlargement, resolving ties by area
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (enlargements[a] != enlargements[b]) {
+            return enlargements[a] < enlargements[b];
+        }
+        return areas[a] < areas[b];
+    });
+
+    int best = order[0];
+    if (node.getLevel() == 1) {
+        // Overlap enlargement is quadratic, so only the best candidates by area enlargement are considered
+        // A child overlaps itself by its area both before and after growing, so summing over
+        // all children instead of the others does not change the difference
+        int candidates = std::min(n, RSTAR_OVERLAP_CANDIDATES);
+        double bestOverlap = std::numeric_limits<double>::max();
+        std::vector<double> grownStart(config->dimensions), grownEnd(config->dimensions);
+        std::vector<double> childStart(config->dimensions), childEnd(config->dimensions);
+        for (int c = 0; c < candidates; ++c) {
+            int i = order[c];
+            for (int d = 0; d < config->dimensions; ++d) {
+                childStart[d] = children.getLow(i, d);
+                childEnd[d] = children.getHigh(i, d);
+                grownStart[d] = std::min(childStart[d], start[d]);
+                grownEnd[d] = std::max(childEnd[d], end[d]);
+            }
+            double overlapEnlargement = children.overlapSum(n, grownStart.data(), grownEnd.data())
+                - children.overlapSum(n, childStart.data(), childEnd.data());
+            // Candidates are visited in enlargement/area order, so strict comparison keeps those tie-breaks
+            if (overlapEnlargement < bestOverlap) {
+                bestOverlap = overlapEnlargement;
+                best = i;
+            }
+        }
+    }
+    return best;
+}
+
+// Called with a node that is full and the entry that did not fit
+// Reinserts part of the entries the first time a level overflows during an insert, otherwise splits
+void RStarTree::overflowTreatment(const std::shared_ptr<TreeNode>& node, const Entry& extra) {
+    std::vector<Entry> entries = getEntries(node);
+    entries.push_back(extra);
+
+    int level = node->getLevel();
+    if (fits(entries, level)) {
+        // Dropping the leaf's tombstones made room
+        deletedPoints -= node->getNumChildren() + 1 - entries.size();
+        adjustPath(makeNode(node->getID(), level, node->getParentID(), entries));
+        return;
+    }
+    if (node->getID() != rootID && !reinsertedLevels[level]) {
+        reinsertedLevels[level] = true;
+        reInsert(node, entries);
+    }
+    else {
+        split(node, entries);
+    }
+}
+
+// Remove the entries farthest from the node's center and insert them again (close reinsert)
+void RStarTree::reInsert(const std::shared_ptr<TreeNode>& node, std::vector<Entry> entries) {
+    Region box;
+    for (const Entry& entry : entries) {
+        box = box.enlarged(entry.box);
+    }
+    std::vector<double> center = box.center();
+
+    std::vector<double> distances(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        std::vector<double> entryCenter = entries[i].box.center();
+        double distance = 0.0;
+        for (size_t d = 0; d < center.size(); ++d) {
+            distance += (entryCenter[d] - center[d]) * (entryCenter[d] - center[d]);
+        }
+        distances[i] = distance;
+    }
+
+    // Sort by decreasing distance from the center
+    std::vector<int> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return distances[a] > distances[b]; });
+
+    // Compressed leaves may overflow with fewer than maxChildren entries
+    int p = std::max(1, static_cast<int>(RSTAR_REINSERT_FRACTION * std::min<size_t>(config->maxChildren, entries.size())));
+    std::vector<Entry> removed;
+    std::vector<Entry> kept;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i < p) {
+            removed.push_back(entries[order[i]]);
+        }
+        else {
+            kept.push_back(entries[order[i]]);
+        }
+    }
+
+    int level = node->getLevel();
+    if (!fits(kept, level)) {
+        // A compressed leaf of points that do not compress well may still be too large
+        split(node, entries);
+        return;
+    }
+    // The overflowing entry may have been kept, so make sure every kept child points here
+    std::shared_ptr<TreeNode> shrunk = makeNode(node->getID(), level, node->getParentID(), kept);
+    setChildrenParent(kept, level, shrunk->getID());
+    adjustPath(shrunk);
+
+    // Close reinsert: start with the entry closest to the center
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+        insertEntry(*it, level);
+    }
+}
+
+// Split the entries of an overflowing node between the node and a new sibling
+void RStarTree::split(const std::shared_ptr<TreeNode>& node, std::vector<Entry> entries) {
+    int level = node->getLevel();
+    int axis = chooseSplitAxis(entries, level);
+    int index = chooseSplitIndex(entries, axis, level);
+    std::vector<Entry> first(entries.begin(), entries.begin() + index);
+    std::vector<Entry> second(entries.begin() + index, entries.end());
+
+    int nodeID = node->getID();
+    int siblingID = newNodeID();
+
+    if (nodeID == rootID) {
+        // Grow the tree by one level
+        int newRootID = newNodeID();
+        std::shared_ptr<TreeNode> left = makeNode(nodeID, level, newRootID, first);
+        std::shared_ptr<TreeNode> right = makeNode(siblingID, level, newRootID, second);
+        setChildrenParent(first, level, nodeID);
+        setChildrenParent(second, level, siblingID);
+
+        makeNode(newRootID, level + 1, -1, {{coverBox(left), nodeID, -1}, {coverBox(right), siblingID, -1}});
+        rootID = newRootID;
+        height++;
+        reinsertedLevels.resize(height, false);
+        return;
+    }
+
+    int parentID = node->getParentID();
+    std::shared_ptr<TreeNode> left = makeNode(nodeID, level, parentID, first);
+    std::shared_ptr<TreeNode> right = makeNode(siblingID, level, parentID, second);
+    setChildrenParent(first, level, nodeID);
+    setChildrenParent(second, level, siblingID);
+
+    // Shrink the node's box in its parent, then add the sibling to the parent
+    // The node keeps its buffer, if it has one
+    auto parent = std::static_pointer_cast<TreeInteriorNode>(getNode(parentID));
+    parent->setChildBoundingBox(parent->findChildIndex(nodeID), coverBox(left));
+    saveNode(parent);
+
+    Entry siblingEntry = {coverBox(right), siblingID, -1};
+    if (parent->getNumChildren() >= config->maxChildren) {
+        overflowTreatment(parent, siblingEntry); // Propagates the split upwards if needed
+        return;
+    }
+    parent->addChild(config, siblingID, siblingEntry.box);
+    saveNode(parent);
+    adjustPath(parent);
+}
+
+// Sort helpers for the split: by lower then upper value, or by upper then lower value, on an axis
+static void sortEntries(std::vector<Region>& boxes, std::vector<int>& order, int axis, bool byUpper) {
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        double aFirst = byUpper ? boxes[a].getEnd()[axis] : boxes[a].getStart()[axis];
+        double bFirst = byUpper ? boxes[b].getEnd()[axis] : boxes[b].getStart()[axis];
+        if (aFirst != bFirst) {
+            return aFirst < bFirst;
+        }
+        double aSecond = byUpper ? boxes[a].getStart()[axis] : boxes[a].getEnd()[axis];
+        double bSecond = byUpper ? boxes[b].getStart()[axis] : boxes[b].getEnd()[axis];
+        return aSecond < bSecond;
+    });
+}
+
+// Bounding boxes of every prefix [0, i) and suffix [i, n) of the sorted boxes
+static void prefixSuffixBoxes(const std::vector<Region>& boxes, const std::vector<int>& order, std::vector<Region>& prefix, std::vector<Region>& suffix) {
+    size_t n = order.size();
+    prefix.assign(n + 1, Region());
+    suffix.assign(n + 1, Region());
+    for (size_t i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i].enlarged(boxes[order[i]]);
+    }
+    for (size_t i = n; i > 0; --i) {
+        suffix[i - 1] = suffix[i].enlarged(boxes[order[i - 1]]);
+    }
+}
+
+// ChooseSplitAxis: the axis with the minimum sum of margins over all distributions
+int RStarTree::chooseSplitAxis(std::vector<Entry>& entries, int level) const {
+    int n = entries.size();
+    int minGroup = getMinChildren(level);
+    std::vector<Region> boxes;
+    for (const Entry& entry : entries) {
+        boxes.push_back(entry.box);
+    }
+
+    int bestAxis = 0;
+    double bestMarginSum = std::numeric_limits<double>::max();
+    std::vector<Region> prefix, suffix;
+    for (int axis = 0; axis < config->dimensions; ++axis) {
+        double marginSum = 0.0;
+        for (bool byUpper : {false, true}) {
+            std::vector<int> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            sortEntries(boxes, order, axis, byUpper);
+            prefixSuffixBoxes(boxes, order, prefix, suffix);
+            // The first group holds minGroup to n - minGroup entries
+            for (int k = minGroup; k <= n - minGroup; ++k) {
+                marginSum += prefix[k].margin() + suffix[k].margin();
+            }
+        }
+        if (marginSum < bestMarginSum) {
+            bestMarginSum = marginSum;
+            bestAxis = axis;
+        }
+    }
+    return bestAxis;
+}
+
+// ChooseSplitIndex: on the chosen axis, the distribution with minimum overlap, then minimum area
+// For compressed leaves, only distributions whose groups both fit a page; the most even one always does
+// Reorders the entries so that the first group is [0, index)
+int RStarTree::chooseSplitIndex(std::vector<Entry>& entries, int axis, int level) const {
+    int n = entries.size();
+    int minGroup = getMinChildren(level);
+    bool compressed = level == 0 && leafPageSize > 0;
+    std::vector<Region> boxes;
+    for (const Entry& entry : entries) {
+        boxes.push_back(entry.box);
+    }
+
+    double bestOverlap = std::numeric_limits<double>::max();
+    double bestArea = std::numeric_limits<double>::max();
+    int bestIndex = minGroup;
+    std::vector<int> bestOrder;
+    std::vector<Region> prefix, suffix;
+    std::vector<bool> prefixFits(n + 1, true), suffixFits(n + 1, true);
+    for (bool byUpper : {false, true}) {
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        sortEntries(boxes, order, axis, byUpper);
+        prefixSuffixBoxes(boxes, order, prefix, suffix);
+        if (compressed) {
+            DeltaLeaf::Footprint first(config->dimensions), second(config->dimensions);
+            for (int i = 0; i < n; ++i) {
+                const Entry& head = entries[order[i]];
+                first.add(head.box.getStart().data(), 1, head.id, head.recordID);
+                prefixFits[i + 1] = leafFits(first);
+                const Entry& tail = entries[order[n - 1 - i]];
+                second.add(tail.box.getStart().data(), 1, tail.id, tail.recordID);
+                suffixFits[n - 1 - i] = leafFits(second);
+            }
+        }
+        for (int k = minGroup; k <= n - minGroup; ++k) {
+            if (!prefixFits[k] || !suffixFits[k]) {
+                continue;
+            }
+            double overlap = prefix[k].overlap(suffix[k]);
+            double area = prefix[k].area() + suffix[k].area();
+            if (overlap < bestOverlap || (overlap == bestOverlap && area < bestArea)) {
+                bestOverlap = overlap;
+                bestArea = area;
+                bestIndex = k;
+                bestOrder = order;
+            }
+        }
+    }
+
+    if (bestOrder.empty()) {
+        throw std::logic_error("No distribution of " + std::to_string(n) + " entries fits two nodes.");
+    }
+    std::vector<Entry> sorted;
+    for (int i : bestOrder) {
+        sorted.push_back(entries[i]);
+    }
+    entries = sorted;
+    return bestIndex;
+}
+
+// Propagate a changed bounding box up to the root, stopping once a parent is unaffected
+void RStarTree::adjustPath(const std::shared_ptr<TreeNode>& node) {
+    std::shared_ptr<TreeNode> current = node;
+    while (current->getID() != rootID) {
+        auto parent = std::static_pointer_cast<TreeInteriorNode>(getNode(current->getParentID()));
+        int index = parent->findChildIndex(current->getID());
+        if (index == -1) {
+            throw std::logic_error("Node " + std::to_string(current->getID()) + " is missing from its parent.");
+        }
+        Region box = coverBox(current);
+        if (parent->getPackedBoxes().boxEquals(index, box)) {
+            return;
+        }
+        parent->setChildBoundingBox(index, box);
+        saveNode(parent);
+        current = parent;
+    }
+}
+
+/*
+===================================================
+=============== Buffered insertion ================
+===================================================
+*/
+
+void RStarTree::InsertBuffer::append(const double* point, int dimensions, int blockID, int recordID) {
+    if (empty()) {
+        low.assign(point, point + dimensions);
+        high.assign(point, point + dimensions);
+    }
+    else {
+        for (int d = 0; d < dimensions; ++d) {
+            low[d] = std::min(low[d], point[d]);
+            high[d] = std::max(high[d], point[d]);
+        }
+    }
+    coords.insert(coords.end(), point, point + dimensions);
+    blockIDs.push_back(blockID);
+    recordIDs.push_back(recordID);
+}
+
+int RStarTree::InsertBuffer::find(const Point& point) const {
+    const std::vector<double>& target = point.getCoordinates();
+    for (int i = 0; i < size(); ++i) {
+        if (std::equal(target.begin(), target.end(), coords.begin() + i * target.size())) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void RStarTree::InsertBuffer::remove(int index, int dimensions) {
+    int last = size() - 1;
+    std::copy(coords.begin() + last * dimensions, coords.end(), coords.begin() + index * dimensions);
+    blockIDs[index] = blockIDs[last];
+    recordIDs[index] = recordIDs[last];
+    coords.resize(last * dimensions);
+    blockIDs.pop_back();
+    recordIDs.pop_back();
+    if (empty()) {
+        low.clear();
+        high.clear();
+    }
+}
+
+bool RStarTree::InsertBuffer::pointInside(int index, const AbstractBoundedClass& query) const {
+    const std::vector<double>& start = query.getStart();
+    const std::vector<double>& end = query.getEnd();
+    const double* values = point(index, start.size());
+    for (size_t d = 0; d < start.size(); ++d) {
+        if (values[d] < start[d] || values[d] > end[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RStarTree::setInsertBuffering(int bufferCapacity) {
+    if (bufferCapacity < 0) {
+        throw std::invalid_argument("Insert buffer capacity cannot be negative.");
+    }
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    insertBufferCapacity = bufferCapacity;
+    if (bufferCapacity == 0) {
+        flushInsertBuffersLocked();
+        saveMetadata();
+    }
+}
+
+void RStarTree::flushInsertBuffers() {
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    flushInsertBuffersLocked();
+    saveMetadata();
+}
+
+// Top-down from the root first; splits and reinserts may have moved nodes with buffers out of the subtrees emptied there
+void RStarTree::flushInsertBuffersLocked() {
+    if (bufferedPoints == 0) {
+        return;
+    }
+    emptyBuffer(rootID, true);
+    while (bufferedPoints > 0) {
+        for (int nodeID = 1; nodeID < latches.size(); ++nodeID) {
+            emptyBuffer(nodeID, true);
+        }
+    }
+}
+
+// Called with the root's shared latch held, so the root cannot change meanwhile
+bool RStarTree::bufferEntry(const Entry& entry) {
+    NodeLatch& rootLatch = latchFor(rootID);
+    bool full;
+    {
+        std::unique_lock<std::shared_mutex> lock(rootLatch.latch);
+        rootLatch.buffered.append(entry.box.getStart().data(), config->dimensions, entry.id, entry.recordID);
+        full = rootLatch.buffered.size() >= insertBufferCapacity;
+    }
+    bufferedPoints++;
+    size++;
+    std::lock_guard<std::mutex> metadataLock(metadataMutex);
+    saveMetadata();
+    return full;
+}
+
+Region RStarTree::coverBox(const std::shared_ptr<TreeNode>& node) const {
+    const InsertBuffer& buffered = latchFor(node->getID()).buffered;
+    if (buffered.empty()) {
+        return node->getBoundingBox();
+    }
+    return node->getBoundingBox().enlarged(Region(buffered.low, buffered.high));
+}
+
+// Every point of the batch goes to the child ChooseSubtree picks, and the child's box grows right away,
+// so that later points of the batch see the boxes sequential inserts would have left
+void RStarTree::emptyBuffer(int nodeID, bool all) {
+    InsertBuffer batch;
+    std::swap(batch, latchFor(nodeID).buffered);
+    if (batch.empty()) {
+        return;
+    }
+    bufferedPoints -= batch.size();
+
+    int dimensions = config->dimensions;
+    auto node = std::static_pointer_cast<TreeInteriorNode>(getNode(nodeID));
+    std::vector<std::vector<int>> routed(node->getNumChildren()); // Points of the batch by child index
+    std::vector<double> coords(dimensions);
+    for (int i = 0; i < batch.size(); ++i) {
+        const double* point = batch.point(i, dimensions);
+        coords.assign(point, point + dimensions);
+        Region box(coords, coords);
+        int index = chooseChild(*node, box);
+        if (!node->getPackedBoxes().boxContains(index, box)) {
+            node->setChildBoundingBox(index, node->getChildBoundingBox(index).enlarged(box));
+        }
+        routed[index].push_back(i);
+    }
+
+    std::vector<Entry> overflowing; // Points routed to leaves that filled up
+    for (int index = 0; index < routed.size(); ++index) {
+        if (routed[index].empty()) {
+            continue;
+        }
+        int childID = node->getChildID(index);
+        if (node->getLevel() > 1) {
+            InsertBuffer& childBuffer = latchFor(childID).buffered;
+            for (int i : routed[index]) {
+                childBuffer.append(batch.point(i, dimensions), dimensions, batch.blockIDs[i], batch.recordIDs[i]);
+            }
+            bufferedPoints += routed[index].size();
+            continue;
+        }
+
+        // One read and one write of the leaf for all of its points
+        auto leaf = std::static_pointer_cast<TreeLeafNode>(getNode(childID));
+        int added = 0;
+        for (int i : routed[index]) {
+            const double* point = batch.point(i, dimensions);
+            coords.assign(point, point + dimensions);
+            Entry entry = {Region(coords, coords), batch.blockIDs[i], batch.recordIDs[i]};
+            if (hasRoom(leaf, entry)) {
+                leaf->addPoint(config, Point(coords), entry.id, entry.recordID);
+                added++;
+            }
+            else {
+                overflowing.push_back(entry);
+            }
+        }
+        if (added > 0) {
+            saveNode(leaf);
+        }
+        node->setChildBoundingBox(index, leaf->getBoundingBox()); // Without the points that did not fit
+    }
+    saveNode(node);
+    adjustPath(node);
+
+    // Points that did not fit go through OverflowTreatment like any insert
+    for (const Entry& entry : overflowing) {
+        reinsertedLevels.assign(height, false);
+        insertEntry(entry, 0);
+    }
+
+    if (node->getLevel() > 1) {
+        // Node IDs stay valid even if emptying one child moves the others to other parents
+        std::vector<int> childrenIDs;
+        for (int index = 0; index < node->getNumChildren(); ++index) {
+            childrenIDs.push_back(node->getChildID(index));
+        }
+        for (int childID : childrenIDs) {
+            const InsertBuffer& childBuffer = latchFor(childID).buffered;
+            if (all ? !childBuffer.empty() : childBuffer.size() >= insertBufferCapacity) {
+                emptyBuffer(childID, all);
+            }
+        }
+    }
+}
+
+/*
+===================================================
+============= Deletion and compaction =============
+===================================================
+*/
+
+// Delete the point, if it is in the tree
+bool RStarTree::remove(const Point& point) {
+    if (point.getCoordinates().size() != config->dimensions) {
+        throw std::invalid_argument("Point dimensions do not match the tree's dimensions.");
+    }
+    long long lsn = 0;
+    bool removed;
+    {
+        std::shared_lock<std::shared_mutex> shared = lockTreeShared();
+        removed = removeInPlace(point);
+        if (removed) {
+            lsn = logDelete(point);
+        }
+    }
+    commitLog(lsn);
+    return removed;
+}
+
+// Looks for the point like findPoint, then takes the latch of the node holding it exclusively to delete it there
+// Under the shared tree latch, points only move within an insert buffer, so it is enough to look again in that node
+bool RStarTree::removeInPlace(const Point& point) {
+    bool found = false;
+    std::vector<std::pair<int, int>> stack = {{rootID, height - 1}};
+    while (!found && !stack.empty()) {
+        auto [nodeID, level] = stack.back();
+        stack.pop_back();
+        NodeLatch& latch = latchFor(nodeID);
+        std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+
+        if (level > 0) {
+            if (latch.buffered.find(point) != -1) {
+                nodeLock.unlock();
+                std::unique_lock<std::shared_mutex> lock(latch.latch);
+                int index = latch.buffered.find(point);
+                if (index == -1) {
+                    return false; // Deleted by another thread meanwhile
+                }
+                looseBoxes = true;
+                latch.buffered.remove(index, config->dimensions);
+                bufferedPoints--;
+                found = true;
+                continue;
+            }
+            for (int childID : std::static_pointer_cast<TreeInteriorNode>(getNode(nodeID))->rangeQuery(point)) {
+                stack.emplace_back(childID, level - 1);
+            }
+            continue;
+        }
+
+        if (std::static_pointer_cast<TreeLeafNode>(getNode(nodeID))->findPoint(point).first == -1) {
+            continue;
+        }
+        nodeLock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> lock(latch.latch);
+            auto leaf = std::static_pointer_cast<TreeLeafNode>(getNode(nodeID));
+            looseBoxes = true;
+            if (leaf->markDeleted(point) == -1) {
+                return false;
+            }
+            saveNode(leaf);
+        }
+        deletedPoints++;
+        {
+            std::lock_guard<std::mutex> lock(compactionMutex);
+            leavesToCompact.insert(nodeID);
+        }
+        compactionWake.notify_one();
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+    size--;
+    std::lock_guard<std::mutex> metadataLock(metadataMutex);
+    saveMetadata();
+    return true;
+}
+
+void RStarTree::compact() {
+    // Every leaf holding tombstones, including those left in the file by an earlier run
+    {
+        std::shared_lock<std::shared_mutex> shared = lockTreeShared();
+        std::vector<int> found;
+        std::vector<std::pair<int, int>> stack = {{rootID, height - 1}};
+        while (!stack.empty()) {
+            auto [nodeID, level] = stack.back();
+            stack.pop_back();
+            std::shared_lock<std::shared_mutex> nodeLock(latchFor(nodeID).latch);
+            std::shared_ptr<TreeNode> node = getNode(nodeID);
+            if (level == 0) {
+                if (std::static_pointer_cast<TreeLeafNode>(node)->getNumDeleted() > 0) {
+                    found.push_back(nodeID);
+                }
+                continue;
+            }
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                stack.emplace_back(interior->getChildID(i), level - 1);
+            }
+        }
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        leavesToCompact.insert(found.begin(), found.end());
+    }
+    while (compactStep(COMPACTION_STEP_LEAVES)) {
+    }
+}
+
+bool RStarTree::compactStep(int maxLeaves) {
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    for (int n = 0; n < maxLeaves; ++n) {
+        int leafID;
+        {
+            std::lock_guard<std::mutex> lock(compactionMutex);
+            if (leavesToCompact.empty()) {
+                break;
+            }
+            leafID = *leavesToCompact.begin();
+            leavesToCompact.erase(leavesToCompact.begin());
+        }
+        compactLeaf(leafID);
+    }
+    shrinkRoot();
+    saveMetadata();
+    std::lock_guard<std::mutex> lock(compactionMutex);
+    return !leavesToCompact.empty();
+}
+
+void RStarTree::compactLeaf(int leafID) {
+    std::shared_ptr<TreeNode> leaf = getNode(leafID);
+    std::vector<Entry> live = getEntries(leaf);
+    long long purged = leaf->getNumChildren() - static_cast<long long>(live.size());
+    if (purged > 0) {
+        // Tombstones left in the file by an earlier run were never counted
+        deletedPoints = std::max(0LL, deletedPoints - purged);
+        leaf = makeNode(leafID, 0, leaf->getParentID(), live);
+    }
+    condenseTree(leaf);
+}
+
+// CondenseTree (Guttman, 1984): going up from the leaf, nodes left with fewer than the minimum fill of their level are removed
+// and their entries reinserted at their level, and the boxes of the others are tightened
+// A root left without children becomes an empty leaf, shrinkRoot promotes the only child of a root left with one
+void RStarTree::condenseTree(const std::shared_ptr<TreeNode>& leaf) {
+    std::vector<std::pair<Entry, int>> orphans; // Entries of removed nodes, with the level they are inserted at
+    auto orphanBuffer = [&](int nodeID) {
+        InsertBuffer buffered;
+        std::swap(buffered, latchFor(nodeID).buffered);
+        for (int i = 0; i < buffered.size(); ++i) {
+            const double* values = buffered.point(i, config->dimensions);
+            std::vector<double> coords(values, values + config->dimensions);
+            orphans.push_back({{Region(coords, coords), buffered.blockIDs[i], buffered.recordIDs[i]}, 0});
+        }
+        bufferedPoints -= buffered.size();
+    };
+
+    std::shared_ptr<TreeNode> current = leaf;
+    while (current->getID() != rootID) {
+        auto parent = std::static_pointer_cast<TreeInteriorNode>(getNode(current->getParentID()));
+        if (current->getNumChildren() < getMinChildren(current->getLevel())) {
+            for (const Entry& entry : getEntries(current)) {
+                orphans.emplace_back(entry, current->getLevel());
+            }
+            orphanBuffer(current->getID());
+            parent->removeChild(current->getID());
+            freeNode(current->getID());
+        }
+        else {
+            parent->setChildBoundingBox(parent->findChildIndex(current->getID()), coverBox(current));
+        }
+        saveNode(parent);
+        current = parent;
+    }
+    if (current->getNumChildren() == 0 && !current->isLeaf()) {
+        orphanBuffer(rootID);
+        height = 1;
+        makeNode(rootID, 0, -1, std::vector<Entry>());
+    }
+
+    // Higher levels first, so that the subtrees go back before the points
+    std::stable_sort(orphans.begin(), orphans.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (size_t i = 0; i < orphans.size(); ++i) {
+        auto [entry, level] = orphans[i];
+        if (level >= height) {
+            // The tree got shorter than the subtree, whose own entries go back instead
+            std::shared_ptr<TreeNode> node = getNode(entry.id);
+            for (const Entry& child : getEntries(node)) {
+                orphans.emplace_back(child, level - 1);
+            }
+            orphanBuffer(entry.id);
+            freeNode(entry.id);
+            continue;
+        }
+        reinsertedLevels.assign(height, false);
+        insertEntry(entry, level);
+    }
+}
+
+void RStarTree::shrinkRoot() {
+    while (height > 1) {
+        std::shared_ptr<TreeNode> root = getNode(rootID);
+        if (root->getNumChildren() != 1) {
+            return;
+        }
+        int childID = std::static_pointer_cast<TreeInteriorNode>(root)->getChildID(0);
+        std::shared_ptr<TreeNode> child = getNode(childID);
+        child->setParentID(-1);
+        saveNode(child);
+        InsertBuffer buffered;
+        std::swap(buffered, latchFor(rootID).buffered);
+        freeNode(rootID);
+        rootID = childID;
+        height--;
+
+        // Points buffered at the old root wait at the new one, or go into it if it is a leaf
+        for (int i = 0; i < buffered.size(); ++i) {
+            const double* values = buffered.point(i, config->dimensions);
+            if (height > 1) {
+                latchFor(rootID).buffered.append(values, config->dimensions, buffered.blockIDs[i], buffered.recordIDs[i]);
+                continue;
+            }
+            std::vector<double> coords(values, values + config->dimensions);
+            bufferedPoints--;
+            reinsertedLevels.assign(height, false);
+            insertEntry({Region(coords, coords), buffered.blockIDs[i], buffered.recordIDs[i]}, 0);
+        }
+    }
+}
+
+// The page of a removed node stays in the tree file until a split reuses its ID (in this run only)
+void RStarTree::freeNode(int nodeID) {
+    if (buffer == nullptr) {
+        nodes.erase(nodeID);
+    }
+    freeNodeIDs.push_back(nodeID);
+    std::lock_guard<std::mutex> lock(compactionMutex);
+    leavesToCompact.erase(nodeID);
+}
+
+// The leaves are walked once: each live point is sorted by key with its record and its slot, the sorted records
+// are written as the new data file, and the new IDs, sorted back by slot, are written into the leaves one leaf at a time
+long long RStarTree::clusterDataFile(WorkStealingPool& pool, long long memoryBudget, const std::string& tempDirectory) {
+    if (buffer == nullptr) {
+        throw std::logic_error("Clustering the data file needs a tree stored in a buffer.");
+    }
+    if (memoryBudget <= 0) {
+        throw std::invalid_argument("Memory budget must be positive.");
+    }
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    flushInsertBuffersLocked();
+    std::shared_ptr<TreeNode> root = getNode(rootID);
+    if (size == 0 || root->getNumChildren() == 0) {
+        return 0;
+    }
+    int dimensions = config->dimensions;
+
+    // <key high, key low, leafID, slot, DataPoint>
+    HilbertCurve curve(root->getBoundingBox());
+    ExternalSorter records(EXTERNAL_SORT_KEYS + 2 + Buffer::packedDataPointWidth(config), memoryBudget / 2, pool, tempDirectory);
+    std::vector<double> record(records.getWidth(), 0.0);
+    std::vector<double> coords(dimensions);
+    std::vector<std::pair<int, int>> stack = {{rootID, height - 1}};
+    while (!stack.empty()) {
+        auto [nodeID, level] = stack.back();
+        stack.pop_back();
+        std::shared_ptr<TreeNode> node = getNode(nodeID);
+        if (level > 0) {
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                stack.emplace_back(interior->getChildID(i), level - 1);
+            }
+            continue;
+        }
+        auto leaf = std::static_pointer_cast<TreeLeafNode>(node);
+        for (int i = 0; i < leaf->getNumChildren(); ++i) {
+            if (leaf->isDeleted(i)) {
+                continue;
+            }
+            for (int d = 0; d < dimensions; ++d) {
+                coords[d] = leaf->getCoordinate(i, d);
+            }
+            uint64_t key = curve.key(coords.data());
+            record[0] = static_cast<double>(key >> 32);
+            record[1] = static_cast<double>(key & 0xFFFFFFFFu);
+            record[2] = nodeID;
+            record[3] = i;
+            buffer->packDataPoint(leaf->getBlockIDs()[i], leaf->getRecordIDs()[i], record.data() + 4);
+            records.add(record.data());
+        }
+    }
+
+    // <leafID, slot, blockID, recordID>
+    ExternalSorter moves(EXTERNAL_SORT_KEYS + 2, memoryBudget / 2, pool, tempDirectory);
+    long long kept = buffer->rewriteDataFile(records, [&](const double* sorted, int blockID, int recordID) {
+        double move[] = {sorted[2], sorted[3], static_cast<double>(blockID), static_cast<double>(recordID)};
+        moves.add(move);
+    });
+    moves.finish();
+    // New IDs may no longer fit a compressed leaf: it keeps the entries that do, the others are inserted again
+    // once every leaf is written
+    std::vector<Entry> evicted;
+    auto saveLeaf = [&](const std::shared_ptr<TreeLeafNode>& leaf) {
+        if (leafPageSize == 0 || leafFits(leaf->getFootprint())) {
+            saveNode(leaf);
+            return;
+        }
+        std::vector<Entry> live = getEntries(leaf);
+        deletedPoints = std::max(0LL, deletedPoints - (leaf->getNumChildren() - static_cast<long long>(live.size())));
+        while (!fits(live, 0)) {
+            evicted.push_back(live.back());
+            live.pop_back();
+        }
+        adjustPath(makeNode(leaf->getID(), 0, leaf->getParentID(), live));
+    };
+    std::shared_ptr<TreeLeafNode> leaf;
+    while (const double* move = moves.next()) {
+        int leafID = static_cast<int>(move[0]);
+        if (leaf == nullptr || leaf->getID() != leafID) {
+            if (leaf != nullptr) {
+                saveLeaf(leaf);
+            }
+            leaf = std::static_pointer_cast<TreeLeafNode>(getNode(leafID));
+        }
+        leaf->setIDs(static_cast<int>(move[1]), static_cast<int>(move[2]), static_cast<int>(move[3]));
+    }
+    if (leaf != nullptr) {
+        saveLeaf(leaf);
+    }
+    for (const Entry& entry : evicted) {
+        reinsertedLevels.assign(height, false);
+        insertEntry(entry, 0);
+    }
+    if (wal != nullptr) {
+        checkpointLocked();
+    }
+    return kept;
+}
+
+void RStarTree::startBackgroundCompaction() {
+    std::lock_guard<std::mutex> lock(compactionMutex);
+    if (compactor.joinable()) {
+        throw std::logic_error("Background compaction is already running.");
+    }
+    stopCompacting = false;
+    compactionError = nullptr;
+    compactor = std::thread([this]() { compactionLoop(); });
+}
+
+void RStarTree::stopBackgroundCompaction() {
+    {
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        if (!compactor.joinable()) {
+            return;
+        }
+        stopCompacting = true;
+    }
+    compactionWake.notify_all();
+    compactor.join();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        std::swap(error, compactionError);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Sleeps until deletes leave tombstones, then compacts a step at a time, releasing the tree latch in between
+void RStarTree::compactionLoop() {
+    try {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(compactionMutex);
+                compactionWake.wait(lock, [this]() { return stopCompacting || !leavesToCompact.empty(); });
+                if (stopCompacting) {
+                    return;
+                }
+            }
+            compactStep(COMPACTION_STEP_LEAVES);
+        }
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        compactionError = std::current_exception();
+    }
+}
+
+/*
+===================================================
+=================== Bulk loading ==================
+===================================================
+*/
+
+// Sort the entries in [begin, end) by their center on the given dimension, cut them into slabs
+// and recurse on the next dimension. On the last dimension, cut runs of capacity entries,
+// or for compressed leaves, shorter runs where the next point would not fit the page.
+void RStarTree::strTile(std::vector<Entry>& entries, size_t begin, size_t end, int dimension, int capacity, int level, std::vector<std::pair<size_t, size_t>>& groups) const {
+    std::sort(entries.begin() + begin, entries.begin() + end, [dimension](const Entry& a, const Entry& b) {
+        return a.box.getStart()[dimension] + a.box.getEnd()[dimension] < b.box.getStart()[dimension] + b.box.getEnd()[dimension];
+    });
+
+    size_t count = end - begin;
+    if (dimension == config->dimensions - 1) {
+        if (level > 0 || leafPageSize == 0) {
+            for (size_t i = begin; i < end; i += capacity) {
+                groups.emplace_back(i, std::min(end, i + capacity));
+            }
+            return;
+        }
+        DeltaLeaf::Footprint footprint(config->dimensions);
+        size_t runBegin = begin;
+        for (size_t i = begin; i < end; ++i) {
+            footprint.add(entries[i].box.getStart().data(), 1, entries[i].id, entries[i].recordID);
+            if (i - runBegin == capacity || !leafFits(footprint)) {
+                groups.emplace_back(runBegin, i);
+                runBegin = i;
+                footprint = DeltaLeaf::Footprint(config->dimensions);
+                footprint.add(entries[i].box.getStart().data(), 1, entries[i].id, entries[i].recordID);
+            }
+        }
+        groups.emplace_back(runBegin, end);
+        return;
+    }
+
+    // S = ceil(P^(1/k)) slabs for the P nodes of this range, with k dimensions left to tile
+    double nodes = std::ceil(static_cast<double>(count) / capacity);
+    size_t slabs = std::ceil(std::pow(nodes, 1.0 / (config->dimensions - dimension)));
+    size_t slabSize = std::ceil(nodes / slabs) * capacity;
+    for (size_t i = begin; i < end; i += slabSize) {
+        strTile(entries, i, std::min(end, i + slabSize), dimension + 1, capacity, level, groups);
+    }
+}
+
+std::vector<std::vector<RStarTree::Entry>> RStarTree::strPack(std::vector<Entry>& entries, int capacity, int level) const {
+    std::vector<std::pair<size_t, size_t>> groups;
+    strTile(entries, 0, entries.size(), 0, capacity, level, groups);
+    auto range = [&](size_t begin, size_t end) { return std::span<const Entry>(entries.data() + begin, end - begin); };
+
+    // The last run of a slab may be shorter than the minimum fill. Groups are adjacent ranges, so merge it
+    // with its neighbour, or share the two evenly if they do not fit in one node (then both exceed M/2).
+    int minGroup = getMinChildren(level);
+    size_t g = 0;
+    while (groups.size() > 1 && g < groups.size()) {
+        if (groups[g].second - groups[g].first >= minGroup) {
+            g++;
+            continue;
+        }
+        size_t first = g > 0 ? g - 1 : g;
+        size_t begin = groups[first].first;
+        size_t end = groups[first + 1].second;
+        if (fits(range(begin, end), level)) {
+            groups[first].second = end;
+            groups.erase(groups.begin() + first + 1);
+        }
+        else {
+            groups[first].second = begin + (end - begin) / 2;
+            groups[first + 1].first = groups[first].second;
+        }
+    }
+    // Shared entries may not fit a compressed leaf, but halves of a leaf that does not fit always do
+    for (g = 0; g < groups.size(); ) {
+        auto [begin, end] = groups[g];
+        if (fits(range(begin, end), level)) {
+            g++;
+            continue;
+        }
+        groups[g].second = begin + (end - begin) / 2;
+        groups.insert(groups.begin() + g + 1, {groups[g].second, end});
+    }
+
+    std::vector<std::vector<Entry>> packed;
+    for (const auto& [begin, end] : groups) {
+        packed.emplace_back(entries.begin() + begin, entries.begin() + end);
+    }
+    return packed;
+}
+
+// Levels are packed bottom-up. The grouping of a level is known before its nodes are written,
+// so every node is written exactly once, already pointing at its parent.
+void RStarTree::bulkLoad(const std::vector<Point>& points, const std::vector<int>& blockIDs, const std::vector<int>& recordIDs, double fillFactor) {
+    if (points.size() != blockIDs.size() || points.size() != recordIDs.size()) {
+        throw std::invalid_argument("Points, block IDs and record IDs must have the same size.");
+    }
+    if (fillFactor <= 0.0 || fillFactor > 1.0) {
+        throw std::invalid_argument("Fill factor must be in (0, 1].");
+    }
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    if (size != 0) {
+        throw std::logic_error("Bulk loading needs an empty tree.");
+    }
+    if (points.empty()) {
+        return;
+    }
+    int capacity = std::clamp(static_cast<int>(std::round(fillFactor * config->maxChildren)), minChildren, config->maxChildren);
+
+    std::vector<Entry> entries;
+    entries.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        const std::vector<double>& coords = points[i].getCoordinates();
+        if (coords.size() != config->dimensions) {
+            throw std::invalid_argument("Point dimensions do not match the tree's dimensions.");
+        }
+        if (blockIDs[i] < 0 || recordIDs[i] < 0) {
+            throw std::invalid_argument("Block ID and Record ID must be non-negative.");
+        }
+        entries.push_back({Region(coords, coords), blockIDs[i], recordIDs[i]});
+    }
+
+    int level = 0;
+    std::vector<std::vector<Entry>> groups = strPack(entries, capacity, 0);
+    // The single node of the top level reuses the (empty) root's ID
+    std::vector<int> groupIDs;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        groupIDs.push_back(groups.size() == 1 ? rootID : newNodeID());
+    }
+
+    while (true) {
+        bool isRoot = groups.size() == 1;
+
+        // Group the next level first, to know the parent of each node of this one
+        std::vector<std::vector<Entry>> parentGroups;
+        std::vector<int> parentIDs;
+        std::unordered_map<int, int> parentOf;
+        if (!isRoot) {
+            std::vector<Entry> parentEntries;
+            for (size_t g = 0; g < groups.size(); ++g) {
+                Region box;
+                for (const Entry& entry : groups[g]) {
+                    box = box.enlarged(entry.box);
+                }
+                parentEntries.push_back({box, groupIDs[g], -1});
+            }
+            parentGroups = strPack(parentEntries, capacity, level + 1);
+            for (const std::vector<Entry>& parentGroup : parentGroups) {
+                parentIDs.push_back(parentGroups.size() == 1 ? rootID : newNodeID());
+                for (const Entry& entry : parentGroup) {
+                    parentOf[entry.id] = parentIDs.back();
+                }
+            }
+        }
+
+        for (size_t g = 0; g < groups.size(); ++g) {
+            const std::vector<Entry>& group = groups[g];
+            int id = groupIDs[g];
+            int parentID = isRoot ? -1 : parentOf[id];
+            if (level == 0) {
+                std::vector<Point> groupPoints;
+                std::vector<int> groupBlockIDs;
+                std::vector<int> groupRecordIDs;
+                for (const Entry& entry : group) {
+                    groupPoints.emplace_back(entry.box.getStart());
+                    groupBlockIDs.push_back(entry.id);
+                    groupRecordIDs.push_back(entry.recordID);
+                }
+                auto leaf = arena->make<TreeLeafNode>(config, id, 0, parentID, Region());
+                leaf->addPoints(config, groupPoints, groupBlockIDs, groupRecordIDs);
+                saveNode(leaf);
+            }
+            else {
+                std::vector<int> childrenIDs;
+                std::vector<Region> childrenBoxes;
+                for (const Entry& entry : group) {
+                    childrenIDs.push_back(entry.id);
+                    childrenBoxes.push_back(entry.box);
+                }
+                auto interior = arena->make<TreeInteriorNode>(config, id, level, parentID, Region());
+                interior->addChildren(config, childrenIDs, childrenBoxes);
+                saveNode(interior);
+            }
+        }
+
+        if (isRoot) {
+            break;
+        }
+        groups = parentGroups;
+        groupIDs = parentIDs;
+        level++;
+    }
+
+    height = level + 1;
+    size = points.size();
+    saveMetadata();
+    if (wal != nullptr) {
+        checkpointLocked();
+    }
+}
+
+/*
+===================================================
+============== External bulk loading ==============
+===================================================
+*/
+
+// Sort-Tile-Recursive with one external sort per dimension: the sort of dimension d orders the entries
+// by <slab of dimensions 0..d-1, center in d>, and the slabs of d are then cut from that order as it streams by.
+// Each level is packed before the one below it is written, so that every node is written once, already
+// pointing at its parent; the level's entries wait in a record file meanwhile.
+long long RStarTree::bulkLoadDataFile(WorkStealingPool& pool, long long memoryBudget, double fillFactor, const std::string& tempDirectory) {
+    if (buffer == nullptr) {
+        throw std::logic_error("Bulk loading from the data file needs a tree stored in a buffer.");
+    }
+    if (fillFactor <= 0.0 || fillFactor > 1.0) {
+        throw std::invalid_argument("Fill factor must be in (0, 1].");
+    }
+    if (memoryBudget <= 0) {
+        throw std::invalid_argument("Memory budget must be positive.");
+    }
+    std::unique_lock<std::shared_mutex> exclusive = lockTreeExclusive();
+    if (size != 0) {
+        throw std::logic_error("Bulk loading needs an empty tree.");
+    }
+    int dimensions = config->dimensions;
+    int width = externalRecordWidth();
+    // At most three sorts are alive at once (the level being packed, its parents and the parents' parentOf pairs)
+    int capacity = std::clamp(static_cast<int>(std::round(fillFactor * config->maxChildren)), minChildren, config->maxChildren);
+    ExternalBuild build = {pool, memoryBudget / 4, tempDirectory, capacity, 1, {}, 0};
+
+    // Scan the data file in block order, straight from the file, whose pool is flushed first and left alone
+    BlockFile* dataFile = buffer->getDataFile();
+    buffer->getDataPool()->flushAll();
+    auto entries = std::make_unique<ExternalSorter>(width, build.sortBudget, pool, tempDirectory);
+    int recordSize = DataPoint::getSerializedSize(config);
+    std::vector<char> page(dataFile->getPageSize());
+    std::vector<double> record(width, 0.0);
+    for (int blockID = 1; blockID < dataFile->getNumBlocks(); ++blockID) {
+        dataFile->readBlock(blockID, page.data());
+        int count = Storable::deserializeInt(page, 0);
+        for (int i = 0; i < count; ++i) {
+            auto start = page.begin() + sizeof(int) + i * recordSize;
+            DataPoint dataPoint = DataPoint::deserialize(config, std::vector<char>(start, start + recordSize));
+            const std::vector<double>& coords = dataPoint.getPoint().getCoordinates();
+            record[1] = 2 * coords[0];
+            std::copy(coords.begin(), coords.end(), record.begin() + EXTERNAL_SORT_KEYS);
+            std::copy(coords.begin(), coords.end(), record.begin() + EXTERNAL_SORT_KEYS + dimensions);
+            record[width - 2] = blockID;
+            record[width - 1] = i;
+            entries->add(record.data());
+        }
+    }
+    long long numPoints = entries->size();
+    if (numPoints == 0) {
+        return 0;
+    }
+
+    // The tree file is written from scratch, dropping the empty root (after logging it, to recover it if this fails)
+    if (wal != nullptr) {
+        for (int blockID = 1; blockID < buffer->getTreeFile()->getNumBlocks(); ++blockID) {
+            wal->preservePage(blockID);
+        }
+    }
+    buffer->getTreePool()->discardAll();
+    buffer->getTreeFile()->truncate();
+    build.pages.resize(static_cast<size_t>(BULK_LOAD_WRITE_PAGES) * buffer->getTreeFile()->getPageSize());
+
+    int level = 0;
+    int firstID = build.nextID;
+    auto nodes = std::make_unique<RecordFile>(tempDirectory, width, EXTERNAL_SORT_MIN_BUFFER);
+    auto parents = std::make_unique<ExternalSorter>(width, build.sortBudget, pool, tempDirectory);
+    long long numNodes = externalPack(std::move(entries), numPoints, *nodes, *parents, nullptr, build);
+    while (numNodes > 1) {
+        auto parentNodes = std::make_unique<RecordFile>(tempDirectory, width, EXTERNAL_SORT_MIN_BUFFER);
+        auto grandparents = std::make_unique<ExternalSorter>(width, build.sortBudget, pool, tempDirectory);
+        auto parentOf = std::make_unique<ExternalSorter>(EXTERNAL_SORT_KEYS + 1, build.sortBudget, pool, tempDirectory);
+        int parentsFirstID = build.nextID;
+        long long numParents = externalPack(std::move(parents), numNodes, *parentNodes, *grandparents, parentOf.get(), build);
+        parentOf->finish();
+        externalWriteLevel(*nodes, level, parentOf.get(), build);
+
+        nodes = std::move(parentNodes);
+        parents = std::move(grandparents);
+        numNodes = numParents;
+        firstID = parentsFirstID;
+        level++;
+    }
+    externalWriteLevel(*nodes, level, nullptr, build);
+    externalFlushPages(build);
+
+    addLatches(build.nextID - 1);
+    rootID = firstID;
+    height = level + 1;
+    size = numPoints;
+    saveMetadata();
+    if (wal != nullptr) {
+        checkpointLocked();
+    }
+    return numPoints;
+}
+
+long long RStarTree::externalPack(std::unique_ptr<ExternalSorter> entries, long long count, RecordFile& nodes, ExternalSorter& parents, ExternalSorter* parentOf, ExternalBuild& build) {
+    int dimensions = config->dimensions;
+    int width = externalRecordWidth();
+    int capacity = build.capacity;
+    std::vector<double> record(width);
+
+    // Slabs of the first dimensions. Entries arrive keyed by <group, center in dimension>, with groupCounts[group] entries in each group
+    std::vector<long long> groupCounts = {count};
+    for (int dimension = 0; dimension < dimensions - 1; ++dimension) {
+        entries->finish();
+        auto next = std::make_unique<ExternalSorter>(width, build.sortBudget, build.pool, build.tempDirectory);
+        std::vector<long long> nextCounts;
+        long long group = -1, rank = 0, slabSize = 0, firstSlab = 0;
+        while (const double* entry = entries->next()) {
+            if (entry[0] != group) {
+                // S = ceil(P^(1/k)) slabs for the P nodes of this group, with k dimensions left to tile, as in strTile
+                group = entry[0];
+                rank = 0;
+                double groupNodes = std::ceil(static_cast<double>(groupCounts[group]) / capacity);
+                size_t slabs = std::ceil(std::pow(groupNodes, 1.0 / (dimensions - dimension)));
+                slabSize = std::ceil(groupNodes / slabs) * capacity;
+                firstSlab = nextCounts.size();
+            }
+            long long slab = firstSlab + rank / slabSize;
+            if (slab == nextCounts.size()) {
+                nextCounts.push_back(0);
+            }
+            nextCounts[slab]++;
+            rank++;
+
+            std::copy(entry, entry + width, record.begin());
+            record[0] = slab;
+            record[1] = entry[EXTERNAL_SORT_KEYS + dimension + 1] + entry[EXTERNAL_SORT_KEYS + dimensions + dimension + 1];
+            next->add(record.data());
+        }
+        entries = std::move(next);
+        groupCounts = std::move(nextCounts);
+    }
+    entries->finish();
+
+    // Runs of capacity entries in each slab of the last dimension make the nodes. As in strPack, a short run is merged
+    // with the node before it (the one after it for the first node), or the two share their entries evenly.
+    // Runs of compressed leaves also end where the next point would not fit the page (the level is 0 without parentOf).
+    bool compressed = parentOf == nullptr && leafPageSize > 0;
+    int minGroup = getMinChildren(parentOf == nullptr ? 0 : 1);
+    auto addToFootprint = [&](DeltaLeaf::Footprint& footprint, const double* entry) {
+        footprint.add(entry + EXTERNAL_SORT_KEYS, 1, static_cast<int>(entry[width - 2]), static_cast<int>(entry[width - 1]));
+    };
+    auto runFits = [&](const double* entries, size_t n) {
+        if (n > config->maxChildren) {
+            return false;
+        }
+        if (!compressed) {
+            return true;
+        }
+        DeltaLeaf::Footprint footprint(dimensions);
+        for (size_t i = 0; i < n; ++i) {
+            addToFootprint(footprint, entries + i * width);
+        }
+        return leafFits(footprint);
+    };
+    long long numNodes = 0;
+    auto emit = [&](const double* entries, size_t n) {
+        int id = build.nextID++;
+        std::vector<double> low(dimensions, std::numeric_limits<double>::infinity());
+        std::vector<double> high(dimensions, -std::numeric_limits<double>::infinity());
+        for (size_t i = 0; i < n; ++i) {
+            const double* entry = entries + i * width;
+            for (int d = 0; d < dimensions; ++d) {
+                low[d] = std::min(low[d], entry[EXTERNAL_SORT_KEYS + d]);
+                high[d] = std::max(high[d], entry[EXTERNAL_SORT_KEYS + dimensions + d]);
+            }
+            std::copy(entry, entry + width, record.begin());
+            record[0] = id;
+            nodes.append(record.data());
+            if (parentOf != nullptr) {
+                double pair[EXTERNAL_SORT_KEYS + 1] = {entry[width - 2], 0.0, static_cast<double>(id)};
+                parentOf->add(pair);
+            }
+        }
+        record[0] = 0;
+        record[1] = low[0] + high[0];
+        std::copy(low.begin(), low.end(), record.begin() + EXTERNAL_SORT_KEYS);
+        std::copy(high.begin(), high.end(), record.begin() + EXTERNAL_SORT_KEYS + dimensions);
+        record[width - 2] = id;
+        record[width - 1] = -1;
+        parents.add(record.data());
+        numNodes++;
+    };
+    // Halves of a compressed leaf that does not fit always do
+    std::function<void(const double*, size_t)> emitFitting = [&](const double* entries, size_t n) {
+        if (runFits(entries, n)) {
+            emit(entries, n);
+            return;
+        }
+        emitFitting(entries, n / 2);
+        emitFitting(entries + (n / 2) * width, n - n / 2);
+    };
+    std::vector<double> pending; // Last complete run, held back in case the next one is short
+    std::vector<double> current; // Run being filled
+    auto closeRun = [&]() {
+        size_t pendingSize = pending.size() / width;
+        size_t currentSize = current.size() / width;
+        if (pendingSize == 0) {
+            pending.swap(current);
+        }
+        else if (pendingSize >= minGroup && currentSize >= minGroup) {
+            emitFitting(pending.data(), pendingSize);
+            pending.swap(current);
+        }
+        else {
+            pending.insert(pending.end(), current.begin(), current.end());
+            if (!runFits(pending.data(), pendingSize + currentSize)) {
+                size_t half = (pendingSize + currentSize) / 2;
+                emitFitting(pending.data(), half);
+                pending.erase(pending.begin(), pending.begin() + half * width);
+            }
+        }
+        current.clear();
+    };
+
+    long long group = -1, rank = 0;
+    DeltaLeaf::Footprint footprint(dimensions); // Of the current run, with the entry being added
+    while (const double* entry = entries->next()) {
+        bool full = rank == capacity;
+        if (compressed) {
+            addToFootprint(footprint, entry);
+            full = full || !leafFits(footprint);
+        }
+        if (entry[0] != group || full) {
+            if (!current.empty()) {
+                closeRun();
+            }
+            group = entry[0];
+            rank = 0;
+            if (compressed) {
+                footprint = DeltaLeaf::Footprint(dimensions);
+                addToFootprint(footprint, entry);
+            }
+        }
+        current.insert(current.end(), entry, entry + width);
+        rank++;
+    }
+    if (!current.empty()) {
+        closeRun();
+    }
+    if (!pending.empty()) {
+        emitFitting(pending.data(), pending.size() / width);
+    }
+    return numNodes;
+}
+
+void RStarTree::externalWriteLevel(RecordFile& nodes, int level, ExternalSorter* parentOf, ExternalBuild& build) {
+    int dimensions = config->dimensions;
+    nodes.rewind(build.sortBudget / 4);
+    const double* entry = nodes.next();
+    while (entry != nullptr) {
+        int id = entry[0];
+        int parentID = -1;
+        if (parentOf != nullptr) {
+            const double* pair = parentOf->next();
+            if (pair == nullptr || pair[0] != id) {
+                throw std::logic_error("Bulk loading lost the parent of node " + std::to_string(id) + ".");
+            }
+            parentID = pair[EXTERNAL_SORT_KEYS];
+        }
+
+        std::shared_ptr<TreeNode> node;
+        if (level == 0) {
+            std::vector<Point> points;
+            std::vector<int> blockIDs, recordIDs;
+            for (; entry != nullptr && entry[0] == id; entry = nodes.next()) {
+                points.emplace_back(std::vector<double>(entry + EXTERNAL_SORT_KEYS, entry + EXTERNAL_SORT_KEYS + dimensions));
+                blockIDs.push_back(entry[EXTERNAL_SORT_KEYS + 2 * dimensions]);
+                recordIDs.push_back(entry[EXTERNAL_SORT_KEYS + 2 * dimensions + 1]);
+            }
+            auto leaf = arena->make<TreeLeafNode>(config, id, 0, parentID, Region());
+            leaf->addPoints(config, points, blockIDs, recordIDs);
+            node = leaf;
+        }
+        else {
+            std::vector<int> childrenIDs;
+            std::vector<Region> childrenBoxes;
+            for (; entry != nullptr && entry[0] == id; entry = nodes.next()) {
+                childrenBoxes.emplace_back(std::vector<double>(entry + EXTERNAL_SORT_KEYS, entry + EXTERNAL_SORT_KEYS + dimensions),
+                    std::vector<double>(entry + EXTERNAL_SORT_KEYS + dimensions, entry + EXTERNAL_SORT_KEYS + 2 * dimensions));
+                childrenIDs.push_back(entry[EXTERNAL_SORT_KEYS + 2 * dimensions]);
+            }
+            auto interior = arena->make<TreeInteriorNode>(config, id, level, parentID, Region());
+            interior->addChildren(config, childrenIDs, childrenBoxes);
+            node = interior;
+        }
+
+        // Nodes are packed in ID order, so appending the pages in order puts each at its ID
+        int pageSize = buffer->getTreeFile()->getPageSize();
+        std::span<std::byte> out(reinterpret_cast<std::byte*>(build.pages.data()) + static_cast<size_t>(build.pendingPages) * pageSize, pageSize);
+        size_t written = node->serializeInto(config, out);
+        std::fill(out.begin() + written, out.end(), std::byte{0});
+        build.pendingPages++;
+        if (build.pendingPages == BULK_LOAD_WRITE_PAGES) {
+            externalFlushPages(build);
+        }
+    }
+}
+
+void RStarTree::externalFlushPages(ExternalBuild& build) {
+    if (build.pendingPages == 0) {
+        return;
+    }
+    buffer->getTreeFile()->appendBlocks(build.pages.data(), build.pendingPages);
+    build.pendingPages = 0;
+}
+
+/*
+===================================================
+===================== Queries =====================
+===================================================
+*/
+
+long long QueryStats::getInteriorVisited() const {
+    return nodesVisited.empty() ? 0 : std::accumulate(nodesVisited.begin() + 1, nodesVisited.end(), 0LL);
+}
+
+void QueryStats::visit(int level) {
+    if (level >= nodesVisited.size()) {
+        nodesVisited.resize(level + 1);
+    }
+    nodesVisited[level]++;
+}
+
+QueryStats& QueryStats::operator+=(const QueryStats& other) {
+    queries += other.queries;
+    if (other.nodesVisited.size() > nodesVisited.size()) {
+        nodesVisited.resize(other.nodesVisited.size());
+    }
+    for (size_t level = 0; level < other.nodesVisited.size(); ++level) {
+        nodesVisited[level] += other.nodesVisited[level];
+    }
+    poolHits += other.poolHits;
+    poolMisses += other.poolMisses;
+    bytesDeserialized += other.bytesDeserialized;
+    overlapTests += other.overlapTests;
+    results += other.results;
+    wallTime += other.wallTime;
+    return *this;
+}
+
+// The clock is only read for queries that collect stats
+static std::chrono::steady_clock::time_point startQuery(const QueryStats* stats) {
+    return stats != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+}
+
+static void finishQuery(QueryStats* stats, std::chrono::steady_clock::time_point start, long long results) {
+    if (stats == nullptr) {
+        return;
+    }
+    stats->queries++;
+    stats->results += results;
+    stats->wallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::pair<int, int> RStarTree::findPoint(const Point& point, QueryStats* stats) const {
+    auto start = startQuery(stats);
+    std::shared_lock<std::shared_mutex> treeLock = lockTreeShared();
+    std::pair<int, int> result = buffer != nullptr ? findPointInPages(point, stats) : findPointInNodes(point, stats);
+    finishQuery(stats, start, result.first != -1);
+    return result;
+}
+
+std::pair<int, int> RStarTree::findPointInNodes(const Point& point, QueryStats* stats) const {
+    std::vector<int> stack = {rootID};
+    while (!stack.empty()) {
+        NodeLatch& latch = latchFor(stack.back());
+        std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+        std::shared_ptr<TreeNode> node = getNode(stack.back());
+        stack.pop_back();
+        if (stats != nullptr) {
+            stats->visit(node->getLevel());
+            stats->overlapTests += latch.buffered.size() + node->getNumChildren();
+        }
+
+        if (node->isLeaf()) {
+            std::pair<int, int> result = std::static_pointer_cast<TreeLeafNode>(node)->findPoint(point);
+            if (result.first != -1) {
+                return result;
+            }
+            continue;
+        }
+        int index = latch.buffered.find(point);
+        if (index != -1) {
+            return {latch.buffered.blockIDs[index], latch.buffered.recordIDs[index]};
+        }
+        if (node->getNumChildren() > 0) {
+            std::vector<int> children = std::static_pointer_cast<TreeInteriorNode>(node)->rangeQuery(point);
+            stack.insert(stack.end(), children.begin(), children.end());
+        }
+    }
+    return {-1, -1}; // Point not found
+}
+
+std::vector<std::pair<int, int>> RStarTree::rangeQuery(const Region& query, QueryStats* stats) const {
+    auto start = startQuery(stats);
+    std::shared_lock<std::shared_mutex> treeLock = lockTreeShared();
+    std::vector<std::pair<int, int>> results;
+    std::vector<std::pair<int, int>> children;
+    std::vector<std::pair<int, int>> stack = {{rootID, height - 1}};
+    while (!stack.empty()) {
+        auto [nodeID, level] = stack.back();
+        stack.pop_back();
+        rangeQueryNode(query, nodeID, level, results, children, stats);
+        stack.insert(stack.end(), children.begin(), children.end());
+        children.clear();
+    }
+    finishQuery(stats, start, results.size());
+    return results;
+}
+
+std::vector<std::vector<std::pair<int, int>>> RStarTree::rangeQueries(const std::vector<Region>& queries, WorkStealingPool& pool, std::vector<QueryStats>* stats) const {
+    // Held by this thread for the whole batch, the workers only take node latches
+    std::shared_lock<std::shared_mutex> treeLock = lockTreeShared();
+    std::vector<std::vector<std::pair<int, int>>> results(queries.size());
+    std::vector<std::mutex> resultsMutexes(queries.size());
+    if (stats != nullptr) {
+        stats->assign(queries.size(), QueryStats());
+    }
+    // Waits for this batch only, so that several threads can run batches on one pool
+    TaskGroup group(pool);
+    for (int i = 0; i < queries.size(); ++i) {
+        QueryStats* queryStats = stats != nullptr ? &(*stats)[i] : nullptr;
+        group.submit([this, &queries, &results, &resultsMutexes, &group, i, queryStats]() {
+            rangeQuerySubtree(queries[i], rootID, height - 1, results[i], resultsMutexes[i], group, queryStats);
+        });
+    }
+    group.wait();
+    if (stats != nullptr) {
+        for (int i = 0; i < queries.size(); ++i) {
+            (*stats)[i].queries = 1;
+            (*stats)[i].results = results[i].size();
+        }
+    }
+    return results;
+}
+
+// While some worker is idle, children above level 0 are submitted as tasks, except the first, which this task goes on with.
+// Leaves are read by the task that found them, as one leaf is too little work for a task,
+// and with every worker busy (most of a large batch) splitting would only add overhead.
+void RStarTree::rangeQuerySubtree(const Region& query, int nodeID, int level, std::vector<std::pair<int, int>>& results, std::mutex& resultsMutex, TaskGroup& group, QueryStats* stats) const {
+    auto start = startQuery(stats);
+    QueryStats taskStats; // Counted without the lock, added to stats at the end
+    QueryStats* counted = stats != nullptr ? &taskStats : nullptr;
+    std::vector<std::pair<int, int>> found;
+    std::vector<std::pair<int, int>> children;
+    std::vector<std::pair<int, int>> stack = {{nodeID, level}};
+    while (!stack.empty()) {
+        auto [currentID, currentLevel] = stack.back();
+        stack.pop_back();
+        rangeQueryNode(query, currentID, currentLevel, found, children, counted);
+        for (int i = 0; i < children.size(); ++i) {
+            auto [childID, childLevel] = children[i];
+            if (i == 0 || childLevel == 0 || !group.getPool().hasIdleWorkers()) {
+                stack.emplace_back(childID, childLevel);
+            }
+            else {
+                group.submit([this, &query, &results, &resultsMutex, &group, childID, childLevel, stats]() {
+                    rangeQuerySubtree(query, childID, childLevel, results, resultsMutex, group, stats);
+                });
+            }
+        }
+        children.clear();
+    }
+    if (stats != nullptr) {
+        taskStats.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (!found.empty() || stats != nullptr) {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        if (stats != nullptr) {
+            *stats += taskStats;
+        }
+        if (found.empty()) {
+            return;
+        }
+        if (results.empty()) {
+            results = std::move(found);
+        }
+        else {
+            results.insert(results.end(), found.begin(), found.end());
+        }
+    }
+}
+
+void RStarTree::rangeQueryNode(const Region& query, int nodeID, int level, std::vector<std::pair<int, int>>& results, std::vector<std::pair<int, int>>& children, QueryStats* stats) const {
+    NodeLatch& latch = latchFor(nodeID);
+    std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+    if (stats != nullptr) {
+        stats->visit(level);
+        stats->overlapTests += latch.buffered.size();
+    }
+    for (int i = 0; i < latch.buffered.size(); ++i) {
+        if (latch.buffered.pointInside(i, query)) {
+            results.emplace_back(latch.buffered.blockIDs[i], latch.buffered.recordIDs[i]);
+        }
+    }
+    if (buffer == nullptr) {
+        std::shared_ptr<TreeNode> node = getNode(nodeID);
+        if (stats != nullptr) {
+            stats->overlapTests += node->getNumChildren();
+        }
+        if (node->isLeaf()) {
+            std::vector<std::pair<int, int>> found = std::static_pointer_cast<TreeLeafNode>(node)->rangeQuery(query);
+            results.insert(results.end(), found.begin(), found.end());
+        }
+        else if (node->getNumChildren() > 0) {
+            for (int childID : std::static_pointer_cast<TreeInteriorNode>(node)->rangeQuery(query)) {
+                children.emplace_back(childID, level - 1);
+            }
+        }
+        return;
+    }
+
+    // Over the tree file's pages, reading the node in place with a view
+    PinnedPage page = buffer->pinNode(nodeID);
+    if (stats != nullptr) {
+        stats->addPage(page.wasHit());
+    }
+    if (level == 0) {
+        LeafNodeView leaf(config, page.bytes());
+        if (stats != nullptr) {
+            stats->overlapTests += leaf.getNumChildren();
+            stats->bytesDeserialized += leaf.getDecodedSize(leaf.getNumChildren());
+        }
+        for (int i = 0; i < leaf.getNumChildren(); ++i) {
+            if (leaf.pointInside(i, query) && !leaf.isDeleted(i)) {
+                results.emplace_back(leaf.getBlockID(i), leaf.getRecordID(i));
+            }
+        }
+    }
+    else {
+        InteriorNodeView interior(config, page.bytes());
+        if (stats != nullptr) {
+            stats->overlapTests += interior.getNumChildren();
+            stats->bytesDeserialized += interior.getDecodedSize(interior.getNumChildren());
+        }
+        for (int i = 0; i < interior.getNumChildren(); ++i) {
+            if (interior.childOverlaps(i, query)) {
+                children.emplace_back(interior.getChildID(i), level - 1);
+            }
+        }
+    }
+}
+
+// findPoint over the pinned pages of the tree file, reading nodes in place with views
+// The stack holds <nodeID, level>, so that each page is read with the right view
+std::pair<int, int> RStarTree::findPointInPages(const Point& point, QueryStats* stats) const {
+    std::vector<std::pair<int, int>> stack = {{rootID, height - 1}};
+    while (!stack.empty()) {
+        auto [nodeID, level] = stack.back();
+        stack.pop_back();
+        NodeLatch& latch = latchFor(nodeID);
+        std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+        if (stats != nullptr) {
+            stats->visit(level);
+            stats->overlapTests += latch.buffered.size();
+        }
+        int index = latch.buffered.find(point);
+        if (index != -1) {
+            return {latch.buffered.blockIDs[index], latch.buffered.recordIDs[index]};
+        }
+        PinnedPage page = buffer->pinNode(nodeID);
+        if (stats != nullptr) {
+            stats->addPage(page.wasHit());
+        }
+
+        if (level == 0) {
+            LeafNodeView leaf(config, page.bytes());
+            int tested = 0; // Points up to the one found
+            std::pair<int, int> found = {-1, -1};
+            while (tested < leaf.getNumChildren() && found.first == -1) {
+                if (leaf.pointEquals(tested, point) && !leaf.isDeleted(tested)) {
+                    found = {leaf.getBlockID(tested), leaf.getRecordID(tested)};
+                }
+                tested++;
+            }
+            if (stats != nullptr) {
+                stats->overlapTests += tested;
+                stats->bytesDeserialized += leaf.getDecodedSize(tested);
+            }
+            if (found.first != -1) {
+                return found;
+            }
+        }
+        else {
+            InteriorNodeView interior(config, page.bytes());
+            if (stats != nullptr) {
+                stats->overlapTests += interior.getNumChildren();
+                stats->bytesDeserialized += interior.getDecodedSize(interior.getNumChildren());
+            }
+            for (int i = 0; i < interior.getNumChildren(); ++i) {
+                if (interior.childOverlaps(i, point)) {
+                    stack.emplace_back(interior.getChildID(i), level - 1);
+                }
+            }
+        }
+    }
+    return {-1, -1}; // Point not found
+}
+
+// Best-first search (Hjaltason and Samet, 1999): a priority queue holds nodes by MINDIST and points by distance,
+// so a point popped from the queue is nearer than anything left. Every queued node holds a point within its
+// MINMAXDIST, so once k queued entries are known to hold points within some distance, farther entries are not queued.
+// After a delete boxes may cover deleted points (tombstones until compaction, or points deleted from an insert
+// buffer), so MINMAXDIST no longer bounds anything and only queued points count. The same holds for quantized boxes.
+std::vector<std::tuple<int, int, double>> RStarTree::nearestNeighbors(const Point& point, int k, QueryStats* stats) const {
+    if (point.getCoordinates().size() != config->dimensions) {
+        throw std::invalid_argument("Query point has " + std::to_string(point.getCoordinates().size()) + " dimensions, expected " + std::to_string(config->dimensions) + ".");
+    }
+    if (k < 0) {
+        throw std::invalid_argument("k cannot be negative.");
+    }
+    auto start = startQuery(stats);
+    std::shared_lock<std::shared_mutex> treeLock = lockTreeShared();
+    std::vector<std::tuple<int, int, double>> results;
+    if (k == 0 || size == 0) {
+        finishQuery(stats, start, 0);
+        return results;
+    }
+
+    struct Candidate {
+        double distance; // Squared MINDIST for nodes, squared distance for points
+        double bound; // Squared distance for points, squared MINMAXDIST (or infinity) for nodes
+        int nodeID; // -1 for points
+        int blockID;
+        int recordID;
+    };
+    // Points before nodes at the same distance, so that results come out as early as possible
+    auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.distance > b.distance || (a.distance == b.distance && a.nodeID > b.nodeID);
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> queue(farther);
+    // Upper bounds of the queued candidates; their subtrees are disjoint, so each finite bound is a different point
+    std::multiset<double> bounds;
+
+    // Distance within which the missing results are guaranteed to be found
+    auto pruneDistance = [&]() {
+        size_t missing = k - results.size();
+        if (bounds.size() < missing) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return *std::next(bounds.begin(), missing - 1);
+    };
+
+    // Quantized child boxes in the pages are rounded outward, so their near faces may touch no point either
+    bool tightBoxes = !looseBoxes && (buffer == nullptr || config->childBoxBits == 0);
+    queue.push({0.0, std::numeric_limits<double>::infinity(), rootID, -1, -1});
+    bounds.insert(std::numeric_limits<double>::infinity());
+    std::vector<Candidate> children;
+    while (!queue.empty() && results.size() < k) {
+        Candidate candidate = queue.top();
+        queue.pop();
+        bounds.erase(bounds.find(candidate.bound));
+
+        if (candidate.nodeID == -1) {
+            results.emplace_back(candidate.blockID, candidate.recordID, std::sqrt(candidate.distance));
+            continue;
+        }
+
+        NodeLatch& latch = latchFor(candidate.nodeID);
+        std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+        std::shared_ptr<TreeNode> node = getNode(candidate.nodeID, stats);
+        if (stats != nullptr) {
+            stats->visit(node->getLevel());
+            stats->overlapTests += latch.buffered.size() + node->getNumChildren();
+        }
+        children.clear();
+        for (int i = 0; i < latch.buffered.size(); ++i) {
+            const double* values = latch.buffered.point(i, config->dimensions);
+            double distance = 0.0;
+            for (int d = 0; d < config->dimensions; ++d) {
+                distance += (values[d] - point.getCoordinates()[d]) * (values[d] - point.getCoordinates()[d]);
+            }
+            children.push_back({distance, distance, -1, latch.buffered.blockIDs[i], latch.buffered.recordIDs[i]});
+        }
+        if (node->isLeaf()) {
+            auto leaf = std::static_pointer_cast<TreeLeafNode>(node);
+            std::span<const int> blockIDs = leaf->getBlockIDs();
+            std::span<const int> recordIDs = leaf->getRecordIDs();
+            for (int i = 0; i < leaf->getNumChildren(); ++i) {
+                if (leaf->isDeleted(i)) {
+                    continue;
+                }
+                double distance = leaf->squaredDistance(i, point);
+                children.push_back({distance, distance, -1, blockIDs[i], recordIDs[i]});
+            }
+        }
+        else {
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                Region box = interior->getChildBoundingBox(i);
+                double bound = tightBoxes ? box.minMaxDist(point) : std::numeric_limits<double>::infinity();
+                children.push_back({box.minDist(point), bound, interior->getChildID(i), -1, -1});
+            }
+        }
+
+        for (const Candidate& child : children) {
+            bounds.insert(child.bound);
+        }
+        double prune = pruneDistance();
+        for (const Candidate& child : children) {
+            if (child.distance > prune) {
+                bounds.erase(bounds.find(child.bound));
+            }
+            else {
+                queue.push(child);
+            }
+        }
+    }
+    finishQuery(stats, start, results.size());
+    return results;
+}
+
+// Branch-and-bound skyline (Papadias et al., 2003): entries are visited by the L1 distance of their best corner
+// to the ideal point, so a point popped from the queue cannot be dominated by a point popped later.
+// Entries whose best corner is dominated by a skyline point are dropped without reading them.
+std::vector<std::pair<int, int>> RStarTree::skyline(const std::vector<SkylinePreference>& preferences) const {
+    if (!preferences.empty() && preferences.size() != config->dimensions) {
+        throw std::invalid_argument("Skyline needs one preference per dimension, got " + std::to_string(preferences.size()) + ".");
+    }
+    std::shared_lock<std::shared_mutex> treeLock = lockTreeShared();
+    std::vector<std::pair<int, int>> results;
+    if (size == 0) {
+        return results;
+    }
+
+    // Coordinates are flipped in Max dimensions, so that smaller is always better
+    std::vector<double> sign(config->dimensions, 1.0);
+    for (size_t d = 0; d < preferences.size(); ++d) {
+        if (preferences[d] == SkylinePreference::Max) {
+            sign[d] = -1.0;
+        }
+    }
+
+    struct Candidate {
+        double distance; // L1 distance of the corner to the ideal point (up to a constant)
+        std::vector<double> corner; // Best corner of the entry, flipped
+        int nodeID; // -1 for points
+        int blockID;
+        int recordID;
+    };
+    auto farther = [](const Candidate& a, const Candidate& b) {
+        return a.distance > b.distance || (a.distance == b.distance && a.nodeID > b.nodeID);
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> queue(farther);
+
+    // The flipped skyline points found so far, in the order of results
+    std::vector<std::vector<double>> skylinePoints;
+    // True if a is at least as good as b in every dimension
+    auto dominates = [](const std::vector<double>& a, const std::vector<double>& b) {
+        for (size_t d = 0; d < a.size(); ++d) {
+            if (a[d] > b[d]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto isDominated = [&](const std::vector<double>& corner) {
+        for (const std::vector<double>& skylinePoint : skylinePoints) {
+            if (dominates(skylinePoint, corner)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto push = [&](const AbstractBoundedClass& box, int nodeID, int blockID, int recordID) {
+        Candidate candidate{0.0, std::vector<double>(config->dimensions), nodeID, blockID, recordID};
+        for (int d = 0; d < config->dimensions; ++d) {
+            candidate.corner[d] = sign[d] > 0 ? box.getStart()[d] : -box.getEnd()[d];
+            candidate.distance += candidate.corner[d];
+        }
+        if (!isDominated(candidate.corner)) {
+            queue.push(std::move(candidate));
+        }
+    };
+
+    queue.push({0.0, {}, rootID, -1, -1});
+    while (!queue.empty()) {
+        Candidate candidate = queue.top();
+        queue.pop();
+        // Skyline points found since the entry was queued may dominate it now
+        if (candidate.nodeID != rootID && isDominated(candidate.corner)) {
+            continue;
+        }
+
+        if (candidate.nodeID == -1) {
+            // Rounding in the distances may put a point just ahead of one dominating it
+            for (size_t i = 0; i < skylinePoints.size(); ++i) {
+                if (dominates(candidate.corner, skylinePoints[i])) {
+                    skylinePoints.erase(skylinePoints.begin() + i);
+                    results.erase(results.begin() + i);
+                    --i;
+                }
+            }
+            skylinePoints.push_back(candidate.corner);
+            results.emplace_back(candidate.blockID, candidate.recordID);
+            continue;
+        }
+
+        NodeLatch& latch = latchFor(candidate.nodeID);
+        std::shared_lock<std::shared_mutex> nodeLock(latch.latch);
+        std::shared_ptr<TreeNode> node = getNode(candidate.nodeID);
+        for (int i = 0; i < latch.buffered.size(); ++i) {
+            const double* values = latch.buffered.point(i, config->dimensions);
+            push(Point(std::vector<double>(values, values + config->dimensions)), -1, latch.buffered.blockIDs[i], latch.buffered.recordIDs[i]);
+        }
+        if (node->isLeaf()) {
+            auto leaf = std::static_pointer_cast<TreeLeafNode>(node);
+            for (int i = 0; i < leaf->getNumChildren(); ++i) {
+                if (!leaf->isDeleted(i)) {
+                    push(leaf->getPoint(i), -1, leaf->getBlockIDs()[i], leaf->getRecordIDs()[i]);
+                }
+            }
+        }
+        else {
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                push(interior->getChildBoundingBox(i), interior->getChildID(i), -1, -1);
+            }
+        }
+    }
+    return results;
+}
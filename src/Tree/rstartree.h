@@ -0,0 +1,325 @@
+#ifndef RSTARTREE_H
+#define RSTARTREE_H
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <set>
+#include <thread>
+#include <span>
+#include "globalparameters.h"
+#include "point.h"
+#include "region.h"
+#include "treenode.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+#include "nodeview.h"
+#include "nodearena.h"
+#include "buffer.h"
+#include "workstealingpool.h"
+#include "externalsorter.h"
+#include "writeaheadlog.h"
+#include "hilbertcurve.h"
+
+// Fraction of maxChildren used as the minimum fill of a node (m in the R*-tree paper)
+#define RSTAR_MIN_FILL 0.4
+// Fraction of maxChildren removed from an overflowing node on forced reinsert (p in the R*-tree paper)
+#define RSTAR_REINSERT_FRACTION 0.3
+// Number of candidates (by area enlargement) considered for the overlap criterion in ChooseSubtree
+#define RSTAR_OVERLAP_CANDIDATES 32
+// Default memory budget in bytes of bulkLoadDataFile
+#define DEFAULT_BULK_LOAD_MEMORY (256LL << 20)
+// Tree pages appended to the tree file with one write by bulkLoadDataFile
+#define BULK_LOAD_WRITE_PAGES 256
+// Default capacity in points of the operation buffer of each interior node in buffered insertion
+#define DEFAULT_INSERT_BUFFER 256
+// Leaves compacted per hold of the exclusive tree latch, so that compaction only stalls queries briefly
+#define COMPACTION_STEP_LEAVES 16
+
+// Whether smaller or larger values are preferred in a dimension of a skyline query
+enum class SkylinePreference { Min, Max };
+
+// Work done by queries, for tuning maxChildren and the page size against a query mix.
+// Query methods add to it when given one, so one QueryStats can sum up many queries; without one they count nothing.
+struct QueryStats {
+    long long queries = 0;
+    std::vector<long long> nodesVisited; // Per level, leaves at 0
+    long long poolHits = 0; // Tree pages found in the tree pool
+    long long poolMisses = 0; // Tree pages read from the tree file
+    // Of tree pages decoded: what range queries and lookups read in place through node views,
+    // and the whole pages nearest neighbors copy into nodes
+    long long bytesDeserialized = 0;
+    // Entries tested against the query: boxes and points by overlaps (points by equality in leaves for lookups),
+    // and for nearest neighbors, the MINDIST of boxes and the distance of points
+    long long overlapTests = 0;
+    long long results = 0;
+    double wallTime = 0.0; // Seconds, waiting for the tree latch included
+
+    long long getLeavesVisited() const { return nodesVisited.empty() ? 0 : nodesVisited[0]; }
+    long long getInteriorVisited() const;
+    void visit(int level);
+    void addPage(bool hit) { hit ? poolHits++ : poolMisses++; }
+    void reset() { *this = QueryStats(); }
+    QueryStats& operator+=(const QueryStats& other);
+};
+
+class RStarTree {
+    // This class manages the root and the nodes of an R*-tree and implements
+    // the R* insertion heuristics (Beckmann et al., 1990):
+    // ChooseSubtree, OverflowTreatment with forced reinsert, and the topological split.
+    // Leaves are level 0, the root is at level height-1.
+    //
+    // Queries and inserts may run from several threads at once.
+    // Both take the tree latch shared, and hold a node's reader/writer latch while they read or change the node.
+    // Under the shared tree latch no node is split or loses entries: inserts only grow boxes, top-down,
+    // and add a point to a leaf that had room (reserved before growing the path), so queries see each point
+    // either nowhere or wherever a later query would.
+    // An insert whose leaf is full needs OverflowTreatment, whose splits and reinserts can move entries
+    // anywhere in the tree, so it retries with the tree latch held exclusively.
+    // bulkLoad also holds it exclusively. Inserting the same point from two threads at once is not detected.
+    //
+    // With a write-ahead log, each insert is logged before it releases its latch and returns once the log is synced,
+    // with concurrent inserts sharing syncs (group commit). Opening the tree recovers from the log and checkpoints.
+    //
+    // Buffered insertion (for high-rate ingest, as in buffer trees): interior nodes carry an operation buffer in memory.
+    // Inserts only append the point to the root's buffer. A full buffer is emptied one level down under the exclusive
+    // tree latch, each node read and written once for the whole batch: points go to the buffers of the children
+    // ChooseSubtree picks, whose boxes grow to cover them, and at level 1 into the leaves, with the usual
+    // OverflowTreatment for leaves that fill up. The box of a node in its parent always covers the node's buffer,
+    // so queries reach every buffered point by reading the buffers of the interior nodes they visit.
+    //
+    // Deletes only mark the point's leaf slot as a tombstone (or take it out of an insert buffer), under the shared
+    // tree latch and the leaf's latch, so they never restructure the tree. Compaction reclaims the tombstones later,
+    // a few leaves per hold of the exclusive tree latch: it rebuilds each leaf without them, and CondenseTree
+    // removes underfull nodes, reinserts their entries and tightens the boxes up to the root.
+    // A full leaf also drops its tombstones before it splits. Nodes removed by compaction are reused by later splits.
+    //
+    // With LEAF_FORMAT_DELTA, a leaf is full once it holds maxChildren points or its encoding fills the page,
+    // whichever comes first. Pages only promise room for maxChildren / 2 + 1 points of any values, so the minimum
+    // fill of leaves is taken from that many, and a split only picks distributions whose groups both fit.
+protected:
+    // An entry of a node, used while redistributing entries in reinsert and split
+    // Leaf entries hold a degenerate box (the point) with its blockID and recordID
+    // Interior entries hold the child's bounding box and ID (recordID is -1)
+    struct Entry {
+        Region box;
+        int id; // blockID for leaf entries, child node ID for interior entries
+        int recordID;
+    };
+
+    GlobalParameters* config;
+    int rootID;
+    int height; // Number of levels in the tree
+    int nextNodeID = 1; // Node ID 0 is reserved (metadata block)
+    int minChildren;
+    int minLeafChildren; // minChildren, or less for compressed leaves (see the class comment)
+    int leafPageSize = 0; // Bytes a compressed leaf may take, 0 for plain leaves, which only fill up by count
+    std::atomic<long long> size = 0; // Number of points in the tree
+    std::vector<bool> reinsertedLevels; // OverflowTreatment: levels that already reinserted during the current insert
+
+    // Nodes live in memory, or in the tree file of the buffer if one is given
+    std::unordered_map<int, std::shared_ptr<TreeNode>> nodes;
+    std::shared_ptr<NodeArena> arena = std::make_shared<NodeArena>(); // Blocks of the nodes built or read by this tree
+    Buffer* buffer = nullptr;
+    WriteAheadLog* wal = nullptr;
+    bool replaying = false; // Redoing the log at startup, when nothing is logged again
+
+    // Points waiting in an interior node for buffered insertion
+    struct InsertBuffer {
+        std::vector<double> coords; // dimensions values per point
+        std::vector<int> blockIDs;
+        std::vector<int> recordIDs;
+        std::vector<double> low; // Bounding box of the points, empty while there are none
+        std::vector<double> high;
+
+        int size() const { return blockIDs.size(); }
+        bool empty() const { return blockIDs.empty(); }
+        const double* point(int index, int dimensions) const { return coords.data() + index * dimensions; }
+        void append(const double* point, int dimensions, int blockID, int recordID);
+        int find(const Point& point) const; // Index of the point, or -1
+        void remove(int index, int dimensions); // The last point takes its place, the box stays as it is
+        bool pointInside(int index, const AbstractBoundedClass& query) const;
+    };
+
+    // Latches
+    struct NodeLatch {
+        std::shared_mutex latch;
+        int reserved = 0; // Leaf slots promised to inserts still growing their path, guarded by latch
+        InsertBuffer buffered; // Operation buffer of an interior node, guarded by latch
+    };
+    mutable std::shared_mutex treeLatch;
+    mutable std::mutex treeLatchGate; // Held by a thread waiting for the exclusive tree latch, so that new readers queue behind it
+    mutable std::atomic<int> exclusiveWaiting = 0;
+    std::vector<std::unique_ptr<NodeLatch>> latches; // Indexed by node ID, only grown under the exclusive tree latch
+    std::mutex metadataMutex; // saveMetadata from inserts under the shared tree latch
+    std::shared_lock<std::shared_mutex> lockTreeShared() const;
+    std::unique_lock<std::shared_mutex> lockTreeExclusive() const;
+    NodeLatch& latchFor(int nodeID) const;
+    void addLatches(int lastNodeID); // Makes sure every node up to lastNodeID has a latch
+
+    // Node storage
+    std::shared_ptr<TreeNode> getNode(int nodeID, QueryStats* stats = nullptr) const; // Counts the page read into stats if given
+    void saveNode(const std::shared_ptr<TreeNode>& node);
+    int newNodeID();
+    void saveMetadata(); // Root, height and size, persisted in the tree file's metadata block
+
+    // Write-ahead logging
+    long long logInsert(const Point& point, int blockID, int recordID); // Called with a latch held, returns the LSN to commit (0 if not logged)
+    void commitLog(long long lsn); // Waits for the log record, then checkpoints if the log has grown past WAL_CHECKPOINT_SIZE
+    void replayLog(); // Redo the operations restored from the log
+    void checkpointLocked(); // Called with the exclusive tree latch held
+
+    // Node construction from entries
+    std::shared_ptr<TreeNode> makeNode(int id, int level, int parentID, const std::vector<Entry>& entries);
+    std::vector<Entry> getEntries(const std::shared_ptr<TreeNode>& node) const;
+    // Room left in nodes: entries of a level fit one node if they are at most maxChildren, and for compressed leaves,
+    // if their encoding fits the page
+    bool leafFits(const DeltaLeaf::Footprint& footprint) const { return TreeNode::getSerializedSize(config) + footprint.getSize() <= leafPageSize; }
+    bool fits(std::span<const Entry> entries, int level) const;
+    bool hasRoom(const std::shared_ptr<TreeNode>& node, const Entry& entry) const; // Whether the node takes one more entry
+
+    // Insertion
+    bool insertInPlace(const Entry& entry); // Under the shared tree latch, false (and nothing changed) if the leaf is full
+    bool bufferEntry(const Entry& entry); // Under the shared tree latch, into the root's buffer. Returns whether the buffer is full.
+    void insertEntry(const Entry& entry, int level);
+    int chooseSubtree(const Region& box, int level);
+    int chooseChild(const TreeInteriorNode& node, const Region& box) const; // Index of the child ChooseSubtree descends to
+    void overflowTreatment(const std::shared_ptr<TreeNode>& node, const Entry& extra);
+    void reInsert(const std::shared_ptr<TreeNode>& node, std::vector<Entry> entries);
+    void split(const std::shared_ptr<TreeNode>& node, std::vector<Entry> entries);
+    int chooseSplitAxis(std::vector<Entry>& entries, int level) const;
+    int chooseSplitIndex(std::vector<Entry>& entries, int axis, int level) const;
+    void adjustPath(const std::shared_ptr<TreeNode>& node);
+    void setChildrenParent(const std::vector<Entry>& entries, int level, int parentID);
+
+    // Buffered insertion, under the exclusive tree latch
+    int insertBufferCapacity = 0; // 0 while inserts are not buffered
+    std::atomic<long long> bufferedPoints = 0;
+    Region coverBox(const std::shared_ptr<TreeNode>& node) const; // The node's box, grown to cover its buffer
+    // Pushes the buffer of an interior node down one level. Child buffers filled up are emptied in turn,
+    // or with all, every child buffer holding points.
+    void emptyBuffer(int nodeID, bool all);
+    void flushInsertBuffersLocked();
+
+    // Deletion and compaction
+    std::atomic<long long> deletedPoints = 0; // Tombstones left in the leaves
+    std::atomic<bool> looseBoxes = false; // Whether boxes may cover deleted points, so that MINMAXDIST bounds do not hold
+    std::vector<int> freeNodeIDs; // Nodes removed by CondenseTree, reused by newNodeID
+    std::mutex compactionMutex;
+    std::condition_variable compactionWake;
+    std::set<int> leavesToCompact; // Leaves holding tombstones, guarded by compactionMutex
+    std::thread compactor;
+    bool stopCompacting = false; // Guarded by compactionMutex
+    std::exception_ptr compactionError; // First error of the background compaction, guarded by compactionMutex
+    bool removeInPlace(const Point& point); // Under the shared tree latch, false if the point is not in the tree
+    long long logDelete(const Point& point);
+    // The steps below run under the exclusive tree latch
+    bool compactStep(int maxLeaves); // Returns whether leaves are left to compact
+    void compactLeaf(int leafID);
+    void condenseTree(const std::shared_ptr<TreeNode>& leaf);
+    void shrinkRoot(); // While the root is an interior node with one child, the child becomes the root
+    void freeNode(int nodeID);
+    void compactionLoop();
+
+    // Queries, each counting its work into stats if given
+    std::pair<int, int> findPointInNodes(const Point& point, QueryStats* stats) const;
+    // Over the tree file's pages, reading nodes in place instead of deserializing them
+    std::pair<int, int> findPointInPages(const Point& point, QueryStats* stats) const;
+    // One node of a range query, under the node's latch: appends the matching points of a leaf to results,
+    // or the overlapping children of an interior node to children as <nodeID, level>
+    void rangeQueryNode(const Region& query, int nodeID, int level, std::vector<std::pair<int, int>>& results, std::vector<std::pair<int, int>>& children, QueryStats* stats) const;
+    // stats is shared by the tasks of a query, guarded by resultsMutex
+    void rangeQuerySubtree(const Region& query, int nodeID, int level, std::vector<std::pair<int, int>>& results, std::mutex& resultsMutex, TaskGroup& group, QueryStats* stats) const;
+
+    // Bulk loading (Sort-Tile-Recursive)
+    void strTile(std::vector<Entry>& entries, size_t begin, size_t end, int dimension, int capacity, int level, std::vector<std::pair<size_t, size_t>>& groups) const;
+    std::vector<std::vector<Entry>> strPack(std::vector<Entry>& entries, int capacity, int level) const;
+
+    // External-memory bulk loading: the same tiling with external sorts, over records of
+    // EXTERNAL_SORT_KEYS sort keys, the low corner, the high corner, id and recordID
+    struct ExternalBuild {
+        WorkStealingPool& pool;
+        long long sortBudget; // Memory budget of each external sort
+        std::string tempDirectory;
+        int capacity;
+        int nextID; // Node IDs are handed out in the order nodes are packed
+        std::vector<char> pages; // Pages waiting to be appended to the tree file
+        int pendingPages = 0;
+    };
+    int externalRecordWidth() const { return EXTERNAL_SORT_KEYS + 2 * config->dimensions + 2; }
+    // Tiles one level and groups it into nodes, written to nodes as the entries of each node keyed by node ID.
+    // Adds an entry per node to parents, and <child ID, node ID> pairs to parentOf if given. Returns the number of nodes.
+    long long externalPack(std::unique_ptr<ExternalSorter> entries, long long count, RecordFile& nodes, ExternalSorter& parents, ExternalSorter* parentOf, ExternalBuild& build);
+    // Appends the nodes of a level to the tree file, with their parents from parentOf (sorted by child ID), or as the root
+    void externalWriteLevel(RecordFile& nodes, int level, ExternalSorter* parentOf, ExternalBuild& build);
+    void externalFlushPages(ExternalBuild& build);
+
+public:
+    // In-memory tree if buffer is null, otherwise opens the tree stored in the buffer's tree file (or starts one)
+    // A write-ahead log (of the buffer's tree file and tree pool) makes inserts durable; the tree is recovered from it first
+    RStarTree(GlobalParameters* config, Buffer* buffer = nullptr, WriteAheadLog* wal = nullptr);
+    ~RStarTree(); // Checkpoints if there is a log
+
+    // Interface methods
+    void insert(const Point& point, int blockID, int recordID);
+    bool remove(const Point& point); // Returns whether the point was in the tree; see the class comment
+    // Queries add the work they do to stats if given (see QueryStats)
+    std::pair<int, int> findPoint(const Point& point, QueryStats* stats = nullptr) const; // <blockID, recordID> or (-1, -1) if not found
+    std::vector<std::pair<int, int>> rangeQuery(const Region& query, QueryStats* stats = nullptr) const; // <blockID, recordID>
+    // Many range queries at once on the pool's threads, results per query in the order of queries (each in no particular order)
+    // Subtrees of a query are tasks of their own, so idle threads take over parts of large queries
+    // stats, if given, gets one QueryStats per query, whose wall time is summed over the query's tasks
+    // Several threads may run batches on one pool at once, each waiting for its own batch only
+    std::vector<std::vector<std::pair<int, int>>> rangeQueries(const std::vector<Region>& queries, WorkStealingPool& pool, std::vector<QueryStats>* stats = nullptr) const;
+    // The k points nearest to the given point as <blockID, recordID, distance>, in ascending distance
+    std::vector<std::tuple<int, int, double>> nearestNeighbors(const Point& point, int k, QueryStats* stats = nullptr) const;
+    // Points not dominated by any other point, with one preference per dimension (all Min if empty) as <blockID, recordID>
+    std::vector<std::pair<int, int>> skyline(const std::vector<SkylinePreference>& preferences = {}) const;
+    // Build the tree from scratch with Sort-Tile-Recursive packing ("build from 0")
+    // Nodes are filled to fillFactor * maxChildren entries. The tree must be empty.
+    void bulkLoad(const std::vector<Point>& points, const std::vector<int>& blockIDs, const std::vector<int>& recordIDs, double fillFactor = 1.0);
+    // Build the tree from the DataPoints of the buffer's data file, in bounded memory, for data sets larger than RAM.
+    // Packs like bulkLoad, but every sort is an external sort on the pool's threads, and the nodes are appended
+    // to the tree file level by level in ID order, so that all writes are sequential.
+    // Memory use stays within about memoryBudget bytes; sorted runs go to tempDirectory (the system temp directory if empty).
+    // The tree must be empty. Returns the number of points loaded.
+    long long bulkLoadDataFile(WorkStealingPool& pool, long long memoryBudget = DEFAULT_BULK_LOAD_MEMORY, double fillFactor = 1.0, const std::string& tempDirectory = "");
+    // Write every change to the tree file and sync it; with a log, the log then starts over from this state
+    // Bulk loads are not logged, they checkpoint when done
+    void checkpoint();
+    // Buffer inserts in the interior nodes, bufferCapacity points per node (see the class comment), or insert directly if 0.
+    // Turning buffering off pushes every buffered point into the leaves.
+    // Buffers live in memory: a tree in a buffer's file pushes them into its nodes on checkpoint and when destroyed,
+    // and a write-ahead log covers buffered points like any other insert.
+    void setInsertBuffering(int bufferCapacity = DEFAULT_INSERT_BUFFER);
+    void flushInsertBuffers(); // Pushes every buffered point into the leaves
+    // Reclaims every tombstone, found by walking the tree (tombstones left in the file by an earlier run included)
+    void compact();
+    // A thread compacting the leaves deletes leave tombstones in, COMPACTION_STEP_LEAVES at a time, until stopped.
+    // Stopping rethrows the first error it ran into. Destroying the tree stops it.
+    void startBackgroundCompaction();
+    void stopBackgroundCompaction();
+    // Rewrites the buffer's data file with only the records of the tree's points, in the Hilbert order of the points
+    // (see Buffer::clusterDataFile), and points the leaves at the new records. Records of deleted points are dropped.
+    // Runs under the exclusive tree latch, in bounded memory, and checkpoints the log when done; the data file itself
+    // is not covered by the log. Returns the number of records kept.
+    long long clusterDataFile(WorkStealingPool& pool, long long memoryBudget = DEFAULT_BULK_LOAD_MEMORY, const std::string& tempDirectory = "");
+
+    // Getters
+    int getRootID() const { return rootID; }
+    int getHeight() const { return height; }
+    long long getSize() const { return size; } // Including buffered points
+    long long getNumBuffered() const { return bufferedPoints; }
+    long long getNumDeleted() const { return deletedPoints; } // Tombstones not reclaimed yet (from this run)
+    int getInsertBufferCapacity() const { return insertBufferCapacity; }
+    int getMinChildren(int level = 1) const { return level == 0 ? minLeafChildren : minChildren; } // Of the nodes of a level
+    long long getNumNodes() const { return buffer ? buffer->getTreeFile()->getNumBlocks() - 1 - freeNodeIDs.size() : nodes.size(); }
+    std::shared_ptr<TreeNode> readNode(int nodeID) const { return getNode(nodeID); } // For inspection and tests
+};
+
+#endif // RSTARTREE_H
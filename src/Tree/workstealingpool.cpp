@@ -0,0 +1,162 @@
+#include "workstealingpool.h"
+#include <algorithm>
+#include <stdexcept>
+
+// Index of the calling thread in the pool it works for (-1 for threads outside any pool)
+static thread_local const WorkStealingPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+WorkStealingPool::WorkStealingPool(int numThreads) {
+    if (numThreads < 0) {
+        throw std::invalid_argument("numThreads must not be negative.");
+    }
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(PoolTask task) {
+    int target = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->mutex);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    // A worker going to sleep counts itself before checking queued, so either it sees the task or it is woken
+    queued++;
+    if (sleeping > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [this]() { return pending == 0; });
+    if (failure) {
+        std::exception_ptr thrown = failure;
+        failure = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+// Own deque from the back, then the others' from the front, starting with the next worker
+bool WorkStealingPool::takeTask(int self, PoolTask& task) {
+    {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (int i = 1; i < workers.size(); ++i) {
+        Worker& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int self) {
+    currentPool = this;
+    currentWorker = self;
+    PoolTask task;
+    while (true) {
+        if (!takeTask(self, task)) {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping++;
+            wakeUp.wait(lock, [this]() { return stopping || queued > 0; });
+            sleeping--;
+            if (stopping && queued == 0) {
+                return;
+            }
+            continue;
+        }
+
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+        task = nullptr; // Release what the task captured before it counts as done
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done.notify_all();
+        }
+    }
+}
+
+/*
+===================================================
+=================== Task groups ===================
+===================================================
+*/
+
+TaskGroup::~TaskGroup() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return pending == 0; });
+}
+
+void TaskGroup::submit(PoolTask task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+    }
+    pool.submit([this, task = std::move(task)]() mutable {
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+        task = nullptr; // Release what the task captured before it counts as done
+        // Counted down under the mutex, so that the group outlives this task's last use of it
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            done.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return pending == 0; });
+    if (failure) {
+        std::exception_ptr thrown = failure;
+        failure = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> PoolTask;
+
+class WorkStealingPool {
+    // Fixed set of worker threads, each with its own deque of tasks.
+    // A worker runs its newest task first (depth-first, so the subtrees it just found stay in cache)
+    // and, when its deque is empty, steals the oldest task of another worker, which is usually the largest piece of work left.
+    // Tasks submitted from a worker go to that worker's deque, tasks submitted from other threads are spread round-robin.
+    // wait() returns once every submitted task, including those submitted by tasks, has run, so the pool
+    // is meant to be driven by one thread at a time; calling wait() from a task deadlocks.
+    // Threads sharing a pool submit through a TaskGroup each instead, and wait for their group only.
+private:
+    struct alignas(64) Worker { // One cache line each, so that deques of different workers do not share lines
+        std::mutex mutex;
+        std::deque<PoolTask> tasks;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::atomic<long long> queued = 0; // Tasks waiting in some deque
+    std::atomic<long long> pending = 0; // Tasks submitted and not finished yet
+    std::atomic<unsigned> nextWorker = 0; // Round-robin target for tasks submitted from outside
+    std::atomic<long long> steals = 0;
+    std::atomic<int> sleeping = 0; // Workers waiting on wakeUp, so that submit only takes sleepMutex when one may need waking
+    bool stopping = false; // Guarded by sleepMutex
+
+    std::mutex sleepMutex; // Idle workers wait on wakeUp
+    std::condition_variable wakeUp;
+    std::mutex doneMutex; // wait() waits on done
+    std::condition_variable done;
+    std::exception_ptr failure; // First exception thrown by a task, guarded by doneMutex
+
+    bool takeTask(int self, PoolTask& task);
+    void workerLoop(int self);
+
+    // Prevent copying and assignment
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+public:
+    // numThreads 0 uses one thread per hardware thread
+    explicit WorkStealingPool(int numThreads = 0);
+    ~WorkStealingPool();
+
+    void submit(PoolTask task);
+    // Blocks until all submitted tasks have run, then rethrows the first exception thrown by one of them
+    void wait();
+
+    // Whether a worker is waiting for tasks, so that tasks can split off work only when someone would take it
+    bool hasIdleWorkers() const { return sleeping > 0; }
+
+    int getNumThreads() const { return threads.size(); }
+    long long getSteals() const { return steals; } // Tasks run by a worker other than the one they were queued on
+};
+
+class TaskGroup {
+    // A batch of tasks run on a pool, waited for apart from the pool's other tasks.
+    // Tasks of the group submit their subtasks through the group too. Exceptions of the group's tasks
+    // go to the group's wait(), not the pool's. Calling wait() from a task deadlocks, as with the pool.
+private:
+    WorkStealingPool& pool;
+    long long pending = 0; // Tasks submitted and not finished yet, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr failure; // First exception thrown by a task, guarded by mutex
+
+    // Prevent copying and assignment
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+public:
+    explicit TaskGroup(WorkStealingPool& pool) : pool(pool) {}
+    ~TaskGroup(); // Waits for the group's tasks, dropping their exceptions
+
+    void submit(PoolTask task);
+    // Blocks until all tasks of the group have run, then rethrows the first exception thrown by one of them
+    void wait();
+
+    WorkStealingPool& getPool() { return pool; }
+};
+
+#endif // WORKSTEALINGPOOL_H
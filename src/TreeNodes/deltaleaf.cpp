@@ -0,0 +1,144 @@
+#include "deltaleaf.h"
+#include <stdexcept>
+#include <string>
+
+DeltaLeaf::Footprint::Footprint(int dimensions) : dimensions(dimensions), low(dimensions, UINT64_MAX), high(dimensions, 0) {
+}
+
+void DeltaLeaf::Footprint::add(const double* coordinates, size_t stride, int blockID, int recordID) {
+    for (int d = 0; d < dimensions; ++d) {
+        uint64_t ordered = toOrdered(coordinates[d * stride]);
+        low[d] = std::min(low[d], ordered);
+        high[d] = std::max(high[d], ordered);
+    }
+    if (blockID >= 0) {
+        minBlockID = std::min(minBlockID, blockID);
+        maxBlockID = std::max(maxBlockID, blockID);
+    }
+    maxRecordID = std::max(maxRecordID, recordID);
+    count++;
+}
+
+size_t DeltaLeaf::Footprint::getSize() const {
+    size_t size = getHeaderSize(dimensions) + arrayBytes(count, 1) + arrayBytes(count, getBlockIDBits()) + arrayBytes(count, getRecordIDBits());
+    for (int d = 0; d < dimensions; ++d) {
+        size += arrayBytes(count, getCoordinateBits(d));
+    }
+    return size + DELTA_LEAF_PADDING;
+}
+
+size_t DeltaLeaf::getWorstSize(int dimensions, int count) {
+    return getHeaderSize(dimensions) + arrayBytes(count, 1) + 2 * arrayBytes(count, DELTA_LEAF_ID_BITS) + dimensions * arrayBytes(count, 64) + DELTA_LEAF_PADDING;
+}
+
+// Header ints and bases in the byte order of Storable::writeInt
+static uint64_t readUnsigned(const std::byte* bytes, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(std::to_integer<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+static void writeUnsigned(std::byte* bytes, int size, uint64_t value) {
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+DeltaLeaf::Layout DeltaLeaf::read(std::span<const std::byte> bytes, int dimensions) {
+    size_t headerSize = getHeaderSize(dimensions);
+    if (bytes.size() < headerSize) {
+        throw std::invalid_argument("Leaf encoding of " + std::to_string(bytes.size()) + " bytes is too short for its header.");
+    }
+    const std::byte* data = bytes.data();
+    int version = std::to_integer<int>(data[0]);
+    if (version != DELTA_LEAF_VERSION) {
+        throw std::invalid_argument("Unsupported leaf encoding version " + std::to_string(version) + ".");
+    }
+
+    Layout layout;
+    const std::byte* ints = data + 3 + dimensions;
+    layout.count = static_cast<int>(readUnsigned(ints, sizeof(int)));
+    layout.blockIDs.bits = std::to_integer<int>(data[1]);
+    layout.blockIDs.base = static_cast<int>(readUnsigned(ints + sizeof(int), sizeof(int)));
+    layout.recordIDs.bits = std::to_integer<int>(data[2]);
+    layout.recordIDs.base = 0;
+    layout.coordinates.resize(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        layout.coordinates[d].bits = std::to_integer<int>(data[3 + d]);
+        layout.coordinates[d].base = readUnsigned(ints + 2 * sizeof(int) + d * sizeof(uint64_t), sizeof(uint64_t));
+    }
+
+    size_t offset = headerSize;
+    layout.deleted = data + offset;
+    offset += arrayBytes(layout.count, 1);
+    layout.blockIDs.array = data + offset;
+    offset += arrayBytes(layout.count, layout.blockIDs.bits);
+    layout.recordIDs.array = data + offset;
+    offset += arrayBytes(layout.count, layout.recordIDs.bits);
+    for (int d = 0; d < dimensions; ++d) {
+        layout.coordinates[d].array = data + offset;
+        offset += arrayBytes(layout.count, layout.coordinates[d].bits);
+    }
+    offset += DELTA_LEAF_PADDING;
+    if (layout.count < 0 || offset > bytes.size()) {
+        throw std::invalid_argument("Leaf encoding of " + std::to_string(layout.count) + " points runs past its " + std::to_string(bytes.size()) + " bytes.");
+    }
+    layout.size = offset;
+    return layout;
+}
+
+size_t DeltaLeaf::write(std::span<std::byte> out, size_t offset, int dimensions, int count, const double* coordinates, size_t stride, const int* blockIDs, const int* recordIDs) {
+    Footprint footprint(dimensions);
+    for (int i = 0; i < count; ++i) {
+        footprint.add(coordinates + i, stride, blockIDs[i], recordIDs[i]);
+    }
+    size_t size = footprint.getSize();
+    if (out.size() < offset + size) {
+        throw std::invalid_argument("Leaf of " + std::to_string(count) + " points needs " + std::to_string(size) + " bytes at offset " + std::to_string(offset) + ", output has " + std::to_string(out.size()) + ".");
+    }
+    std::byte* data = out.data() + offset;
+    std::fill(data, data + size, std::byte{0});
+
+    int blockIDBits = footprint.getBlockIDBits();
+    int blockIDBase = footprint.getBlockIDBase();
+    int recordIDBits = footprint.getRecordIDBits();
+    data[0] = static_cast<std::byte>(DELTA_LEAF_VERSION);
+    data[1] = static_cast<std::byte>(blockIDBits);
+    data[2] = static_cast<std::byte>(recordIDBits);
+    std::byte* ints = data + 3 + dimensions;
+    writeUnsigned(ints, sizeof(int), static_cast<uint32_t>(count));
+    writeUnsigned(ints + sizeof(int), sizeof(int), static_cast<uint32_t>(blockIDBase));
+    for (int d = 0; d < dimensions; ++d) {
+        data[3 + d] = static_cast<std::byte>(footprint.getCoordinateBits(d));
+        writeUnsigned(ints + 2 * sizeof(int) + d * sizeof(uint64_t), sizeof(uint64_t), footprint.getCoordinateBase(d));
+    }
+
+    std::byte* array = data + getHeaderSize(dimensions);
+    for (int i = 0; i < count; ++i) {
+        if (blockIDs[i] < 0) {
+            writeBits(array, i, 1, 1);
+        }
+    }
+    array += arrayBytes(count, 1);
+    for (int i = 0; i < count; ++i) {
+        if (blockIDs[i] >= 0) {
+            writeBits(array, i, blockIDBits, static_cast<uint64_t>(blockIDs[i] - blockIDBase));
+        }
+    }
+    array += arrayBytes(count, blockIDBits);
+    for (int i = 0; i < count; ++i) {
+        writeBits(array, i, recordIDBits, static_cast<uint64_t>(recordIDs[i]));
+    }
+    array += arrayBytes(count, recordIDBits);
+    for (int d = 0; d < dimensions; ++d) {
+        int bits = footprint.getCoordinateBits(d);
+        uint64_t base = footprint.getCoordinateBase(d);
+        for (int i = 0; i < count; ++i) {
+            writeBits(array, i, bits, toOrdered(coordinates[d * stride + i]) - base);
+        }
+        array += arrayBytes(count, bits);
+    }
+    return offset + size;
+}
@@ -0,0 +1,133 @@
+#ifndef DELTALEAF_H
+#define DELTALEAF_H
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#define DELTA_LEAF_VERSION 1 // First byte of an encoded leaf, so that later encodings can tell themselves apart
+#define DELTA_LEAF_ID_BITS 31 // Largest width of a block or record ID (IDs are non-negative ints)
+#define DELTA_LEAF_PADDING 8 // Zero bytes after the arrays, so that a value is always read with one 8-byte load
+
+class DeltaLeaf {
+    // Lossless, compressed encoding of the points and IDs of a leaf page.
+    // Each double maps to a 64-bit integer that sorts the same way (toOrdered), and each coordinate is stored as its
+    // difference from the smallest one of its dimension in the leaf, in as many bits as the largest difference needs.
+    // Points of a leaf are close together, so they share their sign, exponent and leading mantissa bits, and
+    // the differences drop them. Block IDs are stored the same way from the smallest live one, record IDs in as many
+    // bits as the largest needs, and deleted points (negative block IDs) in a bitmap.
+    // Only the used slots are stored, so the encoding of a leaf grows with its points rather than with maxChildren.
+    // Layout: version, block ID bits, record ID bits, bits of each dimension (1 byte each), count, smallest block ID,
+    // smallest ordered coordinate of each dimension (8 bytes each), then the bit-packed arrays, each starting on a byte:
+    // deleted bitmap, block IDs, record IDs, then the coordinates of each dimension, then DELTA_LEAF_PADDING bytes.
+public:
+    static uint64_t toOrdered(double value) {
+        uint64_t bits = std::bit_cast<uint64_t>(value);
+        return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+    }
+    static double fromOrdered(uint64_t ordered) {
+        return std::bit_cast<double>((ordered >> 63) ? ordered & ~(uint64_t(1) << 63) : ~ordered);
+    }
+    static int bitWidth(uint64_t value) { return std::bit_width(value); }
+    static size_t arrayBytes(int count, int bits) { return (static_cast<size_t>(count) * bits + 7) / 8; }
+
+    // Value of width bits at position index of a bit-packed array (little-endian bit order)
+    // Reads 8 bytes from the value's first byte, and a ninth if the value spills into it, which the padding allows
+    static uint64_t readBits(const std::byte* array, size_t index, int bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        size_t bit = index * bits;
+        const std::byte* bytes = array + bit / 8;
+        int shift = bit % 8;
+        uint64_t value = 0;
+        if constexpr (std::endian::native == std::endian::little) {
+            std::memcpy(&value, bytes, sizeof(value));
+        }
+        else {
+            for (int i = 0; i < 8; ++i) {
+                value |= static_cast<uint64_t>(std::to_integer<unsigned char>(bytes[i])) << (8 * i);
+            }
+        }
+        value >>= shift;
+        if (shift + bits > 64) {
+            value |= static_cast<uint64_t>(std::to_integer<unsigned char>(bytes[8])) << (64 - shift);
+        }
+        return bits == 64 ? value : value & ((uint64_t(1) << bits) - 1);
+    }
+    // Sets the bits of value at position index of a zeroed bit-packed array
+    static void writeBits(std::byte* array, size_t index, int bits, uint64_t value) {
+        size_t bit = index * bits;
+        std::byte* bytes = array + bit / 8;
+        int shift = bit % 8;
+        while (bits > 0) {
+            int take = std::min(8 - shift, bits);
+            *bytes |= static_cast<std::byte>((value & ((1u << take) - 1)) << shift);
+            value >>= take;
+            bits -= take;
+            shift = 0;
+            bytes++;
+        }
+    }
+
+    // Widths of a set of points, enough to know the size of their encoding before writing it.
+    // A subset of the points never needs more bytes than the set.
+    class Footprint {
+    private:
+        int dimensions;
+        int count = 0;
+        std::vector<uint64_t> low; // Ordered coordinates
+        std::vector<uint64_t> high;
+        int minBlockID = INT_MAX; // Of the live points
+        int maxBlockID = -1;
+        int maxRecordID = 0;
+    public:
+        explicit Footprint(int dimensions);
+
+        // Coordinate d of the point at coordinates[d * stride]; a negative block ID marks a deleted point
+        void add(const double* coordinates, size_t stride, int blockID, int recordID);
+        int getCount() const { return count; }
+        int getCoordinateBits(int dimension) const { return count == 0 ? 0 : bitWidth(high[dimension] - low[dimension]); }
+        uint64_t getCoordinateBase(int dimension) const { return count == 0 ? 0 : low[dimension]; }
+        int getBlockIDBits() const { return maxBlockID < minBlockID ? 0 : bitWidth(static_cast<uint64_t>(maxBlockID - minBlockID)); }
+        int getBlockIDBase() const { return maxBlockID < minBlockID ? 0 : minBlockID; }
+        int getRecordIDBits() const { return bitWidth(static_cast<uint64_t>(maxRecordID)); }
+        size_t getSize() const; // Bytes of the encoding
+    };
+    static size_t getHeaderSize(int dimensions) { return 3 + dimensions + 2 * sizeof(int) + dimensions * sizeof(uint64_t); }
+    // Bytes of count points of any values: every ID and coordinate at its largest width
+    static size_t getWorstSize(int dimensions, int count);
+
+    // Where an encoded array is, and what its values are relative to
+    struct Column {
+        const std::byte* array;
+        int bits;
+        uint64_t base;
+        uint64_t get(int index) const { return base + readBits(array, index, bits); }
+    };
+    // The arrays of an encoded leaf, pointing into the bytes it was read from
+    struct Layout {
+        int count;
+        const std::byte* deleted; // Bitmap
+        Column blockIDs;
+        Column recordIDs;
+        std::vector<Column> coordinates; // One per dimension, get returns the ordered coordinate
+        size_t size; // Bytes of the encoding
+
+        bool isDeleted(int index) const { return readBits(deleted, index, 1) != 0; }
+        double getCoordinate(int index, int dimension) const { return fromOrdered(coordinates[dimension].get(index)); }
+    };
+    // Throws if the bytes do not start with an encoding of this version, or are too short for it
+    static Layout read(std::span<const std::byte> bytes, int dimensions);
+
+    // Encodes count points, coordinate d of point i at coordinates[d * stride + i], at offset in out.
+    // Returns the offset after the encoding; throws if out is too small.
+    static size_t write(std::span<std::byte> out, size_t offset, int dimensions, int count, const double* coordinates, size_t stride, const int* blockIDs, const int* recordIDs);
+};
+
+#endif // DELTALEAF_H
@@ -0,0 +1,60 @@
+#include "nodearena.h"
+#include <cstdlib>
+
+NodeArena::~NodeArena() {
+    for (std::byte* slab : slabs) {
+        std::free(slab);
+    }
+}
+
+NodeArena::SizeClass& NodeArena::getSizeClass(size_t bytes) {
+    for (SizeClass& sizeClass : sizeClasses) {
+        if (sizeClass.blockSize == bytes) {
+            return sizeClass;
+        }
+    }
+    sizeClasses.push_back({bytes});
+    return sizeClasses.back();
+}
+
+void* NodeArena::allocate(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SizeClass& sizeClass = getSizeClass(roundUp(bytes));
+    stats.allocations++;
+    stats.blocksInUse++;
+
+    if (sizeClass.freeList != nullptr) {
+        void* block = sizeClass.freeList;
+        sizeClass.freeList = *static_cast<void**>(block);
+        stats.recycled++;
+        return block;
+    }
+
+    if (sizeClass.next == sizeClass.end) {
+        size_t slabSize = sizeClass.blockSize * NODE_ARENA_SLAB_BLOCKS;
+        std::byte* slab = static_cast<std::byte*>(std::aligned_alloc(NODE_ARENA_ALIGNMENT, slabSize));
+        if (slab == nullptr) {
+            stats.blocksInUse--;
+            throw std::bad_alloc();
+        }
+        slabs.push_back(slab);
+        stats.slabs++;
+        stats.bytesReserved += slabSize;
+        sizeClass.next = slab;
+        sizeClass.end = slab + slabSize;
+    }
+    void* block = sizeClass.next;
+    sizeClass.next += sizeClass.blockSize;
+    return block;
+}
+
+void NodeArena::deallocate(void* block, size_t bytes) {
+    if (block == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    SizeClass& sizeClass = getSizeClass(roundUp(bytes));
+    *static_cast<void**>(block) = sizeClass.freeList;
+    sizeClass.freeList = block;
+    stats.blocksInUse--;
+}
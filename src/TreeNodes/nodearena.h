@@ -0,0 +1,108 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "globalparameters.h"
+
+#define NODE_ARENA_ALIGNMENT 64 // Blocks start on cache lines, sizes are rounded up to it
+#define NODE_ARENA_SLAB_BLOCKS 64 // Blocks carved out of each slab
+
+struct NodeArenaStats {
+    long long slabs = 0; // Slabs reserved from the heap
+    long long bytesReserved = 0;
+    long long blocksInUse = 0;
+    long long allocations = 0;
+    long long recycled = 0; // Allocations served from a free list
+};
+
+class NodeArena : public std::enable_shared_from_this<NodeArena> {
+    // Slab allocator for the nodes of one tree.
+    // make places a node and its arrays (IDs, coordinates or packed boxes) in one contiguous block,
+    // so building a node costs one block instead of a heap allocation per array and per child box.
+    // Blocks of the same size are carved out of slabs and freed blocks go to a free list per size,
+    // where the next node of that size picks them up; slabs are only returned when the arena is destroyed.
+    // Nodes keep the arena alive through their control blocks, which are allocated from it as well.
+    // allocate and deallocate take a mutex, as the tree's readers may build nodes from pages at the same time.
+private:
+    struct SizeClass {
+        size_t blockSize;
+        void* freeList = nullptr; // Each free block starts with the address of the next one
+        std::byte* next = nullptr; // Uncarved part of the newest slab
+        std::byte* end = nullptr;
+    };
+    std::vector<SizeClass> sizeClasses; // Few sizes (leaf, interior, control blocks), so searched linearly
+    std::vector<std::byte*> slabs;
+    NodeArenaStats stats;
+    std::mutex mutex;
+
+    SizeClass& getSizeClass(size_t bytes);
+
+    // Allocator for the shared_ptr control blocks, holding the arena alive
+    template <typename T>
+    struct ControlAllocator {
+        using value_type = T;
+        std::shared_ptr<NodeArena> arena;
+
+        explicit ControlAllocator(std::shared_ptr<NodeArena> arena) : arena(std::move(arena)) {}
+        template <typename U>
+        ControlAllocator(const ControlAllocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T))); }
+        void deallocate(T* block, size_t n) { arena->deallocate(block, n * sizeof(T)); }
+        template <typename U>
+        bool operator==(const ControlAllocator<U>& other) const { return arena == other.arena; }
+    };
+
+    template <typename Node>
+    struct Deleter {
+        NodeArena* arena; // Kept alive by the allocator of the same control block
+        size_t bytes;
+        void operator()(Node* node) const {
+            node->~Node();
+            arena->deallocate(node, bytes);
+        }
+    };
+
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+    ~NodeArena();
+
+    // Blocks of at least bytes, aligned to NODE_ARENA_ALIGNMENT
+    // deallocate must get the same size as the matching allocate
+    void* allocate(size_t bytes);
+    void deallocate(void* block, size_t bytes);
+
+    static size_t roundUp(size_t bytes) { return (bytes + NODE_ARENA_ALIGNMENT - 1) / NODE_ARENA_ALIGNMENT * NODE_ARENA_ALIGNMENT; }
+
+    // Construct a node in one block, followed by its arrays
+    // Node(config, args..., storage) must take Node::getStorageSize(config) bytes of storage as its last argument
+    // The arena must be owned by a shared_ptr
+    template <typename Node, typename... Args>
+    std::shared_ptr<Node> make(GlobalParameters* config, Args&&... args) {
+        size_t header = roundUp(sizeof(Node));
+        size_t bytes = header + Node::getStorageSize(config);
+        std::byte* block = static_cast<std::byte*>(allocate(bytes));
+        Node* node;
+        try {
+            node = new (block) Node(config, std::forward<Args>(args)..., block + header);
+        }
+        catch (...) {
+            deallocate(block, bytes);
+            throw;
+        }
+        return std::shared_ptr<Node>(node, Deleter<Node>{this, bytes}, ControlAllocator<Node>(shared_from_this()));
+    }
+
+    NodeArenaStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
+
+#endif // NODEARENA_H
@@ -0,0 +1,139 @@
+#include "nodeview.h"
+#include <stdexcept>
+#include <string>
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+NodeView::NodeView(GlobalParameters* config, std::span<const std::byte> page, size_t serializedSize) {
+    if (page.size() < serializedSize) {
+        throw std::invalid_argument("Page of " + std::to_string(page.size()) + " bytes is too small for a node of " + std::to_string(serializedSize) + " bytes.");
+    }
+    this->data = page.data();
+    this->dimensions = config->dimensions;
+    this->maxChildren = config->maxChildren;
+}
+
+Region NodeView::getBoundingBox() const {
+    std::vector<double> start(dimensions), end(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        start[d] = getBoxStart(d);
+        end[d] = getBoxEnd(d);
+    }
+    return Region(start, end);
+}
+
+/*
+===================================================
+==================== Leaf view ====================
+===================================================
+*/
+
+LeafNodeView::LeafNodeView(GlobalParameters* config, std::span<const std::byte> page)
+    : NodeView(config, page, TreeLeafNode::getSerializedSize(config))
+{
+    if (!isLeaf()) {
+        throw std::invalid_argument("Node " + std::to_string(getID()) + " at level " + std::to_string(getLevel()) + " is not a leaf.");
+    }
+    blockIDsOffset = headerSize();
+    recordIDsOffset = blockIDsOffset + maxChildren * sizeof(int);
+    pointsOffset = recordIDsOffset + maxChildren * sizeof(int);
+    delta = config->leafFormat == LEAF_FORMAT_DELTA;
+    if (delta) {
+        layout = DeltaLeaf::read(page.subspan(headerSize()), dimensions);
+        if (layout.count > maxChildren) {
+            throw std::invalid_argument("Leaf " + std::to_string(getID()) + " holds " + std::to_string(layout.count) + " points, more than maxChildren.");
+        }
+        numChildren = layout.count;
+        return;
+    }
+    while (numChildren < maxChildren && getBlockID(numChildren) != -1) {
+        numChildren++;
+    }
+}
+
+Point LeafNodeView::getPoint(int index) const {
+    std::vector<double> coords(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        coords[d] = getCoordinate(index, d);
+    }
+    return Point(coords);
+}
+
+size_t LeafNodeView::getDecodedSize(int count) const {
+    if (delta) {
+        size_t bits = 1 + layout.blockIDs.bits + layout.recordIDs.bits; // The deleted bit and the IDs
+        for (const DeltaLeaf::Column& column : layout.coordinates) {
+            bits += column.bits;
+        }
+        return headerSize() + DeltaLeaf::getHeaderSize(dimensions) + (count * bits + 7) / 8;
+    }
+    return headerSize() + count * (2 * sizeof(int) + dimensions * sizeof(double));
+}
+
+bool LeafNodeView::pointInside(int index, const AbstractBoundedClass& query) const {
+    const std::vector<double>& start = query.getStart();
+    const std::vector<double>& end = query.getEnd();
+    for (int d = 0; d < dimensions; ++d) {
+        double coordinate = getCoordinate(index, d);
+        if (coordinate < start[d] || coordinate > end[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LeafNodeView::pointEquals(int index, const Point& point) const {
+    const std::vector<double>& coords = point.getCoordinates();
+    for (int d = 0; d < dimensions; ++d) {
+        if (getCoordinate(index, d) != coords[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+===================================================
+================== Interior view ==================
+===================================================
+*/
+
+InteriorNodeView::InteriorNodeView(GlobalParameters* config, std::span<const std::byte> page)
+    : NodeView(config, page, TreeInteriorNode::getSerializedSize(config))
+{
+    if (isLeaf()) {
+        throw std::invalid_argument("Node " + std::to_string(getID()) + " is a leaf, not an interior node.");
+    }
+    childrenIDsOffset = headerSize();
+    boxesOffset = childrenIDsOffset + maxChildren * sizeof(int);
+    boxBits = config->childBoxBits;
+    coordinateSize = QuantizedMBR::getCoordinateSize(boxBits);
+    while (numChildren < maxChildren && getChildID(numChildren) >= 0) {
+        numChildren++;
+    }
+}
+
+Region InteriorNodeView::getChildBoundingBox(int index) const {
+    std::vector<double> start(dimensions), end(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        start[d] = getChildStart(index, d);
+        end[d] = getChildEnd(index, d);
+    }
+    return Region(start, end);
+}
+
+size_t InteriorNodeView::getDecodedSize(int count) const {
+    return headerSize() + count * (sizeof(int) + 2 * dimensions * coordinateSize);
+}
+
+bool InteriorNodeView::childOverlaps(int index, const AbstractBoundedClass& query) const {
+    const std::vector<double>& start = query.getStart();
+    const std::vector<double>& end = query.getEnd();
+    for (int d = 0; d < dimensions; ++d) {
+        double frameLow = getBoxStart(d), frameHigh = getBoxEnd(d);
+        if (readChildCoordinate(index, d, frameLow, frameHigh) > end[d] || start[d] > readChildCoordinate(index, dimensions + d, frameLow, frameHigh)) {
+            return false;
+        }
+    }
+    return true;
+}
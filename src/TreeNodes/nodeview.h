@@ -0,0 +1,136 @@
+#ifndef NODEVIEW_H
+#define NODEVIEW_H
+
+#include <span>
+#include <cstddef>
+#include <cstring>
+#include "globalparameters.h"
+#include "abstractBoundedClass.h"
+#include "point.h"
+#include "region.h"
+#include "treeleafnode.h"
+#include "quantizedmbr.h"
+
+class NodeView {
+    // Read-only access to a serialized node (the TreeNode::serializeInto layout) straight from its page,
+    // without building any objects. The view points into the page, so it is only valid while the page is,
+    // e.g. while it stays pinned in the buffer pool.
+    // Layout: id, level, parentID, bounding box (start, end), then the leaf or interior part.
+protected:
+    const std::byte* data;
+    int dimensions;
+    int maxChildren;
+    int numChildren = 0;
+
+    int readInt(size_t offset) const {
+        // Same byte order as Storable::writeInt
+        int value = 0;
+        for (size_t i = 0; i < sizeof(int); ++i) {
+            value |= static_cast<int>(std::to_integer<unsigned char>(data[offset + i])) << (i * 8);
+        }
+        return value;
+    }
+    // Arrays are copied as they are in memory (Storable::writeInts and writeDoubles)
+    int readArrayInt(size_t offset) const {
+        int value;
+        std::memcpy(&value, data + offset, sizeof(int));
+        return value;
+    }
+    double readDouble(size_t offset) const {
+        double value;
+        std::memcpy(&value, data + offset, sizeof(double));
+        return value;
+    }
+    size_t headerSize() const { return 3 * sizeof(int) + 2 * dimensions * sizeof(double); }
+
+    // Throws if the page cannot hold a node of the given serialized size
+    NodeView(GlobalParameters* config, std::span<const std::byte> page, size_t serializedSize);
+
+public:
+    int getID() const { return readInt(0); }
+    int getLevel() const { return readInt(sizeof(int)); }
+    int getParentID() const { return readInt(2 * sizeof(int)); }
+    bool isLeaf() const { return getLevel() == 0; }
+    int getNumChildren() const { return numChildren; }
+
+    double getBoxStart(int dimension) const { return readDouble(3 * sizeof(int) + dimension * sizeof(double)); }
+    double getBoxEnd(int dimension) const { return readDouble(3 * sizeof(int) + (dimensions + dimension) * sizeof(double)); }
+    Region getBoundingBox() const; // Builds a Region, not meant for hot paths
+};
+
+class LeafNodeView: public NodeView {
+    // Leaf part: blockIDs[maxChildren], recordIDs[maxChildren], points[maxChildren][dimensions]
+    // Points are packed at the front, -1 block IDs mark the empty slots and TOMBSTONE_BLOCK_ID the deleted points.
+    // With config->leafFormat set to LEAF_FORMAT_DELTA, the leaf part is a DeltaLeaf encoding instead,
+    // decoded value by value as it is read.
+private:
+    size_t blockIDsOffset;
+    size_t recordIDsOffset;
+    size_t pointsOffset;
+    bool delta;
+    DeltaLeaf::Layout layout; // Of the encoding, when delta
+
+public:
+    // Throws if the page is too small or does not hold a leaf
+    LeafNodeView(GlobalParameters* config, std::span<const std::byte> page);
+
+    int getBlockID(int index) const {
+        if (delta) {
+            return layout.isDeleted(index) ? TOMBSTONE_BLOCK_ID : static_cast<int>(layout.blockIDs.get(index));
+        }
+        return readArrayInt(blockIDsOffset + index * sizeof(int));
+    }
+    int getRecordID(int index) const {
+        return delta ? static_cast<int>(layout.recordIDs.get(index)) : readArrayInt(recordIDsOffset + index * sizeof(int));
+    }
+    double getCoordinate(int index, int dimension) const {
+        return delta ? layout.getCoordinate(index, dimension) : readDouble(pointsOffset + (index * dimensions + dimension) * sizeof(double));
+    }
+    bool isDeleted(int index) const { return getBlockID(index) == TOMBSTONE_BLOCK_ID; }
+    Point getPoint(int index) const; // Builds a Point, not meant for hot paths
+    size_t getDecodedSize(int count) const; // Bytes of the page decoded to read the header and the first count points
+
+    // Same checks as Region::overlaps and Point equality, without building the point
+    bool pointInside(int index, const AbstractBoundedClass& query) const;
+    bool pointEquals(int index, const Point& point) const;
+};
+
+class InteriorNodeView: public NodeView {
+    // Interior part: childrenIDs[maxChildren], then a box (start, end) per child
+    // Children are packed at the front, -1 IDs mark the empty slots.
+    // With config->childBoxBits set, the boxes are quantized relative to the node's box and read back rounded outward.
+private:
+    size_t childrenIDsOffset;
+    size_t boxesOffset;
+    int boxBits;
+    int coordinateSize;
+
+    double readChildCoordinate(int index, int position, double frameLow, double frameHigh) const {
+        const std::byte* coordinate = data + boxesOffset + (static_cast<size_t>(index) * 2 * dimensions + position) * coordinateSize;
+        if (boxBits == 0) {
+            double value;
+            std::memcpy(&value, coordinate, sizeof(double));
+            return value;
+        }
+        return QuantizedMBR::dequantize(QuantizedMBR::read(coordinate, boxBits), frameLow, frameHigh, boxBits);
+    }
+
+public:
+    // Throws if the page is too small or holds a leaf
+    InteriorNodeView(GlobalParameters* config, std::span<const std::byte> page);
+
+    int getChildID(int index) const { return readArrayInt(childrenIDsOffset + index * sizeof(int)); }
+    double getChildStart(int index, int dimension) const {
+        return readChildCoordinate(index, dimension, getBoxStart(dimension), getBoxEnd(dimension));
+    }
+    double getChildEnd(int index, int dimension) const {
+        return readChildCoordinate(index, dimensions + dimension, getBoxStart(dimension), getBoxEnd(dimension));
+    }
+    Region getChildBoundingBox(int index) const; // Builds a Region, not meant for hot paths
+    size_t getDecodedSize(int count) const; // Bytes of the page decoded to read the header and the first count children
+
+    // Same check as Region::overlaps, without building the region
+    bool childOverlaps(int index, const AbstractBoundedClass& query) const;
+};
+
+#endif // NODEVIEW_H
@@ -0,0 +1,388 @@
+#include "packedmbrs.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PACKED_MBRS_X86
+#include <immintrin.h>
+#endif
+
+PackedMBRs::PackedMBRs(int dimensions, int maxChildren) : ownedStorage(getStorageSize(dimensions, maxChildren)) {
+    attach(dimensions, maxChildren, ownedStorage.data());
+}
+
+PackedMBRs::PackedMBRs(int dimensions, int maxChildren, double* storage) {
+    attach(dimensions, maxChildren, storage);
+}
+
+void PackedMBRs::attach(int dimensions, int maxChildren, double* storage) {
+    if (storage != ownedStorage.data()) {
+        std::vector<double>().swap(ownedStorage);
+    }
+    this->dimensions = dimensions;
+    this->capacity = (maxChildren + PACKED_MBRS_WIDTH - 1) / PACKED_MBRS_WIDTH * PACKED_MBRS_WIDTH;
+    size_t size = static_cast<size_t>(dimensions) * capacity;
+    lows = storage;
+    highs = storage + size;
+    std::fill(lows, lows + size, std::numeric_limits<double>::infinity());
+    std::fill(highs, highs + size, -std::numeric_limits<double>::infinity());
+}
+
+size_t PackedMBRs::getStorageSize(int dimensions, int maxChildren) {
+    int capacity = (maxChildren + PACKED_MBRS_WIDTH - 1) / PACKED_MBRS_WIDTH * PACKED_MBRS_WIDTH;
+    return 2 * static_cast<size_t>(dimensions) * capacity;
+}
+
+void PackedMBRs::copyFrom(const PackedMBRs& other) {
+    if (dimensions != other.dimensions || capacity != other.capacity) {
+        throw std::invalid_argument("Packed boxes of different shapes cannot be copied.");
+    }
+    size_t size = static_cast<size_t>(dimensions) * capacity;
+    std::copy(other.lows, other.lows + size, lows);
+    std::copy(other.highs, other.highs + size, highs);
+}
+
+void PackedMBRs::set(int index, const Region& box) {
+    if (box.getStart().empty()) {
+        if (index < 0 || index >= capacity) {
+            throw std::out_of_range("Slot " + std::to_string(index) + " is out of range for " + std::to_string(capacity) + " packed boxes.");
+        }
+        clear(index);
+        return;
+    }
+    if (box.getStart().size() != dimensions) {
+        throw std::invalid_argument("Box has " + std::to_string(box.getStart().size()) + " dimensions, expected " + std::to_string(dimensions) + ".");
+    }
+    set(index, box.getStart().data(), box.getEnd().data());
+}
+
+void PackedMBRs::set(int index, const double* start, const double* end) {
+    if (index < 0 || index >= capacity) {
+        throw std::out_of_range("Slot " + std::to_string(index) + " is out of range for " + std::to_string(capacity) + " packed boxes.");
+    }
+    for (int d = 0; d < dimensions; ++d) {
+        lows[d * capacity + index] = start[d];
+        highs[d * capacity + index] = end[d];
+    }
+}
+
+void PackedMBRs::clear(int index) {
+    for (int d = 0; d < dimensions; ++d) {
+        lows[d * capacity + index] = std::numeric_limits<double>::infinity();
+        highs[d * capacity + index] = -std::numeric_limits<double>::infinity();
+    }
+}
+
+void PackedMBRs::moveSlot(int from, int to) {
+    for (int d = 0; d < dimensions; ++d) {
+        lows[d * capacity + to] = lows[d * capacity + from];
+        highs[d * capacity + to] = highs[d * capacity + from];
+    }
+}
+
+Region PackedMBRs::getBox(int index) const {
+    if (isEmpty(index)) {
+        return Region();
+    }
+    std::vector<double> start(dimensions), end(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        start[d] = lows[d * capacity + index];
+        end[d] = highs[d * capacity + index];
+    }
+    return Region(start, end);
+}
+
+SimdLevel PackedMBRs::bestSimdLevel() {
+#ifdef PACKED_MBRS_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel::AVX2
+        : __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+bool PackedMBRs::boxEquals(int index, const Region& box) const {
+    if (box.getStart().empty() || isEmpty(index)) {
+        return box.getStart().empty() && isEmpty(index);
+    }
+    if (box.getStart().size() != dimensions) {
+        return false;
+    }
+    for (int d = 0; d < dimensions; ++d) {
+        if (lows[d * capacity + index] != box.getStart()[d] || highs[d * capacity + index] != box.getEnd()[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PackedMBRs::boxContains(int index, const Region& box) const {
+    if (box.getStart().size() != dimensions || isEmpty(index)) {
+        return false;
+    }
+    for (int d = 0; d < dimensions; ++d) {
+        if (lows[d * capacity + index] > box.getStart()[d] || highs[d * capacity + index] < box.getEnd()[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+===================================================
+================= Vector kernels ==================
+===================================================
+*/
+
+// Each kernel handles whole registers of children and returns the first child left for the scalar loop.
+// Operations are done in the same order as in the scalar loops, so the results are identical,
+// except that overlapSum adds up its lanes in another order.
+// Kernels are instantiated for D = 2 and 3, whose dimension loops unroll, and for D = 0, which loops over dimensions.
+
+#ifdef PACKED_MBRS_X86
+
+template <int D>
+__attribute__((target("avx2")))
+static int overlapMaskAVX2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, uint64_t* mask) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d overlaps = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        for (int d = 0; d < dims; ++d) {
+            __m256d low = _mm256_loadu_pd(lows + d * capacity + i);
+            __m256d high = _mm256_loadu_pd(highs + d * capacity + i);
+            overlaps = _mm256_and_pd(overlaps, _mm256_cmp_pd(low, _mm256_set1_pd(end[d]), _CMP_LE_OQ));
+            overlaps = _mm256_and_pd(overlaps, _mm256_cmp_pd(_mm256_set1_pd(start[d]), high, _CMP_LE_OQ));
+        }
+        mask[i / 64] |= static_cast<uint64_t>(_mm256_movemask_pd(overlaps)) << (i % 64);
+    }
+    return i;
+}
+
+template <int D>
+__attribute__((target("avx2")))
+static int enlargementCostsAVX2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, double* areas, double* enlargements) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d area = _mm256_set1_pd(1.0);
+        __m256d grownArea = _mm256_set1_pd(1.0);
+        for (int d = 0; d < dims; ++d) {
+            __m256d low = _mm256_loadu_pd(lows + d * capacity + i);
+            __m256d high = _mm256_loadu_pd(highs + d * capacity + i);
+            area = _mm256_mul_pd(area, _mm256_sub_pd(high, low));
+            __m256d grownLow = _mm256_min_pd(low, _mm256_set1_pd(start[d]));
+            __m256d grownHigh = _mm256_max_pd(high, _mm256_set1_pd(end[d]));
+            grownArea = _mm256_mul_pd(grownArea, _mm256_sub_pd(grownHigh, grownLow));
+        }
+        _mm256_storeu_pd(areas + i, area);
+        _mm256_storeu_pd(enlargements + i, _mm256_sub_pd(grownArea, area));
+    }
+    return i;
+}
+
+template <int D>
+__attribute__((target("avx2")))
+static int overlapSumAVX2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, double& sum) {
+    const int dims = D > 0 ? D : dimensions;
+    __m256d total = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d overlap = _mm256_set1_pd(1.0);
+        for (int d = 0; d < dims; ++d) {
+            __m256d low = _mm256_max_pd(_mm256_loadu_pd(lows + d * capacity + i), _mm256_set1_pd(start[d]));
+            __m256d high = _mm256_min_pd(_mm256_loadu_pd(highs + d * capacity + i), _mm256_set1_pd(end[d]));
+            overlap = _mm256_mul_pd(overlap, _mm256_max_pd(_mm256_sub_pd(high, low), _mm256_setzero_pd()));
+        }
+        total = _mm256_add_pd(total, overlap);
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, total);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return i;
+}
+
+template <int D>
+__attribute__((target("sse2")))
+static int overlapMaskSSE2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, uint64_t* mask) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d overlaps = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        for (int d = 0; d < dims; ++d) {
+            __m128d low = _mm_loadu_pd(lows + d * capacity + i);
+            __m128d high = _mm_loadu_pd(highs + d * capacity + i);
+            overlaps = _mm_and_pd(overlaps, _mm_cmple_pd(low, _mm_set1_pd(end[d])));
+            overlaps = _mm_and_pd(overlaps, _mm_cmple_pd(_mm_set1_pd(start[d]), high));
+        }
+        mask[i / 64] |= static_cast<uint64_t>(_mm_movemask_pd(overlaps)) << (i % 64);
+    }
+    return i;
+}
+
+template <int D>
+__attribute__((target("sse2")))
+static int enlargementCostsSSE2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, double* areas, double* enlargements) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d area = _mm_set1_pd(1.0);
+        __m128d grownArea = _mm_set1_pd(1.0);
+        for (int d = 0; d < dims; ++d) {
+            __m128d low = _mm_loadu_pd(lows + d * capacity + i);
+            __m128d high = _mm_loadu_pd(highs + d * capacity + i);
+            area = _mm_mul_pd(area, _mm_sub_pd(high, low));
+            __m128d grownLow = _mm_min_pd(low, _mm_set1_pd(start[d]));
+            __m128d grownHigh = _mm_max_pd(high, _mm_set1_pd(end[d]));
+            grownArea = _mm_mul_pd(grownArea, _mm_sub_pd(grownHigh, grownLow));
+        }
+        _mm_storeu_pd(areas + i, area);
+        _mm_storeu_pd(enlargements + i, _mm_sub_pd(grownArea, area));
+    }
+    return i;
+}
+
+template <int D>
+__attribute__((target("sse2")))
+static int overlapSumSSE2(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, double& sum) {
+    const int dims = D > 0 ? D : dimensions;
+    __m128d total = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d overlap = _mm_set1_pd(1.0);
+        for (int d = 0; d < dims; ++d) {
+            __m128d low = _mm_max_pd(_mm_loadu_pd(lows + d * capacity + i), _mm_set1_pd(start[d]));
+            __m128d high = _mm_min_pd(_mm_loadu_pd(highs + d * capacity + i), _mm_set1_pd(end[d]));
+            overlap = _mm_mul_pd(overlap, _mm_max_pd(_mm_sub_pd(high, low), _mm_setzero_pd()));
+        }
+        total = _mm_add_pd(total, overlap);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, total);
+    sum = lanes[0] + lanes[1];
+    return i;
+}
+
+#endif // PACKED_MBRS_X86
+
+/*
+===================================================
+===================== Kernels =====================
+===================================================
+*/
+
+// Level dispatch and the scalar loop of each kernel, for the dimensions D (0 for any)
+
+template <int D>
+static void overlapMaskKernel(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, uint64_t* mask, SimdLevel level) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+#ifdef PACKED_MBRS_X86
+    if (level == SimdLevel::AVX2) {
+        i = overlapMaskAVX2<D>(lows, highs, capacity, dimensions, count, start, end, mask);
+    }
+    else if (level == SimdLevel::SSE2) {
+        i = overlapMaskSSE2<D>(lows, highs, capacity, dimensions, count, start, end, mask);
+    }
+#endif
+    for (; i < count; ++i) {
+        bool overlaps = true;
+        for (int d = 0; d < dims && overlaps; ++d) {
+            overlaps = lows[d * capacity + i] <= end[d] && start[d] <= highs[d * capacity + i];
+        }
+        if (overlaps) {
+            mask[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+}
+
+template <int D>
+static void enlargementCostsKernel(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, double* areas, double* enlargements, SimdLevel level) {
+    const int dims = D > 0 ? D : dimensions;
+    int i = 0;
+#ifdef PACKED_MBRS_X86
+    if (level == SimdLevel::AVX2) {
+        i = enlargementCostsAVX2<D>(lows, highs, capacity, dimensions, count, start, end, areas, enlargements);
+    }
+    else if (level == SimdLevel::SSE2) {
+        i = enlargementCostsSSE2<D>(lows, highs, capacity, dimensions, count, start, end, areas, enlargements);
+    }
+#endif
+    for (; i < count; ++i) {
+        double area = 1.0;
+        double grownArea = 1.0;
+        for (int d = 0; d < dims; ++d) {
+            double low = lows[d * capacity + i];
+            double high = highs[d * capacity + i];
+            area *= high - low;
+            grownArea *= std::max(high, end[d]) - std::min(low, start[d]);
+        }
+        areas[i] = area;
+        enlargements[i] = grownArea - area;
+    }
+}
+
+template <int D>
+static double overlapSumKernel(const double* lows, const double* highs, int capacity, int dimensions, int count,
+    const double* start, const double* end, SimdLevel level) {
+    const int dims = D > 0 ? D : dimensions;
+    double sum = 0.0;
+    int i = 0;
+#ifdef PACKED_MBRS_X86
+    if (level == SimdLevel::AVX2) {
+        i = overlapSumAVX2<D>(lows, highs, capacity, dimensions, count, start, end, sum);
+    }
+    else if (level == SimdLevel::SSE2) {
+        i = overlapSumSSE2<D>(lows, highs, capacity, dimensions, count, start, end, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        double overlap = 1.0;
+        for (int d = 0; d < dims; ++d) {
+            double low = std::max(lows[d * capacity + i], start[d]);
+            double high = std::min(highs[d * capacity + i], end[d]);
+            overlap *= std::max(high - low, 0.0);
+        }
+        sum += overlap;
+    }
+    return sum;
+}
+
+void PackedMBRs::overlapMask(int count, const double* start, const double* end, uint64_t* mask, SimdLevel level) const {
+    std::fill(mask, mask + (count + 63) / 64, 0);
+    level = std::min(level, bestSimdLevel());
+    switch (dimensions) {
+        case 2: return overlapMaskKernel<2>(lows, highs, capacity, dimensions, count, start, end, mask, level);
+        case 3: return overlapMaskKernel<3>(lows, highs, capacity, dimensions, count, start, end, mask, level);
+        default: return overlapMaskKernel<0>(lows, highs, capacity, dimensions, count, start, end, mask, level);
+    }
+}
+
+void PackedMBRs::enlargementCosts(int count, const double* start, const double* end, double* areas, double* enlargements, SimdLevel level) const {
+    level = std::min(level, bestSimdLevel());
+    switch (dimensions) {
+        case 2: return enlargementCostsKernel<2>(lows, highs, capacity, dimensions, count, start, end, areas, enlargements, level);
+        case 3: return enlargementCostsKernel<3>(lows, highs, capacity, dimensions, count, start, end, areas, enlargements, level);
+        default: return enlargementCostsKernel<0>(lows, highs, capacity, dimensions, count, start, end, areas, enlargements, level);
+    }
+}
+
+double PackedMBRs::overlapSum(int count, const double* start, const double* end, SimdLevel level) const {
+    level = std::min(level, bestSimdLevel());
+    switch (dimensions) {
+        case 2: return overlapSumKernel<2>(lows, highs, capacity, dimensions, count, start, end, level);
+        case 3: return overlapSumKernel<3>(lows, highs, capacity, dimensions, count, start, end, level);
+        default: return overlapSumKernel<0>(lows, highs, capacity, dimensions, count, start, end, level);
+    }
+}
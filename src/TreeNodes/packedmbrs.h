@@ -0,0 +1,65 @@
+#ifndef PACKEDMBRS_H
+#define PACKEDMBRS_H
+
+#include <vector>
+#include <cstdint>
+#include "region.h"
+
+#define PACKED_MBRS_WIDTH 4 // Doubles per AVX2 register, slots are padded to a multiple of it
+
+// Instruction sets the kernels can run with, from slowest to fastest
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+class PackedMBRs {
+    // The child boxes of a node packed per dimension, for kernels that test all children in one pass:
+    // lows[d * capacity + i] and highs[d * capacity + i] are the bounds of child i in dimension d.
+    // Empty slots hold an inverted box (+inf, -inf) that overlaps nothing.
+    // The kernels use AVX2 or SSE2 when the CPU has them (checked once at run time), otherwise plain loops;
+    // every level gives the same overlaps, areas and enlargements.
+    // For 2 and 3 dimensions the kernels are compiled for that dimension, so their per-dimension loops unroll.
+    // The arrays either belong to the object or live in storage of its owner (a node's arena block).
+private:
+    int dimensions = 0;
+    int capacity = 0; // maxChildren rounded up to PACKED_MBRS_WIDTH
+    double* lows = nullptr;
+    double* highs = nullptr;
+    std::vector<double> ownedStorage; // Empty when the arrays live in external storage
+
+public:
+    PackedMBRs() = default;
+    PackedMBRs(int dimensions, int maxChildren);
+    // Uses getStorageSize doubles at storage, which must outlive the object, and clears every slot
+    PackedMBRs(int dimensions, int maxChildren, double* storage);
+    // Copies would alias external storage, use copyFrom instead
+    PackedMBRs(const PackedMBRs&) = delete;
+    PackedMBRs& operator=(const PackedMBRs&) = delete;
+
+    static size_t getStorageSize(int dimensions, int maxChildren); // In doubles
+    void attach(int dimensions, int maxChildren, double* storage); // Moves to external storage, clearing every slot
+    void copyFrom(const PackedMBRs& other); // Throws if the shapes differ
+
+    void set(int index, const Region& box); // An empty Region clears the slot
+    void set(int index, const double* start, const double* end);
+    void clear(int index);
+    void moveSlot(int from, int to); // Copies slot from into slot to
+    bool isEmpty(int index) const { return dimensions == 0 || lows[index] > highs[index]; }
+    Region getBox(int index) const; // Region() for empty slots
+    bool boxEquals(int index, const Region& box) const; // Same as getBox(index) == box, without building the Region
+    bool boxContains(int index, const Region& box) const; // Whether slot index already covers box
+    double getLow(int index, int dimension) const { return lows[dimension * capacity + index]; }
+    double getHigh(int index, int dimension) const { return highs[dimension * capacity + index]; }
+
+    // Best level supported by this CPU and build
+    static SimdLevel bestSimdLevel();
+
+    // Kernels over the first count children, for a box given by its start and end coordinates
+    // Bit i of mask[i / 64] is set if child i overlaps the box (closed intervals, as Region::overlaps).
+    // mask must hold (count + 63) / 64 words.
+    void overlapMask(int count, const double* start, const double* end, uint64_t* mask, SimdLevel level = bestSimdLevel()) const;
+    // Area of each child and the area it would add to include the box (Region::area and Region::enlargement)
+    void enlargementCosts(int count, const double* start, const double* end, double* areas, double* enlargements, SimdLevel level = bestSimdLevel()) const;
+    // Total overlap area (Region::overlap) of the children with the box
+    double overlapSum(int count, const double* start, const double* end, SimdLevel level = bestSimdLevel()) const;
+};
+
+#endif // PACKEDMBRS_H
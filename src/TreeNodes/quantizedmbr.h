@@ -0,0 +1,79 @@
+#ifndef QUANTIZEDMBR_H
+#define QUANTIZEDMBR_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class QuantizedMBR {
+    // Child boxes of an interior page stored relative to the node's own box (the frame), as in the CR-tree
+    // (Kim et al., 2001): each coordinate becomes one of the 2^bits - 1 steps of a grid across the frame,
+    // in 8 or 16 bits instead of a double. Lows are rounded down and highs up, so the box read back always
+    // contains the real one: queries may visit a child they do not need, but never miss one.
+    // Step 0 and the last step are the frame's bounds exactly, so boxes on the frame's border lose nothing.
+public:
+    static bool isValidBits(int bits) { return bits == 0 || bits == 8 || bits == 16; } // 0 for plain doubles
+    static int getCoordinateSize(int bits) { return bits == 0 ? sizeof(double) : bits / 8; }
+    static uint32_t getMaxStep(int bits) { return (uint32_t(1) << bits) - 1; }
+
+    static double dequantize(uint32_t step, double frameLow, double frameHigh, int bits) {
+        uint32_t maxStep = getMaxStep(bits);
+        if (step == 0) {
+            return frameLow;
+        }
+        if (step >= maxStep) {
+            return frameHigh;
+        }
+        return frameLow + (frameHigh - frameLow) * step / maxStep;
+    }
+    // Largest step whose value is at most value (the first step for values below the frame)
+    static uint32_t quantizeLow(double value, double frameLow, double frameHigh, int bits) {
+        uint32_t maxStep = getMaxStep(bits);
+        double extent = frameHigh - frameLow;
+        if (!(extent > 0.0) || value <= frameLow) {
+            return 0;
+        }
+        uint32_t step = static_cast<uint32_t>(std::fmin(std::floor((value - frameLow) / extent * maxStep), maxStep));
+        // The division may land a step off either way
+        while (step > 0 && dequantize(step, frameLow, frameHigh, bits) > value) {
+            step--;
+        }
+        while (step < maxStep && dequantize(step + 1, frameLow, frameHigh, bits) <= value) {
+            step++;
+        }
+        return step;
+    }
+    // Smallest step whose value is at least value (the last step for values above the frame)
+    static uint32_t quantizeHigh(double value, double frameLow, double frameHigh, int bits) {
+        uint32_t maxStep = getMaxStep(bits);
+        double extent = frameHigh - frameLow;
+        if (!(extent > 0.0) || value >= frameHigh) {
+            return maxStep;
+        }
+        uint32_t step = static_cast<uint32_t>(std::fmax(std::ceil((value - frameLow) / extent * maxStep), 0.0));
+        while (step < maxStep && dequantize(step, frameLow, frameHigh, bits) < value) {
+            step++;
+        }
+        while (step > 0 && dequantize(step - 1, frameLow, frameHigh, bits) >= value) {
+            step--;
+        }
+        return step;
+    }
+
+    // Steps are stored little-endian in getCoordinateSize(bits) bytes
+    static void write(std::byte* out, uint32_t step, int bits) {
+        for (int i = 0; i < bits / 8; ++i) {
+            out[i] = static_cast<std::byte>((step >> (8 * i)) & 0xFF);
+        }
+    }
+    static uint32_t read(const std::byte* in, int bits) {
+        uint32_t step = 0;
+        for (int i = 0; i < bits / 8; ++i) {
+            step |= static_cast<uint32_t>(std::to_integer<unsigned char>(in[i])) << (8 * i);
+        }
+        return step;
+    }
+};
+
+#endif // QUANTIZEDMBR_H
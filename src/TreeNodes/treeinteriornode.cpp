@@ -1,7 +1,11 @@
 #include "treeinteriornode.h"
+#include "quantizedmbr.h"
+#include <bit>
+#include <cstring>
+#include <algorithm>
 
 TreeInteriorNode::TreeInteriorNode (GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, std::vector<int> childrenIDs, Region* childrenBoundingBoxes):
-    TreeNode(id, level, parentID, boundingBox) // Call the base class constructor
+    TreeInteriorNode(config, id, level, parentID, boundingBox)
 {
     if(childrenIDs.size() != config->maxChildren) {
         throw std::invalid_argument("childrenIDs size must match maxChildren.");
@@ -10,24 +14,61 @@ TreeInteriorNode::TreeInteriorNode (GlobalParameters* config, int id, int level,
         throw std::invalid_argument("childrenBoundingBoxes cannot be null when initializing TreeInteriorNode.");
     }
 
-    this->childrenIDs = childrenIDs;
-    this->numChildren = 0;
-
     for(int i = 0; i < config->maxChildren; ++i) {
+        this->childrenIDs[i] = childrenIDs[i];
         if(childrenIDs[i] >=0) { // count non-empty children
             this->numChildren++;
+            packedBoxes.set(i, childrenBoundingBoxes[i]);
         }
     }
+}
 
-    this->childrenBoundingBoxes = new Region[config->maxChildren]; // Allocate memory for bounding boxes
+TreeInteriorNode::TreeInteriorNode (GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, std::byte* storage):
+    TreeNode(id, level, parentID, boundingBox),
+    dimensions(config->dimensions),
+    maxChildren(config->maxChildren)
+{
+    attachStorage(storage);
+}
+
+// Deep copies, as each node owns its arrays
+TreeInteriorNode::TreeInteriorNode (const TreeInteriorNode& other):
+    TreeNode(other), dimensions(other.dimensions), maxChildren(other.maxChildren)
+{
+    attachStorage(nullptr);
+    std::copy(other.childrenIDs, other.childrenIDs + maxChildren, childrenIDs);
+    packedBoxes.copyFrom(other.packedBoxes);
+}
 
-    for (int i = 0; i < config->maxChildren; ++i) {
-        this->childrenBoundingBoxes[i] = childrenBoundingBoxes[i];
+TreeInteriorNode& TreeInteriorNode::operator=(const TreeInteriorNode& other) {
+    if (this == &other) {
+        return *this;
     }
+    if (dimensions != other.dimensions || maxChildren != other.maxChildren) {
+        if (ownedStorage == nullptr) {
+            throw std::invalid_argument("A node in arena storage cannot take the shape of another configuration.");
+        }
+        dimensions = other.dimensions;
+        maxChildren = other.maxChildren;
+        attachStorage(nullptr);
+    }
+    TreeNode::operator=(other);
+    std::copy(other.childrenIDs, other.childrenIDs + maxChildren, childrenIDs);
+    packedBoxes.copyFrom(other.packedBoxes);
+    return *this;
 }
 
-TreeInteriorNode::~TreeInteriorNode () {
-    delete[] childrenBoundingBoxes; // Free the memory allocated for bounding boxes
+// Packed boxes first, so that they stay aligned in the block
+void TreeInteriorNode::attachStorage(std::byte* storage) {
+    GlobalParameters shape = {maxChildren, dimensions};
+    if (storage == nullptr) {
+        ownedStorage = std::make_unique<std::byte[]>(getStorageSize(&shape));
+        storage = ownedStorage.get();
+    }
+    double* boxes = reinterpret_cast<double*>(storage);
+    packedBoxes.attach(dimensions, maxChildren, boxes);
+    childrenIDs = reinterpret_cast<int*>(boxes + PackedMBRs::getStorageSize(dimensions, maxChildren));
+    std::fill(childrenIDs, childrenIDs + maxChildren, -1);
 }
 
 void TreeInteriorNode::updateBoundingBox(){
@@ -36,12 +77,17 @@ void TreeInteriorNode::updateBoundingBox(){
         return;
     }
 
-    // create a vector of pointers to the children's bounding boxes
-    std::vector<AbstractBoundedClass*> boundingBoxes;
-    for (int i = 0; i < numChildren; ++i) {
-        boundingBoxes.push_back(childrenBoundingBoxes + i);
+    // Straight from the packed boxes, empty slots are inverted so they never win
+    std::vector<double> start(dimensions), end(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        start[d] = packedBoxes.getLow(0, d);
+        end[d] = packedBoxes.getHigh(0, d);
+        for (int i = 1; i < numChildren; ++i) {
+            start[d] = std::min(start[d], packedBoxes.getLow(i, d));
+            end[d] = std::max(end[d], packedBoxes.getHigh(i, d));
+        }
     }
-    boundingBox = Region::boundingBox(boundingBoxes); // Compute the bounding box of all children
+    boundingBox = Region(start, end);
 }
 
 void TreeInteriorNode::addChild(GlobalParameters* config, int childID, const Region& childBoundingBox) {
@@ -51,7 +97,7 @@ void TreeInteriorNode::addChild(GlobalParameters* config, int childID, const Reg
 
     // Add the new child
     childrenIDs[numChildren] = childID;
-    childrenBoundingBoxes[numChildren] = childBoundingBox;
+    packedBoxes.set(numChildren, childBoundingBox);
     numChildren++;
 
     // Update the bounding box of this node
@@ -68,7 +114,7 @@ void TreeInteriorNode::addChildren(GlobalParameters* config, const std::vector<i
 
     for (size_t i = 0; i < childrenIDs.size(); ++i) {
         this->childrenIDs[numChildren] = childrenIDs[i];
-        this->childrenBoundingBoxes[numChildren] = childrenBoundingBoxes[i];
+        packedBoxes.set(numChildren, childrenBoundingBoxes[i]);
         numChildren++;
     }
 
@@ -84,10 +130,11 @@ int TreeInteriorNode::removeChild(int childID) {
             // Shift remaining children down
             for (int j = i; j < numChildren - 1; ++j) {
                 childrenIDs[j] = childrenIDs[j + 1];
-                childrenBoundingBoxes[j] = childrenBoundingBoxes[j + 1];
+                packedBoxes.moveSlot(j + 1, j);
             }
             numChildren--;
             childrenIDs[numChildren] = -1; // Mark the last child as invalid
+            packedBoxes.clear(numChildren);
             updateBoundingBox(); // Update the bounding box after removal
             return 0;
         }
@@ -95,6 +142,25 @@ int TreeInteriorNode::removeChild(int childID) {
     return -1;
 }
 
+int TreeInteriorNode::findChildIndex(int childID) const {
+    for (int i = 0; i < numChildren; ++i) {
+        if (childrenIDs[i] == childID) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TreeInteriorNode::setChildBoundingBox(int index, const Region& childBoundingBox) {
+    if (index < 0 || index >= numChildren) {
+        throw std::out_of_range("Child index out of range in node " + std::to_string(id) + ".");
+    }
+    packedBoxes.set(index, childBoundingBox);
+
+    // Update the bounding box of this node
+    updateBoundingBox();
+}
+
 // Return all IDs that overlap the query
 // Supports both point and region queries
 std::vector<int> TreeInteriorNode::rangeQuery(const AbstractBoundedClass& query) const {
@@ -106,10 +172,12 @@ std::vector<int> TreeInteriorNode::rangeQuery(const AbstractBoundedClass& query)
         return results; // No overlap, return empty result
     }
 
-    // Iterate through children and add id if overlap
-    for (int i = 0; i < numChildren; ++i) {
-        if (childrenBoundingBoxes[i].overlaps(query)) {
-            results.push_back(childrenIDs[i]); 
+    // Test all children at once, then collect the IDs of the set bits
+    std::vector<uint64_t> mask((numChildren + 63) / 64);
+    packedBoxes.overlapMask(numChildren, query.getStart().data(), query.getEnd().data(), mask.data());
+    for (size_t word = 0; word < mask.size(); ++word) {
+        for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+            results.push_back(childrenIDs[word * 64 + std::countr_zero(bits)]);
         }
     }
 
@@ -126,23 +194,44 @@ std::vector<int> TreeInteriorNode::rangeQuery(const AbstractBoundedClass& query)
 // Doesn't store numChildren, as it can be derived from the data
 // and maxChildren as it's stored in data block 0
 std::vector<char> TreeInteriorNode::serialize(GlobalParameters* config) const {
-    std::vector<char> data = TreeNode::serialize(config); // Serialize the base class first
-    // preallocate space for the serialized data
-    // #TODO: check if this is gives a performance boost
-    // data.reserve(data.size() + getSerializedSize(maxChildren, boundingBox.getStart().size())); 
+    std::vector<char> data(getSerializedSize(config));
+    serializeInto(config, std::as_writable_bytes(std::span(data)));
+    return data;
+}
+
+size_t TreeInteriorNode::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+    size_t offset = TreeNode::serializeInto(config, out); // Serialize the base class first
 
     // Serialize childrenIDs
-    Storable::appendData(data, Storable::serializeInts(childrenIDs));
+    offset = Storable::writeInts(out, offset, std::span<const int>(childrenIDs, maxChildren));
 
-    // Serialize childrenBoundingBoxes
+    // Serialize childrenBoundingBoxes, each as its start then its end coordinates like Region,
+    // as doubles or quantized relative to this node's box. Empty children stay zero
+    int bits = config->childBoxBits;
+    int coordinateSize = QuantizedMBR::getCoordinateSize(bits);
+    size_t boxSize = 2 * dimensions * coordinateSize;
+    size_t boxesOffset = offset;
+    offset = Storable::writeZeros(out, offset, config->maxChildren * boxSize);
+    std::byte* boxes = out.data() + boxesOffset;
     for (int i = 0; i < numChildren; ++i) {
-        Storable::appendData(data, childrenBoundingBoxes[i].serialize(config));
+        if (packedBoxes.isEmpty(i)) {
+            continue;
+        }
+        std::byte* box = boxes + static_cast<size_t>(i) * boxSize;
+        for (int d = 0; d < dimensions; ++d) {
+            double low = packedBoxes.getLow(i, d);
+            double high = packedBoxes.getHigh(i, d);
+            if (bits == 0) {
+                std::memcpy(box + d * sizeof(double), &low, sizeof(double));
+                std::memcpy(box + (dimensions + d) * sizeof(double), &high, sizeof(double));
+                continue;
+            }
+            double frameLow = boundingBox.getStart()[d], frameHigh = boundingBox.getEnd()[d];
+            QuantizedMBR::write(box + d * coordinateSize, QuantizedMBR::quantizeLow(low, frameLow, frameHigh, bits), bits);
+            QuantizedMBR::write(box + (dimensions + d) * coordinateSize, QuantizedMBR::quantizeHigh(high, frameLow, frameHigh, bits), bits);
+        }
     }
-
-    // Pad out for empty children
-    Storable::appendData(data, std::vector<char>((config->maxChildren - numChildren) * Region::getSerializedSize(config), 0));
-
-    return data;
+    return offset;
 }
 
 TreeInteriorNode TreeInteriorNode::deserialize(GlobalParameters* config, const std::vector<char>& data) {
@@ -151,38 +240,63 @@ TreeInteriorNode TreeInteriorNode::deserialize(GlobalParameters* config, const s
     }
     // Deserialize the base class first
     TreeNode baseNode = TreeNode::deserialize(config, data);
-    size_t offset = TreeNode::getSerializedSize(config);
+    TreeInteriorNode node(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox());
+    node.readArrays(config, data);
+    return node;
+}
+
+// Same as above, but the node and its arrays are placed in one block of the arena
+std::shared_ptr<TreeInteriorNode> TreeInteriorNode::deserialize(GlobalParameters* config, const std::vector<char>& data, NodeArena& arena) {
+    if (data.size() < TreeInteriorNode::getSerializedSize(config)) {
+        throw std::invalid_argument("Data size is too small for TreeInteriorNode deserialization.");
+    }
+    TreeNode baseNode = TreeNode::deserialize(config, data);
+    std::shared_ptr<TreeInteriorNode> node = arena.make<TreeInteriorNode>(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox());
+    node->readArrays(config, data);
+    return node;
+}
 
-    // Deserialize childrenIDs
-    std::vector<int> childrenIDs = Storable::deserializeInts(data, offset, config->maxChildren);
+// Read the IDs and the boxes of the children straight into the node's arrays
+void TreeInteriorNode::readArrays(GlobalParameters* config, const std::vector<char>& data) {
+    size_t offset = TreeNode::getSerializedSize(config);
+    std::memcpy(childrenIDs, data.data() + offset, config->maxChildren * sizeof(int));
     offset += config->maxChildren * sizeof(int); // Move the offset past the childrenIDs
     // Count the children
-    int numChildren = 0;
+    numChildren = 0;
     for(int i = 0; i < config->maxChildren; ++i) {
         if(childrenIDs[i] >=0) { // count non-empty children
             numChildren++;
         }
     }
 
-    // Deserialize childrenBoundingBoxes
-    Region* childrenBoundingBoxes = new Region[config->maxChildren];
+    // Don't bother with the rest, they stay empty
+    // Quantized boxes come back rounded outward, so they may be larger than the children's own boxes
+    int bits = config->childBoxBits;
+    int coordinateSize = QuantizedMBR::getCoordinateSize(bits);
+    const std::byte* boxes = reinterpret_cast<const std::byte*>(data.data() + offset);
+    std::vector<double> start(config->dimensions), end(config->dimensions);
     for (int i = 0; i < numChildren; ++i) {
-        std::vector<char>::const_iterator regionDataStart = data.begin() + offset;
-        std::vector<char>::const_iterator regionDataEnd = regionDataStart + Region::getSerializedSize(config);
-        std::vector<char> regionData(regionDataStart, regionDataEnd);
-
-        childrenBoundingBoxes[i] = Region::deserialize(config, regionData);
-        offset += Region::getSerializedSize(config);
-    }
-    // Don't bother with the rest, set to empty regions
-    for (int i = numChildren; i < config->maxChildren; ++i) {
-        childrenBoundingBoxes[i] = Region(); // Default constructor creates an empty region
+        const std::byte* box = boxes + static_cast<size_t>(i) * 2 * config->dimensions * coordinateSize;
+        if (bits == 0) {
+            std::memcpy(start.data(), box, config->dimensions * sizeof(double));
+            std::memcpy(end.data(), box + config->dimensions * sizeof(double), config->dimensions * sizeof(double));
+        }
+        else {
+            for (int d = 0; d < config->dimensions; ++d) {
+                double frameLow = boundingBox.getStart()[d], frameHigh = boundingBox.getEnd()[d];
+                start[d] = QuantizedMBR::dequantize(QuantizedMBR::read(box + d * coordinateSize, bits), frameLow, frameHigh, bits);
+                end[d] = QuantizedMBR::dequantize(QuantizedMBR::read(box + (config->dimensions + d) * coordinateSize, bits), frameLow, frameHigh, bits);
+            }
+        }
+        packedBoxes.set(i, start.data(), end.data());
     }
-
-    return TreeInteriorNode(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox(), childrenIDs, childrenBoundingBoxes);
 }
 
 int TreeInteriorNode::getSerializedSize(GlobalParameters* config) {
     return TreeNode::getSerializedSize(config) + // Size of the base class
-           config->maxChildren * (sizeof(int) + Region::getSerializedSize(config)); // Size of childrenIDs and childrenBoundingBoxes
-}
\ No newline at end of file
+           config->maxChildren * (sizeof(int) + 2 * config->dimensions * QuantizedMBR::getCoordinateSize(config->childBoxBits)); // Size of childrenIDs and childrenBoundingBoxes
+}
+
+size_t TreeInteriorNode::getStorageSize(GlobalParameters* config) {
+    return PackedMBRs::getStorageSize(config->dimensions, config->maxChildren) * sizeof(double) + config->maxChildren * sizeof(int);
+}
@@ -1,29 +1,51 @@
 #ifndef TREEINTERIORNODE_H
 #define TREEINTERIORNODE_H
 
+#include <memory>
 #include "treenode.h"
+#include "packedmbrs.h"
+#include "nodearena.h"
 
 class TreeInteriorNode: public TreeNode {
 private:
-    std::vector<int> childrenIDs; // Array of child node IDs, size determined by maxChildren upon creation
-    Region* childrenBoundingBoxes; // Array of bounding boxes for each child node, size determined by maxChildren upon creation
+    int dimensions;
+    int maxChildren;
+    // The arrays share one block of getStorageSize bytes, either owned by the node
+    // or following it in a NodeArena block
+    PackedMBRs packedBoxes; // Bounding boxes of the children, packed per dimension for the SIMD kernels
+    int* childrenIDs; // Array of child node IDs, size determined by maxChildren upon creation
+    std::unique_ptr<std::byte[]> ownedStorage; // Null when placed by a NodeArena
+    void attachStorage(std::byte* storage); // Points the arrays at storage (owned if null) and empties every slot
+    void readArrays(GlobalParameters* config, const std::vector<char>& data); // Fills the arrays from a serialized node
 
 protected:
     void updateBoundingBox();
 
 public:
     TreeInteriorNode (GlobalParameters* config, int id, int level, int parentID, const Region& rectangle, std::vector<int> childrenIDs, Region* childrenBoundingBoxes = nullptr);
-    ~TreeInteriorNode ();
-    std::vector<int> getChildrenIDs() const { return childrenIDs; }
+    // Node without children, with its arrays in storage of getStorageSize bytes if given (see NodeArena::make)
+    TreeInteriorNode (GlobalParameters* config, int id, int level, int parentID, const Region& rectangle, std::byte* storage = nullptr);
+    TreeInteriorNode (const TreeInteriorNode& other); // The copy owns its arrays
+    TreeInteriorNode& operator=(const TreeInteriorNode& other); // Throws if a node in external storage would change shape
+    ~TreeInteriorNode () = default;
+    std::vector<int> getChildrenIDs() const { return std::vector<int>(childrenIDs, childrenIDs + maxChildren); }
+    int getChildID(int index) const { return childrenIDs[index]; }
+    Region getChildBoundingBox(int index) const { return packedBoxes.getBox(index); } // Region() for empty slots
+    const PackedMBRs& getPackedBoxes() const { return packedBoxes; }
 
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
     static TreeInteriorNode deserialize(GlobalParameters* config, const std::vector<char>& data);
+    static std::shared_ptr<TreeInteriorNode> deserialize(GlobalParameters* config, const std::vector<char>& data, NodeArena& arena);
     static int getSerializedSize(GlobalParameters* config);
+    static size_t getStorageSize(GlobalParameters* config); // Bytes taken by the arrays
 
     // Interface methods
     void addChild(GlobalParameters* config, int childID, const Region& childBoundingBox);
     void addChildren(GlobalParameters* config, const std::vector<int>& childrenIDs, const std::vector<Region>& childrenBoundingBoxes);
     int removeChild(int childID);
+    int findChildIndex(int childID) const; // Returns the index of the child if found, otherwise -1
+    void setChildBoundingBox(int index, const Region& childBoundingBox); // Used when a child grows or shrinks
     std::vector<int> rangeQuery(const AbstractBoundedClass& query) const;
     
 };
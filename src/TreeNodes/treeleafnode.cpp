@@ -1,5 +1,6 @@
 #include "treeleafnode.h"
 #include <cstring>
+#include <algorithm>
 
 
 // Constructor for TreeLeafNode
@@ -8,7 +9,7 @@
 // Throws an error if the input vectors are not of the same size or if they exceed max
 // Throws an error if one of the input vectors contains empty slots where at least one other doesn't
 TreeLeafNode::TreeLeafNode(GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, const std::vector<Point>& points, const std::vector<int>& blockIDs, const std::vector<int>& recordIDs)
-    : TreeNode(id, level, parentID, boundingBox)
+    : TreeLeafNode(config, id, level, parentID, boundingBox)
 {
     // All input vectors of the same size
     if (points.size() != blockIDs.size() || points.size() != recordIDs.size()) {
@@ -19,56 +20,185 @@ TreeLeafNode::TreeLeafNode(GlobalParameters* config, int id, int level, int pare
         throw std::overflow_error("Number of points exceeds maximum children allowed in the leaf node.");
     }
 
-    // pass to self for editability
-    this->blockIDs = blockIDs;
-    this->recordIDs = recordIDs;
-    this->points = points;
-
-    // if input vectors size is smaller than maxChildren, set numChildren and pad with empty values
-    if (this->points.size() < config->maxChildren) {
-        numChildren = this->points.size();
-        // -1 and Point() for empty slots
-        this->blockIDs.resize(config->maxChildren, -1);
-        this->recordIDs.resize(config->maxChildren, -1);
-        this->points.resize(config->maxChildren, Point());
+    // if input vectors size is smaller than maxChildren, set numChildren and leave the rest empty
+    if (points.size() < config->maxChildren) {
+        for (size_t i = 0; i < points.size(); ++i) {
+            this->blockIDs[i] = blockIDs[i];
+            this->recordIDs[i] = recordIDs[i];
+            setPoint(i, points[i]);
+        }
+        numChildren = points.size();
+        return;
     }
+
     // if input vectors size is equal to maxChildren, either we have that many children or we have empty slots
-    else {
-        numChildren = 0;
-        for (size_t i = 0; i < this->points.size(); ++i) {
-            // if none indicate empty, count as a child
-            if (this->blockIDs[i] != -1 && this->recordIDs[i] != -1 && this->points[i] != Point()) {
-                numChildren++;
-            }
-            // if NOT ALL indicate empty, throw an error
-            else {
-                // After serialization, an empty point is at 0,0,...,0
-                Point zeroPoint = Point(std::vector<double>(this->points[0].getCoordinates().size(), 0.0));
-                if (!(this->blockIDs[i] == -1 && this->recordIDs[i] == -1 && (points[i] == Point() || points[i] == zeroPoint))) {
-                    throw std::invalid_argument("Invalid point, block ID or record ID at index " + std::to_string(i) + ".\n"
-                        "Got: " + this->printPointInfo(config, i) + ".\n");
-                }
+    for (size_t i = 0; i < points.size(); ++i) {
+        // if none indicate empty, count as a child
+        if (blockIDs[i] != -1 && recordIDs[i] != -1 && points[i] != Point()) {
+            this->blockIDs[i] = blockIDs[i];
+            this->recordIDs[i] = recordIDs[i];
+            setPoint(i, points[i]);
+            numChildren++;
+        }
+        // if NOT ALL indicate empty, throw an error
+        else {
+            // After serialization, an empty point is at 0,0,...,0
+            Point zeroPoint = Point(std::vector<double>(dimensions, 0.0));
+            if (!(blockIDs[i] == -1 && recordIDs[i] == -1 && (points[i] == Point() || points[i] == zeroPoint))) {
+                throw std::invalid_argument("Invalid point, block ID or record ID at index " + std::to_string(i) + ".\n"
+                    "Got: " + points[i].toString(config) + ", Block ID: " + std::to_string(blockIDs[i]) + ", Record ID: " + std::to_string(recordIDs[i]) + ".\n");
             }
         }
     }
 }
 
+TreeLeafNode::TreeLeafNode(GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, std::byte* storage)
+    : TreeNode(id, level, parentID, boundingBox),
+    dimensions(config->dimensions),
+    maxChildren(config->maxChildren)
+{
+    attachStorage(storage);
+}
+
+TreeLeafNode::TreeLeafNode(const TreeLeafNode& other)
+    : TreeNode(other),
+    dimensions(other.dimensions),
+    maxChildren(other.maxChildren)
+{
+    attachStorage(nullptr);
+    std::memcpy(coordinates, other.coordinates, static_cast<size_t>(maxChildren) * dimensions * sizeof(double));
+    std::memcpy(blockIDs, other.blockIDs, maxChildren * sizeof(int));
+    std::memcpy(recordIDs, other.recordIDs, maxChildren * sizeof(int));
+}
+
+TreeLeafNode& TreeLeafNode::operator=(const TreeLeafNode& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (dimensions != other.dimensions || maxChildren != other.maxChildren) {
+        if (ownedStorage == nullptr) {
+            throw std::invalid_argument("A leaf in arena storage cannot take the shape of another configuration.");
+        }
+        dimensions = other.dimensions;
+        maxChildren = other.maxChildren;
+        attachStorage(nullptr);
+    }
+    TreeNode::operator=(other);
+    std::memcpy(coordinates, other.coordinates, static_cast<size_t>(maxChildren) * dimensions * sizeof(double));
+    std::memcpy(blockIDs, other.blockIDs, maxChildren * sizeof(int));
+    std::memcpy(recordIDs, other.recordIDs, maxChildren * sizeof(int));
+    return *this;
+}
+
+// Coordinates first, so that they stay aligned in the block
+void TreeLeafNode::attachStorage(std::byte* storage) {
+    GlobalParameters shape = {maxChildren, dimensions};
+    if (storage == nullptr) {
+        ownedStorage = std::make_unique<std::byte[]>(getStorageSize(&shape));
+        storage = ownedStorage.get();
+    }
+    coordinates = reinterpret_cast<double*>(storage);
+    blockIDs = reinterpret_cast<int*>(coordinates + static_cast<size_t>(maxChildren) * dimensions);
+    recordIDs = blockIDs + maxChildren;
+    std::fill(coordinates, coordinates + static_cast<size_t>(maxChildren) * dimensions, 0.0);
+    std::fill(blockIDs, blockIDs + maxChildren, -1);
+    std::fill(recordIDs, recordIDs + maxChildren, -1);
+}
+
 std::string TreeLeafNode::printPointInfo(GlobalParameters* config, int i) const {
     if (i < 0 || i >= config->maxChildren) {
         throw std::out_of_range("Index out of range for point info.");
     }
-    return "Point: " + points[i].toString(config) + ", Block ID: " + std::to_string(blockIDs[i]) + ", Record ID: " + std::to_string(recordIDs[i]);
+    return "Point: " + getPoint(i).toString(config) + ", Block ID: " + std::to_string(blockIDs[i]) + ", Record ID: " + std::to_string(recordIDs[i]);
+}
+
+void TreeLeafNode::setPoint(int i, const Point& point) {
+    const std::vector<double>& coords = point.getCoordinates();
+    if (coords.size() != dimensions) {
+        throw std::invalid_argument("Point has " + std::to_string(coords.size()) + " dimensions, expected " + std::to_string(dimensions) + ".");
+    }
+    for (int d = 0; d < dimensions; ++d) {
+        coordinates[d * maxChildren + i] = coords[d];
+    }
+}
+
+void TreeLeafNode::moveSlot(int from, int to) {
+    for (int d = 0; d < dimensions; ++d) {
+        coordinates[d * maxChildren + to] = coordinates[d * maxChildren + from];
+    }
+    blockIDs[to] = blockIDs[from];
+    recordIDs[to] = recordIDs[from];
+}
+
+// Mark a slot as empty, so that serialization and the constructor agree on it
+void TreeLeafNode::clearSlot(int i) {
+    for (int d = 0; d < dimensions; ++d) {
+        coordinates[d * maxChildren + i] = 0.0;
+    }
+    blockIDs[i] = -1;
+    recordIDs[i] = -1;
+}
+
+void TreeLeafNode::updateBoundingBox() {
+    if (numChildren == 0) {
+        boundingBox = Region(); // Reset to an empty region if no points
+        return;
+    }
+
+    // Degenerate in a dimension if all points share it
+    std::vector<double> start(dimensions), end(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        const double* values = coordinates + d * maxChildren;
+        auto [minimum, maximum] = std::minmax_element(values, values + numChildren);
+        start[d] = *minimum;
+        end[d] = *maximum;
+    }
+    boundingBox = Region(start, end);
 }
 
 int TreeLeafNode::findPointIndex(const Point& point) const {
+    const std::vector<double>& coords = point.getCoordinates();
+    if (coords.size() != dimensions) {
+        return -1;
+    }
     for (int i = 0; i < numChildren; ++i) {
-        if (points[i] == point) {
+        int d = 0;
+        while (d < dimensions && coordinates[d * maxChildren + i] == coords[d]) {
+            d++;
+        }
+        if (d == dimensions && !isDeleted(i)) {
             return i; // Return the index of the found point
         }
     }
     return -1; // Point not found
 }
 
+std::vector<Point> TreeLeafNode::getPoints() const {
+    std::vector<Point> points(maxChildren);
+    for (int i = 0; i < numChildren; ++i) {
+        points[i] = getPoint(i);
+    }
+    return points;
+}
+
+Point TreeLeafNode::getPoint(int index) const {
+    std::vector<double> coords(dimensions);
+    for (int d = 0; d < dimensions; ++d) {
+        coords[d] = coordinates[d * maxChildren + index];
+    }
+    return Point(coords);
+}
+
+double TreeLeafNode::squaredDistance(int index, const Point& point) const {
+    const std::vector<double>& coords = point.getCoordinates();
+    double result = 0.0;
+    for (int d = 0; d < dimensions; ++d) {
+        double difference = coordinates[d * maxChildren + index] - coords[d];
+        result += difference * difference;
+    }
+    return result;
+}
+
 // Add a point to the leaf node
 // Throws an error if the point already exists or if the maximum number of children is reached
 void TreeLeafNode::addPoint(GlobalParameters* config, const Point& point, int blockID, int recordID) {
@@ -85,10 +215,13 @@ void TreeLeafNode::addPoint(GlobalParameters* config, const Point& point, int bl
     }
 
     // Add the point and its IDs
-    points[numChildren] = point;
+    setPoint(numChildren, point);
     blockIDs[numChildren] = blockID;
     recordIDs[numChildren] = recordID;
     numChildren++;
+
+    // Update the bounding box of this node
+    updateBoundingBox();
 }
 
 // Add multiple points to the leaf node
@@ -104,43 +237,71 @@ void TreeLeafNode::addPoints(GlobalParameters* config, const std::vector<Point>&
 
     for(int i = 0; i < points.size(); ++i) {
         // Add the point and its IDs
-        this->points[numChildren] = points[i];
+        setPoint(numChildren, points[i]);
         this->blockIDs[numChildren] = blockIDs[i];
         this->recordIDs[numChildren] = recordIDs[i];
         numChildren++;
     }
+
+    // Update the bounding box of this node
+    updateBoundingBox();
 }
 
 std::pair<int, int> TreeLeafNode::findPoint(const Point& point) const {
-    for (int i = 0; i < numChildren; ++i) {
-        if (points[i] == point) {
-            return {blockIDs[i], recordIDs[i]};
-        }
+    int index = findPointIndex(point);
+    if (index == -1) {
+        return {-1, -1}; // Point not found
     }
-    return {-1, -1}; // Point not found
+    return {blockIDs[index], recordIDs[index]};
 }
 
 std::vector<std::pair<int, int>> TreeLeafNode::rangeQuery(const AbstractBoundedClass& query) const {
-    Region queryRegion = static_cast<const Region&>(query);
+    const std::vector<double>& start = query.getStart();
+    const std::vector<double>& end = query.getEnd();
     std::vector<std::pair<int, int>> results;
     for (int i = 0; i < numChildren; ++i) {
-        if (queryRegion.overlaps(points[i])) {
+        bool inside = true;
+        for (int d = 0; d < dimensions && inside; ++d) {
+            double coordinate = coordinates[d * maxChildren + i];
+            inside = coordinate >= start[d] && coordinate <= end[d];
+        }
+        if (inside && !isDeleted(i)) {
             results.emplace_back(blockIDs[i], recordIDs[i]);
         }
     }
     return results;
 }
 
+int TreeLeafNode::markDeleted(const Point& point) {
+    int index = findPointIndex(point);
+    if (index != -1) {
+        blockIDs[index] = TOMBSTONE_BLOCK_ID;
+    }
+    return index;
+}
+
+void TreeLeafNode::setIDs(int index, int blockID, int recordID) {
+    if (index < 0 || index >= numChildren) {
+        throw std::out_of_range("Point index out of range in node " + std::to_string(id) + ".");
+    }
+    blockIDs[index] = blockID;
+    recordIDs[index] = recordID;
+}
+
+int TreeLeafNode::getNumDeleted() const {
+    return std::count(blockIDs, blockIDs + numChildren, TOMBSTONE_BLOCK_ID);
+}
+
 int TreeLeafNode::removePoint(int blockID, int recordID) {
     for (int i = 0; i < numChildren; ++i) {
         if (blockIDs[i] == blockID && recordIDs[i] == recordID) {
             // Shift the remaining points to fill the gap
             for (int j = i; j < numChildren - 1; ++j) {
-                points[j] = points[j + 1];
-                blockIDs[j] = blockIDs[j + 1];
-                recordIDs[j] = recordIDs[j + 1];
+                moveSlot(j + 1, j);
             }
             numChildren--;
+            clearSlot(numChildren);
+            updateBoundingBox();
             return 0;
         }
     }
@@ -154,11 +315,11 @@ int TreeLeafNode::removePoint(const Point& point) {
     }
     // Shift the remaining points to fill the gap
     for (int j = index; j < numChildren - 1; ++j) {
-        points[j] = points[j + 1];
-        blockIDs[j] = blockIDs[j + 1];
-        recordIDs[j] = recordIDs[j + 1];
+        moveSlot(j + 1, j);
     }
     numChildren--;
+    clearSlot(numChildren);
+    updateBoundingBox();
     return 0;
 }
 
@@ -168,21 +329,37 @@ int TreeLeafNode::removePoint(const Point& point) {
 ===================================================
 */
 
+// A compressed leaf may need more than getSerializedSize, when it holds more points than any values would fit
 std::vector<char> TreeLeafNode::serialize(GlobalParameters* config) const {
-    std::vector<char> data = TreeNode::serialize(config);
-    
-    // Serialize the points, blockIDs and recordIDs
-    Storable::appendData(data, Storable::serializeInts(blockIDs));
-    Storable::appendData(data, Storable::serializeInts(recordIDs));
+    std::vector<char> data(std::max<size_t>(getSerializedSize(config), getEncodedSize(config)));
+    serializeInto(config, std::as_writable_bytes(std::span(data)));
+    return data;
+}
 
-    // Serialize existing points
-    for (size_t i = 0; i < numChildren; ++i) {
-        Storable::appendData(data, points[i].serialize(config));
+// Throws if out cannot hold the encoding, which may happen with LEAF_FORMAT_DELTA for leaves of more than
+// maxChildren / 2 + 1 points
+size_t TreeLeafNode::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+    size_t offset = TreeNode::serializeInto(config, out);
+    if (config->leafFormat == LEAF_FORMAT_DELTA) {
+        return DeltaLeaf::write(out, offset, dimensions, numChildren, coordinates, maxChildren, blockIDs, recordIDs);
     }
-    // Pad out for empty slots
-    Storable::appendData(data, std::vector<char>((config->maxChildren - numChildren) * Point::getSerializedSize(config), 0));
 
-    return data;
+    // Serialize the blockIDs and recordIDs
+    offset = Storable::writeInts(out, offset, getBlockIDs());
+    offset = Storable::writeInts(out, offset, getRecordIDs());
+
+    // Points are stored one after the other in the page, so transpose the coordinates
+    // Empty slots stay zero
+    size_t pointsOffset = offset;
+    offset = Storable::writeZeros(out, offset, static_cast<size_t>(maxChildren) * dimensions * sizeof(double));
+    std::byte* points = out.data() + pointsOffset;
+    for (int d = 0; d < dimensions; ++d) {
+        const double* values = coordinates + d * maxChildren;
+        for (int i = 0; i < numChildren; ++i) {
+            std::memcpy(points + (i * dimensions + d) * sizeof(double), values + i, sizeof(double));
+        }
+    }
+    return offset;
 }
 
 TreeLeafNode TreeLeafNode::deserialize(GlobalParameters* config, const std::vector<char>& data) {
@@ -191,28 +368,83 @@ TreeLeafNode TreeLeafNode::deserialize(GlobalParameters* config, const std::vect
     }
     // Deserialize the base class first
     TreeNode baseNode = TreeNode::deserialize(config, data);
-    int offset = TreeNode::getSerializedSize(config);
-    
-    // Prepare vectors for blockIDs, recordIDs and points
-    std::vector<int> blockIDs = Storable::deserializeInts(data, offset, config->maxChildren);
+    TreeLeafNode node(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox());
+    node.readArrays(config, data);
+    return node;
+}
+
+// Same as above, but the node and its arrays are placed in one block of the arena
+std::shared_ptr<TreeLeafNode> TreeLeafNode::deserialize(GlobalParameters* config, const std::vector<char>& data, NodeArena& arena) {
+    if (data.size() < TreeLeafNode::getSerializedSize(config)) {
+        throw std::invalid_argument("Data size is too small for TreeLeafNode deserialization.");
+    }
+    TreeNode baseNode = TreeNode::deserialize(config, data);
+    std::shared_ptr<TreeLeafNode> node = arena.make<TreeLeafNode>(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox());
+    node->readArrays(config, data);
+    return node;
+}
+
+// Read the IDs and coordinates straight into the node's arrays
+void TreeLeafNode::readArrays(GlobalParameters* config, const std::vector<char>& data) {
+    size_t offset = TreeNode::getSerializedSize(config);
+    if (config->leafFormat == LEAF_FORMAT_DELTA) {
+        DeltaLeaf::Layout layout = DeltaLeaf::read(std::as_bytes(std::span(data)).subspan(offset), config->dimensions);
+        if (layout.count > config->maxChildren) {
+            throw std::invalid_argument("Leaf " + std::to_string(id) + " holds " + std::to_string(layout.count) + " points, more than maxChildren.");
+        }
+        for (int i = 0; i < layout.count; ++i) {
+            blockIDs[i] = layout.isDeleted(i) ? TOMBSTONE_BLOCK_ID : static_cast<int>(layout.blockIDs.get(i));
+            recordIDs[i] = static_cast<int>(layout.recordIDs.get(i));
+            for (int d = 0; d < config->dimensions; ++d) {
+                coordinates[d * config->maxChildren + i] = layout.getCoordinate(i, d);
+            }
+        }
+        numChildren = layout.count;
+        return;
+    }
+    std::memcpy(blockIDs, data.data() + offset, config->maxChildren * sizeof(int));
     offset += config->maxChildren * sizeof(int);
-    std::vector<int> recordIDs = Storable::deserializeInts(data, offset, config->maxChildren);
+    std::memcpy(recordIDs, data.data() + offset, config->maxChildren * sizeof(int));
     offset += config->maxChildren * sizeof(int);
-    
-    std::vector<Point> points;
+    numChildren = 0;
+    for (int i = 0; i < config->maxChildren; ++i) {
+        if (blockIDs[i] != -1 && recordIDs[i] != -1) {
+            numChildren++;
+        }
+    }
     for (int i = 0; i < config->maxChildren; ++i) {
-        std::vector<char> pointData(data.begin() + offset, data.begin() + offset + Point::getSerializedSize(config));
-        points.push_back(Point::deserialize(config, pointData));
-        offset += Point::getSerializedSize(config);
+        for (int d = 0; d < config->dimensions; ++d) {
+            std::memcpy(&coordinates[d * config->maxChildren + i], data.data() + offset + (i * config->dimensions + d) * sizeof(double), sizeof(double));
+        }
     }
-    printf("Final offset: %d\n", offset);
-    return TreeLeafNode(config, baseNode.getID(), baseNode.getLevel(), baseNode.getParentID(), baseNode.getBoundingBox(), points, blockIDs, recordIDs);
+}
+
+DeltaLeaf::Footprint TreeLeafNode::getFootprint() const {
+    DeltaLeaf::Footprint footprint(dimensions);
+    for (int i = 0; i < numChildren; ++i) {
+        footprint.add(coordinates + i, maxChildren, blockIDs[i], recordIDs[i]);
+    }
+    return footprint;
+}
+
+size_t TreeLeafNode::getEncodedSize(GlobalParameters* config) const {
+    if (config->leafFormat == LEAF_FORMAT_DELTA) {
+        return TreeNode::getSerializedSize(config) + getFootprint().getSize();
+    }
+    return getSerializedSize(config);
 }
 
 int TreeLeafNode::getSerializedSize(GlobalParameters* config) {
+    if (config->leafFormat == LEAF_FORMAT_DELTA) {
+        return TreeNode::getSerializedSize(config) + DeltaLeaf::getWorstSize(config->dimensions, config->maxChildren / 2 + 1);
+    }
     return TreeNode::getSerializedSize(config) + config->maxChildren * (
         sizeof(int) + // blockIDs
         sizeof(int) + // recordIDs
         Point::getSerializedSize(config) // points
     );
-}
\ No newline at end of file
+}
+
+size_t TreeLeafNode::getStorageSize(GlobalParameters* config) {
+    return static_cast<size_t>(config->maxChildren) * (config->dimensions * sizeof(double) + 2 * sizeof(int));
+}
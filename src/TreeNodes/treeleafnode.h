@@ -3,19 +3,47 @@
 
 #include "treenode.h"
 #include <vector>
+#include <memory>
 #include "point.h"
+#include "nodearena.h"
+#include "deltaleaf.h"
+
+#define TOMBSTONE_BLOCK_ID -2 // Block ID of a deleted point whose slot is not reclaimed yet (recordID is kept)
+#define LEAF_FORMAT_PLAIN 0 // GlobalParameters::leafFormat: every slot stored, doubles and ints as they are
+#define LEAF_FORMAT_DELTA 1 // GlobalParameters::leafFormat: the used slots only, encoded by DeltaLeaf
 
 class TreeLeafNode : public TreeNode {
 private:
+    int dimensions;
+    int maxChildren;
+    // The arrays share one block of getStorageSize bytes, either owned by the node
+    // or following it in a NodeArena block
+    // Coordinates stored per dimension (structure of arrays), so that a scan reads contiguous memory:
+    // coordinate d of slot i is at coordinates[d * maxChildren + i], 0 for empty slots
+    double* coordinates;
     // Store the blockID and recordID for each datapoint
     // Use the point coordinates to identify the datapoint
-    std::vector<int> blockIDs; // -1 for empty slots
-    std::vector<int> recordIDs; // -1 for empty slots
-    std::vector<Point> points; // Point() for empty slots
+    int* blockIDs; // -1 for empty slots, TOMBSTONE_BLOCK_ID for deleted points
+    int* recordIDs; // -1 for empty slots
+    std::unique_ptr<std::byte[]> ownedStorage; // Null when placed by a NodeArena
+    void attachStorage(std::byte* storage); // Points the arrays at storage (owned if null) and empties every slot
+    void readArrays(GlobalParameters* config, const std::vector<char>& data); // Fills the arrays from a serialized node
     std::string printPointInfo(GlobalParameters* config, int i) const;
-    int findPointIndex(const Point& point) const; // Returns the index of the point if found, otherwise -1
+    void setPoint(int i, const Point& point); // Copies the coordinates into slot i
+    void moveSlot(int from, int to);
+    int findPointIndex(const Point& point) const; // Returns the index of the point if found (and not deleted), otherwise -1
+
+    void clearSlot(int i); // Resets slot i to the empty markers
+
+protected:
+    void updateBoundingBox();
+
 public:
     TreeLeafNode(GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, const std::vector<Point>& points, const std::vector<int>& blockIDs, const std::vector<int>& recordIDs);
+    // Empty leaf, with its arrays in storage of getStorageSize bytes if given (see NodeArena::make)
+    TreeLeafNode(GlobalParameters* config, int id, int level, int parentID, const Region& boundingBox, std::byte* storage = nullptr);
+    TreeLeafNode(const TreeLeafNode& other); // The copy owns its arrays
+    TreeLeafNode& operator=(const TreeLeafNode& other); // Throws if a node in external storage would change shape
     ~TreeLeafNode() = default;
 
     // Interface methods
@@ -25,16 +53,32 @@ public:
     std::vector<std::pair<int, int>> rangeQuery(const AbstractBoundedClass& query) const; // <blockID, recordID> 
     int removePoint(int blockID, int recordID);
     int removePoint(const Point& point);
+    // Tombstones: the point stays in its slot, and in the bounding box, but is no longer found
+    // Returns the index of the deleted point, or -1 if not found
+    int markDeleted(const Point& point);
+    bool isDeleted(int index) const { return blockIDs[index] == TOMBSTONE_BLOCK_ID; }
+    int getNumDeleted() const;
+    void setIDs(int index, int blockID, int recordID); // For when the data record of the point moves
 
     // Getters
-    const std::vector<Point>& getPoints() const { return points; }
-    const std::vector<int>& getBlockIDs() const { return blockIDs; }
-    const std::vector<int>& getRecordIDs() const { return recordIDs; }
+    std::vector<Point> getPoints() const; // Compatibility accessor, builds maxChildren Points (Point() for empty slots)
+    Point getPoint(int index) const;
+    double getCoordinate(int index, int dimension) const { return coordinates[dimension * maxChildren + index]; }
+    double squaredDistance(int index, const Point& point) const; // Squared distance from the point in slot index
+    std::span<const int> getBlockIDs() const { return {blockIDs, static_cast<size_t>(maxChildren)}; }
+    std::span<const int> getRecordIDs() const { return {recordIDs, static_cast<size_t>(maxChildren)}; }
+    DeltaLeaf::Footprint getFootprint() const; // Of the points in the leaf, for LEAF_FORMAT_DELTA
 
     // Serialization
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
     static TreeLeafNode deserialize(GlobalParameters* config, const std::vector<char>& data);
+    static std::shared_ptr<TreeLeafNode> deserialize(GlobalParameters* config, const std::vector<char>& data, NodeArena& arena);
+    size_t getEncodedSize(GlobalParameters* config) const; // Bytes serializeInto writes for this leaf
+    // Bytes a page must have for any leaf: with LEAF_FORMAT_DELTA, only enough for maxChildren / 2 + 1 points of any values,
+    // so that both halves of a split always fit; leaves of points that compress well hold up to maxChildren
     static int getSerializedSize(GlobalParameters* config);
+    static size_t getStorageSize(GlobalParameters* config); // Bytes taken by the arrays
 };
 
 #endif // TREELEAFNODE_H
\ No newline at end of file
@@ -17,17 +17,19 @@ TreeNode ::~TreeNode () {
 // Doesn't store numChildren, as it can be derived from the data
 // and maxChildren as it's stored in data block 0
 std::vector<char> TreeNode::serialize(GlobalParameters* config) const {
-    std::vector<char> data;
-    // Serialize the basic properties of the TreeNode
-    Storable::appendData(data, Storable::serializeInt(id));
-    Storable::appendData(data, Storable::serializeInt(level));
-    Storable::appendData(data, Storable::serializeInt(parentID));
-
-    // Serialize the bounding box 
-    Storable::appendData(data, boundingBox.serialize(config));
+    std::vector<char> data(getSerializedSize(config));
+    serializeInto(config, std::as_writable_bytes(std::span(data)));
     return data;
 }
 
+// Writes the basic properties of the TreeNode and its bounding box
+size_t TreeNode::serializeInto(GlobalParameters* config, std::span<std::byte> out) const {
+    size_t offset = Storable::writeInt(out, 0, id);
+    offset = Storable::writeInt(out, offset, level);
+    offset = Storable::writeInt(out, offset, parentID);
+    return offset + boundingBox.serializeInto(config, out.subspan(offset));
+}
+
 // Deserialize the object from a string representation
 // maxChildren is not stored but needed for the constructor
 TreeNode TreeNode::deserialize(GlobalParameters* config, const std::vector<char>& data) {
@@ -20,17 +20,19 @@ protected:
 
 public:
     TreeNode (int id, int level, int parentID, const Region& boundingBox);
-    ~TreeNode ();
+    virtual ~TreeNode ();
 
     bool isLeaf() const { return level == 0; } 
     
     int getID() const { return id; }
     int getLevel() const { return level; }
     int getParentID() const { return parentID; }
+    void setParentID(int newParentID) { parentID = newParentID; } // Used by the tree when nodes are split
     int getNumChildren() const { return numChildren; }
     const Region getBoundingBox() const { return boundingBox; }
 
     std::vector<char> serialize(GlobalParameters* config) const override;
+    size_t serializeInto(GlobalParameters* config, std::span<std::byte> out) const override;
     static TreeNode deserialize(GlobalParameters* config, const std::vector<char>& data);
     static int getSerializedSize(GlobalParameters* config);
 
@@ -0,0 +1,70 @@
+// Throughput of RStarTree::rangeQueries on a WorkStealingPool of 1 to maxThreads threads, against rangeQuery
+// called once per query on the main thread. Two batches: many small windows (map tiles), and a few large
+// windows, where a single query holds most of the work and only splitting it into subtree tasks keeps all threads busy.
+// Usage: bench_batch_query [numPoints] [maxThreads] [maxChildren] [batchSize]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include "rstartree.h"
+
+std::vector<Region> makeQueries(int count, double side, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0 - side);
+    std::vector<Region> queries;
+    for (int i = 0; i < count; ++i) {
+        double x = distribution(generator), y = distribution(generator);
+        queries.push_back(Region({x, y}, {x + side, y + side}));
+    }
+    return queries;
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    GlobalParameters config;
+    config.maxChildren = argc > 3 ? std::atoi(argv[3]) : 32;
+    config.dimensions = 2;
+    int batchSize = argc > 4 ? std::atoi(argv[4]) : 10000;
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> ids(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+        ids[i] = i;
+    }
+    RStarTree tree(&config);
+    tree.bulkLoad(points, ids, ids);
+
+    printf("%d points, maxChildren=%d, height=%d\n", numPoints, config.maxChildren, tree.getHeight());
+    struct Batch { const char* name; std::vector<Region> queries; };
+    std::vector<Batch> batches = {
+        {"small", makeQueries(batchSize, 0.01, 1)},
+        {"large", makeQueries(std::max(1, maxThreads / 2), 0.5, 2)},
+    };
+    for (const Batch& batch : batches) {
+        auto start = std::chrono::steady_clock::now();
+        long long results = 0;
+        for (const Region& query : batch.queries) {
+            results += tree.rangeQuery(query).size();
+        }
+        double sequential = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("\n%s batch: %zu queries, %lld results, rangeQuery loop %.3f s\n", batch.name, batch.queries.size(), results, sequential);
+        printf("threads   time (s)   speedup     steals\n");
+
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            WorkStealingPool pool(threads);
+            start = std::chrono::steady_clock::now();
+            std::vector<std::vector<std::pair<int, int>>> found = tree.rangeQueries(batch.queries, pool);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("%7d  %9.3f  %8.2f  %9lld\n", threads, elapsed, sequential / elapsed, pool.getSteals());
+            if (threads < maxThreads && threads * 2 > maxThreads) {
+                threads = maxThreads / 2; // Always end with maxThreads
+            }
+        }
+    }
+    return 0;
+}
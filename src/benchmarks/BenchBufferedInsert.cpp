@@ -0,0 +1,67 @@
+// Insert throughput of a tree in a buffer's tree file, inserting directly and with buffered insertion
+// for a few buffer capacities: inserts/s, pages read from and written to the tree file, and the time of
+// a batch of range queries run while points still wait in the buffers.
+// Usage: bench_buffered_insert [numPoints] [maxChildren] [poolPages]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include "rstartree.h"
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 500000;
+    GlobalParameters config;
+    config.maxChildren = argc > 2 ? std::atoi(argv[2]) : 32;
+    config.dimensions = 2;
+    int poolPages = argc > 3 ? std::atoi(argv[3]) : 1024;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_buffered_insert.tree").string();
+    std::string dataFilename = (directory / "bench_buffered_insert.data").string();
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+    std::vector<Region> queries;
+    for (int i = 0; i < 1000; ++i) {
+        double x = distribution(generator) * 0.99, y = distribution(generator) * 0.99;
+        queries.push_back(Region({x, y}, {x + 0.01, y + 0.01}));
+    }
+
+    printf("%d points, maxChildren=%d, pool of %d pages\n", numPoints, config.maxChildren, poolPages);
+    printf("%10s %12s %12s %12s %12s %14s\n", "buffer", "inserts/s", "page reads", "page writes", "buffered", "queries (ms)");
+    for (int capacity : {0, 64, 256, 1024}) {
+        std::filesystem::remove(treeFilename);
+        std::filesystem::remove(dataFilename);
+        Buffer buffer(&config, treeFilename, dataFilename, static_cast<size_t>(poolPages) * BlockFile::pageSizeFor(&config));
+        RStarTree tree(&config, &buffer);
+        tree.setInsertBuffering(capacity);
+        BlockFile* treeFile = buffer.getTreeFile();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numPoints; ++i) {
+            tree.insert(points[i], i / 100, i % 100);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        long long buffered = tree.getNumBuffered();
+
+        auto queryStart = std::chrono::steady_clock::now();
+        long long found = 0;
+        for (const Region& query : queries) {
+            found += tree.rangeQuery(query).size();
+        }
+        double queryTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+        printf("%10d %12.0f %12lld %12lld %12lld %14.1f\n", capacity, numPoints / elapsed, treeFile->getReads(),
+            treeFile->getWrites(), buffered, queryTime);
+        if (found == 0) {
+            printf("(no query results)\n");
+        }
+    }
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return 0;
+}
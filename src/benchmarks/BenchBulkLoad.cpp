@@ -0,0 +1,123 @@
+// Compares building the R*-tree with STR bulk loading against repeated single inserts:
+// build time, and node accesses / page reads of range queries on the resulting trees.
+// Both trees are stored in block files, with a tree buffer pool small enough that misses are real reads.
+// Usage: bench_bulk_load [numPoints] [maxChildren] [dimensions] [numQueries] [treeBufferSize]
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include "rstartree.h"
+
+// Random points in the unit cube
+std::vector<Point> randomPoints(int count, int dimensions, std::mt19937& generator) {
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    points.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        std::vector<double> coords(dimensions);
+        for (double& coord : coords) {
+            coord = distribution(generator);
+        }
+        points.emplace_back(coords);
+    }
+    return points;
+}
+
+struct BuildResult {
+    double buildSeconds;
+    int height;
+    long long numNodes;
+    double nodesPerQuery; // Pins of tree pages
+    double readsPerQuery; // Pages read from the tree file
+};
+
+BuildResult run(const char* name, GlobalParameters config, long long treeBufferSize, const std::vector<Region>& queries,
+    const std::function<void(RStarTree&)>& build) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / (std::string("bench_bulk_load_") + name + ".tree")).string();
+    std::string dataFilename = (directory / (std::string("bench_bulk_load_") + name + ".data")).string();
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+
+    BuildResult result;
+    {
+        Buffer buffer(&config, treeFilename, dataFilename, treeBufferSize, DATA_BLOCK_SIZE);
+        RStarTree tree(&config, &buffer);
+
+        auto start = std::chrono::steady_clock::now();
+        build(tree);
+        buffer.flush();
+        result.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.height = tree.getHeight();
+        result.numNodes = tree.getNumNodes();
+
+        // Start the queries from a cold pool
+        buffer.getTreePool()->discardAll();
+        buffer.getTreePool()->resetStats();
+        long long readsBefore = buffer.getTreeFile()->getReads();
+        for (const Region& query : queries) {
+            tree.rangeQuery(query);
+        }
+        BufferPoolStats stats = buffer.getTreePool()->getStats();
+        result.nodesPerQuery = double(stats.hits + stats.misses) / queries.size();
+        result.readsPerQuery = double(buffer.getTreeFile()->getReads() - readsBefore) / queries.size();
+    }
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 100000;
+    GlobalParameters config;
+    config.maxChildren = argc > 2 ? std::atoi(argv[2]) : 32;
+    config.dimensions = argc > 3 ? std::atoi(argv[3]) : 2;
+    int numQueries = argc > 4 ? std::atoi(argv[4]) : 1000;
+    long long treeBufferSize = argc > 5 ? std::atoll(argv[5]) : (1LL << 20);
+
+    std::mt19937 generator(12345);
+    std::vector<Point> points = randomPoints(numPoints, config.dimensions, generator);
+    std::vector<int> blockIDs(numPoints), recordIDs(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        blockIDs[i] = i / 100;
+        recordIDs[i] = i % 100;
+    }
+
+    // Square queries around random centers, each covering about 0.1% of the space
+    double side = std::pow(0.001, 1.0 / config.dimensions);
+    std::vector<Region> queries;
+    for (const Point& center : randomPoints(numQueries, config.dimensions, generator)) {
+        std::vector<double> start(config.dimensions), end(config.dimensions);
+        for (int d = 0; d < config.dimensions; ++d) {
+            start[d] = center.getCoordinates()[d] - side / 2;
+            end[d] = center.getCoordinates()[d] + side / 2;
+        }
+        queries.emplace_back(start, end);
+    }
+
+    printf("%d points, maxChildren=%d, dimensions=%d, %d range queries, tree buffer %lld bytes\n",
+        numPoints, config.maxChildren, config.dimensions, numQueries, treeBufferSize);
+    printf("%-16s %10s %7s %9s %14s %14s\n", "build", "time (s)", "height", "nodes", "nodes/query", "reads/query");
+
+    auto print = [](const char* name, const BuildResult& result) {
+        printf("%-16s %10.3f %7d %9lld %14.2f %14.2f\n", name, result.buildSeconds, result.height, result.numNodes,
+            result.nodesPerQuery, result.readsPerQuery);
+    };
+
+    print("insert", run("insert", config, treeBufferSize, queries, [&](RStarTree& tree) {
+        for (int i = 0; i < numPoints; ++i) {
+            tree.insert(points[i], blockIDs[i], recordIDs[i]);
+        }
+    }));
+    for (double fillFactor : {1.0, 0.7}) {
+        char name[32];
+        snprintf(name, sizeof(name), "str (fill %.1f)", fillFactor);
+        print(name, run("str", config, treeBufferSize, queries, [&](RStarTree& tree) {
+            tree.bulkLoad(points, blockIDs, recordIDs, fillFactor);
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Data-block reads of range queries that fetch every DataPoint they find, over Gaussian clusters of points
+// (dense areas) stored in the data file in arrival order, clustered by Buffer::clusterDataFile before the
+// bulk load, or clustered by RStarTree::clusterDataFile under a tree built by inserts:
+// distinct data blocks per query, data pages read through a small data pool, query time and clustering time.
+// Usage: bench_cluster [numPoints] [maxChildren] [dataPoolPages]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <set>
+#include "rstartree.h"
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 500000;
+    GlobalParameters config;
+    config.maxChildren = argc > 2 ? std::atoi(argv[2]) : 32;
+    config.dimensions = 2;
+    int dataPoolPages = argc > 3 ? std::atoi(argv[3]) : 256;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_cluster.tree").string();
+    std::string dataFilename = (directory / "bench_cluster.data").string();
+
+    // 50 clusters of different spreads, points arriving in random order
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> uniform(0.1, 0.9);
+    std::vector<std::pair<std::normal_distribution<double>, std::normal_distribution<double>>> clusters;
+    for (int c = 0; c < 50; ++c) {
+        double spread = 0.005 + 0.02 * (c % 5);
+        clusters.push_back({std::normal_distribution<double>(uniform(generator), spread), std::normal_distribution<double>(uniform(generator), spread)});
+    }
+    std::uniform_int_distribution<int> pick(0, clusters.size() - 1);
+    std::vector<Point> points;
+    for (int i = 0; i < numPoints; ++i) {
+        auto& [x, y] = clusters[pick(generator)];
+        points.push_back(Point({x(generator), y(generator)}));
+    }
+    // Queries centered on points, so that they land in the dense areas
+    std::vector<Region> queries;
+    std::uniform_int_distribution<int> anyPoint(0, numPoints - 1);
+    for (int i = 0; i < 500; ++i) {
+        const std::vector<double>& center = points[anyPoint(generator)].getCoordinates();
+        queries.push_back(Region({center[0] - 0.002, center[1] - 0.002}, {center[0] + 0.002, center[1] + 0.002}));
+    }
+
+    printf("%d points in 50 clusters, maxChildren=%d, data pool of %d pages\n", numPoints, config.maxChildren, dataPoolPages);
+    printf("%20s %12s %14s %14s %12s %12s\n", "data order", "results/q", "blocks/query", "data reads/q", "queries (ms)", "cluster (s)");
+    for (const char* mode : {"arrival", "clustered at load", "clustered by tree"}) {
+        std::string name(mode);
+        std::filesystem::remove(treeFilename);
+        std::filesystem::remove(dataFilename);
+        long long dataPoolSize = static_cast<long long>(dataPoolPages) * DATA_BLOCK_SIZE;
+        Buffer buffer(&config, treeFilename, dataFilename, DEFAULT_TREE_BUFFER_SIZE, dataPoolSize);
+        RStarTree tree(&config, &buffer);
+        WorkStealingPool pool(1);
+        double clusterTime = 0.0;
+
+        if (name == "clustered by tree") {
+            for (int i = 0; i < numPoints; ++i) {
+                auto [blockID, recordID] = buffer.addDataPoint(DataPoint(points[i], {}, i));
+                tree.insert(points[i], blockID, recordID);
+            }
+            auto start = std::chrono::steady_clock::now();
+            tree.clusterDataFile(pool);
+            clusterTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        else {
+            for (int i = 0; i < numPoints; ++i) {
+                buffer.addDataPoint(DataPoint(points[i], {}, i));
+            }
+            if (name == "clustered at load") {
+                auto start = std::chrono::steady_clock::now();
+                buffer.clusterDataFile(pool, DEFAULT_BULK_LOAD_MEMORY);
+                clusterTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            tree.bulkLoadDataFile(pool);
+        }
+        buffer.flush();
+        buffer.getDataPool()->discardAll();
+
+        long long results = 0, blocks = 0;
+        long long readsBefore = buffer.getDataFile()->getReads();
+        auto start = std::chrono::steady_clock::now();
+        for (const Region& query : queries) {
+            std::set<int> touched;
+            for (auto [blockID, recordID] : tree.rangeQuery(query)) {
+                buffer.readDataPoint(blockID, recordID);
+                touched.insert(blockID);
+                results++;
+            }
+            blocks += touched.size();
+        }
+        double queryTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        long long reads = buffer.getDataFile()->getReads() - readsBefore;
+        printf("%20s %12.1f %14.1f %14.1f %12.1f %12.3f\n", mode, double(results) / queries.size(), double(blocks) / queries.size(),
+            double(reads) / queries.size(), queryTime, clusterTime);
+    }
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return 0;
+}
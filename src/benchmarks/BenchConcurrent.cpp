@@ -0,0 +1,111 @@
+// Throughput of the in-memory R*-tree with 1 to maxThreads threads running a mix of
+// inserts, range queries and kNN queries on a bulk-loaded tree, for a few insert shares.
+// Every run starts from a fresh tree and lasts a fixed time; speedup is against 1 thread of the same mix.
+// Usage: bench_concurrent [numPoints] [maxThreads] [maxChildren] [seconds]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include "rstartree.h"
+
+struct RunResult {
+    double opsPerSecond;
+    long long inserts;
+    long long newNodes; // Added by splits, each one done under the exclusive tree latch
+};
+
+RunResult run(GlobalParameters config, const std::vector<Point>& points, int threads, int insertPercent, double seconds) {
+    RStarTree tree(&config);
+    std::vector<int> ids(points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        ids[i] = i;
+    }
+    tree.bulkLoad(points, ids, ids, 0.7);
+    long long nodesBefore = tree.getNumNodes();
+
+    std::atomic<bool> stop = false;
+    std::atomic<long long> operations = 0;
+    std::atomic<long long> inserts = 0;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 generator(1000 + t);
+            std::uniform_real_distribution<double> coordinate(0.0, 1.0);
+            std::uniform_int_distribution<int> percent(0, 99);
+            std::vector<double> coords(config.dimensions);
+            long long done = 0;
+            long long inserted = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (double& coord : coords) {
+                    coord = coordinate(generator);
+                }
+                int choice = percent(generator);
+                if (choice < insertPercent) {
+                    tree.insert(Point(coords), t, static_cast<int>(inserted));
+                    inserted++;
+                }
+                else if (choice % 2 == 0) {
+                    // Windows of about 0.01% of the space
+                    std::vector<double> end(coords);
+                    for (double& value : end) {
+                        value += 0.01;
+                    }
+                    tree.rangeQuery(Region(coords, end));
+                }
+                else {
+                    tree.nearestNeighbors(Point(coords), 10);
+                }
+                done++;
+            }
+            operations += done;
+            inserts += inserted;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {operations / elapsed, inserts.load(), tree.getNumNodes() - nodesBefore};
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    GlobalParameters config;
+    config.maxChildren = argc > 3 ? std::atoi(argv[3]) : 32;
+    config.dimensions = 2;
+    double seconds = argc > 4 ? std::atof(argv[4]) : 1.0;
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    points.reserve(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+
+    printf("%d points, maxChildren=%d, dimensions=%d, %.1f s per run, range and kNN queries in equal shares\n",
+        numPoints, config.maxChildren, config.dimensions, seconds);
+    printf("inserts  threads       ops/s   speedup    inserts  new nodes\n");
+    for (int insertPercent : {0, 10, 50}) {
+        double single = 0.0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            RunResult result = run(config, points, threads, insertPercent, seconds);
+            if (threads == 1) {
+                single = result.opsPerSecond;
+            }
+            printf("%6d%%  %7d  %10.0f  %8.2f  %9lld  %9lld\n", insertPercent, threads, result.opsPerSecond,
+                result.opsPerSecond / single, result.inserts, result.newNodes);
+            if (threads < maxThreads && threads * 2 > maxThreads) {
+                threads = maxThreads / 2; // Always end with maxThreads
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Expiry of part of an in-memory tree while another thread keeps querying it: delete latency, latency of the
+// concurrent range queries (median, 99th percentile, worst) and the tombstones left, when tombstones are left in place,
+// reclaimed by the background compactor while deleting, or reclaimed by compact() once the deletes are done.
+// Usage: bench_delete [numPoints] [expirePercent] [maxChildren]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include "rstartree.h"
+
+double percentile(std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 500000;
+    int expirePercent = argc > 2 ? std::atoi(argv[2]) : 50;
+    GlobalParameters config;
+    config.maxChildren = argc > 3 ? std::atoi(argv[3]) : 32;
+    config.dimensions = 2;
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> ids(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+        ids[i] = i;
+    }
+    int expired = static_cast<int>(static_cast<long long>(numPoints) * expirePercent / 100);
+
+    printf("%d points, %d expired, maxChildren=%d\n", numPoints, expired, config.maxChildren);
+    printf("%12s %12s %14s %12s %12s %12s %12s %12s\n", "compaction", "deletes/s", "max del (us)", "q p50 (us)",
+        "q p99 (us)", "q max (us)", "tombstones", "compact (s)");
+    for (const char* mode : {"none", "background", "after"}) {
+        RStarTree tree(&config);
+        tree.bulkLoad(points, ids, ids, 0.7);
+        bool background = std::string(mode) == "background";
+        if (background) {
+            tree.startBackgroundCompaction();
+        }
+
+        std::atomic<bool> deleting = true;
+        std::vector<double> queryLatencies;
+        std::thread reader([&]() {
+            std::mt19937 queryGenerator(7);
+            std::uniform_real_distribution<double> corner(0.0, 0.99);
+            while (deleting) {
+                double x = corner(queryGenerator), y = corner(queryGenerator);
+                auto start = std::chrono::steady_clock::now();
+                tree.rangeQuery(Region({x, y}, {x + 0.01, y + 0.01}));
+                queryLatencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+        });
+
+        double maxDelete = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < expired; ++i) {
+            auto deleteStart = std::chrono::steady_clock::now();
+            tree.remove(points[i]);
+            maxDelete = std::max(maxDelete, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - deleteStart).count());
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        deleting = false;
+        reader.join();
+        if (background) {
+            tree.stopBackgroundCompaction();
+        }
+        long long tombstones = tree.getNumDeleted();
+
+        double compactTime = 0.0;
+        if (std::string(mode) != "none") {
+            auto compactStart = std::chrono::steady_clock::now();
+            tree.compact(); // Whatever the background compactor had not reached yet
+            compactTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - compactStart).count();
+        }
+        printf("%12s %12.0f %14.1f %12.1f %12.1f %12.1f %12lld %12.3f\n", mode, expired / elapsed, maxDelete,
+            percentile(queryLatencies, 0.5), percentile(queryLatencies, 0.99), percentile(queryLatencies, 1.0),
+            tombstones, compactTime);
+    }
+    return 0;
+}
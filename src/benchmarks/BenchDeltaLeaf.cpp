@@ -0,0 +1,90 @@
+// Range queries over trees bulk loaded from the data file with plain and with delta-encoded leaf pages, with
+// maxChildren as large as 4096-byte pages allow for each format (interior child boxes quantized to 16 bits in both),
+// and the data file in arrival order or clustered in Hilbert order (whose block IDs compress better):
+// points per leaf, leaves, height, tree pages and bytes read per query through a small tree pool, and query time.
+// Usage: bench_delta_leaf [numPoints] [treePoolPages]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include "rstartree.h"
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 500000;
+    int treePoolPages = argc > 2 ? std::atoi(argv[2]) : 64;
+    int pageSize = 4096;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_delta_leaf.tree").string();
+    std::string dataFilename = (directory / "bench_delta_leaf.data").string();
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+    std::vector<Region> queries;
+    for (int i = 0; i < 2000; ++i) {
+        double x = distribution(generator), y = distribution(generator);
+        queries.push_back(Region({x, y}, {x + 0.01, y + 0.01}));
+    }
+
+    printf("%d uniform points, %d-byte pages, tree pool of %d pages\n", numPoints, pageSize, treePoolPages);
+    printf("%8s %12s %12s %10s %10s %8s %14s %14s %12s\n", "leaves", "data order", "maxChildren", "pts/leaf", "leaves", "height",
+        "tree reads/q", "KB read/q", "queries (ms)");
+    for (int format : {LEAF_FORMAT_PLAIN, LEAF_FORMAT_DELTA}) {
+        for (bool clustered : {false, true}) {
+            std::filesystem::remove(treeFilename);
+            std::filesystem::remove(dataFilename);
+            GlobalParameters config = {0, 2, 16, format};
+            config.maxChildren = BlockFile::maxChildrenFor(&config, pageSize);
+            Buffer buffer(&config, treeFilename, dataFilename, static_cast<long long>(treePoolPages) * pageSize);
+            for (int i = 0; i < numPoints; ++i) {
+                buffer.addDataPoint(DataPoint(points[i], {}, i));
+            }
+            WorkStealingPool pool(1);
+            if (clustered) {
+                buffer.clusterDataFile(pool, DEFAULT_BULK_LOAD_MEMORY);
+            }
+            RStarTree tree(&config, &buffer);
+            tree.bulkLoadDataFile(pool);
+            buffer.flush();
+
+            long long leaves = 0;
+            std::vector<std::pair<int, int>> stack = {{tree.getRootID(), tree.getHeight() - 1}};
+            while (!stack.empty()) {
+                auto [nodeID, level] = stack.back();
+                stack.pop_back();
+                if (level == 0) {
+                    leaves++;
+                    continue;
+                }
+                auto interior = std::static_pointer_cast<TreeInteriorNode>(tree.readNode(nodeID));
+                for (int i = 0; i < interior->getNumChildren(); ++i) {
+                    stack.emplace_back(interior->getChildID(i), level - 1);
+                }
+            }
+            buffer.getTreePool()->discardAll();
+
+            long long results = 0;
+            long long readsBefore = buffer.getTreeFile()->getReads();
+            auto start = std::chrono::steady_clock::now();
+            for (const Region& query : queries) {
+                results += tree.rangeQuery(query).size();
+            }
+            double queryTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            long long reads = buffer.getTreeFile()->getReads() - readsBefore;
+            printf("%8s %12s %12d %10.1f %10lld %8d %14.2f %14.1f %12.1f\n", format == LEAF_FORMAT_DELTA ? "delta" : "plain",
+                clustered ? "hilbert" : "arrival", config.maxChildren, double(numPoints) / leaves, leaves, tree.getHeight(),
+                double(reads) / queries.size(), double(reads) * pageSize / 1024 / queries.size(), queryTime);
+            if (results == 0) {
+                printf("no results\n");
+            }
+        }
+    }
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return 0;
+}
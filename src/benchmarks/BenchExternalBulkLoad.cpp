@@ -0,0 +1,87 @@
+// Builds the R*-tree from a data file of random DataPoints with bulkLoadDataFile, for a few memory budgets and thread counts:
+// build time, runs written by the sorts (temp bytes), tree pages appended and peak resident memory of the process.
+// The in-memory bulkLoad of the same points is timed first for reference.
+// Usage: bench_external_bulk_load [numPoints] [maxThreads] [maxChildren] [tempDirectory]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <sys/resource.h>
+#include "rstartree.h"
+
+long peakMemoryKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    GlobalParameters config;
+    config.maxChildren = argc > 3 ? std::atoi(argv[3]) : 32;
+    config.dimensions = 2;
+    std::string tempDirectory = argc > 4 ? argv[4] : "";
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_external_bulk_load.tree").string();
+    std::string dataFilename = (directory / "bench_external_bulk_load.data").string();
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> blockIDs, recordIDs;
+    {
+        Buffer buffer(&config, treeFilename, dataFilename);
+        for (int i = 0; i < numPoints; ++i) {
+            points.push_back(Point({distribution(generator), distribution(generator)}));
+            auto [blockID, recordID] = buffer.addDataPoint(DataPoint(points.back(), {}, i));
+            blockIDs.push_back(blockID);
+            recordIDs.push_back(recordID);
+        }
+        buffer.flush();
+    }
+    printf("%d points, maxChildren=%d, peak memory after generating them %ld MB\n", numPoints, config.maxChildren, peakMemoryKB() >> 10);
+
+    {
+        Buffer buffer(&config, treeFilename, dataFilename);
+        RStarTree tree(&config, &buffer);
+        auto start = std::chrono::steady_clock::now();
+        tree.bulkLoad(points, blockIDs, recordIDs);
+        buffer.flush();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("in-memory bulkLoad: %.3f s, %lld nodes\n", elapsed, tree.getNumNodes());
+    }
+    std::vector<Point>().swap(points);
+
+    printf("%12s %8s %10s %10s %12s\n", "budget (MB)", "threads", "time (s)", "nodes", "tree writes");
+    for (long long budget : {16LL << 20, 64LL << 20, 256LL << 20}) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            // Start from an empty tree file over the same data file
+            std::filesystem::remove(treeFilename);
+            Buffer buffer(&config, treeFilename, dataFilename);
+            RStarTree tree(&config, &buffer);
+            WorkStealingPool pool(threads);
+            long long writesBefore = buffer.getTreeFile()->getWrites();
+
+            auto start = std::chrono::steady_clock::now();
+            tree.bulkLoadDataFile(pool, budget, 1.0, tempDirectory);
+            buffer.flush();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("%12lld %8d %10.3f %10lld %12lld\n", budget >> 20, threads, elapsed, tree.getNumNodes(),
+                buffer.getTreeFile()->getWrites() - writesBefore);
+            if (threads < maxThreads && threads * 2 > maxThreads) {
+                threads = maxThreads / 2; // Always end with maxThreads
+            }
+        }
+    }
+    printf("peak memory %ld MB\n", peakMemoryKB() >> 10);
+
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return 0;
+}
@@ -0,0 +1,46 @@
+// Insert throughput benchmark for the R*-tree
+// Usage: bench_insert [numPoints] [maxChildren] [dimensions]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "rstartree.h"
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 200000;
+    GlobalParameters config;
+    config.maxChildren = argc > 2 ? std::atoi(argv[2]) : 32;
+    config.dimensions = argc > 3 ? std::atoi(argv[3]) : 2;
+
+    // Generate all points up front so that only the inserts are timed
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    points.reserve(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        std::vector<double> coords(config.dimensions);
+        for (double& coord : coords) {
+            coord = distribution(generator);
+        }
+        points.emplace_back(coords);
+    }
+
+    printf("Inserting %d points (maxChildren=%d, dimensions=%d)\n", numPoints, config.maxChildren, config.dimensions);
+    RStarTree tree(&config);
+    int reportEvery = std::max(1, numPoints / 10);
+    auto start = std::chrono::steady_clock::now();
+    auto intervalStart = start;
+    for (int i = 0; i < numPoints; ++i) {
+        tree.insert(points[i], i / 100, i % 100);
+
+        if ((i + 1) % reportEvery == 0) {
+            auto now = std::chrono::steady_clock::now();
+            double interval = std::chrono::duration<double>(now - intervalStart).count();
+            printf("  %9d points: %10.0f inserts/s (height %d, %lld nodes)\n", i + 1, reportEvery / interval, tree.getHeight(), tree.getNumNodes());
+            intervalStart = now;
+        }
+    }
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Total: %.3f s, %.0f inserts/s\n", total, numPoints / total);
+    return 0;
+}
@@ -0,0 +1,307 @@
+// Google Benchmark micro-benchmarks of the geometry and node operations under the tree, each parameterized by
+// dimensions and maxChildren. Every iteration works on a node's worth (maxChildren) of objects, and items/s is per object.
+// Usage: rstartree_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>] (see --help)
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+/* === Inputs === */
+
+// Uniform points in the unit cube
+std::vector<Point> randomPoints(int dimensions, int count, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < count; ++i) {
+        std::vector<double> coords(dimensions);
+        for (double& coord : coords) {
+            coord = distribution(generator);
+        }
+        points.push_back(Point(coords));
+    }
+    return points;
+}
+
+// Boxes with sides up to maxSide in the unit cube
+std::vector<Region> randomRegions(int dimensions, int count, double maxSide, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Region> regions;
+    for (int i = 0; i < count; ++i) {
+        std::vector<double> start(dimensions), end(dimensions);
+        for (int d = 0; d < dimensions; ++d) {
+            start[d] = distribution(generator) * (1.0 - maxSide);
+            end[d] = start[d] + distribution(generator) * maxSide;
+        }
+        regions.push_back(Region(start, end));
+    }
+    return regions;
+}
+
+Region unitCube(int dimensions) {
+    return Region(std::vector<double>(dimensions, 0.0), std::vector<double>(dimensions, 1.0));
+}
+
+// Half the side of the unit cube in every dimension, so that a query meets about 1/2^dimensions of the points
+Region centralQuery(int dimensions) {
+    return Region(std::vector<double>(dimensions, 0.25), std::vector<double>(dimensions, 0.75));
+}
+
+std::vector<int> sequence(int count) {
+    std::vector<int> values(count);
+    for (int i = 0; i < count; ++i) {
+        values[i] = i;
+    }
+    return values;
+}
+
+// Arguments of every benchmark: {dimensions, maxChildren}
+void nodeShapes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"dims", "maxChildren"})->ArgsProduct({{2, 3, 5}, {16, 64, 256}});
+}
+
+/* === Region === */
+
+void BM_RegionOverlaps(benchmark::State& state) {
+    int dimensions = state.range(0), count = state.range(1);
+    std::vector<Region> regions = randomRegions(dimensions, count, 0.2, 1);
+    Region query = randomRegions(dimensions, 1, 0.2, 2)[0];
+    for (auto _ : state) {
+        int overlapping = 0;
+        for (const Region& region : regions) {
+            overlapping += region.overlaps(query);
+        }
+        benchmark::DoNotOptimize(overlapping);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_RegionOverlaps)->Apply(nodeShapes);
+
+void BM_RegionOverlap(benchmark::State& state) {
+    int dimensions = state.range(0), count = state.range(1);
+    std::vector<Region> regions = randomRegions(dimensions, count, 0.2, 1);
+    Region query = randomRegions(dimensions, 1, 0.2, 2)[0];
+    for (auto _ : state) {
+        double total = 0;
+        for (const Region& region : regions) {
+            total += region.overlap(query);
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_RegionOverlap)->Apply(nodeShapes);
+
+void BM_RegionBoundingBox(benchmark::State& state) {
+    int dimensions = state.range(0), count = state.range(1);
+    std::vector<Region> regions = randomRegions(dimensions, count, 0.2, 1);
+    std::vector<AbstractBoundedClass*> objects;
+    for (Region& region : regions) {
+        objects.push_back(&region);
+    }
+    for (auto _ : state) {
+        Region box = Region::boundingBox(objects);
+        benchmark::DoNotOptimize(box);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_RegionBoundingBox)->Apply(nodeShapes);
+
+/* === Serialization === */
+
+void BM_PointSerialize(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Point> points = randomPoints(config.dimensions, config.maxChildren, 1);
+    for (auto _ : state) {
+        for (const Point& point : points) {
+            std::vector<char> data = point.serialize(&config);
+            benchmark::DoNotOptimize(data.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_PointSerialize)->Apply(nodeShapes);
+
+void BM_PointSerializeInto(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Point> points = randomPoints(config.dimensions, config.maxChildren, 1);
+    std::vector<std::byte> page(static_cast<size_t>(Point::getSerializedSize(&config)) * config.maxChildren);
+    for (auto _ : state) {
+        size_t offset = 0;
+        for (const Point& point : points) {
+            offset += point.serializeInto(&config, std::span<std::byte>(page).subspan(offset));
+        }
+        benchmark::DoNotOptimize(page.data());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_PointSerializeInto)->Apply(nodeShapes);
+
+void BM_PointDeserialize(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<std::vector<char>> serialized;
+    for (const Point& point : randomPoints(config.dimensions, config.maxChildren, 1)) {
+        serialized.push_back(point.serialize(&config));
+    }
+    for (auto _ : state) {
+        for (const std::vector<char>& data : serialized) {
+            Point point = Point::deserialize(&config, data);
+            benchmark::DoNotOptimize(point);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_PointDeserialize)->Apply(nodeShapes);
+
+void BM_RegionSerialize(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Region> regions = randomRegions(config.dimensions, config.maxChildren, 0.2, 1);
+    for (auto _ : state) {
+        for (const Region& region : regions) {
+            std::vector<char> data = region.serialize(&config);
+            benchmark::DoNotOptimize(data.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_RegionSerialize)->Apply(nodeShapes);
+
+void BM_RegionSerializeInto(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Region> regions = randomRegions(config.dimensions, config.maxChildren, 0.2, 1);
+    std::vector<std::byte> page(static_cast<size_t>(Region::getSerializedSize(&config)) * config.maxChildren);
+    for (auto _ : state) {
+        size_t offset = 0;
+        for (const Region& region : regions) {
+            offset += region.serializeInto(&config, std::span<std::byte>(page).subspan(offset));
+        }
+        benchmark::DoNotOptimize(page.data());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_RegionSerializeInto)->Apply(nodeShapes);
+
+void BM_RegionDeserialize(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<std::vector<char>> serialized;
+    for (const Region& region : randomRegions(config.dimensions, config.maxChildren, 0.2, 1)) {
+        serialized.push_back(region.serialize(&config));
+    }
+    for (auto _ : state) {
+        for (const std::vector<char>& data : serialized) {
+            Region region = Region::deserialize(&config, data);
+            benchmark::DoNotOptimize(region);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_RegionDeserialize)->Apply(nodeShapes);
+
+/* === TreeLeafNode === */
+
+// Full leaf of uniform points, with block ID 0 and record ID i in slot i
+TreeLeafNode fullLeaf(GlobalParameters* config, const std::vector<Point>& points) {
+    return TreeLeafNode(config, 0, 0, -1, unitCube(config->dimensions), points, std::vector<int>(points.size(), 0), sequence(points.size()));
+}
+
+void BM_LeafRangeQuery(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    TreeLeafNode leaf = fullLeaf(&config, randomPoints(config.dimensions, config.maxChildren, 1));
+    Region query = centralQuery(config.dimensions);
+    for (auto _ : state) {
+        std::vector<std::pair<int, int>> results = leaf.rangeQuery(query);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_LeafRangeQuery)->Apply(nodeShapes);
+
+// Looks up every point of a full leaf
+void BM_LeafFindPoint(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Point> points = randomPoints(config.dimensions, config.maxChildren, 1);
+    TreeLeafNode leaf = fullLeaf(&config, points);
+    for (auto _ : state) {
+        for (const Point& point : points) {
+            benchmark::DoNotOptimize(leaf.findPoint(point));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_LeafFindPoint)->Apply(nodeShapes);
+
+// Fills an empty leaf (each add also checks for a duplicate point and grows the bounding box)
+void BM_LeafAddPoint(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Point> points = randomPoints(config.dimensions, config.maxChildren, 1);
+    Region box = unitCube(config.dimensions);
+    for (auto _ : state) {
+        state.PauseTiming();
+        TreeLeafNode leaf(&config, 0, 0, -1, box);
+        state.ResumeTiming();
+        for (int i = 0; i < config.maxChildren; ++i) {
+            leaf.addPoint(&config, points[i], 0, i);
+        }
+        benchmark::DoNotOptimize(leaf.getNumChildren());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_LeafAddPoint)->Apply(nodeShapes);
+
+/* === TreeInteriorNode === */
+
+// Fills an empty node with children of small boxes (each add grows the bounding box)
+void BM_InteriorAddChild(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Region> boxes = randomRegions(config.dimensions, config.maxChildren, 0.2, 1);
+    Region box = unitCube(config.dimensions);
+    for (auto _ : state) {
+        state.PauseTiming();
+        TreeInteriorNode node(&config, 0, 1, -1, box);
+        state.ResumeTiming();
+        for (int i = 0; i < config.maxChildren; ++i) {
+            node.addChild(&config, i, boxes[i]);
+        }
+        benchmark::DoNotOptimize(node.getNumChildren());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_InteriorAddChild)->Apply(nodeShapes);
+
+// Empties a full node, removing its children in random order
+void BM_InteriorRemoveChild(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    std::vector<Region> boxes = randomRegions(config.dimensions, config.maxChildren, 0.2, 1);
+    std::vector<int> ids = sequence(config.maxChildren);
+    std::vector<int> order = ids;
+    std::shuffle(order.begin(), order.end(), std::mt19937(2));
+    TreeInteriorNode full(&config, 0, 1, -1, unitCube(config.dimensions));
+    full.addChildren(&config, ids, boxes);
+    for (auto _ : state) {
+        state.PauseTiming();
+        TreeInteriorNode node(full);
+        state.ResumeTiming();
+        for (int id : order) {
+            node.removeChild(id);
+        }
+        benchmark::DoNotOptimize(node.getNumChildren());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_InteriorRemoveChild)->Apply(nodeShapes);
+
+void BM_InteriorRangeQuery(benchmark::State& state) {
+    GlobalParameters config = {static_cast<int>(state.range(1)), static_cast<int>(state.range(0))};
+    TreeInteriorNode node(&config, 0, 1, -1, unitCube(config.dimensions));
+    node.addChildren(&config, sequence(config.maxChildren), randomRegions(config.dimensions, config.maxChildren, 0.2, 1));
+    Region query = centralQuery(config.dimensions);
+    for (auto _ : state) {
+        std::vector<int> results = node.rangeQuery(query);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * config.maxChildren);
+}
+BENCHMARK(BM_InteriorRangeQuery)->Apply(nodeShapes);
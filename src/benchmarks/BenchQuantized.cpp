@@ -0,0 +1,98 @@
+// Range queries over trees whose interior pages hold child boxes as doubles or quantized to 16 or 8 bits,
+// with maxChildren as large as 4096-byte pages allow for each format: height, nodes, tree pages read per
+// query through a small tree pool, query time, and the children visited only because of the rounding
+// (their stored box meets the query, their real box does not).
+// Usage: bench_quantized [numPoints] [treePoolPages]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include "rstartree.h"
+
+// Children whose quantized box meets the query while their own box does not, over the whole descent
+long long falsePositiveVisits(Buffer& buffer, GlobalParameters* config, int nodeID, int level, const Region& query) {
+    if (level == 0) {
+        return 0;
+    }
+    std::vector<std::pair<int, bool>> visits;
+    {
+        PinnedPage page = buffer.pinNode(nodeID);
+        InteriorNodeView interior(config, page.bytes());
+        for (int i = 0; i < interior.getNumChildren(); ++i) {
+            if (interior.childOverlaps(i, query)) {
+                PinnedPage childPage = buffer.pinNode(interior.getChildID(i));
+                Region childBox = level == 1 ? LeafNodeView(config, childPage.bytes()).getBoundingBox()
+                                             : InteriorNodeView(config, childPage.bytes()).getBoundingBox();
+                visits.emplace_back(interior.getChildID(i), childBox.overlaps(query));
+            }
+        }
+    }
+    long long count = 0;
+    for (auto [childID, real] : visits) {
+        count += real ? falsePositiveVisits(buffer, config, childID, level - 1, query) : 1;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    int numPoints = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int treePoolPages = argc > 2 ? std::atoi(argv[2]) : 64;
+    int pageSize = 4096;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_quantized.tree").string();
+    std::string dataFilename = (directory / "bench_quantized.data").string();
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < numPoints; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+    std::vector<int> ids(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        ids[i] = i;
+    }
+    std::vector<Region> queries;
+    for (int i = 0; i < 2000; ++i) {
+        double x = distribution(generator), y = distribution(generator);
+        queries.push_back(Region({x, y}, {x + 0.01, y + 0.01}));
+    }
+
+    printf("%d uniform points, %d-byte pages, tree pool of %d pages\n", numPoints, pageSize, treePoolPages);
+    printf("%10s %12s %8s %10s %14s %12s %14s\n", "box bits", "maxChildren", "height", "nodes", "tree reads/q", "queries (ms)", "false visits/q");
+    for (int bits : {0, 16, 8}) {
+        std::filesystem::remove(treeFilename);
+        std::filesystem::remove(dataFilename);
+        GlobalParameters config = {0, 2, bits};
+        config.maxChildren = BlockFile::maxChildrenFor(&config, pageSize);
+        Buffer buffer(&config, treeFilename, dataFilename, static_cast<long long>(treePoolPages) * pageSize);
+        RStarTree tree(&config, &buffer);
+        tree.bulkLoad(points, ids, ids);
+        buffer.flush();
+        buffer.getTreePool()->discardAll();
+
+        long long results = 0;
+        long long readsBefore = buffer.getTreeFile()->getReads();
+        auto start = std::chrono::steady_clock::now();
+        for (const Region& query : queries) {
+            results += tree.rangeQuery(query).size();
+        }
+        double queryTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        long long reads = buffer.getTreeFile()->getReads() - readsBefore;
+
+        long long falseVisits = 0;
+        for (const Region& query : queries) {
+            falseVisits += falsePositiveVisits(buffer, &config, tree.getRootID(), tree.getHeight() - 1, query);
+        }
+        printf("%10d %12d %8d %10lld %14.2f %12.1f %14.3f\n", bits, config.maxChildren, tree.getHeight(), tree.getNumNodes(),
+            double(reads) / queries.size(), queryTime, double(falseVisits) / queries.size());
+        if (results == 0) {
+            printf("no results\n");
+        }
+    }
+    std::filesystem::remove(treeFilename);
+    std::filesystem::remove(dataFilename);
+    return 0;
+}
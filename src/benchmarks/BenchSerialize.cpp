@@ -0,0 +1,74 @@
+// Node serialization throughput: serialize() into a new vector and copied to a page,
+// against serializeInto() writing directly into the page
+// Usage: bench_serialize [iterations] [maxChildren] [dimensions]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <span>
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+// Time a serialization loop and print nodes/s and MB/s
+void report(const char* name, int iterations, int nodeSize, const std::function<void()>& serializeOnce) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        serializeOnce();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-28s %12.0f nodes/s %10.1f MB/s\n", name, iterations / seconds, double(iterations) * nodeSize / seconds / (1 << 20));
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+    GlobalParameters config;
+    config.maxChildren = argc > 2 ? std::atoi(argv[2]) : 32;
+    config.dimensions = argc > 3 ? std::atoi(argv[3]) : 2;
+
+    // Full nodes, so that every slot holds real data
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> ids;
+    std::vector<Region> boxes;
+    for (int i = 0; i < config.maxChildren; ++i) {
+        std::vector<double> start(config.dimensions), end(config.dimensions);
+        for (int d = 0; d < config.dimensions; ++d) {
+            start[d] = distribution(generator);
+            end[d] = start[d] + distribution(generator);
+        }
+        points.emplace_back(start);
+        ids.push_back(i);
+        boxes.emplace_back(start, end);
+    }
+    std::vector<AbstractBoundedClass*> pointPointers;
+    std::vector<AbstractBoundedClass*> boxPointers;
+    for (int i = 0; i < config.maxChildren; ++i) {
+        pointPointers.push_back(&points[i]);
+        boxPointers.push_back(&boxes[i]);
+    }
+    TreeLeafNode leaf(&config, 1, 0, 2, Region::boundingBox(pointPointers), points, ids, ids);
+    TreeInteriorNode interior(&config, 2, 1, -1, Region::boundingBox(boxPointers), ids, boxes.data());
+
+    int pageSize = std::max(TreeLeafNode::getSerializedSize(&config), TreeInteriorNode::getSerializedSize(&config));
+    std::vector<char> page(pageSize);
+    printf("%d iterations, maxChildren=%d, dimensions=%d\n", iterations, config.maxChildren, config.dimensions);
+
+    const TreeNode* nodes[] = {&leaf, &interior};
+    const char* names[] = {"leaf", "interior"};
+    for (int n = 0; n < 2; ++n) {
+        const TreeNode& node = *nodes[n];
+        int nodeSize = n == 0 ? TreeLeafNode::getSerializedSize(&config) : TreeInteriorNode::getSerializedSize(&config);
+        printf("%s (%d bytes)\n", names[n], nodeSize);
+        report("serialize + copy", iterations, nodeSize, [&]() {
+            std::vector<char> data = node.serialize(&config);
+            std::memcpy(page.data(), data.data(), data.size());
+        });
+        report("serializeInto page", iterations, nodeSize, [&]() {
+            node.serializeInto(&config, std::as_writable_bytes(std::span(page)));
+        });
+    }
+    return 0;
+}
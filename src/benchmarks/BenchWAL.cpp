@@ -0,0 +1,71 @@
+// Durable insert throughput with the write-ahead log, for 1 to maxThreads inserting threads.
+// Every insert returns only once its log record is synced; group commit lets one fdatasync cover the inserts
+// of all threads waiting at that moment, so syncs per insert drop as threads are added.
+// The first row inserts without a log, as the ceiling.
+// Usage: bench_wal [insertsPerThread] [maxThreads] [maxChildren] [directory]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include "rstartree.h"
+
+int main(int argc, char** argv) {
+    int insertsPerThread = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int maxThreads = argc > 2 ? std::atoi(argv[2]) : 64;
+    GlobalParameters config;
+    config.maxChildren = argc > 3 ? std::atoi(argv[3]) : 32;
+    config.dimensions = 2;
+    std::filesystem::path directory = argc > 4 ? std::filesystem::path(argv[4]) : std::filesystem::temp_directory_path();
+    std::string treeFilename = (directory / "bench_wal.tree").string();
+    std::string dataFilename = (directory / "bench_wal.data").string();
+    std::string logFilename = (directory / "bench_wal.log").string();
+
+    printf("%d inserts per thread, maxChildren=%d, files in %s\n", insertsPerThread, config.maxChildren, directory.c_str());
+    printf("%8s %8s %12s %10s %14s\n", "log", "threads", "inserts/s", "syncs", "inserts/sync");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        for (bool logged : {false, true}) {
+            if (!logged && threads > 1) {
+                continue;
+            }
+            for (const std::string& file : {treeFilename, dataFilename, logFilename}) {
+                std::filesystem::remove(file);
+            }
+            Buffer buffer(&config, treeFilename, dataFilename);
+            std::unique_ptr<WriteAheadLog> wal;
+            if (logged) {
+                wal = std::make_unique<WriteAheadLog>(logFilename, buffer.getTreeFile(), buffer.getTreePool());
+            }
+            long long syncsBefore = logged ? wal->getStats().syncs : 0;
+            RStarTree tree(&config, &buffer, wal.get());
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    std::mt19937 generator(t);
+                    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+                    for (int i = 0; i < insertsPerThread; ++i) {
+                        tree.insert(Point({distribution(generator), distribution(generator)}), t, i);
+                    }
+                });
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long long inserts = static_cast<long long>(threads) * insertsPerThread;
+            long long syncs = logged ? wal->getStats().syncs - syncsBefore : 0;
+            printf("%8s %8d %12.0f %10lld %14.1f\n", logged ? "yes" : "no", threads, inserts / elapsed, syncs,
+                syncs > 0 ? double(inserts) / syncs : 0.0);
+        }
+        if (threads < maxThreads && threads * 2 > maxThreads) {
+            threads = maxThreads / 2; // Always end with maxThreads
+        }
+    }
+    for (const std::string& file : {treeFilename, dataFilename, logFilename}) {
+        std::filesystem::remove(file);
+    }
+    return 0;
+}
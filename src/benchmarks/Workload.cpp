@@ -0,0 +1,553 @@
+// Workload driver: bulk loads a generated point set (uniform, Gaussian clusters or Zipf-skewed hotspots), then runs a
+// mix of inserts, deletes, point lookups, range queries and kNN queries against the tree, or replays a recorded trace,
+// and reports throughput and p50/p99/p999 latency per operation (and QueryStats per query with --stats).
+// Usage: rstartree_workload [--option=value ...] (--help for the options)
+//
+// Trace format, one operation per line (blank lines and lines starting with # are skipped), coordinates in order:
+//   load x1 .. xd        a point bulk loaded before the timed run
+//   insert x1 .. xd
+//   delete x1 .. xd
+//   find x1 .. xd
+//   range l1 .. ld h1 .. hd
+//   knn k x1 .. xd
+// A generated workload can be written out as a trace with --record, to replay it later or against another build.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "rstartree.h"
+
+/* === Options === */
+
+struct Options {
+    int points = 100000; // Bulk loaded before the run
+    int dimensions = 2;
+    std::string distribution = "uniform"; // uniform, gaussian or zipf
+    int clusters = 10; // Gaussian clusters, or Zipf hotspots
+    double sigma = 0.02; // Standard deviation of a cluster or hotspot
+    double zipf = 1.0; // Exponent of the Zipf distribution over hotspots
+    int operations = 100000;
+    // Shares of the mix, normalized over their sum
+    double insert = 0.1;
+    double remove = 0.05;
+    double find = 0.05;
+    double range = 0.7;
+    double knn = 0.1;
+    double selectivity = 0.001; // Fraction of the points a range query should return on average
+    int k = 10;
+    std::string storage = "memory"; // memory, or file (through a Buffer with a tree pool of poolPages pages)
+    int maxChildren = 0; // 0 for 32 in memory, or as many as a pageSize page holds in a file
+    int pageSize = 4096;
+    int poolPages = 1024;
+    bool compaction = false; // Background compaction during the run
+    bool stats = false; // Collect QueryStats for the queries
+    unsigned seed = 12345;
+    std::string trace; // Replay this trace instead of generating a workload
+    std::string record; // Write the generated workload to this trace
+};
+
+void printUsage() {
+    Options defaults;
+    printf("Usage: rstartree_workload [--option=value ...]\n"
+        "Data:\n"
+        "  --points=N            points bulk loaded before the run (%d)\n"
+        "  --dims=D              dimensions (%d)\n"
+        "  --distribution=NAME   uniform, gaussian (clusters) or zipf (hotspots chosen by Zipf rank) (%s)\n"
+        "  --clusters=N          clusters or hotspots (%d)\n"
+        "  --sigma=S             standard deviation of a cluster or hotspot (%g)\n"
+        "  --zipf=S              Zipf exponent (%g)\n"
+        "Operations:\n"
+        "  --ops=N               operations in the run (%d)\n"
+        "  --insert=W --delete=W --find=W --range=W --knn=W\n"
+        "                        shares of the mix (%g %g %g %g %g)\n"
+        "  --selectivity=F       average fraction of the points a range query returns (%g)\n"
+        "  --k=K                 neighbors per kNN query (%d)\n"
+        "Tree:\n"
+        "  --storage=NAME        memory, or file through a buffer pool (%s)\n"
+        "  --max-children=N      0 for 32 in memory, or as many as a page holds in a file (%d)\n"
+        "  --page-size=B         page size of the tree file (%d)\n"
+        "  --pool-pages=N        pages of the tree pool (%d)\n"
+        "  --compaction          compact deleted points in the background during the run\n"
+        "  --stats               report QueryStats of the queries\n"
+        "  --seed=N              (%u)\n"
+        "Traces:\n"
+        "  --trace=FILE          replay a trace instead of generating a workload\n"
+        "  --record=FILE         write the generated workload to a trace\n",
+        defaults.points, defaults.dimensions, defaults.distribution.c_str(), defaults.clusters, defaults.sigma, defaults.zipf,
+        defaults.operations, defaults.insert, defaults.remove, defaults.find, defaults.range, defaults.knn, defaults.selectivity,
+        defaults.k, defaults.storage.c_str(), defaults.maxChildren, defaults.pageSize, defaults.poolPages, defaults.seed);
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument.rfind("--", 0) != 0) {
+            throw std::invalid_argument("Unexpected argument " + argument + ".");
+        }
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+        auto number = [&]() {
+            if (value.empty()) {
+                throw std::invalid_argument("--" + name + " needs a value.");
+            }
+            return std::stod(value);
+        };
+
+        std::map<std::string, std::function<void()>> setters = {
+            {"points", [&]() { options.points = number(); }},
+            {"dims", [&]() { options.dimensions = number(); }},
+            {"distribution", [&]() { options.distribution = value; }},
+            {"clusters", [&]() { options.clusters = number(); }},
+            {"sigma", [&]() { options.sigma = number(); }},
+            {"zipf", [&]() { options.zipf = number(); }},
+            {"ops", [&]() { options.operations = number(); }},
+            {"insert", [&]() { options.insert = number(); }},
+            {"delete", [&]() { options.remove = number(); }},
+            {"find", [&]() { options.find = number(); }},
+            {"range", [&]() { options.range = number(); }},
+            {"knn", [&]() { options.knn = number(); }},
+            {"selectivity", [&]() { options.selectivity = number(); }},
+            {"k", [&]() { options.k = number(); }},
+            {"storage", [&]() { options.storage = value; }},
+            {"max-children", [&]() { options.maxChildren = number(); }},
+            {"page-size", [&]() { options.pageSize = number(); }},
+            {"pool-pages", [&]() { options.poolPages = number(); }},
+            {"compaction", [&]() { options.compaction = true; }},
+            {"stats", [&]() { options.stats = true; }},
+            {"seed", [&]() { options.seed = number(); }},
+            {"trace", [&]() { options.trace = value; }},
+            {"record", [&]() { options.record = value; }},
+        };
+        auto setter = setters.find(name);
+        if (setter == setters.end()) {
+            throw std::invalid_argument("Unknown option --" + name + ".");
+        }
+        setter->second();
+    }
+
+    if (options.dimensions < 1 || options.points < 0 || options.operations < 0 || options.clusters < 1 || options.k < 0) {
+        throw std::invalid_argument("--dims and --clusters must be positive, --points, --ops and --k not negative.");
+    }
+    if (options.distribution != "uniform" && options.distribution != "gaussian" && options.distribution != "zipf") {
+        throw std::invalid_argument("--distribution must be uniform, gaussian or zipf.");
+    }
+    if (options.storage != "memory" && options.storage != "file") {
+        throw std::invalid_argument("--storage must be memory or file.");
+    }
+    double shares[] = {options.insert, options.remove, options.find, options.range, options.knn};
+    if (std::any_of(std::begin(shares), std::end(shares), [](double share) { return share < 0; })
+        || options.insert + options.remove + options.find + options.range + options.knn <= 0) {
+        throw std::invalid_argument("Shares of the mix cannot be negative, and at least one must be positive.");
+    }
+    if (options.selectivity <= 0 || options.selectivity > 1) {
+        throw std::invalid_argument("--selectivity must be in (0, 1].");
+    }
+    return options;
+}
+
+/* === Data === */
+
+class PointGenerator {
+    // Points in the unit cube: uniform, around cluster centers chosen uniformly (gaussian),
+    // or around hotspots chosen by Zipf rank, so that a few hotspots take most of the points (zipf).
+    // Clustered points falling outside the unit cube are drawn again.
+private:
+    int dimensions;
+    bool uniform;
+    std::mt19937& generator;
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    std::normal_distribution<double> offset;
+    std::vector<std::vector<double>> centers;
+    std::discrete_distribution<int> pickCenter;
+
+public:
+    PointGenerator(const Options& options, std::mt19937& generator)
+        : dimensions(options.dimensions), uniform(options.distribution == "uniform"), generator(generator), offset(0.0, options.sigma) {
+        if (uniform) {
+            return;
+        }
+        std::vector<double> weights;
+        for (int i = 0; i < options.clusters; ++i) {
+            std::vector<double> center(dimensions);
+            for (double& coord : center) {
+                coord = unit(generator);
+            }
+            centers.push_back(center);
+            weights.push_back(options.distribution == "zipf" ? 1.0 / std::pow(i + 1, options.zipf) : 1.0);
+        }
+        pickCenter = std::discrete_distribution<int>(weights.begin(), weights.end());
+    }
+
+    Point next() {
+        std::vector<double> coords(dimensions);
+        if (uniform) {
+            for (double& coord : coords) {
+                coord = unit(generator);
+            }
+            return Point(coords);
+        }
+        const std::vector<double>& center = centers[pickCenter(generator)];
+        for (int d = 0; d < dimensions; ++d) {
+            do {
+                coords[d] = center[d] + offset(generator);
+            } while (coords[d] < 0.0 || coords[d] > 1.0);
+        }
+        return Point(coords);
+    }
+};
+
+// Side of a cube around a point of the data that holds on average the given fraction of the points,
+// found by bisection over a sample of the points and of query centers
+double calibrateQuerySide(const std::vector<Point>& sample, const std::vector<Point>& centers, double selectivity) {
+    auto averageFraction = [&](double side) {
+        long long inside = 0;
+        for (const Point& center : centers) {
+            for (const Point& point : sample) {
+                bool in = true;
+                for (size_t d = 0; d < point.getCoordinates().size() && in; ++d) {
+                    in = std::abs(point.getCoordinates()[d] - center.getCoordinates()[d]) <= side / 2;
+                }
+                inside += in;
+            }
+        }
+        return double(inside) / (double(sample.size()) * centers.size());
+    };
+    double low = 0.0, high = 2.0;
+    for (int i = 0; i < 30; ++i) {
+        double middle = (low + high) / 2;
+        (averageFraction(middle) < selectivity ? low : high) = middle;
+    }
+    return high;
+}
+
+/* === Operations === */
+
+enum OperationType { LOAD, INSERT, DELETE, FIND, RANGE, KNN, OPERATION_TYPES };
+const char* operationNames[] = {"load", "insert", "delete", "find", "range", "knn"};
+
+struct Operation {
+    OperationType type = INSERT;
+    std::vector<double> coords = {}; // The point, or the low then the high corner of a range query
+    int k = 0;
+};
+
+// The operations of a generated run, with deletes and lookups of points live at that moment of the run
+std::vector<Operation> generateOperations(const Options& options, PointGenerator& points, std::vector<std::vector<double>> live, std::mt19937& generator) {
+    std::vector<Operation> operations;
+    if (options.operations == 0) {
+        return operations;
+    }
+    std::discrete_distribution<int> pickType({options.insert, options.remove, options.find, options.range, options.knn});
+
+    double side = 0.0;
+    if (options.range > 0) {
+        std::vector<Point> sample, centers;
+        for (int i = 0; i < 10000; ++i) {
+            sample.push_back(points.next());
+        }
+        for (int i = 0; i < 200; ++i) {
+            centers.push_back(points.next());
+        }
+        side = calibrateQuerySide(sample, centers, options.selectivity);
+    }
+
+    for (int i = 0; i < options.operations; ++i) {
+        OperationType type = static_cast<OperationType>(INSERT + pickType(generator));
+        if ((type == DELETE || type == FIND) && live.empty()) {
+            type = INSERT;
+        }
+        Operation operation = {type};
+        if (type == INSERT) {
+            operation.coords = points.next().getCoordinates();
+            live.push_back(operation.coords);
+        }
+        else if (type == DELETE || type == FIND) {
+            size_t index = std::uniform_int_distribution<size_t>(0, live.size() - 1)(generator);
+            operation.coords = live[index];
+            if (type == DELETE) {
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        else if (type == RANGE) {
+            // Centered on a point of the data, so that queries follow the data like real ones
+            std::vector<double> center = points.next().getCoordinates();
+            for (double coord : center) {
+                operation.coords.push_back(coord - side / 2);
+            }
+            for (double coord : center) {
+                operation.coords.push_back(coord + side / 2);
+            }
+        }
+        else {
+            operation.coords = points.next().getCoordinates();
+            operation.k = options.k;
+        }
+        operations.push_back(operation);
+    }
+    return operations;
+}
+
+std::vector<Operation> readTrace(const std::string& filename, int dimensions) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Cannot open trace " + filename + ".");
+    }
+    std::vector<Operation> operations;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        auto type = std::find(std::begin(operationNames), std::end(operationNames), name);
+        if (type == std::end(operationNames)) {
+            throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": unknown operation " + name + ".");
+        }
+        Operation operation = {static_cast<OperationType>(type - std::begin(operationNames))};
+        if (operation.type == KNN && !(fields >> operation.k)) {
+            throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": knn needs k.");
+        }
+        for (double value; fields >> value;) {
+            operation.coords.push_back(value);
+        }
+        size_t expected = operation.type == RANGE ? 2 * dimensions : dimensions;
+        if (operation.coords.size() != expected || !fields.eof()) {
+            throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": " + name + " needs " + std::to_string(expected) + " coordinates.");
+        }
+        operations.push_back(operation);
+    }
+    return operations;
+}
+
+void writeTrace(const std::string& filename, const std::vector<Operation>& operations) {
+    std::ofstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Cannot write trace " + filename + ".");
+    }
+    file.precision(17);
+    for (const Operation& operation : operations) {
+        file << operationNames[operation.type];
+        if (operation.type == KNN) {
+            file << ' ' << operation.k;
+        }
+        for (double coord : operation.coords) {
+            file << ' ' << coord;
+        }
+        file << '\n';
+    }
+}
+
+/* === Run === */
+
+// Latencies of one kind of operation, in seconds
+struct Latencies {
+    std::vector<double> samples;
+    long long results = 0;
+    QueryStats stats;
+
+    double percentile(double fraction) const {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    }
+};
+
+// Runs every operation (besides loads) one at a time, timing each
+void runOperations(RStarTree& tree, const std::vector<Operation>& operations, bool collectStats, int& nextID, std::vector<Latencies>& latencies) {
+    for (const Operation& operation : operations) {
+        if (operation.type == LOAD) {
+            continue;
+        }
+        Latencies& latency = latencies[operation.type];
+        QueryStats* stats = collectStats ? &latency.stats : nullptr;
+        long long results = 0;
+        auto start = std::chrono::steady_clock::now();
+        switch (operation.type) {
+            case INSERT:
+                tree.insert(Point(operation.coords), nextID, nextID);
+                nextID++;
+                results = 1;
+                break;
+            case DELETE:
+                results = tree.remove(Point(operation.coords));
+                break;
+            case FIND:
+                results = tree.findPoint(Point(operation.coords), stats).first != -1;
+                break;
+            case RANGE: {
+                size_t dimensions = operation.coords.size() / 2;
+                Region query(std::vector<double>(operation.coords.begin(), operation.coords.begin() + dimensions),
+                    std::vector<double>(operation.coords.begin() + dimensions, operation.coords.end()));
+                results = tree.rangeQuery(query, stats).size();
+                break;
+            }
+            case KNN:
+                results = tree.nearestNeighbors(Point(operation.coords), operation.k, stats).size();
+                break;
+            default:
+                break;
+        }
+        latency.samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        latency.results += results;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (std::string(argv[i]) == "--help") {
+                printUsage();
+                return 0;
+            }
+        }
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception& error) {
+        fprintf(stderr, "%s\n", error.what());
+        printUsage();
+        return 1;
+    }
+
+    try {
+        std::mt19937 generator(options.seed);
+        std::vector<Operation> operations;
+        if (!options.trace.empty()) {
+            operations = readTrace(options.trace, options.dimensions);
+        }
+        else {
+            PointGenerator points(options, generator);
+            std::vector<std::vector<double>> live;
+            for (int i = 0; i < options.points; ++i) {
+                live.push_back(points.next().getCoordinates());
+                operations.push_back({LOAD, live.back()});
+            }
+            std::vector<Operation> run = generateOperations(options, points, live, generator);
+            operations.insert(operations.end(), run.begin(), run.end());
+        }
+        if (!options.record.empty()) {
+            writeTrace(options.record, operations);
+        }
+
+        // The tree
+        GlobalParameters config = {options.maxChildren, options.dimensions};
+        std::unique_ptr<Buffer> buffer;
+        std::filesystem::path directory = std::filesystem::temp_directory_path();
+        std::string treeFilename = (directory / "rstartree_workload.tree").string();
+        std::string dataFilename = (directory / "rstartree_workload.data").string();
+        if (options.storage == "file") {
+            std::filesystem::remove(treeFilename);
+            std::filesystem::remove(dataFilename);
+            if (config.maxChildren == 0) {
+                config.maxChildren = BlockFile::maxChildrenFor(&config, options.pageSize);
+            }
+            buffer = std::make_unique<Buffer>(&config, treeFilename, dataFilename, static_cast<long long>(options.poolPages) * options.pageSize);
+        }
+        else if (config.maxChildren == 0) {
+            config.maxChildren = 32;
+        }
+        RStarTree tree(&config, buffer.get());
+
+        std::vector<Point> loadPoints;
+        for (const Operation& operation : operations) {
+            if (operation.type == LOAD) {
+                loadPoints.push_back(Point(operation.coords));
+            }
+        }
+        std::vector<int> ids(loadPoints.size());
+        for (int i = 0; i < ids.size(); ++i) {
+            ids[i] = i;
+        }
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!loadPoints.empty()) {
+            tree.bulkLoad(loadPoints, ids, ids);
+        }
+        double loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        int nextID = loadPoints.size();
+
+        printf("%s: %zu points loaded, %zu operations, %d dimensions\n", options.trace.empty() ? options.distribution.c_str() : options.trace.c_str(),
+            loadPoints.size(), operations.size() - loadPoints.size(), options.dimensions);
+        printf("Tree: %s, maxChildren %d, height %d, bulk load %.3f s\n", options.storage == "file" ? "file" : "memory",
+            config.maxChildren, tree.getHeight(), loadTime);
+
+        if (options.compaction) {
+            tree.startBackgroundCompaction();
+        }
+        std::vector<Latencies> latencies(OPERATION_TYPES);
+        auto runStart = std::chrono::steady_clock::now();
+        runOperations(tree, operations, options.stats, nextID, latencies);
+        double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+        if (options.compaction) {
+            tree.stopBackgroundCompaction();
+        }
+
+        // Throughput of an operation kind is over the time spent on it, so that the kinds of a mix can be compared
+        printf("\n%8s %10s %12s %12s %12s %12s %12s %12s\n", "op", "count", "ops/s", "mean (us)", "p50 (us)", "p99 (us)", "p999 (us)", "results/op");
+        Latencies all;
+        auto printRow = [](const char* name, Latencies& latency, double time) {
+            std::sort(latency.samples.begin(), latency.samples.end());
+            double total = 0.0;
+            for (double sample : latency.samples) {
+                total += sample;
+            }
+            size_t count = latency.samples.size();
+            printf("%8s %10zu %12.0f %12.2f %12.2f %12.2f %12.2f %12.2f\n", name, count, time > 0 ? count / time : 0.0,
+                count ? total / count * 1e6 : 0.0, latency.percentile(0.5) * 1e6, latency.percentile(0.99) * 1e6,
+                latency.percentile(0.999) * 1e6, count ? double(latency.results) / count : 0.0);
+        };
+        for (int type = INSERT; type < OPERATION_TYPES; ++type) {
+            if (latencies[type].samples.empty()) {
+                continue;
+            }
+            all.samples.insert(all.samples.end(), latencies[type].samples.begin(), latencies[type].samples.end());
+            all.results += latencies[type].results;
+            double time = 0.0;
+            for (double sample : latencies[type].samples) {
+                time += sample;
+            }
+            printRow(operationNames[type], latencies[type], time);
+        }
+        printRow("all", all, runTime);
+
+        if (options.stats) {
+            printf("\n%8s %10s %10s %12s %12s %12s %14s\n", "query", "nodes/q", "leaves/q", "pool hits/q", "misses/q", "KB deser./q", "entry tests/q");
+            for (int type : {FIND, RANGE, KNN}) {
+                const QueryStats& stats = latencies[type].stats;
+                if (stats.queries == 0) {
+                    continue;
+                }
+                double queries = stats.queries;
+                printf("%8s %10.2f %10.2f %12.2f %12.2f %12.2f %14.1f\n", operationNames[type],
+                    (stats.getLeavesVisited() + stats.getInteriorVisited()) / queries, stats.getLeavesVisited() / queries,
+                    stats.poolHits / queries, stats.poolMisses / queries, stats.bytesDeserialized / queries / 1024, stats.overlapTests / queries);
+            }
+        }
+
+        if (buffer) {
+            std::filesystem::remove(treeFilename);
+            std::filesystem::remove(dataFilename);
+        }
+    }
+    catch (const std::exception& error) {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
@@ -4,7 +4,18 @@
  * It helps avoid storing them per each object and unifies the Storable interface.
 */
 
+#ifndef GLOBALPARAMETERS_H
+#define GLOBALPARAMETERS_H
+
 struct GlobalParameters {
     int maxChildren; // Maximum number of children per node
     int dimensions; // Dimensionality of the points
+    // Bits per coordinate of the child boxes stored in interior pages: 8 or 16 to quantize them
+    // relative to the node's box (see QuantizedMBR), 0 to store them as doubles
+    int childBoxBits = 0;
+    // Encoding of leaf pages: LEAF_FORMAT_PLAIN (maxChildren slots of doubles and ints) or LEAF_FORMAT_DELTA
+    // (compressed, see DeltaLeaf), whose leaves hold up to maxChildren points, as many as fit in their page
+    int leafFormat = 0;
 };
+
+#endif // GLOBALPARAMETERS_H
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "blockfile.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+// Fresh path in the temp directory for each test
+std::string tempFile(const std::string& name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / ("rstartree_" + name + ".bin");
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+TEST(BlockFileTest, PageSize) {
+    for (int dimensions = 1; dimensions <= 5; ++dimensions) {
+        for (int maxChildren = 2; maxChildren <= 300; ++maxChildren) {
+            GlobalParameters config = {maxChildren, dimensions};
+            int pageSize = BlockFile::pageSizeFor(&config);
+            EXPECT_EQ(pageSize % BLOCK_ALIGNMENT, 0);
+            EXPECT_GE(pageSize, TreeLeafNode::getSerializedSize(&config));
+            EXPECT_GE(pageSize, TreeInteriorNode::getSerializedSize(&config));
+            EXPECT_LT(pageSize - BLOCK_ALIGNMENT, std::max(TreeLeafNode::getSerializedSize(&config), TreeInteriorNode::getSerializedSize(&config)));
+        }
+    }
+}
+
+TEST(BlockFileTest, MaxChildrenFor) {
+    for (int dimensions = 1; dimensions <= 5; ++dimensions) {
+        for (int bits : {0, 8, 16}) {
+            GlobalParameters config = {0, dimensions, bits, bits == 8 ? LEAF_FORMAT_DELTA : LEAF_FORMAT_PLAIN};
+            config.maxChildren = BlockFile::maxChildrenFor(&config, 4096);
+            EXPECT_EQ(BlockFile::pageSizeFor(&config), 4096);
+            config.maxChildren++;
+            EXPECT_GT(BlockFile::pageSizeFor(&config), 4096);
+        }
+    }
+    // Quantized child boxes make interior nodes smaller
+    GlobalParameters doubles = {64, 2, 0}, quantized = {64, 2, 16};
+    EXPECT_LT(TreeInteriorNode::getSerializedSize(&quantized), TreeInteriorNode::getSerializedSize(&doubles));
+    EXPECT_GT(BlockFile::maxChildrenFor(&quantized, 4096), BlockFile::maxChildrenFor(&doubles, 4096));
+    // Compressed leaves only need room for half of maxChildren of any values
+    GlobalParameters plainLeaves = {0, 2, 16}, deltaLeaves = {0, 2, 16, LEAF_FORMAT_DELTA};
+    EXPECT_GT(BlockFile::maxChildrenFor(&deltaLeaves, 4096), BlockFile::maxChildrenFor(&plainLeaves, 4096) * 3 / 2);
+    GlobalParameters huge = {0, 200};
+    EXPECT_THROW(BlockFile::maxChildrenFor(&huge, 4096), std::invalid_argument);
+}
+
+TEST(BlockFileTest, ReadWriteBlocks) {
+    std::string filename = tempFile("readwrite");
+    GlobalParameters config = {8, 2};
+    BlockFile file(filename, &config);
+
+    EXPECT_EQ(file.getNumBlocks(), 1); // Only the metadata block
+    int first = file.allocateBlock();
+    int second = file.allocateBlock();
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 2);
+
+    std::vector<char> data = {'a', 'b', 'c'};
+    file.writeBlock(second, data);
+    std::vector<char> page = file.readBlock(second);
+    EXPECT_EQ(page.size(), file.getPageSize());
+    EXPECT_EQ(page[0], 'a');
+    EXPECT_EQ(page[2], 'c');
+    EXPECT_EQ(page[3], 0); // Padded
+    EXPECT_EQ(file.readBlock(first), std::vector<char>(file.getPageSize(), 0));
+
+    // Out of range blocks and oversized data
+    EXPECT_THROW(file.readBlock(3), std::out_of_range);
+    EXPECT_THROW(file.writeBlock(first, std::vector<char>(file.getPageSize() + 1, 'x')), std::invalid_argument);
+
+    // A reserved block costs no write and reads as zeros until written
+    long long writes = file.getWrites();
+    int reserved = file.reserveBlock();
+    EXPECT_EQ(reserved, 3);
+    EXPECT_EQ(file.getNumBlocks(), 4);
+    EXPECT_EQ(file.getWrites(), writes);
+    EXPECT_EQ(file.readBlock(reserved), std::vector<char>(file.getPageSize(), 0));
+    file.writeBlock(reserved, data);
+    EXPECT_EQ(file.readBlock(reserved)[1], 'b');
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BlockFileTest, MetadataPersists) {
+    std::string filename = tempFile("metadata");
+    int pageSize;
+    {
+        GlobalParameters config = {50, 3, 16, LEAF_FORMAT_DELTA};
+        BlockFile file(filename, &config);
+        pageSize = file.getPageSize();
+        file.allocateBlock();
+        file.writeBlock(1, std::vector<char>{'x'});
+        file.setRootID(1);
+        file.setHeight(1);
+        file.setCount(123456789012LL);
+    }
+
+    // Reopening loads the parameters, whatever config says
+    GlobalParameters config = {4, 1};
+    BlockFile file(filename, &config);
+    EXPECT_EQ(config.maxChildren, 50);
+    EXPECT_EQ(config.dimensions, 3);
+    EXPECT_EQ(config.childBoxBits, 16);
+    EXPECT_EQ(config.leafFormat, LEAF_FORMAT_DELTA);
+    EXPECT_EQ(file.getPageSize(), pageSize);
+    EXPECT_EQ(file.getNumBlocks(), 2);
+    EXPECT_EQ(file.getRootID(), 1);
+    EXPECT_EQ(file.getHeight(), 1);
+    EXPECT_EQ(file.getCount(), 123456789012LL);
+    EXPECT_EQ(file.readBlock(1)[0], 'x');
+
+    file.truncate();
+    EXPECT_EQ(file.getNumBlocks(), 1);
+    EXPECT_EQ(file.getRootID(), -1);
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BlockFileTest, RejectsForeignFile) {
+    std::string filename = tempFile("foreign");
+    FILE* handle = fopen(filename.c_str(), "w");
+    fputs("definitely not a block file, but long enough to have a header", handle);
+    fclose(handle);
+
+    GlobalParameters config = {8, 2};
+    EXPECT_THROW(BlockFile file(filename, &config), std::runtime_error);
+
+    std::filesystem::remove(filename);
+}
@@ -0,0 +1,818 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <random>
+#include <cmath>
+#include "buffer.h"
+#include "rstartree.h"
+
+// Fresh paths in the temp directory for each test
+std::pair<std::string, std::string> tempFiles(const std::string& name) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string treeFile = (directory / ("rstartree_" + name + "_tree.bin")).string();
+    std::string dataFile = (directory / ("rstartree_" + name + "_data.bin")).string();
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+    return {treeFile, dataFile};
+}
+
+TEST(BufferTest, NodeRoundTrip) {
+    auto [treeFile, dataFile] = tempFiles("nodes");
+    GlobalParameters config = {4, 2};
+    Buffer buffer(&config, treeFile, dataFile);
+
+    int leafID = buffer.allocateNode();
+    TreeLeafNode leaf(&config, leafID, 0, -1, Region({0.1, 0.1}, {0.2, 0.3}), {Point({0.1, 0.1}), Point({0.2, 0.3})}, {1, 2}, {3, 4});
+    buffer.writeNode(leaf);
+
+    int interiorID = buffer.allocateNode();
+    std::vector<Region> boxes = {Region({0.0, 0.0}, {1.0, 1.0}), Region(), Region(), Region()};
+    TreeInteriorNode interior(&config, interiorID, 1, -1, Region({0.0, 0.0}, {1.0, 1.0}), {leafID, -1, -1, -1}, boxes.data());
+    buffer.writeNode(interior);
+
+    buffer.getTreePool()->resetStats();
+    std::shared_ptr<TreeNode> readLeaf = buffer.readNode(leafID);
+    std::shared_ptr<TreeNode> readInterior = buffer.readNode(interiorID);
+    BufferPoolStats stats = buffer.getTreePool()->getStats();
+    EXPECT_EQ(stats.hits + stats.misses, 2); // One page per node
+
+    ASSERT_TRUE(readLeaf->isLeaf());
+    EXPECT_EQ(readLeaf->getNumChildren(), 2);
+    EXPECT_EQ(std::static_pointer_cast<TreeLeafNode>(readLeaf)->getRecordIDs()[1], 4);
+    ASSERT_FALSE(readInterior->isLeaf());
+    EXPECT_EQ(std::static_pointer_cast<TreeInteriorNode>(readInterior)->getChildID(0), leafID);
+
+    // After a flush a fresh buffer reads the same nodes from the file
+    buffer.flush();
+    GlobalParameters reopened = {0, 0};
+    Buffer other(&reopened, treeFile, dataFile);
+    EXPECT_EQ(other.readNode(leafID)->getBoundingBox(), leaf.getBoundingBox());
+    EXPECT_EQ(other.getTreeFile()->getReads() - 1, 1); // The metadata block, then one page
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+TEST(BufferTest, DataBlocks) {
+    auto [treeFile, dataFile] = tempFiles("data");
+    GlobalParameters config = {4, 2};
+    Buffer buffer(&config, treeFile, dataFile);
+
+    int count = buffer.getRecordsPerBlock() * 2 + 3;
+    std::vector<std::pair<int, int>> ids;
+    for (int i = 0; i < count; ++i) {
+        ids.push_back(buffer.addDataPoint(DataPoint({i * 1.0, i * 2.0}, {'n'}, i)));
+    }
+    // Records are packed into consecutive blocks
+    EXPECT_EQ(ids[0], std::make_pair(1, 0));
+    EXPECT_EQ(ids[buffer.getRecordsPerBlock()], std::make_pair(2, 0));
+    EXPECT_EQ(ids.back(), std::make_pair(3, 2));
+    EXPECT_EQ(buffer.readDataBlock(3).size(), 3);
+
+    for (int i = 0; i < count; ++i) {
+        DataPoint dataPoint = buffer.readDataPoint(ids[i].first, ids[i].second);
+        EXPECT_EQ(dataPoint.getID(), i);
+        EXPECT_EQ(dataPoint.getPoint(), Point({i * 1.0, i * 2.0}));
+    }
+    EXPECT_THROW(buffer.readDataPoint(3, 3), std::out_of_range);
+
+    // Each data block is written once, by the pool, plus the metadata block
+    long long writes = buffer.getDataFile()->getWrites();
+    buffer.flush();
+    EXPECT_EQ(buffer.getDataFile()->getWrites() - writes, 4);
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+TEST(BufferTest, TreeSurvivesRestart) {
+    auto [treeFile, dataFile] = tempFiles("restart");
+    std::vector<Point> points;
+    for (int i = 0; i < 500; ++i) {
+        points.push_back(Point({(i * 37 % 500) / 500.0, (i * 91 % 500) / 500.0 + i * 1e-6}));
+    }
+
+    {
+        GlobalParameters config = {6, 2};
+        Buffer buffer(&config, treeFile, dataFile, 8 * BlockFile::pageSizeFor(&config)); // Forces evictions
+        RStarTree tree(&config, &buffer);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+        buffer.flush();
+    }
+
+    GlobalParameters config = {0, 0}; // Loaded from the tree file
+    Buffer buffer(&config, treeFile, dataFile);
+    RStarTree tree(&config, &buffer);
+    EXPECT_EQ(config.maxChildren, 6);
+    EXPECT_EQ(tree.getSize(), points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i, i));
+    }
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), points.size());
+    Region query({0.2, 0.3}, {0.6, 0.7});
+    long long expected = std::count_if(points.begin(), points.end(), [&](const Point& point) { return query.overlaps(point); });
+    EXPECT_EQ(tree.rangeQuery(query).size(), expected);
+    // Queries read pages in place, and leave nothing pinned
+    EXPECT_NO_THROW(buffer.getTreePool()->discardAll());
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// Nodes read from pages by several threads, while others insert through the same pool
+TEST(BufferTest, ConcurrentTree) {
+    auto [treeFile, dataFile] = tempFiles("concurrent");
+    GlobalParameters config = {6, 2};
+    Buffer buffer(&config, treeFile, dataFile, 16 * BlockFile::pageSizeFor(&config));
+    RStarTree tree(&config, &buffer);
+    std::vector<Point> points;
+    for (int i = 0; i < 2000; ++i) {
+        points.push_back(Point({(i * 37 % 2000) / 2000.0, (i * 91 % 2000) / 2000.0 + i * 1e-7}));
+    }
+    for (int i = 0; i < 500; ++i) {
+        tree.insert(points[i], i, i);
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<int> misses(2, 0);
+    for (int w = 0; w < 2; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int i = 500 + w; i < points.size(); i += 2) {
+                tree.insert(points[i], i, i);
+            }
+        });
+        threads.emplace_back([&, w]() {
+            for (int i = 0; i < 500; ++i) {
+                if (tree.findPoint(points[i]) != std::make_pair(i, i)) {
+                    misses[w]++;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(misses, std::vector<int>(2, 0));
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), points.size());
+    EXPECT_NO_THROW(buffer.getTreePool()->discardAll());
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+TEST(BufferTest, BatchRangeQueries) {
+    auto [treeFile, dataFile] = tempFiles("batch");
+    GlobalParameters config = {6, 2};
+    Buffer buffer(&config, treeFile, dataFile, 16 * BlockFile::pageSizeFor(&config));
+    RStarTree tree(&config, &buffer);
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(Point({(i * 37 % 1000) / 1000.0, (i * 91 % 1000) / 1000.0 + i * 1e-7}), i, i);
+    }
+
+    std::vector<Region> queries;
+    for (int i = 0; i < 50; ++i) {
+        double x = i / 60.0;
+        queries.push_back(Region({x, 1.0 - x - 0.2}, {x + 0.2, 1.0 - x}));
+    }
+    WorkStealingPool pool(3);
+    std::vector<std::vector<std::pair<int, int>>> batch = tree.rangeQueries(queries, pool);
+    for (int i = 0; i < queries.size(); ++i) {
+        std::vector<std::pair<int, int>> expected = tree.rangeQuery(queries[i]);
+        std::sort(expected.begin(), expected.end());
+        std::sort(batch[i].begin(), batch[i].end());
+        EXPECT_EQ(batch[i], expected);
+    }
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// Buffered points are found over the pages, and reach the file when the tree is destroyed
+TEST(BufferTest, BufferedInsertion) {
+    auto [treeFile, dataFile] = tempFiles("buffered");
+    std::vector<Point> points;
+    for (int i = 0; i < 2000; ++i) {
+        points.push_back(Point({(i * 37 % 2000) / 2000.0, (i * 91 % 2000) / 2000.0 + i * 1e-7}));
+    }
+    Region query({0.2, 0.3}, {0.6, 0.7});
+    long long expected = std::count_if(points.begin(), points.end(), [&](const Point& point) { return query.overlaps(point); });
+
+    {
+        GlobalParameters config = {6, 2};
+        Buffer buffer(&config, treeFile, dataFile, 8 * BlockFile::pageSizeFor(&config)); // Forces evictions
+        RStarTree tree(&config, &buffer);
+        tree.setInsertBuffering(32);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+        ASSERT_GT(tree.getNumBuffered(), 0);
+        for (int i = 0; i < points.size(); ++i) {
+            EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i, i));
+        }
+        EXPECT_EQ(tree.rangeQuery(query).size(), expected);
+    }
+
+    GlobalParameters config = {0, 0};
+    Buffer buffer(&config, treeFile, dataFile);
+    RStarTree tree(&config, &buffer);
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), points.size());
+    EXPECT_EQ(tree.rangeQuery(query).size(), expected);
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// Tombstones are stored in the pages: deleted points stay deleted after a restart, and compact finds them there
+TEST(BufferTest, DeleteAndCompact) {
+    auto [treeFile, dataFile] = tempFiles("delete");
+    std::vector<Point> points;
+    for (int i = 0; i < 2000; ++i) {
+        points.push_back(Point({(i * 37 % 2000) / 2000.0, (i * 91 % 2000) / 2000.0 + i * 1e-7}));
+    }
+    long long nodesBefore;
+    {
+        GlobalParameters config = {6, 2};
+        Buffer buffer(&config, treeFile, dataFile, 8 * BlockFile::pageSizeFor(&config)); // Forces evictions
+        RStarTree tree(&config, &buffer);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+        nodesBefore = tree.getNumNodes();
+        for (int i = 0; i < points.size(); i += 2) {
+            EXPECT_TRUE(tree.remove(points[i]));
+        }
+        EXPECT_EQ(tree.getNumDeleted(), points.size() / 2);
+    }
+
+    GlobalParameters config = {0, 0};
+    Buffer buffer(&config, treeFile, dataFile);
+    RStarTree tree(&config, &buffer);
+    EXPECT_EQ(tree.getSize(), points.size() / 2);
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), points.size() / 2);
+    EXPECT_EQ(tree.findPoint(points[0]), std::make_pair(-1, -1));
+    EXPECT_EQ(tree.findPoint(points[1]), std::make_pair(1, 1));
+    tree.compact();
+    EXPECT_LT(tree.getNumNodes(), nodesBefore);
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), points.size() / 2);
+    for (int i = 1; i < points.size(); i += 2) {
+        EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i, i));
+    }
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// Trees whose interior pages hold quantized child boxes answer like a tree of doubles
+TEST(BufferTest, QuantizedChildBoxes) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < 3000; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+    std::vector<Region> queries;
+    for (int i = 0; i < 50; ++i) {
+        double x = distribution(generator), y = distribution(generator);
+        queries.push_back(Region({x, y}, {x + 0.05, y + 0.03}));
+    }
+    GlobalParameters plainConfig = {8, 2};
+    RStarTree plain(&plainConfig);
+    for (int i = 0; i < points.size(); ++i) {
+        plain.insert(points[i], i, i);
+    }
+    for (int i = 0; i < points.size(); i += 3) {
+        plain.remove(points[i]);
+    }
+    auto sorted = [](std::vector<std::pair<int, int>> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    for (int bits : {8, 16}) {
+        auto [treeFile, dataFile] = tempFiles("quantized" + std::to_string(bits));
+        {
+            GlobalParameters config = {8, 2, bits};
+            Buffer buffer(&config, treeFile, dataFile, 8 * BlockFile::pageSizeFor(&config)); // Forces evictions
+            RStarTree tree(&config, &buffer);
+            for (int i = 0; i < points.size(); ++i) {
+                tree.insert(points[i], i, i);
+            }
+            for (int i = 0; i < points.size(); i += 3) {
+                EXPECT_TRUE(tree.remove(points[i]));
+            }
+            tree.compact();
+            buffer.flush();
+        }
+
+        GlobalParameters config = {0, 0};
+        Buffer buffer(&config, treeFile, dataFile);
+        RStarTree tree(&config, &buffer);
+        EXPECT_EQ(config.childBoxBits, bits);
+        EXPECT_EQ(tree.getSize(), plain.getSize());
+        for (const Region& query : queries) {
+            EXPECT_EQ(sorted(tree.rangeQuery(query)), sorted(plain.rangeQuery(query)));
+        }
+        for (int i = 0; i < 200; ++i) {
+            EXPECT_EQ(tree.findPoint(points[i]), plain.findPoint(points[i]));
+        }
+        for (int i = 0; i < 20; ++i) {
+            std::vector<std::tuple<int, int, double>> found = tree.nearestNeighbors(points[i], 10);
+            std::vector<std::tuple<int, int, double>> expected = plain.nearestNeighbors(points[i], 10);
+            ASSERT_EQ(found.size(), expected.size());
+            for (int j = 0; j < found.size(); ++j) {
+                EXPECT_DOUBLE_EQ(std::get<2>(found[j]), std::get<2>(expected[j]));
+            }
+        }
+
+        std::filesystem::remove(treeFile);
+        std::filesystem::remove(dataFile);
+    }
+
+    GlobalParameters config = {8, 2, 4};
+    EXPECT_THROW(RStarTree tree(&config), std::invalid_argument);
+}
+
+// Compressed leaves give the same answers as plain ones, and every leaf fits its page, however it was built
+// Quantized boxes are rounded outward, so nearest neighbors must not trust their MINMAXDIST
+TEST(BufferTest, QuantizedNearestNeighbors) {
+    std::mt19937 generator(17);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::normal_distribution<double> spread(0.0, 0.002);
+    std::vector<Point> points, centers;
+    for (int i = 0; i < 200; ++i) {
+        Point center({distribution(generator), distribution(generator)});
+        centers.push_back(center);
+        for (int j = 0; j < 20; ++j) {
+            points.push_back(Point({center.getCoordinates()[0] + spread(generator), center.getCoordinates()[1] + spread(generator)}));
+        }
+    }
+    for (int i = 0; i < 3000; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+    }
+
+    for (int bits : {8, 16}) {
+        auto [treeFile, dataFile] = tempFiles("quantized_knn" + std::to_string(bits));
+        {
+            GlobalParameters config = {8, 2, bits};
+            Buffer buffer(&config, treeFile, dataFile);
+            RStarTree tree(&config, &buffer);
+            for (int i = 0; i < points.size(); ++i) {
+                tree.insert(points[i], i, i);
+            }
+            // Just off the clusters along one axis, where the rounded near face is closest to the query
+            for (int i = 0; i < centers.size(); ++i) {
+                Point query({centers[i].getCoordinates()[0] + 0.01, centers[i].getCoordinates()[1]});
+                std::vector<double> expected;
+                for (const Point& point : points) {
+                    expected.push_back(std::sqrt(query.squaredDistance(point)));
+                }
+                std::sort(expected.begin(), expected.end());
+                std::vector<std::tuple<int, int, double>> found = tree.nearestNeighbors(query, 5);
+                ASSERT_EQ(found.size(), 5);
+                for (int j = 0; j < 5; ++j) {
+                    EXPECT_DOUBLE_EQ(std::get<2>(found[j]), expected[j]);
+                }
+            }
+        }
+        std::filesystem::remove(treeFile);
+        std::filesystem::remove(dataFile);
+    }
+}
+
+TEST(BufferTest, DeltaLeaves) {
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> ids;
+    for (int i = 0; i < 12000; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+        ids.push_back(i);
+    }
+    std::vector<Region> queries;
+    for (int i = 0; i < 50; ++i) {
+        double x = distribution(generator), y = distribution(generator);
+        queries.push_back(Region({x, y}, {x + 0.1, y + 0.05}));
+    }
+    GlobalParameters plainConfig = {8, 2};
+    RStarTree plain(&plainConfig);
+    for (int i = 0; i < points.size(); ++i) {
+        plain.insert(points[i], i, i);
+    }
+    for (int i = 0; i < points.size(); i += 3) {
+        plain.remove(points[i]);
+    }
+    auto sorted = [](std::vector<std::pair<int, int>> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    GlobalParameters pagePlain = {0, 2, 16};
+    int plainMaxChildren = BlockFile::maxChildrenFor(&pagePlain, 4096);
+    GlobalParameters deltaConfig = {0, 2, 16, LEAF_FORMAT_DELTA};
+    deltaConfig.maxChildren = BlockFile::maxChildrenFor(&deltaConfig, 4096);
+    // Returns the largest number of points in a leaf
+    auto checkLeaves = [&](const RStarTree& tree, GlobalParameters* config) {
+        int largest = 0;
+        std::vector<int> stack = {tree.getRootID()};
+        while (!stack.empty()) {
+            auto node = tree.readNode(stack.back());
+            stack.pop_back();
+            if (node->getID() != tree.getRootID()) {
+                EXPECT_GE(node->getNumChildren(), tree.getMinChildren(node->getLevel()));
+            }
+            EXPECT_LE(node->getNumChildren(), config->maxChildren);
+            if (node->isLeaf()) {
+                EXPECT_LE(std::static_pointer_cast<TreeLeafNode>(node)->getEncodedSize(config), 4096);
+                largest = std::max(largest, node->getNumChildren());
+                continue;
+            }
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                stack.push_back(interior->getChildID(i));
+            }
+        }
+        return largest;
+    };
+
+    auto [treeFile, dataFile] = tempFiles("delta");
+    {
+        GlobalParameters config = deltaConfig;
+        Buffer buffer(&config, treeFile, dataFile, 8 * 4096); // Forces evictions
+        RStarTree tree(&config, &buffer);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+        EXPECT_GT(checkLeaves(tree, &config), plainMaxChildren);
+        for (int i = 0; i < points.size(); i += 3) {
+            EXPECT_TRUE(tree.remove(points[i]));
+        }
+        tree.compact();
+        checkLeaves(tree, &config);
+        buffer.flush();
+    }
+    {
+        GlobalParameters config = {0, 0};
+        Buffer buffer(&config, treeFile, dataFile);
+        RStarTree tree(&config, &buffer);
+        EXPECT_EQ(config.leafFormat, LEAF_FORMAT_DELTA);
+        EXPECT_EQ(tree.getSize(), plain.getSize());
+        for (const Region& query : queries) {
+            EXPECT_EQ(sorted(tree.rangeQuery(query)), sorted(plain.rangeQuery(query)));
+        }
+        for (int i = 0; i < 300; ++i) {
+            EXPECT_EQ(tree.findPoint(points[i]), plain.findPoint(points[i]));
+        }
+        for (int i = 0; i < 20; ++i) {
+            std::vector<std::tuple<int, int, double>> found = tree.nearestNeighbors(points[i], 10);
+            std::vector<std::tuple<int, int, double>> expected = plain.nearestNeighbors(points[i], 10);
+            ASSERT_EQ(found.size(), expected.size());
+            for (int j = 0; j < found.size(); ++j) {
+                EXPECT_EQ(std::get<2>(found[j]), std::get<2>(expected[j]));
+            }
+        }
+    }
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+
+    // Bulk loads cut leaves where the page fills up
+    std::vector<Point> live;
+    std::vector<int> liveIDs;
+    for (int i = 0; i < points.size(); ++i) {
+        if (i % 3 != 0) {
+            live.push_back(points[i]);
+            liveIDs.push_back(i);
+        }
+    }
+    GlobalParameters memoryConfig = deltaConfig;
+    RStarTree packed(&memoryConfig);
+    packed.bulkLoad(live, liveIDs, liveIDs);
+    EXPECT_GT(checkLeaves(packed, &memoryConfig), plainMaxChildren);
+    for (const Region& query : queries) {
+        EXPECT_EQ(sorted(packed.rangeQuery(query)), sorted(plain.rangeQuery(query)));
+    }
+
+    {
+        GlobalParameters config = deltaConfig;
+        Buffer buffer(&config, treeFile, dataFile);
+        for (int i = 0; i < live.size(); ++i) {
+            buffer.addDataPoint(DataPoint(live[i], {}, liveIDs[i]));
+        }
+        RStarTree tree(&config, &buffer);
+        WorkStealingPool pool(2);
+        EXPECT_EQ(tree.bulkLoadDataFile(pool, 64 << 10), live.size());
+        checkLeaves(tree, &config);
+        EXPECT_EQ(tree.clusterDataFile(pool, 64 << 10), live.size());
+        checkLeaves(tree, &config);
+        for (const Region& query : queries) {
+            std::vector<int> found;
+            for (auto [blockID, recordID] : tree.rangeQuery(query)) {
+                found.push_back(buffer.readDataPoint(blockID, recordID).getID());
+            }
+            std::sort(found.begin(), found.end());
+            std::vector<int> expected;
+            for (auto [blockID, recordID] : plain.rangeQuery(query)) {
+                expected.push_back(blockID);
+            }
+            std::sort(expected.begin(), expected.end());
+            EXPECT_EQ(found, expected);
+        }
+    }
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+
+    GlobalParameters config = {8, 2, 0, 2};
+    EXPECT_THROW(RStarTree tree(&config), std::invalid_argument);
+}
+
+TEST(BufferTest, BulkLoadDataFile) {
+    GlobalParameters config = {8, 2};
+    std::vector<DataPoint> dataPoints;
+    std::vector<Point> points;
+    std::vector<int> blockIDs, recordIDs;
+    auto [treeFile, dataFile] = tempFiles("external");
+    {
+        Buffer buffer(&config, treeFile, dataFile);
+        for (int i = 0; i < 5000; ++i) {
+            Point point({(i * 7919 % 5000) / 5000.0, (i * 104729 % 4999) / 4999.0});
+            auto [blockID, recordID] = buffer.addDataPoint(DataPoint(point, {}, i));
+            points.push_back(point);
+            blockIDs.push_back(blockID);
+            recordIDs.push_back(recordID);
+        }
+        RStarTree tree(&config, &buffer);
+        WorkStealingPool pool(2);
+        // 64 KB: the leaf level is sorted in many runs
+        EXPECT_EQ(tree.bulkLoadDataFile(pool, 64 << 10, 0.7), points.size());
+        EXPECT_THROW(tree.bulkLoadDataFile(pool), std::logic_error);
+        buffer.flush();
+    }
+
+    // Same shape as the in-memory packing of the same points
+    GlobalParameters memoryConfig = config;
+    RStarTree packed(&memoryConfig);
+    packed.bulkLoad(points, blockIDs, recordIDs, 0.7);
+
+    Buffer buffer(&config, treeFile, dataFile);
+    RStarTree tree(&config, &buffer);
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_EQ(tree.getHeight(), packed.getHeight());
+    EXPECT_EQ(tree.getNumNodes(), packed.getNumNodes());
+    for (int i = 0; i < points.size(); i += 7) {
+        EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(blockIDs[i], recordIDs[i]));
+    }
+    Region query({0.2, 0.3}, {0.6, 0.5});
+    std::vector<std::pair<int, int>> found = tree.rangeQuery(query);
+    std::vector<std::pair<int, int>> expected = packed.rangeQuery(query);
+    std::sort(found.begin(), found.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(found, expected);
+
+    // Every node is within its parent's box, and the tree takes inserts afterwards
+    std::vector<int> stack = {tree.getRootID()};
+    while (!stack.empty()) {
+        auto node = tree.readNode(stack.back());
+        stack.pop_back();
+        if (node->getID() != tree.getRootID()) {
+            EXPECT_GE(node->getNumChildren(), tree.getMinChildren());
+        }
+        if (!node->isLeaf()) {
+            auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+            for (int i = 0; i < interior->getNumChildren(); ++i) {
+                auto child = tree.readNode(interior->getChildID(i));
+                EXPECT_EQ(child->getParentID(), node->getID());
+                EXPECT_EQ(child->getLevel(), node->getLevel() - 1);
+                stack.push_back(child->getID());
+            }
+        }
+    }
+    tree.insert(Point({2.0, 2.0}), 1, 1);
+    EXPECT_EQ(tree.findPoint(Point({2.0, 2.0})), std::make_pair(1, 1));
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// The data file is rewritten in Hilbert order, every record reported at its new place
+TEST(BufferTest, ClusterDataFile) {
+    GlobalParameters config = {8, 2};
+    auto [treeFile, dataFile] = tempFiles("cluster");
+    Buffer buffer(&config, treeFile, dataFile);
+    std::vector<Point> points;
+    for (int i = 0; i < 3000; ++i) {
+        points.push_back(Point({(i * 7919 % 3000) / 3000.0, (i * 104729 % 2999) / 2999.0}));
+        buffer.addDataPoint(DataPoint(points.back(), {char('a' + i % 26)}, i));
+    }
+    int numBlocks = buffer.getDataFile()->getNumBlocks();
+
+    WorkStealingPool pool(2);
+    std::vector<std::pair<int, int>> moved(points.size(), {-1, -1});
+    long long records = buffer.clusterDataFile(pool, 32 << 10, "", [&](int oldBlockID, int oldRecordID, int blockID, int recordID) {
+        int i = (oldBlockID - 1) * buffer.getRecordsPerBlock() + oldRecordID; // Appended in order
+        EXPECT_EQ(moved[i], std::make_pair(-1, -1));
+        moved[i] = {blockID, recordID};
+    });
+    EXPECT_EQ(records, points.size());
+    EXPECT_EQ(buffer.getDataFile()->getNumBlocks(), numBlocks);
+    EXPECT_EQ(buffer.getDataFile()->getCount(), points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        DataPoint dataPoint = buffer.readDataPoint(moved[i].first, moved[i].second);
+        EXPECT_EQ(dataPoint.getID(), i);
+        EXPECT_EQ(dataPoint.getPoint(), points[i]);
+        EXPECT_EQ(dataPoint.getData()[0], 'a' + i % 26);
+    }
+
+    // In file order, the keys never go down
+    std::vector<Point> inFileOrder;
+    for (int blockID = 1; blockID < numBlocks; ++blockID) {
+        for (const DataPoint& dataPoint : buffer.readDataBlock(blockID)) {
+            inFileOrder.push_back(dataPoint.getPoint());
+        }
+    }
+    std::vector<double> low = {1.0, 1.0}, high = {0.0, 0.0};
+    for (const Point& point : points) {
+        for (int d = 0; d < 2; ++d) {
+            low[d] = std::min(low[d], point.getCoordinates()[d]);
+            high[d] = std::max(high[d], point.getCoordinates()[d]);
+        }
+    }
+    HilbertCurve dataCurve(Region(low, high));
+    for (int i = 1; i < inFileOrder.size(); ++i) {
+        EXPECT_LE(dataCurve.key(inFileOrder[i - 1]), dataCurve.key(inFileOrder[i]));
+    }
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// The tree keeps only the records of its live points, in Hilbert order, and its leaves follow them
+TEST(BufferTest, TreeClusterDataFile) {
+    GlobalParameters config = {6, 2};
+    auto [treeFile, dataFile] = tempFiles("tree_cluster");
+    std::vector<Point> points;
+    {
+        Buffer buffer(&config, treeFile, dataFile, 8 * BlockFile::pageSizeFor(&config));
+        RStarTree tree(&config, &buffer);
+        WorkStealingPool pool(2);
+        EXPECT_EQ(tree.clusterDataFile(pool), 0);
+        tree.setInsertBuffering(16);
+        for (int i = 0; i < 2000; ++i) {
+            points.push_back(Point({(i * 37 % 2000) / 2000.0, (i * 91 % 2000) / 2000.0 + i * 1e-7}));
+            auto [blockID, recordID] = buffer.addDataPoint(DataPoint(points.back(), {}, i));
+            tree.insert(points.back(), blockID, recordID);
+        }
+        for (int i = 0; i < points.size(); i += 4) {
+            EXPECT_TRUE(tree.remove(points[i]));
+        }
+        EXPECT_EQ(tree.clusterDataFile(pool, 16 << 10), points.size() * 3 / 4);
+        EXPECT_EQ(buffer.getDataFile()->getCount(), points.size() * 3 / 4);
+        EXPECT_EQ(tree.getNumBuffered(), 0);
+    }
+
+    GlobalParameters reopened = {0, 0};
+    Buffer buffer(&reopened, treeFile, dataFile);
+    RStarTree tree(&reopened, &buffer);
+    for (int i = 0; i < points.size(); ++i) {
+        auto [blockID, recordID] = tree.findPoint(points[i]);
+        if (i % 4 == 0) {
+            EXPECT_EQ(blockID, -1);
+            continue;
+        }
+        DataPoint dataPoint = buffer.readDataPoint(blockID, recordID);
+        EXPECT_EQ(dataPoint.getID(), i);
+        EXPECT_EQ(dataPoint.getPoint(), points[i]);
+    }
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+TEST(BufferTest, ParseOSMFile) {
+    auto [treeFile, dataFile] = tempFiles("osm");
+    std::string osmFile = (std::filesystem::temp_directory_path() / "rstartree_test.osm").string();
+    FILE* handle = fopen(osmFile.c_str(), "w");
+    fputs("<?xml version='1.0' encoding='UTF-8'?>\n"
+          "<osm version=\"0.6\" generator=\"test\">\n"
+          " <bounds minlat=\"40.0\" minlon=\"22.0\" maxlat=\"41.0\" maxlon=\"23.0\"/>\n", handle);
+    for (int i = 0; i < 300; ++i) {
+        // Alternate attribute order, quoting and child tags
+        if (i % 2 == 0) {
+            fprintf(handle, " <node id=\"%d\" visible=\"true\" version=\"1\" user=\"a > b\" lat=\"%.7f\" lon=\"%.7f\"/>\n", 1000 + i, 40.0 + i * 1e-3, 22.0 + i * 2e-3);
+        }
+        else {
+            fprintf(handle, " <node lon='%.7f' lat='%.7f' id='%d'>\n  <tag k=\"name\" v=\"Node %d\"/>\n </node>\n", 22.0 + i * 2e-3, 40.0 + i * 1e-3, 1000 + i, i);
+        }
+    }
+    fputs(" <node id=\"5\" visible=\"false\"/>\n" // No coordinates
+          " <way id=\"1\">\n  <nd ref=\"1000\"/>\n  <nd ref=\"1001\"/>\n </way>\n"
+          "</osm>\n", handle);
+    fclose(handle);
+
+    GlobalParameters config = {4, 2};
+    Buffer buffer(&config, treeFile, dataFile);
+    buffer.addDataPoint(DataPoint({1.0, 1.0}, {}, 1)); // Deleted by the load
+
+    // Small chunks cut tags at every possible position
+    for (size_t chunkSize : {8, 13, 64, 4096}) {
+        std::vector<std::pair<int, int>> ids;
+        std::vector<long long> osmIDs;
+        long long loaded = buffer.parseOSMFile(osmFile, [&](const DataPoint& dataPoint, int blockID, int recordID) {
+            ids.emplace_back(blockID, recordID);
+            osmIDs.push_back(dataPoint.getID());
+        }, chunkSize);
+
+        ASSERT_EQ(loaded, 300);
+        ASSERT_EQ(ids.size(), 300);
+        EXPECT_EQ(buffer.getDataFile()->getCount(), 300);
+        for (int i = 0; i < 300; ++i) {
+            EXPECT_EQ(osmIDs[i], 1000 + i);
+            DataPoint dataPoint = buffer.readDataPoint(ids[i].first, ids[i].second);
+            EXPECT_EQ(dataPoint.getID(), 1000 + i);
+            EXPECT_NEAR(dataPoint.getPoint().getCoordinates()[0], 40.0 + i * 1e-3, 1e-9);
+            EXPECT_NEAR(dataPoint.getPoint().getCoordinates()[1], 22.0 + i * 2e-3, 1e-9);
+        }
+        EXPECT_EQ(ids[0], std::make_pair(1, 0)); // Previous data is gone
+    }
+
+    EXPECT_THROW(buffer.parseOSMFile(osmFile + ".missing"), std::runtime_error);
+
+    std::filesystem::remove(osmFile);
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
+
+// Queries over a tree in a buffer count the tree pages they pin, and which of them were already in the pool
+TEST(BufferTest, QueryStats) {
+    auto [treeFile, dataFile] = tempFiles("querystats");
+    GlobalParameters config = {8, 2};
+    Buffer buffer(&config, treeFile, dataFile);
+    RStarTree tree(&config, &buffer);
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    std::vector<int> ids;
+    for (int i = 0; i < 2000; ++i) {
+        points.push_back(Point({distribution(generator), distribution(generator)}));
+        ids.push_back(i);
+    }
+    tree.bulkLoad(points, ids, ids);
+    buffer.flush();
+    buffer.getTreePool()->discardAll();
+    buffer.getTreePool()->resetStats();
+
+    // Cold, then warm
+    QueryStats cold, warm;
+    Region everything({0.0, 0.0}, {1.0, 1.0});
+    tree.rangeQuery(everything, &cold);
+    tree.rangeQuery(everything, &warm);
+    EXPECT_EQ(cold.results, points.size());
+    EXPECT_EQ(cold.poolMisses, tree.getNumNodes());
+    EXPECT_EQ(cold.poolHits, 0);
+    EXPECT_EQ(warm.poolHits, tree.getNumNodes());
+    EXPECT_EQ(warm.poolMisses, 0);
+    BufferPoolStats poolStats = buffer.getTreePool()->getStats();
+    EXPECT_EQ(poolStats.misses, cold.poolMisses);
+    EXPECT_EQ(poolStats.hits, warm.poolHits);
+
+    // Read in place, every entry of every node
+    long long decoded = 0;
+    for (int nodeID = 1; nodeID < buffer.getTreeFile()->getNumBlocks(); ++nodeID) {
+        bool leaf = tree.readNode(nodeID)->isLeaf();
+        PinnedPage page = buffer.pinNode(nodeID);
+        if (leaf) {
+            LeafNodeView view(&config, page.bytes());
+            decoded += view.getDecodedSize(view.getNumChildren());
+        }
+        else {
+            InteriorNodeView view(&config, page.bytes());
+            decoded += view.getDecodedSize(view.getNumChildren());
+        }
+    }
+    EXPECT_EQ(cold.bytesDeserialized, decoded);
+    EXPECT_EQ(warm.bytesDeserialized, decoded);
+    EXPECT_LT(decoded, tree.getNumNodes() * buffer.getTreeFile()->getPageSize());
+
+    QueryStats lookups;
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_EQ(tree.findPoint(points[i], &lookups).first, i);
+    }
+    EXPECT_EQ(lookups.results, 50);
+    EXPECT_EQ(lookups.poolHits + lookups.poolMisses, lookups.getLeavesVisited() + lookups.getInteriorVisited());
+    EXPECT_GT(lookups.bytesDeserialized, 0);
+    EXPECT_LT(lookups.bytesDeserialized, (lookups.getLeavesVisited() + lookups.getInteriorVisited()) * buffer.getTreeFile()->getPageSize());
+
+    // Nearest neighbors deserialize every node they visit
+    QueryStats nearest;
+    EXPECT_EQ(tree.nearestNeighbors(points[5], 10, &nearest).size(), 10);
+    long long visits = nearest.getLeavesVisited() + nearest.getInteriorVisited();
+    EXPECT_EQ(nearest.poolHits + nearest.poolMisses, visits);
+    EXPECT_EQ(nearest.bytesDeserialized, visits * buffer.getTreeFile()->getPageSize());
+
+    std::filesystem::remove(treeFile);
+    std::filesystem::remove(dataFile);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <atomic>
+#include <thread>
+#include "bufferpool.h"
+
+// Block file with the given number of data blocks, block i starting with the character 'a' + i
+std::string createTestFile(const std::string& name, int blocks) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / ("rstartree_" + name + ".bin");
+    std::filesystem::remove(path);
+    GlobalParameters config = {4, 2};
+    BlockFile file(path.string(), &config, BLOCK_ALIGNMENT);
+    for (int i = 0; i < blocks; ++i) {
+        int blockID = file.allocateBlock();
+        file.writeBlock(blockID, std::vector<char>{static_cast<char>('a' + blockID)});
+    }
+    return path.string();
+}
+
+TEST(BufferPoolTest, Budget) {
+    std::string filename = createTestFile("pool_budget", 1);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+
+    EXPECT_THROW(BufferPool pool(&file, BLOCK_ALIGNMENT - 1), std::invalid_argument);
+    BufferPool pool(&file, 3 * BLOCK_ALIGNMENT + 100);
+    EXPECT_EQ(pool.getNumFrames(), 3);
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BufferPoolTest, HitsAndMisses) {
+    std::string filename = createTestFile("pool_hits", 4);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+    BufferPool pool(&file, 4 * BLOCK_ALIGNMENT);
+
+    for (int round = 0; round < 3; ++round) {
+        for (int blockID = 1; blockID <= 4; ++blockID) {
+            char* page = pool.pin(blockID);
+            EXPECT_EQ(page[0], 'a' + blockID);
+            pool.unpin(blockID, false);
+        }
+    }
+    BufferPoolStats stats = pool.getStats();
+    EXPECT_EQ(stats.misses, 4); // The working set fits
+    EXPECT_EQ(stats.hits, 8);
+    EXPECT_EQ(stats.evictions, 0);
+
+    pool.resetStats();
+    EXPECT_EQ(pool.getStats().hits, 0);
+    EXPECT_THROW(pool.unpin(1, false), std::logic_error); // Not pinned anymore
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BufferPoolTest, EvictionAndWriteBack) {
+    std::string filename = createTestFile("pool_evict", 4);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+    {
+        BufferPool pool(&file, 2 * BLOCK_ALIGNMENT);
+
+        // Dirty every page, which only fit two at a time
+        for (int blockID = 1; blockID <= 4; ++blockID) {
+            char* page = pool.pin(blockID);
+            page[1] = 'X';
+            pool.unpin(blockID, true);
+        }
+        BufferPoolStats stats = pool.getStats();
+        EXPECT_EQ(stats.misses, 4);
+        EXPECT_EQ(stats.evictions, 2);
+        EXPECT_EQ(stats.writebacks, 2);
+
+        // Evicted pages come back with their changes
+        char* page = pool.pin(1);
+        EXPECT_EQ(page[0], 'b');
+        EXPECT_EQ(page[1], 'X');
+        pool.unpin(1, false);
+    }
+    // The rest are written back when the pool is destroyed
+    for (int blockID = 1; blockID <= 4; ++blockID) {
+        EXPECT_EQ(file.readBlock(blockID)[1], 'X');
+    }
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BufferPoolTest, WriteBackHook) {
+    std::string filename = createTestFile("pool_hook", 3);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+    BufferPool pool(&file, 2 * BLOCK_ALIGNMENT);
+
+    // The hook runs without the pool's mutex, before the page reaches the file, and the page can still be pinned
+    std::vector<std::pair<int, char>> seen;
+    pool.setWriteBackHook([&](int blockID) {
+        char* page = pool.pin(blockID);
+        seen.push_back({blockID, file.readBlock(blockID)[1]});
+        EXPECT_EQ(page[1], 'X');
+        pool.unpin(blockID, false);
+    });
+    for (int blockID = 1; blockID <= 3; ++blockID) {
+        char* page = pool.pin(blockID);
+        page[1] = 'X';
+        pool.unpin(blockID, true);
+    }
+    pool.flushAll();
+    std::sort(seen.begin(), seen.end());
+    EXPECT_EQ(seen, (std::vector<std::pair<int, char>>{{1, 0}, {2, 0}, {3, 0}}));
+    EXPECT_EQ(pool.getStats().writebacks, 3);
+    EXPECT_EQ(file.readBlock(1)[1], 'X');
+
+    pool.setWriteBackHook(nullptr);
+    std::filesystem::remove(filename);
+}
+
+// Misses read without the mutex: threads pinning the same pages all see them loaded, and failed reads free the frame
+TEST(BufferPoolTest, ConcurrentPins) {
+    std::string filename = createTestFile("pool_concurrent", 12);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+    BufferPool pool(&file, 6 * BLOCK_ALIGNMENT);
+
+    std::atomic<int> wrong = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, &wrong, t]() {
+            for (int i = 0; i < 2000; ++i) {
+                int blockID = 1 + (i * 7 + t * 3) % 12;
+                char* page = pool.pin(blockID);
+                if (page[0] != 'a' + blockID) {
+                    wrong++;
+                }
+                pool.unpin(blockID, false);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(wrong, 0);
+    BufferPoolStats stats = pool.getStats();
+    EXPECT_EQ(stats.hits + stats.misses, 4 * 2000);
+
+    EXPECT_THROW(pool.pin(13), std::out_of_range);
+    for (int blockID = 1; blockID <= 6; ++blockID) {
+        EXPECT_EQ(pool.pin(blockID)[0], 'a' + blockID); // Every frame is still usable
+    }
+    for (int blockID = 1; blockID <= 6; ++blockID) {
+        pool.unpin(blockID, false);
+    }
+
+    std::filesystem::remove(filename);
+}
+
+TEST(BufferPoolTest, PinnedFramesStay) {
+    std::string filename = createTestFile("pool_pinned", 3);
+    GlobalParameters config;
+    BlockFile file(filename, &config);
+    BufferPool pool(&file, 2 * BLOCK_ALIGNMENT);
+
+    char* first = pool.pin(1);
+    char* second = pool.pin(2);
+    EXPECT_THROW(pool.pin(3), std::runtime_error); // Every frame is pinned
+
+    // Unpinning one frame lets the third page in, without touching the pinned one
+    pool.unpin(2, false);
+    char* third = pool.pin(3);
+    EXPECT_EQ(third, second);
+    EXPECT_EQ(third[0], 'd');
+    EXPECT_EQ(first[0], 'b');
+    // A page pinned twice needs two unpins
+    EXPECT_EQ(pool.pin(1), first);
+    pool.unpin(1, false);
+    pool.unpin(1, false);
+    pool.unpin(3, false);
+
+    std::filesystem::remove(filename);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include "externalsorter.h"
+
+// Records of <key, key, payload>, with many equal first keys
+std::vector<std::vector<double>> randomRecords(int count, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> group(0, 20);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    std::vector<std::vector<double>> records;
+    for (int i = 0; i < count; ++i) {
+        records.push_back({static_cast<double>(group(generator)), value(generator), static_cast<double>(i)});
+    }
+    return records;
+}
+
+std::vector<std::vector<double>> sortAll(ExternalSorter& sorter, const std::vector<std::vector<double>>& records) {
+    for (const std::vector<double>& record : records) {
+        sorter.add(record.data());
+    }
+    sorter.finish();
+    std::vector<std::vector<double>> sorted;
+    while (const double* record = sorter.next()) {
+        sorted.emplace_back(record, record + 3);
+    }
+    return sorted;
+}
+
+void expectSorted(std::vector<std::vector<double>> sorted, std::vector<std::vector<double>> records) {
+    ASSERT_EQ(sorted.size(), records.size());
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        EXPECT_TRUE(std::make_pair(sorted[i - 1][0], sorted[i - 1][1]) <= std::make_pair(sorted[i][0], sorted[i][1]));
+    }
+    // Every record comes out exactly once, payload included
+    std::sort(sorted.begin(), sorted.end());
+    std::sort(records.begin(), records.end());
+    EXPECT_EQ(sorted, records);
+}
+
+TEST(ExternalSorterTest, InMemory) {
+    WorkStealingPool pool(3);
+    std::vector<std::vector<double>> records = randomRecords(1000, 1);
+    ExternalSorter sorter(3, 1 << 20, pool);
+    expectSorted(sortAll(sorter, records), records);
+    EXPECT_EQ(sorter.getNumRuns(), 0);
+    EXPECT_EQ(sorter.size(), 1000);
+    EXPECT_THROW(sorter.add(records[0].data()), std::logic_error);
+}
+
+TEST(ExternalSorterTest, SpillsAndMergesRuns) {
+    WorkStealingPool pool(2);
+    std::vector<std::vector<double>> records = randomRecords(50000, 2);
+    // 16 KB budget: chunks of about 85 records, far more runs than one merge can take
+    ExternalSorter sorter(3, 16 << 10, pool);
+    expectSorted(sortAll(sorter, records), records);
+    EXPECT_LE(sorter.getNumRuns(), 2); // Merged down to the fan-in of the last merge
+}
+
+TEST(ExternalSorterTest, EmptyAndInvalid) {
+    WorkStealingPool pool(2);
+    ExternalSorter sorter(3, 1 << 20, pool);
+    EXPECT_THROW(sorter.next(), std::logic_error);
+    sorter.finish();
+    EXPECT_EQ(sorter.next(), nullptr);
+    EXPECT_THROW(ExternalSorter(1, 1 << 20, pool), std::invalid_argument);
+    EXPECT_THROW(ExternalSorter(3, 0, pool), std::invalid_argument);
+}
+
+TEST(ExternalSorterTest, RecordFileRoundTrip) {
+    RecordFile file("", 2, 100); // Buffer of 6 records
+    for (int i = 0; i < 20; ++i) {
+        double record[2] = {static_cast<double>(i), -i * 0.5};
+        file.append(record);
+    }
+    EXPECT_EQ(file.size(), 20);
+    for (int pass = 0; pass < 2; ++pass) {
+        file.rewind(48);
+        for (int i = 0; i < 20; ++i) {
+            const double* record = file.next();
+            ASSERT_NE(record, nullptr);
+            EXPECT_EQ(record[0], i);
+            EXPECT_EQ(record[1], -i * 0.5);
+        }
+        EXPECT_EQ(file.next(), nullptr);
+    }
+    double record[2] = {0.0, 0.0};
+    EXPECT_THROW(file.append(record), std::logic_error);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include "hilbertcurve.h"
+
+// The centers of a grid of 4 cells per dimension, sorted by key, follow the curve of that grid:
+// every key is distinct and consecutive centers are neighbouring cells
+void expectCurveOnGrid(int dimensions) {
+    HilbertCurve curve(Region(std::vector<double>(dimensions, 0.0), std::vector<double>(dimensions, 1.0)));
+    int cells = 1;
+    for (int d = 0; d < dimensions; ++d) {
+        cells *= 4;
+    }
+    std::vector<std::pair<uint64_t, std::vector<int>>> keyed;
+    for (int cell = 0; cell < cells; ++cell) {
+        std::vector<int> grid(dimensions);
+        std::vector<double> center(dimensions);
+        for (int d = 0, rest = cell; d < dimensions; ++d, rest /= 4) {
+            grid[d] = rest % 4;
+            center[d] = (grid[d] + 0.5) / 4;
+        }
+        keyed.emplace_back(curve.key(center.data()), grid);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    for (int i = 1; i < cells; ++i) {
+        EXPECT_LT(keyed[i - 1].first, keyed[i].first);
+        int distance = 0;
+        for (int d = 0; d < dimensions; ++d) {
+            distance += std::abs(keyed[i].second[d] - keyed[i - 1].second[d]);
+        }
+        EXPECT_EQ(distance, 1) << "cells " << i - 1 << " and " << i << " of the curve in " << dimensions << " dimensions";
+    }
+}
+
+TEST(HilbertCurveTest, AdjacentCellsAlongTheCurve) {
+    for (int dimensions : {1, 2, 3, 4}) {
+        expectCurveOnGrid(dimensions);
+    }
+}
+
+TEST(HilbertCurveTest, Resolution) {
+    EXPECT_EQ(HilbertCurve(Region({0.0}, {1.0})).getBitsPerDimension(), HILBERT_MAX_BITS_PER_DIMENSION);
+    EXPECT_EQ(HilbertCurve(Region({0.0, 0.0}, {1.0, 1.0})).getBitsPerDimension(), 32);
+    EXPECT_EQ(HilbertCurve(Region({0.0, 0.0, 0.0}, {1.0, 1.0, 1.0})).getBitsPerDimension(), 21);
+    EXPECT_THROW(HilbertCurve{Region()}, std::invalid_argument);
+
+    // The curve starts at the low corner
+    HilbertCurve curve(Region({-2.0, 10.0}, {2.0, 20.0}));
+    EXPECT_EQ(curve.key(Point({-2.0, 10.0})), 0);
+    // Points outside the box get the key of the border cell they are clamped to
+    EXPECT_EQ(curve.key(Point({-5.0, 0.0})), 0);
+    EXPECT_EQ(curve.key(Point({9.0, 25.0})), curve.key(Point({2.0, 20.0})));
+    EXPECT_NE(curve.key(Point({2.0, 20.0})), 0);
+}
+
+TEST(HilbertCurveTest, FlatAndManyDimensions) {
+    // A flat dimension does not take part in the order
+    HilbertCurve flat(Region({0.0, 5.0}, {1.0, 5.0}));
+    EXPECT_LT(flat.key(Point({0.1, 5.0})), flat.key(Point({0.9, 5.0})));
+
+    // Beyond HILBERT_KEY_BITS dimensions each one gets a single bit and the key keeps the leading ones
+    int dimensions = 100;
+    HilbertCurve curve(Region(std::vector<double>(dimensions, 0.0), std::vector<double>(dimensions, 1.0)));
+    EXPECT_EQ(curve.getBitsPerDimension(), 1);
+    std::vector<double> low(dimensions, 0.25), high(dimensions, 0.75);
+    EXPECT_EQ(curve.key(low.data()), 0);
+    EXPECT_NE(curve.key(high.data()), 0);
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "nodearena.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+TEST(NodeArenaTest, BlocksAreRecycled) {
+    NodeArena arena;
+    void* first = arena.allocate(100);
+    void* second = arena.allocate(100);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % NODE_ARENA_ALIGNMENT, 0);
+    EXPECT_EQ(static_cast<std::byte*>(second) - static_cast<std::byte*>(first), NodeArena::roundUp(100)); // Carved from the same slab
+
+    arena.deallocate(first, 100);
+    EXPECT_EQ(arena.getStats().blocksInUse, 1);
+    EXPECT_EQ(arena.allocate(100), first);
+    EXPECT_EQ(arena.getStats().recycled, 1);
+
+    // Another size gets its own blocks
+    void* other = arena.allocate(1000);
+    arena.deallocate(other, 1000);
+    EXPECT_NE(arena.allocate(100), other);
+
+    // A full slab makes room for a new one
+    EXPECT_EQ(arena.getStats().slabs, 2);
+    for (int i = 0; i < NODE_ARENA_SLAB_BLOCKS; ++i) {
+        arena.allocate(100);
+    }
+    EXPECT_EQ(arena.getStats().slabs, 3);
+}
+
+TEST(NodeArenaTest, NodeInOneBlock) {
+    GlobalParameters config = {8, 3};
+    auto arena = std::make_shared<NodeArena>();
+    std::shared_ptr<TreeLeafNode> leaf = arena->make<TreeLeafNode>(&config, 1, 0, -1, Region());
+    leaf->addPoints(&config, {Point({1.0, 2.0, 3.0}), Point({4.0, 5.0, 6.0})}, {10, 11}, {20, 21});
+
+    // The arrays follow the node in its block
+    const std::byte* begin = reinterpret_cast<const std::byte*>(leaf.get());
+    const std::byte* end = begin + NodeArena::roundUp(sizeof(TreeLeafNode)) + TreeLeafNode::getStorageSize(&config);
+    const std::byte* ids = reinterpret_cast<const std::byte*>(leaf->getRecordIDs().data());
+    EXPECT_GE(ids, begin);
+    EXPECT_LT(ids, end);
+
+    // And it behaves like a node on the heap
+    TreeLeafNode heapLeaf(&config, 1, 0, -1, Region(), {Point({1.0, 2.0, 3.0}), Point({4.0, 5.0, 6.0})}, {10, 11}, {20, 21});
+    heapLeaf.addPoints(&config, {}, {}, {}); // Computes the bounding box
+    EXPECT_EQ(leaf->serialize(&config), heapLeaf.serialize(&config));
+    EXPECT_EQ(leaf->findPoint(Point({4.0, 5.0, 6.0})), std::make_pair(11, 21));
+
+    std::shared_ptr<TreeInteriorNode> interior = arena->make<TreeInteriorNode>(&config, 2, 1, -1, Region());
+    interior->addChildren(&config, {1, 5}, {leaf->getBoundingBox(), Region({7.0, 7.0, 7.0}, {8.0, 8.0, 8.0})});
+    EXPECT_EQ(interior->getNumChildren(), 2);
+    EXPECT_EQ(interior->getBoundingBox(), Region({1.0, 2.0, 3.0}, {8.0, 8.0, 8.0}));
+    EXPECT_EQ(interior->rangeQuery(Region({7.5, 7.5, 7.5}, {9.0, 9.0, 9.0})), std::vector<int>{5});
+    TreeInteriorNode copy = TreeInteriorNode::deserialize(&config, interior->serialize(&config));
+    EXPECT_EQ(copy.getChildBoundingBox(1), interior->getChildBoundingBox(1));
+}
+
+TEST(NodeArenaTest, FreedNodesAreReused) {
+    GlobalParameters config = {8, 2};
+    auto arena = std::make_shared<NodeArena>();
+    std::shared_ptr<TreeLeafNode> leaf = arena->make<TreeLeafNode>(&config, 1, 0, -1, Region());
+    const TreeLeafNode* address = leaf.get();
+    long long inUse = arena->getStats().blocksInUse;
+    EXPECT_EQ(inUse, 2); // The node and its control block
+
+    leaf.reset();
+    EXPECT_EQ(arena->getStats().blocksInUse, 0);
+    EXPECT_EQ(arena->make<TreeLeafNode>(&config, 2, 0, -1, Region()).get(), address);
+
+    // Nodes keep the arena alive
+    std::shared_ptr<TreeLeafNode> survivor = arena->make<TreeLeafNode>(&config, 3, 0, -1, Region());
+    arena.reset();
+    survivor->addPoint(&config, Point({1.0, 1.0}), 1, 1);
+    EXPECT_EQ(survivor->getNumChildren(), 1);
+}
+
+TEST(NodeArenaTest, CopiesOwnTheirArrays) {
+    GlobalParameters config = {4, 2};
+    GlobalParameters larger = {6, 2};
+    auto arena = std::make_shared<NodeArena>();
+    std::shared_ptr<TreeLeafNode> leaf = arena->make<TreeLeafNode>(&config, 1, 0, -1, Region());
+    leaf->addPoint(&config, Point({1.0, 1.0}), 1, 1);
+
+    TreeLeafNode copy = *leaf;
+    leaf->removePoint(1, 1);
+    EXPECT_EQ(copy.findPoint(Point({1.0, 1.0})), std::make_pair(1, 1));
+
+    // Same shape is copied in place, another one does not fit the block
+    *leaf = copy;
+    EXPECT_EQ(leaf->getNumChildren(), 1);
+    EXPECT_THROW(*leaf = TreeLeafNode(&larger, 1, 0, -1, Region()), std::invalid_argument);
+    std::shared_ptr<TreeInteriorNode> interior = arena->make<TreeInteriorNode>(&config, 2, 1, -1, Region());
+    EXPECT_THROW(*interior = TreeInteriorNode(&larger, 2, 1, -1, Region()), std::invalid_argument);
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "nodeview.h"
+#include "treeleafnode.h"
+#include "treeinteriornode.h"
+
+// Serialize a node into a page like the buffer does
+std::vector<std::byte> toPage(GlobalParameters* config, const TreeNode& node, size_t pageSize) {
+    std::vector<std::byte> page(pageSize);
+    node.serializeInto(config, page);
+    return page;
+}
+
+TEST(NodeViewTest, LeafView) {
+    GlobalParameters config = {4, 2};
+    TreeLeafNode leaf(&config, 7, 0, 3, Region({0.1, 0.2}, {0.5, 0.9}), {Point({0.1, 0.9}), Point({0.5, 0.2}), Point({0.3, 0.3})}, {10, 11, 12}, {0, 1, 2});
+    std::vector<std::byte> page = toPage(&config, leaf, TreeLeafNode::getSerializedSize(&config));
+
+    LeafNodeView view(&config, page);
+    EXPECT_EQ(view.getID(), 7);
+    EXPECT_EQ(view.getLevel(), 0);
+    EXPECT_TRUE(view.isLeaf());
+    EXPECT_EQ(view.getParentID(), 3);
+    EXPECT_EQ(view.getBoundingBox(), leaf.getBoundingBox());
+    ASSERT_EQ(view.getNumChildren(), 3);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(view.getBlockID(i), leaf.getBlockIDs()[i]);
+        EXPECT_EQ(view.getRecordID(i), leaf.getRecordIDs()[i]);
+        EXPECT_EQ(view.getPoint(i), leaf.getPoints()[i]);
+        EXPECT_TRUE(view.pointEquals(i, leaf.getPoints()[i]));
+    }
+    EXPECT_FALSE(view.pointEquals(0, Point({0.1, 0.8})));
+    // Same answers as the leaf's own range query
+    Region query({0.0, 0.0}, {0.4, 1.0});
+    EXPECT_TRUE(view.pointInside(0, query));
+    EXPECT_FALSE(view.pointInside(1, query));
+    EXPECT_TRUE(view.pointInside(2, query));
+    EXPECT_EQ(leaf.rangeQuery(query).size(), 2);
+    // Header (3 ints and the box), then a block ID, a record ID and the coordinates per point
+    EXPECT_EQ(view.getDecodedSize(0), 3 * sizeof(int) + 4 * sizeof(double));
+    EXPECT_EQ(view.getDecodedSize(3), view.getDecodedSize(0) + 3 * (2 * sizeof(int) + 2 * sizeof(double)));
+    EXPECT_FALSE(view.isDeleted(0));
+    leaf.markDeleted(Point({0.5, 0.2}));
+    LeafNodeView deleted(&config, toPage(&config, leaf, TreeLeafNode::getSerializedSize(&config)));
+    EXPECT_EQ(deleted.getNumChildren(), 3);
+    EXPECT_TRUE(deleted.isDeleted(1));
+    EXPECT_FALSE(deleted.isDeleted(2));
+
+    // Wrong node type or a short page
+    EXPECT_THROW(InteriorNodeView(&config, page), std::invalid_argument);
+    EXPECT_THROW(LeafNodeView(&config, std::span(page).first(10)), std::invalid_argument);
+}
+
+TEST(NodeViewTest, DeltaLeafView) {
+    GlobalParameters config = {4, 2, 0, LEAF_FORMAT_DELTA};
+    TreeLeafNode leaf(&config, 7, 0, 3, Region({-0.5, 1e-9}, {0.3, 0.9}), {Point({0.1, 0.9}), Point({-0.5, 0.2}), Point({0.3, 1e-9})}, {10, 11, 40}, {0, 1, 2});
+    leaf.markDeleted(Point({-0.5, 0.2}));
+    std::vector<std::byte> page = toPage(&config, leaf, 4096);
+
+    // The view decodes the same values as the deserialized leaf
+    LeafNodeView view(&config, page);
+    EXPECT_EQ(view.getID(), 7);
+    EXPECT_EQ(view.getParentID(), 3);
+    EXPECT_EQ(view.getBoundingBox(), leaf.getBoundingBox());
+    ASSERT_EQ(view.getNumChildren(), 3);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(view.getBlockID(i), leaf.getBlockIDs()[i]);
+        EXPECT_EQ(view.getRecordID(i), leaf.getRecordIDs()[i]);
+        EXPECT_EQ(view.getPoint(i), leaf.getPoint(i));
+    }
+    EXPECT_TRUE(view.isDeleted(1));
+    EXPECT_FALSE(view.isDeleted(2));
+    EXPECT_TRUE(view.pointInside(2, Region({0.0, 0.0}, {0.5, 0.5})));
+    EXPECT_TRUE(view.pointEquals(0, Point({0.1, 0.9})));
+    // Points take their encoded widths
+    EXPECT_GT(view.getDecodedSize(0), 3 * sizeof(int) + 4 * sizeof(double));
+    EXPECT_GT(view.getDecodedSize(3), view.getDecodedSize(0));
+    EXPECT_LE(view.getDecodedSize(3), view.getDecodedSize(0) + 3 * (2 * sizeof(int) + 2 * sizeof(double)));
+
+    // Plain pages are not an encoding
+    GlobalParameters plainConfig = {4, 2};
+    std::vector<std::byte> plainPage = toPage(&plainConfig, leaf, 4096);
+    EXPECT_THROW(LeafNodeView(&config, plainPage), std::invalid_argument);
+}
+
+TEST(NodeViewTest, InteriorView) {
+    GlobalParameters config = {3, 2};
+    Region boxes[] = {Region({0.0, 0.0}, {0.5, 0.5}), Region({0.5, 0.5}, {1.0, 1.0}), Region()};
+    TreeInteriorNode interior(&config, 2, 1, -1, Region({0.0, 0.0}, {1.0, 1.0}), {4, 5, -1}, boxes);
+    // Pages are usually larger than the node
+    std::vector<std::byte> page = toPage(&config, interior, 4096);
+
+    InteriorNodeView view(&config, page);
+    EXPECT_EQ(view.getID(), 2);
+    EXPECT_EQ(view.getLevel(), 1);
+    EXPECT_FALSE(view.isLeaf());
+    EXPECT_EQ(view.getParentID(), -1);
+    ASSERT_EQ(view.getNumChildren(), 2);
+    EXPECT_EQ(view.getChildID(0), 4);
+    EXPECT_EQ(view.getChildID(1), 5);
+    EXPECT_EQ(view.getChildBoundingBox(1), boxes[1]);
+    EXPECT_DOUBLE_EQ(view.getChildStart(1, 0), 0.5);
+    EXPECT_DOUBLE_EQ(view.getChildEnd(0, 1), 0.5);
+
+    EXPECT_TRUE(view.childOverlaps(0, Point({0.2, 0.2})));
+    EXPECT_FALSE(view.childOverlaps(1, Point({0.2, 0.2})));
+    EXPECT_TRUE(view.childOverlaps(1, Region({0.4, 0.4}, {0.6, 0.6})));
+    EXPECT_EQ(view.getDecodedSize(2), 3 * sizeof(int) + 4 * sizeof(double) + 2 * (sizeof(int) + 4 * sizeof(double)));
+
+    EXPECT_THROW(LeafNodeView(&config, page), std::invalid_argument);
+}
+
+TEST(NodeViewTest, QuantizedInteriorView) {
+    Region boxes[] = {Region({0.0, 0.0}, {0.31, 0.52}), Region({0.27, 0.5}, {1.0, 1.0}), Region()};
+    for (int bits : {8, 16}) {
+        GlobalParameters config = {3, 2, bits};
+        TreeInteriorNode interior(&config, 2, 1, -1, Region({0.0, 0.0}, {1.0, 1.0}), {4, 5, -1}, boxes);
+        std::vector<std::byte> page = toPage(&config, interior, 4096);
+
+        // The view reads the same rounded boxes as the deserialized node
+        InteriorNodeView view(&config, page);
+        std::vector<char> bytes(reinterpret_cast<char*>(page.data()), reinterpret_cast<char*>(page.data()) + TreeInteriorNode::getSerializedSize(&config));
+        TreeInteriorNode deserialized = TreeInteriorNode::deserialize(&config, bytes);
+        ASSERT_EQ(view.getNumChildren(), 2);
+        for (int i = 0; i < 2; ++i) {
+            EXPECT_EQ(view.getChildID(i), deserialized.getChildID(i));
+            EXPECT_EQ(view.getChildBoundingBox(i), deserialized.getChildBoundingBox(i));
+        }
+        EXPECT_DOUBLE_EQ(view.getChildStart(0, 0), 0.0);
+        EXPECT_DOUBLE_EQ(view.getChildEnd(1, 1), 1.0);
+        EXPECT_LE(view.getChildStart(1, 0), 0.27);
+        EXPECT_GE(view.getChildEnd(0, 1), 0.52);
+
+        EXPECT_TRUE(view.childOverlaps(0, Point({0.31, 0.52})));
+        EXPECT_TRUE(view.childOverlaps(1, Point({0.27, 0.5})));
+        EXPECT_FALSE(view.childOverlaps(1, Point({0.2, 0.2})));
+    }
+}
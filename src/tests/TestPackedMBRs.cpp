@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "packedmbrs.h"
+
+// Random boxes in the unit cube, some of them degenerate
+std::vector<Region> randomBoxes(int count, int dimensions, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Region> boxes;
+    for (int i = 0; i < count; ++i) {
+        std::vector<double> start(dimensions), end(dimensions);
+        for (int d = 0; d < dimensions; ++d) {
+            start[d] = distribution(generator);
+            end[d] = i % 7 == 0 ? start[d] : start[d] + distribution(generator) / 3;
+        }
+        boxes.emplace_back(start, end);
+    }
+    return boxes;
+}
+
+// Every level the CPU supports gives the Region results, for counts that leave every possible tail,
+// both with the fixed-dimension kernels (2 and 3) and with the others
+TEST(PackedMBRsTest, KernelsMatchRegion) {
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (PackedMBRs::bestSimdLevel() >= SimdLevel::SSE2) levels.push_back(SimdLevel::SSE2);
+    if (PackedMBRs::bestSimdLevel() >= SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+
+    for (int dimensions = 1; dimensions <= 4; ++dimensions) {
+        int maxChildren = 70;
+        std::vector<Region> boxes = randomBoxes(maxChildren, dimensions, dimensions);
+        std::vector<Region> queries = randomBoxes(12, dimensions, 100 + dimensions);
+        PackedMBRs packed(dimensions, maxChildren);
+        for (int i = 0; i < maxChildren; ++i) {
+            packed.set(i, boxes[i]);
+        }
+
+        for (int count : {0, 1, 3, 4, 5, 31, 64, 65, 70}) {
+            for (const Region& query : queries) {
+                const double* start = query.getStart().data();
+                const double* end = query.getEnd().data();
+                for (SimdLevel level : levels) {
+                    std::vector<uint64_t> mask(2, ~uint64_t(0));
+                    std::vector<double> areas(count), enlargements(count);
+                    packed.overlapMask(count, start, end, mask.data(), level);
+                    packed.enlargementCosts(count, start, end, areas.data(), enlargements.data(), level);
+                    double expectedSum = 0.0;
+                    for (int i = 0; i < count; ++i) {
+                        EXPECT_EQ((mask[i / 64] >> (i % 64)) & 1, boxes[i].overlaps(query) ? 1 : 0);
+                        EXPECT_DOUBLE_EQ(areas[i], boxes[i].area());
+                        EXPECT_DOUBLE_EQ(enlargements[i], boxes[i].enlargement(query));
+                        expectedSum += boxes[i].overlap(query);
+                    }
+                    // No bits past count
+                    if (count % 64 != 0) {
+                        EXPECT_EQ(mask[count / 64] >> (count % 64), 0);
+                    }
+                    EXPECT_NEAR(packed.overlapSum(count, start, end, level), expectedSum, 1e-12);
+                }
+            }
+        }
+    }
+}
+
+TEST(PackedMBRsTest, EmptySlots) {
+    PackedMBRs packed(2, 5);
+    Region query({0.0, 0.0}, {1.0, 1.0});
+    packed.set(0, Region({0.2, 0.2}, {0.4, 0.4}));
+    packed.set(2, Region({0.5, 0.5}, {0.6, 0.6}));
+    packed.set(2, Region()); // Cleared again
+
+    uint64_t mask;
+    packed.overlapMask(5, query.getStart().data(), query.getEnd().data(), &mask);
+    EXPECT_EQ(mask, 1);
+    EXPECT_NEAR(packed.overlapSum(5, query.getStart().data(), query.getEnd().data()), 0.04, 1e-12);
+    EXPECT_EQ(packed.getLow(0, 1), 0.2);
+    EXPECT_EQ(packed.getHigh(0, 1), 0.4);
+}
+
+TEST(PackedMBRsTest, InvalidInput) {
+    PackedMBRs packed(2, 5);
+    EXPECT_THROW(packed.set(8, Region({0.0, 0.0}, {1.0, 1.0})), std::out_of_range);
+    EXPECT_THROW(packed.set(-1, Region({0.0, 0.0}, {1.0, 1.0})), std::out_of_range);
+    EXPECT_THROW(packed.set(0, Region({0.0}, {1.0})), std::invalid_argument);
+}
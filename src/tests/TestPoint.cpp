@@ -30,3 +30,11 @@ TEST(PointTest, EmptryToString) {
 
     delete config;
 }
+
+TEST(PointTest, SquaredDistance) {
+    Point a({1.0, 2.0, 3.0});
+    Point b({4.0, 6.0, 3.0});
+    EXPECT_DOUBLE_EQ(a.squaredDistance(b), 25.0);
+    EXPECT_DOUBLE_EQ(b.squaredDistance(a), 25.0);
+    EXPECT_DOUBLE_EQ(a.squaredDistance(a), 0.0);
+}
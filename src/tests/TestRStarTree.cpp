@@ -0,0 +1,713 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include "rstartree.h"
+
+// Random points in the unit cube, generated with a fixed seed for reproducibility
+std::vector<Point> randomPoints(int count, int dimensions, unsigned int seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::vector<Point> points;
+    for (int i = 0; i < count; ++i) {
+        std::vector<double> coords(dimensions);
+        for (int d = 0; d < dimensions; ++d) {
+            coords[d] = distribution(generator);
+        }
+        points.emplace_back(coords);
+    }
+    return points;
+}
+
+bool contains(const Region& outer, const AbstractBoundedClass& inner) {
+    for (size_t d = 0; d < outer.getStart().size(); ++d) {
+        if (inner.getStart()[d] < outer.getStart()[d] || inner.getEnd()[d] > outer.getEnd()[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walk the whole tree and check the structural invariants, returns the number of points found
+long long checkSubtree(const RStarTree& tree, GlobalParameters* config, int nodeID, int parentID, int expectedLevel) {
+    std::shared_ptr<TreeNode> node = tree.readNode(nodeID);
+    EXPECT_EQ(node->getLevel(), expectedLevel);
+    EXPECT_EQ(node->getParentID(), parentID);
+    EXPECT_LE(node->getNumChildren(), config->maxChildren);
+    if (nodeID != tree.getRootID()) {
+        EXPECT_GE(node->getNumChildren(), tree.getMinChildren());
+    }
+
+    if (node->isLeaf()) {
+        auto leaf = std::static_pointer_cast<TreeLeafNode>(node);
+        for (int i = 0; i < leaf->getNumChildren(); ++i) {
+            EXPECT_TRUE(contains(leaf->getBoundingBox(), leaf->getPoint(i)));
+        }
+        return leaf->getNumChildren();
+    }
+
+    auto interior = std::static_pointer_cast<TreeInteriorNode>(node);
+    long long count = 0;
+    for (int i = 0; i < interior->getNumChildren(); ++i) {
+        std::shared_ptr<TreeNode> child = tree.readNode(interior->getChildID(i));
+        // The box stored in the parent is exactly the child's box
+        EXPECT_EQ(interior->getChildBoundingBox(i), child->getBoundingBox());
+        EXPECT_TRUE(contains(interior->getBoundingBox(), interior->getChildBoundingBox(i)));
+        count += checkSubtree(tree, config, child->getID(), nodeID, expectedLevel - 1);
+    }
+    return count;
+}
+
+TEST(RStarTreeTest, EmptyTree) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 4;
+
+    RStarTree tree(config);
+    EXPECT_EQ(tree.getHeight(), 1);
+    EXPECT_EQ(tree.getSize(), 0);
+    EXPECT_EQ(tree.findPoint(Point({0.5, 0.5})), std::make_pair(-1, -1));
+    EXPECT_TRUE(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).empty());
+
+    delete config;
+}
+
+TEST(RStarTreeTest, InvalidInsert) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 4;
+
+    RStarTree tree(config);
+    tree.insert(Point({0.5, 0.5}), 1, 1);
+    // Same location not allowed
+    EXPECT_THROW(tree.insert(Point({0.5, 0.5}), 2, 2), std::invalid_argument);
+    // Wrong dimensions and negative IDs not allowed
+    EXPECT_THROW(tree.insert(Point({0.5, 0.5, 0.5}), 3, 3), std::invalid_argument);
+    EXPECT_THROW(tree.insert(Point({0.6, 0.6}), -1, 3), std::invalid_argument);
+    EXPECT_EQ(tree.getSize(), 1);
+
+    delete config;
+}
+
+TEST(RStarTreeTest, InsertAndFind) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 5;
+
+    RStarTree tree(config);
+    std::vector<Point> points = randomPoints(2000, config->dimensions, 42);
+    for (int i = 0; i < points.size(); ++i) {
+        tree.insert(points[i], i / 10, i % 10);
+    }
+
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_GT(tree.getHeight(), 3);
+    for (int i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i / 10, i % 10));
+    }
+    EXPECT_EQ(tree.findPoint(Point({2.0, 2.0})), std::make_pair(-1, -1));
+
+    delete config;
+}
+
+TEST(RStarTreeTest, StructureInvariants) {
+    for (int maxChildren : {2, 3, 8, 50}) {
+        for (int dimensions : {1, 2, 3}) {
+            GlobalParameters* config = new GlobalParameters;
+            config->dimensions = dimensions;
+            config->maxChildren = maxChildren;
+
+            RStarTree tree(config);
+            std::vector<Point> points = randomPoints(1500, dimensions, maxChildren * 10 + dimensions);
+            for (int i = 0; i < points.size(); ++i) {
+                tree.insert(points[i], i, 0);
+            }
+
+            EXPECT_EQ(checkSubtree(tree, config, tree.getRootID(), -1, tree.getHeight() - 1), points.size());
+            delete config;
+        }
+    }
+}
+
+TEST(RStarTreeTest, RangeQueryMatchesScan) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 3;
+    config->maxChildren = 8;
+
+    RStarTree tree(config);
+    std::vector<Point> points = randomPoints(3000, config->dimensions, 7);
+    for (int i = 0; i < points.size(); ++i) {
+        tree.insert(points[i], i, i);
+    }
+
+    std::vector<Point> corners = randomPoints(40, config->dimensions, 99);
+    for (int q = 0; q + 1 < corners.size(); q += 2) {
+        std::vector<double> start(config->dimensions), end(config->dimensions);
+        for (int d = 0; d < config->dimensions; ++d) {
+            start[d] = std::min(corners[q].getCoordinates()[d], corners[q + 1].getCoordinates()[d]);
+            end[d] = std::max(corners[q].getCoordinates()[d], corners[q + 1].getCoordinates()[d]);
+        }
+        Region query(start, end);
+
+        std::vector<int> expected;
+        for (int i = 0; i < points.size(); ++i) {
+            if (query.overlaps(points[i])) {
+                expected.push_back(i);
+            }
+        }
+        std::vector<int> found;
+        for (const auto& result : tree.rangeQuery(query)) {
+            EXPECT_EQ(result.first, result.second);
+            found.push_back(result.first);
+        }
+        std::sort(found.begin(), found.end());
+        EXPECT_EQ(found, expected);
+    }
+
+    delete config;
+}
+
+TEST(RStarTreeTest, BulkLoad) {
+    for (int dimensions : {1, 2, 3}) {
+        for (double fillFactor : {1.0, 0.7, 0.5}) {
+            for (int count : {0, 1, 7, 8, 9, 1000, 2345}) {
+                GlobalParameters* config = new GlobalParameters;
+                config->dimensions = dimensions;
+                config->maxChildren = 8;
+
+                std::vector<Point> points = randomPoints(count, dimensions, count + dimensions);
+                std::vector<int> blockIDs, recordIDs;
+                for (int i = 0; i < count; ++i) {
+                    blockIDs.push_back(i);
+                    recordIDs.push_back(i);
+                }
+
+                RStarTree tree(config);
+                tree.bulkLoad(points, blockIDs, recordIDs, fillFactor);
+                EXPECT_EQ(tree.getSize(), count);
+                EXPECT_EQ(checkSubtree(tree, config, tree.getRootID(), -1, tree.getHeight() - 1), count);
+                for (int i = 0; i < count; ++i) {
+                    EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i, i));
+                }
+                EXPECT_EQ(tree.rangeQuery(Region(std::vector<double>(dimensions, 0.0), std::vector<double>(dimensions, 1.0))).size(), count);
+
+                // The tree keeps working with regular inserts
+                std::vector<Point> more = randomPoints(100, dimensions, 1234567);
+                for (int i = 0; i < more.size(); ++i) {
+                    tree.insert(more[i], count + i, 0);
+                }
+                EXPECT_EQ(checkSubtree(tree, config, tree.getRootID(), -1, tree.getHeight() - 1), count + 100);
+
+                delete config;
+            }
+        }
+    }
+}
+
+TEST(RStarTreeTest, BulkLoadFillsNodes) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 10;
+
+    std::vector<Point> points = randomPoints(10000, config->dimensions, 5);
+    std::vector<int> ids(points.size());
+    std::iota(ids.begin(), ids.end(), 0);
+
+    RStarTree tree(config);
+    tree.bulkLoad(points, ids, ids);
+    // 1000 full leaves, 100 full parents, 10 full grandparents and the root
+    EXPECT_EQ(tree.getHeight(), 4);
+    EXPECT_EQ(tree.getNumNodes(), 1111);
+
+    // Not allowed on a tree with points
+    EXPECT_THROW(tree.bulkLoad(points, ids, ids), std::logic_error);
+    RStarTree other(config);
+    EXPECT_THROW(other.bulkLoad(points, ids, ids, 1.5), std::invalid_argument);
+    ids.pop_back();
+    EXPECT_THROW(other.bulkLoad(points, ids, ids), std::invalid_argument);
+
+    delete config;
+}
+
+TEST(RStarTreeTest, NearestNeighborBounds) {
+    Region box({0.0, 0.0}, {2.0, 1.0});
+    // Inside the box
+    EXPECT_DOUBLE_EQ(box.minDist(Point({0.5, 0.5})), 0.0);
+    EXPECT_DOUBLE_EQ(box.minMaxDist(Point({0.5, 0.5})), 0.5 * 0.5 + 0.5 * 0.5);
+    // Outside the box: the face x = 2 holds an object at most (1, 2) away, the face y = 1 one at most (3, 1) away
+    EXPECT_DOUBLE_EQ(box.minDist(Point({3.0, 2.0})), 1.0 + 1.0);
+    EXPECT_DOUBLE_EQ(box.minMaxDist(Point({3.0, 2.0})), std::min(1.0 + 4.0, 9.0 + 1.0));
+    // MINDIST never exceeds MINMAXDIST
+    Region small({0.25, 0.25}, {0.5, 0.75});
+    for (const Point& query : randomPoints(100, 2, 3)) {
+        EXPECT_LE(small.minDist(query), small.minMaxDist(query));
+    }
+}
+
+TEST(RStarTreeTest, NearestNeighborsMatchScan) {
+    for (int dimensions : {1, 2, 3}) {
+        GlobalParameters* config = new GlobalParameters;
+        config->dimensions = dimensions;
+        config->maxChildren = 8;
+
+        RStarTree tree(config);
+        EXPECT_TRUE(tree.nearestNeighbors(Point(std::vector<double>(dimensions, 0.5)), 3).empty());
+        std::vector<Point> points = randomPoints(2000, dimensions, 11 + dimensions);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+
+        for (const Point& query : randomPoints(30, dimensions, 77)) {
+            std::vector<double> expected;
+            for (const Point& point : points) {
+                expected.push_back(std::sqrt(query.squaredDistance(point)));
+            }
+            std::sort(expected.begin(), expected.end());
+
+            for (int k : {1, 5, 40}) {
+                std::vector<std::tuple<int, int, double>> found = tree.nearestNeighbors(query, k);
+                ASSERT_EQ(found.size(), k);
+                for (int i = 0; i < k; ++i) {
+                    auto [blockID, recordID, distance] = found[i];
+                    EXPECT_EQ(blockID, recordID);
+                    EXPECT_DOUBLE_EQ(distance, std::sqrt(query.squaredDistance(points[blockID])));
+                    EXPECT_DOUBLE_EQ(distance, expected[i]);
+                }
+            }
+        }
+        // More neighbors than points returns every point
+        EXPECT_EQ(tree.nearestNeighbors(points[0], 5000).size(), points.size());
+        EXPECT_EQ(std::get<2>(tree.nearestNeighbors(points[0], 1)[0]), 0.0);
+        EXPECT_THROW(tree.nearestNeighbors(points[0], -1), std::invalid_argument);
+        EXPECT_THROW(tree.nearestNeighbors(Point(std::vector<double>(dimensions + 1, 0.5)), 1), std::invalid_argument);
+
+        delete config;
+    }
+}
+
+TEST(RStarTreeTest, SkylineMatchesScan) {
+    for (int dimensions : {1, 2, 3}) {
+        GlobalParameters* config = new GlobalParameters;
+        config->dimensions = dimensions;
+        config->maxChildren = 6;
+
+        RStarTree tree(config);
+        EXPECT_TRUE(tree.skyline().empty());
+        std::vector<Point> points = randomPoints(3000, dimensions, 21 + dimensions);
+        for (int i = 0; i < points.size(); ++i) {
+            tree.insert(points[i], i, i);
+        }
+
+        std::vector<std::vector<SkylinePreference>> preferenceSets = {{}};
+        preferenceSets.push_back(std::vector<SkylinePreference>(dimensions, SkylinePreference::Max));
+        std::vector<SkylinePreference> mixed(dimensions, SkylinePreference::Min);
+        mixed[0] = SkylinePreference::Max;
+        preferenceSets.push_back(mixed);
+
+        for (const auto& preferences : preferenceSets) {
+            // Quadratic scan
+            auto better = [&](const Point& a, const Point& b, int d) {
+                bool max = !preferences.empty() && preferences[d] == SkylinePreference::Max;
+                return max ? a.getCoordinates()[d] - b.getCoordinates()[d] : b.getCoordinates()[d] - a.getCoordinates()[d];
+            };
+            std::vector<int> expected;
+            for (int i = 0; i < points.size(); ++i) {
+                bool dominated = false;
+                for (int j = 0; j < points.size() && !dominated; ++j) {
+                    bool noWorse = true, strictlyBetter = false;
+                    for (int d = 0; d < dimensions; ++d) {
+                        double difference = better(points[j], points[i], d);
+                        noWorse = noWorse && difference >= 0;
+                        strictlyBetter = strictlyBetter || difference > 0;
+                    }
+                    dominated = noWorse && strictlyBetter;
+                }
+                if (!dominated) {
+                    expected.push_back(i);
+                }
+            }
+
+            std::vector<int> found;
+            for (const auto& result : tree.skyline(preferences)) {
+                EXPECT_EQ(result.first, result.second);
+                found.push_back(result.first);
+            }
+            std::sort(found.begin(), found.end());
+            EXPECT_EQ(found, expected);
+        }
+        EXPECT_THROW(tree.skyline(std::vector<SkylinePreference>(dimensions + 1)), std::invalid_argument);
+
+        delete config;
+    }
+}
+
+// Inserts from several threads, some of them splitting and reinserting, while other threads query
+// Queries must find every point inserted before the writers started, and the tree must end up whole
+TEST(RStarTreeTest, BatchRangeQueriesMatchSingle) {
+    GlobalParameters config = {6, 3};
+    RStarTree tree(&config);
+    std::vector<Point> points = randomPoints(5000, 3, 31);
+    for (int i = 0; i < points.size(); ++i) {
+        tree.insert(points[i], i, i % 7);
+    }
+
+    std::vector<Region> queries;
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    for (int i = 0; i < 200; ++i) {
+        std::vector<double> start(3), end(3);
+        double side = i % 10 == 0 ? 0.9 : 0.15; // A few queries covering most of the tree
+        for (int d = 0; d < 3; ++d) {
+            start[d] = distribution(generator) * (1.0 - side);
+            end[d] = start[d] + side;
+        }
+        queries.emplace_back(start, end);
+    }
+
+    WorkStealingPool pool(4);
+    std::vector<std::vector<std::pair<int, int>>> batch = tree.rangeQueries(queries, pool);
+    ASSERT_EQ(batch.size(), queries.size());
+    for (int i = 0; i < queries.size(); ++i) {
+        std::vector<std::pair<int, int>> expected = tree.rangeQuery(queries[i]);
+        std::sort(expected.begin(), expected.end());
+        std::sort(batch[i].begin(), batch[i].end());
+        EXPECT_EQ(batch[i], expected);
+    }
+    EXPECT_TRUE(tree.rangeQueries({}, pool).empty());
+}
+
+TEST(RStarTreeTest, ConcurrentInsertsAndQueries) {
+    GlobalParameters config = {8, 2};
+    RStarTree tree(&config);
+    std::vector<Point> points = randomPoints(6000, 2, 77);
+    int preloaded = 2000;
+    for (int i = 0; i < preloaded; ++i) {
+        tree.insert(points[i], i, 0);
+    }
+
+    int writers = 4;
+    std::atomic<int> writersLeft = writers;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int i = preloaded + w; i < points.size(); i += writers) {
+                tree.insert(points[i], i, 0);
+            }
+            writersLeft--;
+        });
+    }
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&, r]() {
+            std::mt19937 generator(r);
+            std::uniform_real_distribution<double> distribution(0.0, 0.8);
+            while (writersLeft > 0) {
+                double x = distribution(generator), y = distribution(generator);
+                Region query({x, y}, {x + 0.2, y + 0.2});
+                std::vector<std::pair<int, int>> found = tree.rangeQuery(query);
+                std::vector<bool> seen(points.size(), false);
+                for (auto [blockID, recordID] : found) {
+                    seen[blockID] = true;
+                    if (!query.overlaps(points[blockID])) {
+                        failures++;
+                    }
+                }
+                for (int i = 0; i < preloaded; ++i) {
+                    if (query.overlaps(points[i]) && !seen[i]) {
+                        failures++;
+                    }
+                }
+                if (tree.nearestNeighbors(Point({x, y}), 5).size() != 5 || tree.findPoint(points[r]).first != r) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(tree.findPoint(points[i]).first, i);
+    }
+}
+
+// Queries over a tree with points waiting in its buffers match an unbuffered tree holding the same points,
+// and pushing the buffers down leaves a valid tree
+TEST(RStarTreeTest, BufferedInsertion) {
+    GlobalParameters config = {6, 2};
+    RStarTree reference(&config);
+    RStarTree tree(&config);
+    EXPECT_THROW(tree.setInsertBuffering(-1), std::invalid_argument);
+    tree.setInsertBuffering(16);
+    std::vector<Point> points = randomPoints(4000, 2, 31);
+    for (int i = 0; i < points.size(); ++i) {
+        reference.insert(points[i], i, i);
+        tree.insert(points[i], i, i);
+    }
+    ASSERT_GT(tree.getNumBuffered(), 0);
+    EXPECT_EQ(tree.getSize(), points.size());
+    EXPECT_THROW(tree.insert(points.back(), 0, 0), std::invalid_argument); // Still in the root's buffer
+
+    auto sorted = [](std::vector<std::pair<int, int>> results) {
+        std::sort(results.begin(), results.end());
+        return results;
+    };
+    for (int i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(tree.findPoint(points[i]), std::make_pair(i, i));
+    }
+    for (const Point& corner : randomPoints(30, 2, 32)) {
+        double x = corner.getCoordinates()[0] * 0.8, y = corner.getCoordinates()[1] * 0.8;
+        Region query({x, y}, {x + 0.2, y + 0.2});
+        EXPECT_EQ(sorted(tree.rangeQuery(query)), sorted(reference.rangeQuery(query)));
+        std::vector<std::tuple<int, int, double>> found = tree.nearestNeighbors(corner, 20);
+        std::vector<std::tuple<int, int, double>> expected = reference.nearestNeighbors(corner, 20);
+        ASSERT_EQ(found.size(), expected.size());
+        for (int i = 0; i < found.size(); ++i) {
+            EXPECT_DOUBLE_EQ(std::get<2>(found[i]), std::get<2>(expected[i]));
+        }
+    }
+    EXPECT_EQ(sorted(tree.skyline()), sorted(reference.skyline()));
+    WorkStealingPool pool(2);
+    std::vector<Region> queries = {Region({0.1, 0.1}, {0.4, 0.3}), Region({0.0, 0.0}, {1.0, 1.0})};
+    std::vector<std::vector<std::pair<int, int>>> batch = tree.rangeQueries(queries, pool);
+    EXPECT_EQ(sorted(batch[0]), sorted(reference.rangeQuery(queries[0])));
+    EXPECT_EQ(batch[1].size(), points.size());
+
+    tree.flushInsertBuffers();
+    EXPECT_EQ(tree.getNumBuffered(), 0);
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), points.size());
+
+    // Buffered inserts alongside queries, then turning buffering off pushes everything down
+    std::vector<Point> more = randomPoints(4000, 2, 33);
+    std::atomic<bool> writing = true;
+    std::atomic<int> failures = 0;
+    std::thread reader([&]() {
+        while (writing) {
+            for (int i = 0; i < points.size(); i += 97) {
+                if (tree.findPoint(points[i]).first != i) {
+                    failures++;
+                }
+            }
+            if (tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size() < points.size()) {
+                failures++;
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 2; ++w) {
+        writers.emplace_back([&, w]() {
+            for (int i = w; i < more.size(); i += 2) {
+                tree.insert(more[i], points.size() + i, 0);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    writing = false;
+    reader.join();
+    EXPECT_EQ(failures, 0);
+    tree.setInsertBuffering(0);
+    EXPECT_EQ(tree.getNumBuffered(), 0);
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), points.size() + more.size());
+}
+
+// Deletes leave tombstones that every query skips, compaction reclaims them and keeps the tree valid,
+// and background compaction runs alongside deletes and queries
+TEST(RStarTreeTest, DeleteAndCompact) {
+    GlobalParameters config = {6, 2};
+    RStarTree tree(&config);
+    std::vector<Point> points = randomPoints(4000, 2, 41);
+    for (int i = 0; i < points.size(); ++i) {
+        tree.insert(points[i], i, i);
+    }
+    EXPECT_THROW(tree.remove(Point({0.5})), std::invalid_argument);
+    EXPECT_FALSE(tree.remove(Point({2.0, 2.0})));
+
+    std::vector<bool> live(points.size(), true);
+    for (int i = 0; i < points.size(); i += 3) {
+        EXPECT_TRUE(tree.remove(points[i]));
+        live[i] = false;
+    }
+    EXPECT_FALSE(tree.remove(points[0])); // Deleted already
+    EXPECT_GT(tree.getNumDeleted(), 0);
+    long long numLive = std::count(live.begin(), live.end(), true);
+    EXPECT_EQ(tree.getSize(), numLive);
+
+    auto checkQueries = [&]() {
+        for (int i = 0; i < points.size(); i += 7) {
+            EXPECT_EQ(tree.findPoint(points[i]).first, live[i] ? i : -1);
+        }
+        for (const Point& corner : randomPoints(20, 2, 42)) {
+            double x = corner.getCoordinates()[0] * 0.7, y = corner.getCoordinates()[1] * 0.7;
+            Region query({x, y}, {x + 0.3, y + 0.3});
+            std::vector<int> expected, found;
+            std::vector<double> distances;
+            for (int i = 0; i < points.size(); ++i) {
+                if (live[i] && query.overlaps(points[i])) {
+                    expected.push_back(i);
+                }
+                if (live[i]) {
+                    distances.push_back(std::sqrt(corner.squaredDistance(points[i])));
+                }
+            }
+            for (auto [blockID, recordID] : tree.rangeQuery(query)) {
+                found.push_back(blockID);
+            }
+            std::sort(found.begin(), found.end());
+            EXPECT_EQ(found, expected);
+
+            std::sort(distances.begin(), distances.end());
+            std::vector<std::tuple<int, int, double>> neighbors = tree.nearestNeighbors(corner, 10);
+            ASSERT_EQ(neighbors.size(), 10);
+            for (int i = 0; i < 10; ++i) {
+                EXPECT_TRUE(live[std::get<0>(neighbors[i])]);
+                EXPECT_DOUBLE_EQ(std::get<2>(neighbors[i]), distances[i]);
+            }
+        }
+        for (auto [blockID, recordID] : tree.skyline()) {
+            EXPECT_TRUE(live[blockID]);
+        }
+    };
+    checkQueries();
+
+    tree.compact();
+    EXPECT_EQ(tree.getNumDeleted(), 0);
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), numLive);
+    checkQueries();
+
+    // Deletes, queries and the background compactor at once
+    tree.startBackgroundCompaction();
+    EXPECT_THROW(tree.startBackgroundCompaction(), std::logic_error);
+    std::atomic<bool> deleting = true;
+    std::atomic<int> failures = 0;
+    std::thread reader([&]() {
+        while (deleting) {
+            // Points 1 mod 3 are never deleted
+            for (int i = 1; i < points.size(); i += 99) {
+                if (tree.findPoint(points[i]).first != i) {
+                    failures++;
+                }
+            }
+            if (tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size() < points.size() / 3) {
+                failures++;
+            }
+        }
+    });
+    std::vector<std::thread> deleters;
+    for (int w = 0; w < 2; ++w) {
+        deleters.emplace_back([&, w]() {
+            for (int i = 2 + 3 * w; i < points.size(); i += 6) {
+                if (!tree.remove(points[i])) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (std::thread& deleter : deleters) {
+        deleter.join();
+    }
+    deleting = false;
+    reader.join();
+    tree.stopBackgroundCompaction();
+    EXPECT_EQ(failures, 0);
+    for (int i = 2; i < points.size(); i += 3) {
+        live[i] = false;
+    }
+    numLive = std::count(live.begin(), live.end(), true);
+    EXPECT_EQ(tree.getSize(), numLive);
+    tree.compact();
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), numLive);
+    checkQueries();
+
+    // Down to an empty tree and back
+    for (int i = 1; i < points.size(); i += 3) {
+        EXPECT_TRUE(tree.remove(points[i]));
+    }
+    tree.compact();
+    EXPECT_EQ(tree.getSize(), 0);
+    EXPECT_EQ(tree.getHeight(), 1);
+    EXPECT_TRUE(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).empty());
+    for (int i = 0; i < points.size(); ++i) {
+        tree.insert(points[i], i, i);
+    }
+    EXPECT_EQ(checkSubtree(tree, &config, tree.getRootID(), -1, tree.getHeight() - 1), points.size());
+}
+
+TEST(RStarTreeTest, QueryStats) {
+    GlobalParameters config = {8, 2};
+    RStarTree tree(&config);
+    std::vector<Point> points = randomPoints(4000, 2, 41);
+    std::vector<int> ids(points.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    tree.bulkLoad(points, ids, ids);
+
+    // A query covering everything visits every node once and tests every entry
+    QueryStats stats;
+    Region everything({0.0, 0.0}, {1.0, 1.0});
+    EXPECT_EQ(tree.rangeQuery(everything, &stats).size(), points.size());
+    EXPECT_EQ(stats.queries, 1);
+    EXPECT_EQ(stats.results, points.size());
+    ASSERT_EQ(stats.nodesVisited.size(), tree.getHeight());
+    EXPECT_EQ(stats.nodesVisited[tree.getHeight() - 1], 1);
+    EXPECT_EQ(stats.getLeavesVisited() + stats.getInteriorVisited(), tree.getNumNodes());
+    EXPECT_EQ(stats.overlapTests, tree.getNumNodes() - 1 + points.size());
+    EXPECT_EQ(stats.poolHits + stats.poolMisses, 0); // Nodes in memory
+    EXPECT_EQ(stats.bytesDeserialized, 0);
+    EXPECT_GT(stats.wallTime, 0.0);
+
+    // Queries add up
+    QueryStats single;
+    Region small({0.4, 0.4}, {0.45, 0.5});
+    std::vector<std::pair<int, int>> found = tree.rangeQuery(small, &single);
+    EXPECT_EQ(single.results, found.size());
+    EXPECT_LT(single.getLeavesVisited(), stats.getLeavesVisited());
+    QueryStats sum = stats;
+    sum += single;
+    tree.rangeQuery(small, &stats);
+    EXPECT_EQ(stats.queries, 2);
+    EXPECT_EQ(stats.results, sum.results);
+    EXPECT_EQ(stats.nodesVisited, sum.nodesVisited);
+    EXPECT_EQ(stats.overlapTests, sum.overlapTests);
+    stats.reset();
+    EXPECT_EQ(stats.queries, 0);
+    EXPECT_TRUE(stats.nodesVisited.empty());
+
+    // Lookups count a result only when the point is found
+    EXPECT_EQ(tree.findPoint(points[17], &stats), std::make_pair(17, 17));
+    EXPECT_EQ(tree.findPoint(Point({2.0, 2.0}), &stats), std::make_pair(-1, -1));
+    EXPECT_EQ(stats.queries, 2);
+    EXPECT_EQ(stats.results, 1);
+    EXPECT_GE(stats.getLeavesVisited(), 1);
+    EXPECT_EQ(stats.nodesVisited[tree.getHeight() - 1], 2);
+
+    stats.reset();
+    EXPECT_EQ(tree.nearestNeighbors(points[3], 5, &stats).size(), 5);
+    EXPECT_EQ(stats.results, 5);
+    EXPECT_GE(stats.getLeavesVisited(), 1);
+    EXPECT_LT(stats.getLeavesVisited() + stats.getInteriorVisited(), tree.getNumNodes());
+    EXPECT_GT(stats.overlapTests, 0);
+
+    // A batch counts each query like a single query would
+    std::vector<Region> queries = {everything, small, Region({0.9, 0.1}, {0.95, 0.3})};
+    std::vector<QueryStats> batchStats;
+    WorkStealingPool pool(4);
+    std::vector<std::vector<std::pair<int, int>>> batch = tree.rangeQueries(queries, pool, &batchStats);
+    ASSERT_EQ(batchStats.size(), queries.size());
+    for (int i = 0; i < queries.size(); ++i) {
+        QueryStats expected;
+        tree.rangeQuery(queries[i], &expected);
+        EXPECT_EQ(batchStats[i].queries, 1);
+        EXPECT_EQ(batchStats[i].results, batch[i].size());
+        EXPECT_EQ(batchStats[i].results, expected.results);
+        EXPECT_EQ(batchStats[i].nodesVisited, expected.nodesVisited);
+        EXPECT_EQ(batchStats[i].overlapTests, expected.overlapTests);
+    }
+}
@@ -250,4 +250,69 @@ TEST(TreeInteriorNodeTest, RangeQuery) {
     EXPECT_TRUE(result[0] == 2 || result[1] == 2 || result[2] == 2);
     EXPECT_TRUE(result[0] == 3 || result[1] == 3 || result[2] == 3);
     EXPECT_TRUE(result[0] == 4 || result[1] == 4 || result[2] == 4);
-}
\ No newline at end of file
+}
+
+TEST(TreeInteriorNodeTest, SerializeIntoSpan) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 3;
+
+    std::vector<int> childrenIDs = {2, -1, -1};
+    Region childrenBoundingBoxes[] = {
+        Region(std::vector<double> {0.0, 0.0}, std::vector<double> {0.5, 0.5}),
+        Region(),
+        Region()
+    };
+    TreeInteriorNode node(config, 1, 1, -1, childrenBoundingBoxes[0], childrenIDs, childrenBoundingBoxes);
+
+    std::vector<std::byte> page(TreeInteriorNode::getSerializedSize(config), std::byte{0x7f});
+    EXPECT_EQ(node.serializeInto(config, page), TreeInteriorNode::getSerializedSize(config));
+    TreeInteriorNode deserializedNode = TreeInteriorNode::deserialize(config, std::vector<char>(reinterpret_cast<char*>(page.data()), reinterpret_cast<char*>(page.data()) + page.size()));
+    EXPECT_EQ(deserializedNode.getChildrenIDs(), childrenIDs);
+    EXPECT_EQ(deserializedNode.getChildBoundingBox(0), childrenBoundingBoxes[0]);
+    // Empty slots are zero padded
+    EXPECT_EQ(page.back(), std::byte{0});
+
+    EXPECT_THROW(node.serializeInto(config, std::span(page).first(10)), std::invalid_argument);
+
+    delete config;
+}
+
+TEST(TreeInteriorNodeTest, QuantizedChildBoxes) {
+    Region rectangle(std::vector<double>{-1.0, 10.0}, std::vector<double>{3.0, 20.0});
+    std::vector<int> childrenIDs = {2, 3, 4, -1};
+    Region childrenBoundingBoxes[] = {
+        Region(std::vector<double> {-1.0, 10.0}, std::vector<double> {0.123456, 13.3333}),
+        Region(std::vector<double> {0.7, 12.5}, std::vector<double> {3.0, 20.0}),
+        Region(std::vector<double> {1.1, 15.0}, std::vector<double> {1.1, 15.0}), // A point
+        Region()
+    };
+    for (int bits : {8, 16}) {
+        GlobalParameters config = {4, 2, bits};
+        EXPECT_EQ(TreeInteriorNode::getSerializedSize(&config),
+                  TreeNode::getSerializedSize(&config) + 4 * (sizeof(int) + 2 * 2 * bits / 8));
+        TreeInteriorNode node(&config, 1, 1, -1, rectangle, childrenIDs, childrenBoundingBoxes);
+        std::vector<char> serializedData = node.serialize(&config);
+        EXPECT_EQ(serializedData.size(), TreeInteriorNode::getSerializedSize(&config));
+
+        TreeInteriorNode deserializedNode = TreeInteriorNode::deserialize(&config, serializedData);
+        EXPECT_EQ(deserializedNode.getBoundingBox(), rectangle);
+        EXPECT_EQ(deserializedNode.getChildrenIDs(), childrenIDs);
+        double step = 10.0 / ((1 << bits) - 1); // Of the widest dimension
+        for (int i = 0; i < 3; ++i) {
+            // Rounded outward, by less than a step
+            Region box = deserializedNode.getChildBoundingBox(i);
+            for (int d = 0; d < 2; ++d) {
+                EXPECT_LE(box.getStart()[d], childrenBoundingBoxes[i].getStart()[d]) << bits << " bits, child " << i;
+                EXPECT_GE(box.getEnd()[d], childrenBoundingBoxes[i].getEnd()[d]) << bits << " bits, child " << i;
+                EXPECT_LE(childrenBoundingBoxes[i].getStart()[d] - box.getStart()[d], step);
+                EXPECT_LE(box.getEnd()[d] - childrenBoundingBoxes[i].getEnd()[d], step);
+            }
+        }
+        // Coordinates on the node's border are exact
+        EXPECT_EQ(deserializedNode.getChildBoundingBox(0).getStart(), rectangle.getStart());
+        EXPECT_EQ(deserializedNode.getChildBoundingBox(1).getEnd(), rectangle.getEnd());
+        // Serializing what was read gives the same page
+        EXPECT_EQ(deserializedNode.serialize(&config), serializedData);
+    }
+}
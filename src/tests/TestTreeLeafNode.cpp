@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <cstring>
 #include "treeleafnode.h"
 
 
@@ -192,6 +193,33 @@ TEST(TreeLeafNodeTest, RemovePointByPoint) {
     delete config;
 }
 
+TEST(TreeLeafNodeTest, MarkDeleted) {
+    GlobalParameters config = {4, 2};
+    TreeLeafNode node = *createTestNode(&config);
+    Region box = node.getBoundingBox();
+
+    EXPECT_EQ(node.markDeleted(Point({0.1, 0.2})), 1);
+    EXPECT_EQ(node.markDeleted(Point({0.1, 0.2})), -1); // Already deleted
+    EXPECT_EQ(node.markDeleted(Point({0.9, 0.9})), -1);
+    EXPECT_TRUE(node.isDeleted(1));
+    EXPECT_FALSE(node.isDeleted(0));
+    EXPECT_EQ(node.getNumDeleted(), 1);
+    // The slot and the bounding box stay, but the point is no longer found
+    EXPECT_EQ(node.getNumChildren(), 3);
+    EXPECT_EQ(node.getBoundingBox(), box);
+    EXPECT_EQ(node.findPoint(Point({0.1, 0.2})), std::make_pair(-1, -1));
+    EXPECT_EQ(node.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), 2);
+    // The same point can come back
+    node.addPoint(&config, Point({0.1, 0.2}), 30, 300);
+    EXPECT_EQ(node.findPoint(Point({0.1, 0.2})), std::make_pair(30, 300));
+
+    // Tombstones are stored in the page
+    TreeLeafNode copy = TreeLeafNode::deserialize(&config, node.serialize(&config));
+    EXPECT_EQ(copy.getNumChildren(), 4);
+    EXPECT_TRUE(copy.isDeleted(1));
+    EXPECT_EQ(copy.getNumDeleted(), 1);
+}
+
 TEST(TreeLeafNodeTest, GetSerializedSize) {
     for (int dimensions = 1; dimensions <= 20; ++dimensions) {
         for (int maxChildren = 1; maxChildren <= 1000; ++maxChildren) {
@@ -235,4 +263,113 @@ TEST(TreeLeafNodeTest, SerializeAndDeserialize) {
     }
 
     delete config;
-}
\ No newline at end of file
+}
+
+TEST(TreeLeafNodeTest, SerializeIntoSpan) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 2;
+    config->maxChildren = 4;
+    TreeLeafNode node = *createTestNode(config);
+
+    // Written in place of a larger page, leaving the rest untouched
+    std::vector<std::byte> page(TreeLeafNode::getSerializedSize(config) + 16, std::byte{0x7f});
+    EXPECT_EQ(node.serializeInto(config, page), TreeLeafNode::getSerializedSize(config));
+    std::vector<char> serializedData = node.serialize(config);
+    EXPECT_EQ(std::memcmp(page.data(), serializedData.data(), serializedData.size()), 0);
+    EXPECT_EQ(page.back(), std::byte{0x7f});
+
+    // Too small for the node
+    EXPECT_THROW(node.serializeInto(config, std::span(page).first(TreeLeafNode::getSerializedSize(config) - 1)), std::invalid_argument);
+
+    delete config;
+}
+
+TEST(TreeLeafNodeTest, CoordinateAccess) {
+    GlobalParameters* config = new GlobalParameters;
+    config->dimensions = 3;
+    config->maxChildren = 4;
+    TreeLeafNode node(config, 1, 0, -1, Region(), {Point({0.1, 0.2, 0.3}), Point({0.4, 0.5, 0.6})}, {1, 2}, {10, 20});
+
+    EXPECT_EQ(node.getPoint(1), Point({0.4, 0.5, 0.6}));
+    EXPECT_DOUBLE_EQ(node.getCoordinate(0, 2), 0.3);
+    EXPECT_DOUBLE_EQ(node.squaredDistance(0, Point({0.1, 0.2, 1.3})), 1.0);
+    // The compatibility accessor still returns every slot
+    std::vector<Point> points = node.getPoints();
+    ASSERT_EQ(points.size(), 4);
+    EXPECT_EQ(points[0], Point({0.1, 0.2, 0.3}));
+    EXPECT_EQ(points[2], Point());
+
+    // Removing shifts the coordinates of the remaining points
+    EXPECT_EQ(node.removePoint(1, 10), 0);
+    EXPECT_EQ(node.getPoint(0), Point({0.4, 0.5, 0.6}));
+    EXPECT_EQ(node.findPoint(Point({0.4, 0.5, 0.6})), std::make_pair(2, 20));
+    EXPECT_EQ(node.getBoundingBox(), Region({0.4, 0.5, 0.6}, {0.4, 0.5, 0.6}));
+
+    // Points must match the dimensions of the node
+    EXPECT_THROW(node.addPoint(config, Point({0.7, 0.7}), 3, 30), std::invalid_argument);
+
+    delete config;
+}
+
+TEST(TreeLeafNodeTest, DeltaLeafRoundTrip) {
+    GlobalParameters config = {64, 3, 0, LEAF_FORMAT_DELTA};
+    GlobalParameters plainConfig = {64, 3};
+    // Values of any sign and magnitude come back bit for bit
+    std::vector<double> values = {0.0, -0.0, 1.0, -1.0, 0.1, -2.5e-300, 1e300, 3.0e-320, 0.30000000000000004, 12345.678};
+    for (double value : values) {
+        EXPECT_EQ(DeltaLeaf::fromOrdered(DeltaLeaf::toOrdered(value)), value);
+    }
+    std::sort(values.begin(), values.end());
+    for (size_t i = 1; i < values.size(); ++i) {
+        if (values[i - 1] < values[i]) {
+            EXPECT_LT(DeltaLeaf::toOrdered(values[i - 1]), DeltaLeaf::toOrdered(values[i]));
+        }
+    }
+
+    std::vector<Point> points;
+    std::vector<int> blockIDs, recordIDs;
+    for (int i = 0; i < 40; ++i) {
+        points.push_back(Point({0.5 + i * 1e-4, -0.25 - (i % 7) * 3e-5, values[i % values.size()]}));
+        blockIDs.push_back(1000 + i / 4);
+        recordIDs.push_back(i % 4);
+    }
+    TreeLeafNode node(&config, 9, 0, 2, Region(), {}, {}, {});
+    node.addPoints(&config, points, blockIDs, recordIDs);
+    node.markDeleted(points[5]);
+
+    std::vector<char> data = node.serialize(&config);
+    EXPECT_EQ(node.getEncodedSize(&config), TreeNode::getSerializedSize(&config) + node.getFootprint().getSize());
+    EXPECT_LT(node.getEncodedSize(&config), TreeLeafNode::getSerializedSize(&plainConfig));
+    TreeLeafNode deserialized = TreeLeafNode::deserialize(&config, data);
+    EXPECT_EQ(deserialized.getID(), 9);
+    EXPECT_EQ(deserialized.getParentID(), 2);
+    EXPECT_EQ(deserialized.getBoundingBox(), node.getBoundingBox());
+    ASSERT_EQ(deserialized.getNumChildren(), 40);
+    for (int i = 0; i < 40; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            EXPECT_EQ(std::bit_cast<uint64_t>(deserialized.getCoordinate(i, d)), std::bit_cast<uint64_t>(node.getCoordinate(i, d)));
+        }
+        EXPECT_EQ(deserialized.getBlockIDs()[i], node.getBlockIDs()[i]);
+        EXPECT_EQ(deserialized.getRecordIDs()[i], node.getRecordIDs()[i]);
+    }
+    EXPECT_TRUE(deserialized.isDeleted(5));
+    EXPECT_EQ(deserialized.getNumDeleted(), 1);
+    EXPECT_EQ(deserialized.findPoint(points[6]), std::make_pair(1001, 2));
+
+    // Half of maxChildren always fits, whatever the values; more points may not
+    TreeLeafNode worst(&config, 3, 0, -1, Region());
+    for (int i = 0; i < config.maxChildren / 2 + 1; ++i) {
+        double sign = i % 2 ? -1.0 : 1.0;
+        worst.addPoint(&config, Point({sign * 1e300 / (i + 1), -sign * 1e299 * (i + 1), sign * i}), i % 2 ? INT_MAX - i : i, INT_MAX - i);
+    }
+    std::vector<std::byte> page(TreeLeafNode::getSerializedSize(&config));
+    EXPECT_NO_THROW(worst.serializeInto(&config, page));
+    worst.addPoint(&config, Point({5e299, 7e-301, 3.5}), 77, INT_MAX);
+    EXPECT_THROW(worst.serializeInto(&config, page), std::invalid_argument);
+
+    // Empty leaves, and bytes that are not an encoding of this version
+    TreeLeafNode empty(&config, 4, 0, -1, Region());
+    EXPECT_EQ(TreeLeafNode::deserialize(&config, empty.serialize(&config)).getNumChildren(), 0);
+    data[TreeNode::getSerializedSize(&config)] = 7;
+    EXPECT_THROW(TreeLeafNode::deserialize(&config, data), std::invalid_argument);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include "workstealingpool.h"
+
+TEST(WorkStealingPoolTest, RunsAllTasks) {
+    WorkStealingPool pool(4);
+    EXPECT_EQ(pool.getNumThreads(), 4);
+    std::atomic<long long> sum = 0;
+    for (int i = 1; i <= 1000; ++i) {
+        pool.submit([&sum, i]() { sum += i; });
+    }
+    pool.wait();
+    EXPECT_EQ(sum, 500500);
+
+    // The pool can be reused after wait
+    pool.submit([&sum]() { sum = 0; });
+    pool.wait();
+    EXPECT_EQ(sum, 0);
+}
+
+// Tasks that submit tasks: a binary tree of depth 12 split across the workers
+void spawn(WorkStealingPool& pool, std::atomic<int>& leaves, int depth) {
+    if (depth == 0) {
+        leaves++;
+        return;
+    }
+    pool.submit([&pool, &leaves, depth]() { spawn(pool, leaves, depth - 1); });
+    spawn(pool, leaves, depth - 1);
+}
+
+TEST(WorkStealingPoolTest, NestedTasks) {
+    WorkStealingPool pool(3);
+    std::atomic<int> leaves = 0;
+    pool.submit([&pool, &leaves]() { spawn(pool, leaves, 12); });
+    pool.wait();
+    EXPECT_EQ(leaves, 1 << 12);
+}
+
+TEST(WorkStealingPoolTest, RethrowsTaskException) {
+    WorkStealingPool pool(2);
+    std::atomic<int> ran = 0;
+    for (int i = 0; i < 10; ++i) {
+        pool.submit([&ran, i]() {
+            ran++;
+            if (i == 5) {
+                throw std::runtime_error("task failed");
+            }
+        });
+    }
+    EXPECT_THROW(pool.wait(), std::runtime_error);
+    EXPECT_EQ(ran, 10); // The other tasks still run
+
+    pool.submit([&ran]() { ran++; });
+    EXPECT_NO_THROW(pool.wait());
+    EXPECT_EQ(ran, 11);
+    EXPECT_THROW(WorkStealingPool(-1), std::invalid_argument);
+}
+
+TEST(WorkStealingPoolTest, TaskGroups) {
+    WorkStealingPool pool(2);
+    std::atomic<bool> release = false;
+    std::atomic<int> ran = 0;
+
+    // A group blocked on a slow task does not hold up the wait of another group
+    TaskGroup slow(pool);
+    slow.submit([&release]() {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    TaskGroup fast(pool);
+    for (int i = 0; i < 100; ++i) {
+        fast.submit([&fast, &ran]() {
+            fast.submit([&ran]() { ran++; }); // Subtasks belong to the group too
+        });
+    }
+    fast.submit([]() { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(fast.wait(), std::runtime_error);
+    EXPECT_EQ(ran, 100);
+    EXPECT_FALSE(release);
+
+    release = true;
+    EXPECT_NO_THROW(slow.wait());
+    EXPECT_NO_THROW(pool.wait()); // The group's exception stays with the group
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "writeaheadlog.h"
+#include "rstartree.h"
+
+struct LogFiles {
+    std::string tree, data, log;
+};
+
+// Fresh paths in the temp directory for each test
+LogFiles tempLogFiles(const std::string& name) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    LogFiles files = {(directory / ("rstartree_wal_" + name + "_tree.bin")).string(),
+        (directory / ("rstartree_wal_" + name + "_data.bin")).string(),
+        (directory / ("rstartree_wal_" + name + ".log")).string()};
+    for (const std::string& file : {files.tree, files.data, files.log}) {
+        std::filesystem::remove(file);
+    }
+    return files;
+}
+
+void removeLogFiles(const LogFiles& files) {
+    for (const std::string& file : {files.tree, files.data, files.log}) {
+        std::filesystem::remove(file);
+    }
+}
+
+Point logTestPoint(int i) {
+    return Point({(i * 7919 % 10007) / 10007.0, (i * 104729 % 9973) / 9973.0});
+}
+
+// Runs work in a child process that then dies without running any destructor, like a crash:
+// nothing still in the tree pool reaches the file, and nothing is checkpointed
+void crashAfter(const std::function<void()>& work) {
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        work();
+        _exit(0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+// Open the tree with its log (recovering it) and check that points 0..count-1 are all there
+void expectRecovered(const LogFiles& files, GlobalParameters config, int count) {
+    Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+    WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+    RStarTree tree(&config, &buffer, &wal);
+    EXPECT_EQ(tree.getSize(), count);
+    for (int i = 0; i < count; ++i) {
+        EXPECT_EQ(tree.findPoint(logTestPoint(i)), std::make_pair(i, 0));
+    }
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), count);
+    EXPECT_EQ(wal.getSize(), WAL_HEADER_SIZE); // Checkpointed after recovery
+}
+
+TEST(WriteAheadLogTest, GroupCommit) {
+    LogFiles files = tempLogFiles("group");
+    GlobalParameters config = {8, 2};
+    BlockFile file(files.tree, &config);
+    BufferPool pool(&file, 4 * file.getPageSize());
+    WriteAheadLog wal(files.log, &file, &pool);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&wal, t]() {
+            for (int i = 0; i < 100; ++i) {
+                wal.commit(wal.append(WALRecordType::Insert, Storable::serializeInt(t * 1000 + i)));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    WALStats stats = wal.getStats();
+    EXPECT_EQ(stats.records, 800);
+    EXPECT_EQ(stats.commits, 800);
+    EXPECT_LE(stats.syncs, stats.commits); // Each sync covers one or more commits
+    EXPECT_EQ(wal.getSize(), WAL_HEADER_SIZE + 800 * (WAL_RECORD_HEADER_SIZE + sizeof(int)));
+    EXPECT_EQ(std::filesystem::file_size(files.log), wal.getSize());
+    removeLogFiles(files);
+}
+
+TEST(WriteAheadLogTest, RecoversCommittedInserts) {
+    LogFiles files = tempLogFiles("crash");
+    GlobalParameters config = {8, 2};
+    int count = 3000;
+    crashAfter([&]() {
+        // A pool of 8 pages evicts (and overwrites in the file) pages all the time
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        for (int i = 0; i < count; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+        if (wal.getStats().pageImages == 0) {
+            _exit(1);
+        }
+    });
+    expectRecovered(files, config, count);
+    // Recovered and checkpointed: opening again changes nothing
+    expectRecovered(files, config, count);
+    removeLogFiles(files);
+}
+
+TEST(WriteAheadLogTest, RecoversFromCheckpoint) {
+    LogFiles files = tempLogFiles("checkpoint");
+    GlobalParameters config = {6, 2};
+    crashAfter([&]() {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+        tree.checkpoint();
+        for (int i = 1000; i < 2000; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+    });
+    expectRecovered(files, config, 2000);
+    removeLogFiles(files);
+}
+
+// Points still in the insert buffers at the crash are in the log like any other insert
+TEST(WriteAheadLogTest, RecoversBufferedInserts) {
+    LogFiles files = tempLogFiles("buffered");
+    GlobalParameters config = {6, 2};
+    crashAfter([&]() {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        tree.setInsertBuffering(32);
+        for (int i = 0; i < 1500; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+        if (tree.getNumBuffered() == 0) {
+            _exit(1);
+        }
+    });
+    expectRecovered(files, config, 1500);
+    removeLogFiles(files);
+}
+
+// Deletes are redone like inserts, whether the point was in a leaf or still in an insert buffer
+TEST(WriteAheadLogTest, RecoversDeletes) {
+    LogFiles files = tempLogFiles("delete");
+    GlobalParameters config = {6, 2};
+    crashAfter([&]() {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+        tree.checkpoint();
+        tree.setInsertBuffering(32);
+        for (int i = 1000; i < 1500; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+        for (int i = 0; i < 1500; i += 3) {
+            if (!tree.remove(logTestPoint(i))) {
+                _exit(1);
+            }
+        }
+    });
+
+    Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+    WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+    RStarTree tree(&config, &buffer, &wal);
+    EXPECT_EQ(tree.getSize(), 1000);
+    for (int i = 0; i < 1500; ++i) {
+        EXPECT_EQ(tree.findPoint(logTestPoint(i)), i % 3 == 0 ? std::make_pair(-1, -1) : std::make_pair(i, 0));
+    }
+    EXPECT_EQ(tree.rangeQuery(Region({0.0, 0.0}, {1.0, 1.0})).size(), 1000);
+    removeLogFiles(files);
+}
+
+TEST(WriteAheadLogTest, IgnoresTornTail) {
+    LogFiles files = tempLogFiles("torn");
+    GlobalParameters config = {8, 2};
+    crashAfter([&]() {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        for (int i = 0; i < 500; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+    });
+    {
+        // Half of a record, as a crash in the middle of a group's write leaves it
+        std::ofstream log(files.log, std::ios::binary | std::ios::app);
+        std::vector<char> record(WAL_RECORD_HEADER_SIZE + 20, 1);
+        log.write(record.data(), record.size() / 2);
+    }
+    expectRecovered(files, config, 500);
+    removeLogFiles(files);
+}
+
+TEST(WriteAheadLogTest, CleanShutdownAndBulkLoad) {
+    LogFiles files = tempLogFiles("clean");
+    GlobalParameters config = {8, 2};
+    std::vector<Point> points;
+    std::vector<int> blockIDs, recordIDs;
+    for (int i = 0; i < 800; ++i) {
+        points.push_back(logTestPoint(i));
+        blockIDs.push_back(i);
+        recordIDs.push_back(0);
+    }
+    crashAfter([&]() {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        tree.bulkLoad(points, blockIDs, recordIDs, 0.7); // Not logged, checkpointed instead
+        for (int i = 800; i < 900; ++i) {
+            tree.insert(logTestPoint(i), i, 0);
+        }
+    });
+    expectRecovered(files, config, 900);
+    {
+        Buffer buffer(&config, files.tree, files.data, 8 * BlockFile::pageSizeFor(&config));
+        WriteAheadLog wal(files.log, buffer.getTreeFile(), buffer.getTreePool());
+        RStarTree tree(&config, &buffer, &wal);
+        tree.insert(logTestPoint(900), 900, 0);
+        EXPECT_THROW(RStarTree(&config, nullptr, &wal), std::invalid_argument);
+    }
+    // The destructors checkpoint, so the log is empty
+    EXPECT_EQ(std::filesystem::file_size(files.log), WAL_HEADER_SIZE);
+    expectRecovered(files, config, 901);
+    removeLogFiles(files);
+}